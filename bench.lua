@@ -0,0 +1,263 @@
+--[[
+  Compile time benchmarks, ran via "lua build.lua -bench" (which builds the
+  driver first). Every corpus file gets compiled at -O0 and -O1 across a range
+  of thread counts using -Tstats, the best of a few runs is kept and then
+  compared against the saved baseline.
+
+    -bench_save        write the results as the new baseline
+    -bench_reps=N      runs per configuration (default 3)
+    -bench_threads=N   max thread count (default: core count)
+    -bench_tolerance=N allowed slowdown in percent (default 10)
+--]]
+
+local is_windows = package.config:sub(1,1) == "\\"
+
+local out_dir       = "bin/bench"
+local baseline_path = "tests/bench_baseline.json"
+local results_path  = out_dir.."/results.json"
+
+local cuik = is_windows and "bin\\cuik.exe" or "bin/cuik"
+
+local save      = false
+local reps      = 3
+local tolerance = 10
+local max_threads = nil
+
+for i = 1, #arg do
+	local k, v = arg[i]:match("^%-bench_(%w+)=?(.*)")
+	if k == "save" then save = true
+	elseif k == "reps" then reps = tonumber(v)
+	elseif k == "threads" then max_threads = tonumber(v)
+	elseif k == "tolerance" then tolerance = tonumber(v)
+	end
+end
+
+if max_threads == nil then
+	if is_windows then
+		max_threads = tonumber(os.getenv("NUMBER_OF_PROCESSORS"))
+	else
+		local p = io.popen("nproc 2>/dev/null || sysctl -n hw.ncpu")
+		max_threads = tonumber(p:read("*l"))
+		p:close()
+	end
+	max_threads = max_threads or 1
+end
+
+if is_windows then
+	os.execute("if not exist bin\\bench mkdir bin\\bench")
+else
+	os.execute("mkdir -p "..out_dir)
+end
+
+------------------------------------------------
+-- generated stress inputs
+------------------------------------------------
+function write_file(path, str)
+	local f = io.open(path, "wb")
+	f:write(str)
+	f:close()
+	return path
+end
+
+-- one giant function, stresses the per-function passes (regalloc, scheduling)
+function gen_huge_function(n)
+	local b = { "int huge(int* arr, int x) {\n", "    int a = x, b = x * 3, c = 7;\n" }
+	for i = 1, n do
+		b[#b + 1] = string.format("    a = (a ^ (b + %d)) * c; if (a & %d) { b += arr[%d]; } else { c -= b >> 3; }\n", i, i % 64 + 1, i % 128)
+	end
+	b[#b + 1] = "    return a + b + c;\n}\n"
+	return table.concat(b)
+end
+
+-- lots of tiny functions, stresses symbol creation and the per-function scheduler
+function gen_many_functions(n)
+	local b = {}
+	for i = 1, n do
+		b[#b + 1] = string.format("static int fn%d(int x) { return x * %d + (x >> %d); }\n", i, i, i % 31)
+	end
+	b[#b + 1] = "int many(int x) {\n"
+	for i = 1, n do
+		b[#b + 1] = string.format("    x = fn%d(x);\n", i)
+	end
+	b[#b + 1] = "    return x;\n}\n"
+	return table.concat(b)
+end
+
+-- deeply nested macro expansions, stresses the preprocessor
+function gen_deep_macros(depth, uses)
+	local b = { "#define M0(x) ((x) + 1)\n", "#define L0(x) (x)\n" }
+	-- each M level doubles the expansions so keep it shallow, L is the deep linear chain
+	for i = 1, 6 do
+		b[#b + 1] = string.format("#define M%d(x) M%d(M%d(x) * 2)\n", i, i - 1, i - 1)
+	end
+	for i = 1, depth do
+		b[#b + 1] = string.format("#define L%d(x) M2(L%d(x))\n", i, i - 1)
+	end
+	for i = 1, uses do
+		b[#b + 1] = string.format("int deep%d(int x) { return M6(x) + L%d(x); }\n", i, depth)
+	end
+	return table.concat(b)
+end
+
+-- header heavy TUs, mostly preprocessor and parser work
+function gen_sqlite_tu(i)
+	return string.format([[
+#include "../../tests/sqlite3.h"
+
+int bench_sqlite%d(sqlite3* db, const char* sql) {
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, 0) != SQLITE_OK) return -1;
+    int rows = 0;
+    while (sqlite3_step(stmt) == SQLITE_ROW) rows += sqlite3_column_int(stmt, 0);
+    sqlite3_finalize(stmt);
+    return rows;
+}
+]], i)
+end
+
+local corpus = {
+	"tests/nbody.c",
+	"tests/loop.c",
+	write_file(out_dir.."/sqlite_1.c", gen_sqlite_tu(1)),
+	write_file(out_dir.."/sqlite_2.c", gen_sqlite_tu(2)),
+	write_file(out_dir.."/huge_function.c", gen_huge_function(500)),
+	write_file(out_dir.."/many_functions.c", gen_many_functions(3000)),
+	write_file(out_dir.."/deep_macros.c", gen_deep_macros(64, 20)),
+}
+
+local thread_counts = { 1 }
+do
+	local t = 2
+	while t < max_threads do
+		thread_counts[#thread_counts + 1] = t
+		t = t * 2
+	end
+	if max_threads > 1 then thread_counts[#thread_counts + 1] = max_threads end
+end
+
+------------------------------------------------
+-- running
+------------------------------------------------
+function read_stats(path)
+	local f = io.open(path, "rb")
+	if f == nil then return nil end
+	local str = f:read("*a")
+	f:close()
+
+	local s = {
+		wall_ms       = tonumber(str:match('"wall_ms": ([%d%.]+)')),
+		peak_rss_kb   = tonumber(str:match('"peak_rss_kb": (%d+)')),
+		lines         = tonumber(str:match('"lines": (%d+)')),
+		lines_per_sec = tonumber(str:match('"lines_per_sec": ([%d%.]+)')),
+		phases        = {},
+	}
+
+	for name, ms in str:gmatch('"([^"]+)": { "ms": ([%d%.]+)') do
+		s.phases[name] = tonumber(ms)
+	end
+	return s
+end
+
+local stats_path = out_dir.."/stats.json"
+local results = {}
+local order = {}
+
+for _, file in ipairs(corpus) do
+	for opt = 0, 1 do
+		for _, threads in ipairs(thread_counts) do
+			local key = string.format("%s -O%d -j%d", file, opt, threads)
+			local cmd = string.format("%s -c %s -o %s/out.o -O%d -j%d -Tstats %s", cuik, file, out_dir, opt, threads, stats_path)
+
+			local best = nil
+			for r = 1, reps do
+				os.remove(stats_path)
+				local ok = os.execute(cmd)
+				local s = read_stats(stats_path)
+				if not ok or s == nil then
+					print("error: failed to run '"..cmd.."'")
+					os.exit(1)
+				end
+
+				-- best of N is the least noisy for wall time, peak memory should be stable anyways
+				if best == nil or s.wall_ms < best.wall_ms then best = s end
+			end
+
+			print(string.format("%-40s %9.2f ms %8d KiB %10.0f lines/s", key, best.wall_ms, best.peak_rss_kb, best.lines_per_sec))
+			results[key] = best
+			order[#order + 1] = key
+		end
+	end
+end
+
+function write_results(path)
+	local f = io.open(path, "wb")
+	f:write("{\n")
+	for i, key in ipairs(order) do
+		local s = results[key]
+		f:write(string.format('  "%s": {\n', key))
+		f:write(string.format('    "wall_ms": %.3f,\n', s.wall_ms))
+		f:write(string.format('    "peak_rss_kb": %d,\n', s.peak_rss_kb))
+		f:write(string.format('    "lines": %d,\n', s.lines))
+		f:write(string.format('    "lines_per_sec": %.1f,\n', s.lines_per_sec))
+		f:write('    "phases": {')
+
+		local names = {}
+		for name, _ in pairs(s.phases) do names[#names + 1] = name end
+		table.sort(names)
+		for j, name in ipairs(names) do
+			f:write(string.format('%s\n      "%s": %.3f', j > 1 and "," or "", name, s.phases[name]))
+		end
+		f:write("\n    }\n")
+		f:write(i < #order and "  },\n" or "  }\n")
+	end
+	f:write("}\n")
+	f:close()
+end
+
+write_results(results_path)
+print("wrote "..results_path)
+
+if save then
+	write_results(baseline_path)
+	print("saved baseline to "..baseline_path)
+	return
+end
+
+------------------------------------------------
+-- regressions
+------------------------------------------------
+local f = io.open(baseline_path, "rb")
+if f == nil then
+	print("no baseline at "..baseline_path..", run with -bench_save to make one")
+	return
+end
+local baseline = f:read("*a")
+f:close()
+
+local failed = false
+for _, key in ipairs(order) do
+	local pattern = '"'..key:gsub("%p", "%%%0")..'": {(.-)}'
+	local entry = baseline:match(pattern)
+	if entry ~= nil then
+		local s = results[key]
+		local old_ms  = tonumber(entry:match('"wall_ms": ([%d%.]+)'))
+		local old_rss = tonumber(entry:match('"peak_rss_kb": (%d+)'))
+
+		-- small inputs are mostly noise, give them a millisecond of slack
+		local limit = 1.0 + tolerance / 100.0
+		if old_ms and s.wall_ms > old_ms * limit + 1.0 then
+			print(string.format("REGRESSION %s: %.2f ms -> %.2f ms", key, old_ms, s.wall_ms))
+			failed = true
+		end
+
+		if old_rss and s.peak_rss_kb > old_rss * limit then
+			print(string.format("REGRESSION %s: %d KiB -> %d KiB", key, old_rss, s.peak_rss_kb))
+			failed = true
+		end
+	end
+end
+
+if failed then
+	os.exit(1)
+end
+print("no regressions against "..baseline_path)
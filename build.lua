@@ -23,6 +23,7 @@ local options = {
 	cuik          = false,
 	tb            = false,
 	tests         = false,
+	hash_bench    = false,
 	driver        = false,
 	shared        = false,
 	test          = false,
@@ -30,7 +31,8 @@ local options = {
 	lld           = false,
 	gcc           = false,
 	asan          = false,
-	spall_auto    = false
+	spall_auto    = false,
+	bench         = false
 }
 
 -- Cuik/TB are broken down into several pieces
@@ -50,6 +52,8 @@ local modules = {
 	forth        = { is_exe=true, srcs={"forth/forth.c"}, deps={"common", "tb"}, flags="-I libCuik/include" },
 	--   TB unittests
 	tests        = { is_exe=true, srcs={"tb/tests/cg_test.c"}, deps={"tb", "common"} },
+	--   hash map/set microbenchmarks
+	hash_bench   = { is_exe=true, srcs={"tb/tests/hash_bench.c"}, deps={"common"} },
 
 	-- external dependencies
 	mimalloc = { srcs={"mimalloc/src/static.c"} }
@@ -62,6 +66,11 @@ for i = 1, #arg do
 	end
 end
 
+-- benchmarks need the driver
+if options.bench then
+	options.driver = true
+end
+
 local ldflags = ""
 local cflags = " -g -march=haswell -I common -Wall -Werror -Wno-unused -Wno-deprecated -DMI_SKIP_COLLECT_ON_EXIT -DCUIK_ALLOW_THREADS -I mimalloc/include"
 
@@ -234,6 +243,10 @@ rule("run", {
 command("bin/objs/lexgen"..exe_ext, "libCuik/meta/lexgen.c", cc.." $in -O1 -o $out")
 command("libCuik/lib/preproc/keywords.h libCuik/lib/preproc/dfa.h", "bin/objs/lexgen"..exe_ext, "bin/objs/lexgen"..exe_ext)
 
+-- peephole rules metaprogram
+command("bin/objs/peepgen"..exe_ext, "tb/meta/peepgen.c", cc.." $in -O1 -o $out")
+command("tb/src/opt/peeps.h", "tb/src/opt/peeps.rules", "bin/objs/peepgen"..exe_ext.." $in $out", "bin/objs/peepgen"..exe_ext)
+
 -- package freestanding headers into C file
 local x = {}
 if is_windows then
@@ -263,6 +276,8 @@ for i, f in ipairs(src) do
 	ninja:write("build "..out..": cc "..f)
 	if out == "bin/objs/libcuik.o" then
 		ninja:write(" | libCuik/lib/preproc/keywords.h libCuik/lib/preproc/dfa.h\n")
+	elseif out == "bin/objs/libtb.o" then
+		ninja:write(" | tb/src/opt/peeps.h\n")
 	else
 		ninja:write("\n")
 	end
@@ -275,6 +290,7 @@ local exe_name = "cuik"
 if options.tb    then exe_name = "tb" end
 if options.tests then exe_name = "tests" end
 if options.forth then exe_name = "forth" end
+if options.hash_bench then exe_name = "hash_bench" end
 
 -- placing executables into bin/
 exe_name = "bin/"..exe_name
@@ -292,3 +308,7 @@ ninja:close()
 
 local _0, _1, res = os.execute("ninja")
 if res ~= 0 then os.exit(res) end
+
+if options.bench then
+	dofile("bench.lua")
+end
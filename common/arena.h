@@ -30,7 +30,8 @@ enum {
 typedef struct TB_ArenaChunk TB_ArenaChunk;
 struct TB_ArenaChunk {
     TB_ArenaChunk* next;
-    size_t pad;
+    // usually the arena's chunk_size but oversized allocations get their own chunk
+    size_t size;
     char data[];
 };
 
@@ -1,8 +1,11 @@
 // Common is just a bunch of crap i want accessible to all projects in the Cuik repo
+#include "common.h"
 #include "arena.h"
 #include "futex.h"
 #include <stdatomic.h>
 
+#include <threads.h>
+
 #ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
@@ -24,6 +27,43 @@
 uint64_t cuik__page_size = 0;
 uint64_t cuik__page_mask = 0;
 
+// running totals for the profiler's counters (see perf.c)
+_Thread_local uint64_t cuikperf__arena_bytes;
+_Thread_local uint64_t cuikperf__valloc_bytes;
+
+#if defined(CUIK_USE_MIMALLOC) || defined(TB_USE_MIMALLOC)
+_Thread_local Cuik_Heap* cuik__heap;
+
+Cuik_Heap* cuik_heap_create(void) {
+    return mi_heap_new();
+}
+
+void cuik_heap_destroy(Cuik_Heap* heap) {
+    if (heap != NULL) {
+        assert(cuik__heap != heap && "destroying the current heap");
+        mi_heap_destroy(heap);
+    }
+}
+
+void cuik_heap_release(Cuik_Heap* heap) {
+    if (heap != NULL) {
+        assert(cuik__heap != heap && "releasing the current heap");
+        mi_heap_delete(heap);
+    }
+}
+
+Cuik_Heap* cuik_heap_enter(Cuik_Heap* heap) {
+    Cuik_Heap* old = cuik__heap;
+    cuik__heap = heap;
+    return old;
+}
+#else
+Cuik_Heap* cuik_heap_create(void) { return NULL; }
+void cuik_heap_destroy(Cuik_Heap* heap) {}
+void cuik_heap_release(Cuik_Heap* heap) {}
+Cuik_Heap* cuik_heap_enter(Cuik_Heap* heap) { return NULL; }
+#endif
+
 void cuik_init_terminal(void) {
     #if _WIN32
     // Raw input mode
@@ -52,11 +92,13 @@ void* cuik__valloc(size_t size) {
 
     // round size to page size
     size = (size + cuik__page_mask) & ~cuik__page_mask;
+    cuikperf__valloc_bytes += size;
 
     return VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
     #else
     cuik__page_size = 4096;
     cuik__page_mask = 4095;
+    cuikperf__valloc_bytes += size;
 
     return mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
     #endif
@@ -70,6 +112,183 @@ void cuik__vfree(void* ptr, size_t size) {
     #endif
 }
 
+////////////////////////////////
+// Arena chunk pool
+////////////////////////////////
+// Arenas get made and killed constantly (every function's passes, every build
+// step, the linker) so the standard sized chunks are recycled rather than going
+// back to the OS. Each thread caches a few without locking, the rest sit in a
+// global pool where the OS is free to take the pages back (MADV_FREE) while we
+// keep the mapping. Large chunks are 2MiB aligned so they can use huge pages.
+enum {
+    ARENA_POOL_SMALL,
+    ARENA_POOL_MEDIUM,
+    ARENA_POOL_LARGE,
+    ARENA_POOL_COUNT,
+
+    ARENA_HUGE_PAGE_SIZE = 2 * 1024 * 1024,
+};
+
+typedef struct {
+    TB_ArenaChunk* head;
+    size_t count;
+} ArenaChunkList;
+
+static const size_t arena_pool_sizes[ARENA_POOL_COUNT] = { TB_ARENA_SMALL_CHUNK_SIZE, TB_ARENA_MEDIUM_CHUNK_SIZE, TB_ARENA_LARGE_CHUNK_SIZE };
+
+// how many chunks each thread holds onto and how many the pool keeps
+static const size_t arena_pool_thread_cap[ARENA_POOL_COUNT] = { 64, 8, 2 };
+static const size_t arena_pool_global_cap[ARENA_POOL_COUNT] = { 1024, 64, 16 };
+
+static _Thread_local ArenaChunkList arena_thread_cache[ARENA_POOL_COUNT];
+static _Thread_local bool arena_thread_registered;
+
+static ArenaChunkList arena_pool[ARENA_POOL_COUNT];
+static mtx_t arena_pool_lock;
+static tss_t arena_pool_tss;
+static once_flag arena_pool_once = ONCE_FLAG_INIT;
+
+static int arena_pool_class(size_t size) {
+    for (int i = 0; i < ARENA_POOL_COUNT; i++) {
+        if (arena_pool_sizes[i] == size) return i;
+    }
+    return -1;
+}
+
+static TB_ArenaChunk* arena_list_pop(ArenaChunkList* l) {
+    TB_ArenaChunk* c = l->head;
+    if (c != NULL) {
+        l->head = c->next;
+        l->count--;
+    }
+    return c;
+}
+
+static void arena_list_push(ArenaChunkList* l, TB_ArenaChunk* c) {
+    c->next = l->head;
+    l->head = c;
+    l->count++;
+}
+
+static TB_ArenaChunk* arena_chunk_valloc(size_t size) {
+    #if defined(__linux__) && defined(MADV_HUGEPAGE)
+    if (size >= ARENA_HUGE_PAGE_SIZE) {
+        // over-allocate so we can trim it down to a huge page boundary
+        size_t padded = size + ARENA_HUGE_PAGE_SIZE;
+        char* ptr = mmap(NULL, padded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ptr == MAP_FAILED) {
+            return NULL;
+        }
+
+        char* aligned = (char*) (((uintptr_t) ptr + ARENA_HUGE_PAGE_SIZE - 1) & -(uintptr_t) ARENA_HUGE_PAGE_SIZE);
+        if (aligned != ptr) {
+            munmap(ptr, aligned - ptr);
+        }
+        munmap(aligned + size, (ptr + padded) - (aligned + size));
+
+        madvise(aligned, size, MADV_HUGEPAGE);
+        cuikperf__valloc_bytes += size;
+        return (TB_ArenaChunk*) aligned;
+    }
+    #endif
+
+    return cuik__valloc(size);
+}
+
+// the chunk is going idle, the OS can have the pages back whenever (the
+// header stays put since we're still using it for the free list)
+static void arena_chunk_idle(TB_ArenaChunk* c) {
+    #if defined(_WIN32)
+    if (c->size > 4096) {
+        VirtualAlloc((char*) c + 4096, c->size - 4096, MEM_RESET, PAGE_READWRITE);
+    }
+    #elif defined(MADV_FREE)
+    if (c->size > 4096) {
+        madvise((char*) c + 4096, c->size - 4096, MADV_FREE);
+    }
+    #else
+    if (c->size > 4096) {
+        madvise((char*) c + 4096, c->size - 4096, MADV_DONTNEED);
+    }
+    #endif
+}
+
+// thread's dying, give the rest of the world its chunks
+static void arena_pool_flush_thread(void* arg) {
+    for (int i = 0; i < ARENA_POOL_COUNT; i++) {
+        TB_ArenaChunk* c;
+        while ((c = arena_list_pop(&arena_thread_cache[i])) != NULL) {
+            arena_chunk_idle(c);
+
+            mtx_lock(&arena_pool_lock);
+            bool kept = arena_pool[i].count < arena_pool_global_cap[i];
+            if (kept) arena_list_push(&arena_pool[i], c);
+            mtx_unlock(&arena_pool_lock);
+
+            if (!kept) cuik__vfree(c, c->size);
+        }
+    }
+}
+
+static void arena_pool_init(void) {
+    mtx_init(&arena_pool_lock, mtx_plain);
+    tss_create(&arena_pool_tss, arena_pool_flush_thread);
+}
+
+static TB_ArenaChunk* arena_chunk_alloc(size_t size) {
+    int i = arena_pool_class(size);
+    if (i >= 0) {
+        TB_ArenaChunk* c = arena_list_pop(&arena_thread_cache[i]);
+        if (c != NULL) {
+            return c;
+        }
+
+        call_once(&arena_pool_once, arena_pool_init);
+        mtx_lock(&arena_pool_lock);
+        c = arena_list_pop(&arena_pool[i]);
+        mtx_unlock(&arena_pool_lock);
+
+        if (c != NULL) {
+            return c;
+        }
+    }
+
+    TB_ArenaChunk* c = arena_chunk_valloc(size);
+    c->size = size;
+    return c;
+}
+
+static void arena_chunk_free(TB_ArenaChunk* c) {
+    int i = arena_pool_class(c->size);
+    if (i >= 0) {
+        call_once(&arena_pool_once, arena_pool_init);
+
+        if (arena_thread_cache[i].count < arena_pool_thread_cap[i]) {
+            // the destructor only runs for threads with a non-NULL value
+            if (!arena_thread_registered) {
+                arena_thread_registered = true;
+                tss_set(arena_pool_tss, arena_thread_cache);
+            }
+
+            arena_list_push(&arena_thread_cache[i], c);
+            return;
+        }
+
+        arena_chunk_idle(c);
+
+        mtx_lock(&arena_pool_lock);
+        bool kept = arena_pool[i].count < arena_pool_global_cap[i];
+        if (kept) arena_list_push(&arena_pool[i], c);
+        mtx_unlock(&arena_pool_lock);
+
+        if (kept) {
+            return;
+        }
+    }
+
+    cuik__vfree(c, c->size);
+}
+
 ////////////////////////////////
 // TB_Arenas
 ////////////////////////////////
@@ -79,7 +298,7 @@ void tb_arena_create(TB_Arena* restrict arena, size_t chunk_size) {
     }
 
     // allocate initial chunk
-    TB_ArenaChunk* c = cuik__valloc(chunk_size);
+    TB_ArenaChunk* c = arena_chunk_alloc(chunk_size);
     c->next = NULL;
 
     arena->chunk_size = chunk_size;
@@ -92,23 +311,30 @@ void tb_arena_destroy(TB_Arena* restrict arena) {
     TB_ArenaChunk* c = arena->base;
     while (c != NULL) {
         TB_ArenaChunk* next = c->next;
-        cuik__vfree(c, arena->chunk_size);
+        arena_chunk_free(c);
         c = next;
     }
 }
 
 void* tb_arena_unaligned_alloc(TB_Arena* restrict arena, size_t size) {
+    cuikperf__arena_bytes += size;
     if (LIKELY(arena->watermark + size < arena->high_point)) {
         char* ptr = arena->watermark;
         arena->watermark += size;
         return ptr;
     } else {
         // slow path, we need to allocate more
-        TB_ArenaChunk* c = cuik__valloc(arena->chunk_size);
+        size_t chunk_size = arena->chunk_size;
+        if (size + sizeof(TB_ArenaChunk) > chunk_size) {
+            // doesn't fit in a normal chunk, make a big enough one
+            chunk_size = (size + sizeof(TB_ArenaChunk) + 4095) & ~(size_t) 4095;
+        }
+
+        TB_ArenaChunk* c = arena_chunk_alloc(chunk_size);
         c->next = NULL;
 
         arena->watermark  = c->data + size;
-        arena->high_point = &c->data[arena->chunk_size - sizeof(TB_ArenaChunk)];
+        arena->high_point = &c->data[chunk_size - sizeof(TB_ArenaChunk)];
 
         // append to top
         arena->top->next = c;
@@ -153,13 +379,14 @@ void tb_arena_restore(TB_Arena* arena, TB_ArenaSavepoint sp) {
     TB_ArenaChunk* c = sp.top->next;
     while (c != NULL) {
         TB_ArenaChunk* next = c->next;
-        cuik__vfree(c, arena->chunk_size);
+        arena_chunk_free(c);
         c = next;
     }
 
+    sp.top->next = NULL;
     arena->top = sp.top;
     arena->watermark = sp.watermark;
-    arena->high_point = &sp.top->data[arena->chunk_size - sizeof(TB_ArenaChunk)];
+    arena->high_point = &sp.top->data[sp.top->size - sizeof(TB_ArenaChunk)];
 }
 
 void* tb_arena_alloc(TB_Arena* restrict arena, size_t size) {
@@ -175,14 +402,17 @@ void tb_arena_clear(TB_Arena* arena) {
     if (c == NULL) return;
 
     arena->watermark = c->data;
-    arena->high_point = &c->data[arena->chunk_size - sizeof(TB_ArenaChunk)];
+    arena->high_point = &c->data[c->size - sizeof(TB_ArenaChunk)];
     arena->base = arena->top = c;
 
     // remove extra chunks
-    c = c->next;
+    TB_ArenaChunk* rest = c->next;
+    c->next = NULL;
+
+    c = rest;
     while (c != NULL) {
         TB_ArenaChunk* next = c->next;
-        cuik__vfree(c, arena->chunk_size);
+        arena_chunk_free(c);
         c = next;
     }
 }
@@ -195,7 +425,7 @@ size_t tb_arena_current_size(TB_Arena* arena) {
     size_t total = 0;
     TB_ArenaChunk* c = arena->base;
     while (c != arena->top) {
-        total += arena->chunk_size;
+        total += c->size;
         c = c->next;
     }
 
@@ -6,16 +6,29 @@
 #include <stdlib.h>
 #include <string.h>
 
-// Cuik currently uses mimalloc so we wrap those calls here
-#ifdef CUIK_USE_MIMALLOC
+// Cuik currently uses mimalloc so we wrap those calls here, allocations go to
+// the thread's current heap (see cuik_heap_enter) so a build step can throw out
+// everything it made in one go.
+#if defined(CUIK_USE_MIMALLOC) || defined(TB_USE_MIMALLOC)
 #include <mimalloc.h>
 
-#define cuik_malloc(size)        mi_malloc(size)
-#define cuik_calloc(count, size) mi_calloc(count, size)
+typedef mi_heap_t Cuik_Heap;
+
+// NULL means the thread's default heap
+extern _Thread_local Cuik_Heap* cuik__heap;
+
+static inline Cuik_Heap* cuik_heap_current(void) {
+    return cuik__heap ? cuik__heap : mi_heap_get_default();
+}
+
+#define cuik_malloc(size)        mi_heap_malloc(cuik_heap_current(), size)
+#define cuik_calloc(count, size) mi_heap_calloc(cuik_heap_current(), count, size)
 #define cuik_free(ptr)           mi_free(ptr)
-#define cuik_realloc(ptr, size)  mi_realloc(ptr, size)
-#define cuik_strdup(x)           mi_strdup(x)
+#define cuik_realloc(ptr, size)  mi_heap_realloc(cuik_heap_current(), ptr, size)
+#define cuik_strdup(x)           mi_heap_strdup(cuik_heap_current(), x)
 #else
+typedef struct Cuik_Heap Cuik_Heap;
+
 #define cuik_malloc(size)        malloc(size)
 #define cuik_calloc(count, size) calloc(count, size)
 #define cuik_free(size)          free(size)
@@ -85,5 +98,17 @@ void* tls_pop(size_t size);
 void* tls_save(void);
 void  tls_restore(void* p);
 
+// Heaps own everything allocated on a thread while they're entered, NULL is the
+// process-wide heap. Without mimalloc these are no-ops and the frees are all we
+// have. Global state which outlives the heap (caches, the TU list) has to step
+// out to the NULL heap while it allocates.
+Cuik_Heap* cuik_heap_create(void);
+// frees everything still in the heap, has to be called on the creating thread
+void cuik_heap_destroy(Cuik_Heap* heap);
+// hands whatever is still alive over to the process-wide heap
+void cuik_heap_release(Cuik_Heap* heap);
+// returns the previously entered heap
+Cuik_Heap* cuik_heap_enter(Cuik_Heap* heap);
+
 void* cuik__valloc(size_t sz);
 void  cuik__vfree(void* p, size_t sz);
@@ -10,12 +10,13 @@
 #include <assert.h>
 
 #if defined(TB_USE_MIMALLOC) || defined(CUIK_USE_MIMALLOC)
-#include <mimalloc.h>
+#include <common.h>
 
-#define NL_MALLOC(s)     mi_malloc(s)
-#define NL_CALLOC(c, s)  mi_calloc(c, s)
-#define NL_REALLOC(p, s) mi_realloc(p, s)
-#define NL_FREE(p)       mi_free(p)
+// tables follow the thread's current heap like everything else
+#define NL_MALLOC(s)     cuik_malloc(s)
+#define NL_CALLOC(c, s)  cuik_calloc(c, s)
+#define NL_REALLOC(p, s) cuik_realloc(p, s)
+#define NL_FREE(p)       cuik_free(p)
 #else
 #define NL_MALLOC(s)     malloc(s)
 #define NL_CALLOC(c, s)  calloc(c, s)
@@ -36,7 +37,7 @@ typedef struct {
 /////////////////////////////////////////////////
 #define nl_map_is_strmap(map) _Generic((map)->k, NL_Slice: true, default: false)
 
-#define nl_map_create(map, initial_cap) ((map) = ((void*) nl_map__alloc(initial_cap, sizeof(*map))->kv_table))
+#define nl_map_create(map, initial_cap) ((map) = ((void*) nl_map__alloc(initial_cap, sizeof(*map), nl_map_is_strmap(map))->kv_table))
 
 #define nl_map_put(map, key, value)                                                  \
 do {                                                                                 \
@@ -68,7 +69,7 @@ do {
     (out_index) = ins__.index;                                                       \
 } while (0)
 
-#define nl_map_remove(map, key) ((map) != NULL ? nl_map__remove(map, sizeof(*map), sizeof(key), &(key)) : -1)
+#define nl_map_remove(map, key) ((map) != NULL ? (nl_map_is_strmap(map) ? nl_map__removes : nl_map__remove)(map, sizeof(*map), sizeof(key), &(key)) : (void) 0)
 
 #define nl_map_get(map, key) ((map) != NULL ? (nl_map_is_strmap(map) ? nl_map__gets : nl_map__get)(((NL_MapHeader*)(map)) - 1, sizeof(*map), sizeof(key), &(key)) : -1)
 #define nl_map_get_checked(map, key) ((map)[nl_map__check(nl_map_get(map, key))].v)
@@ -88,6 +89,89 @@ do {                                              \
     }                                             \
 } while (0)
 
+
+/////////////////////////////////////////////////
+// tag groups
+/////////////////////////////////////////////////
+// every slot has a tag byte stored off to the side, full slots keep 7 bits of
+// the hash while empty & deleted slots have the high bit set. probing checks a
+// group of 16 tags at once and only compares keys on a tag hit.
+#define NL_TAG_EMPTY   0x80
+#define NL_TAG_DELETED 0xFE
+#define NL_GROUP_SIZE  16
+
+// Cuik doesn't have SIMD intrinsics yet
+#if (defined(__x86_64__) || defined(_M_X64)) && !defined(__CUIK__)
+#include <emmintrin.h>
+
+// bit i is set if tags[i] == tag
+inline static uint32_t nl_group__match(const uint8_t* tags, uint8_t tag) {
+    __m128i group = _mm_loadu_si128((const __m128i*) tags);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(tag)));
+}
+
+// bit i is set if tags[i] is empty or deleted
+inline static uint32_t nl_group__free(const uint8_t* tags) {
+    return _mm_movemask_epi8(_mm_loadu_si128((const __m128i*) tags));
+}
+#else
+inline static uint32_t nl_group__match(const uint8_t* tags, uint8_t tag) {
+    uint32_t mask = 0;
+    for (int i = 0; i < NL_GROUP_SIZE; i++) {
+        mask |= (uint32_t) (tags[i] == tag) << i;
+    }
+    return mask;
+}
+
+inline static uint32_t nl_group__free(const uint8_t* tags) {
+    uint32_t mask = 0;
+    for (int i = 0; i < NL_GROUP_SIZE; i++) {
+        mask |= (uint32_t) (tags[i] >> 7) << i;
+    }
+    return mask;
+}
+#endif
+
+inline static int nl_group__ctz(uint32_t x) {
+    #if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanForward(&index, x);
+    return index;
+    #else
+    return __builtin_ctz(x);
+    #endif
+}
+
+// the raw hashes are multiplicative or FNV, both have weak bits somewhere so
+// we mix before taking the group index from the bottom and the tag from the top.
+inline static uint32_t nl_hash__mix(uint32_t h) {
+    h ^= h >> 16;
+    h *= 0x85EBCA6B;
+    h ^= h >> 13;
+    return h;
+}
+
+// tag for a slot we're removing, if its group still has an empty slot no
+// probe has ever gone past it so we don't need a tombstone.
+inline static uint8_t nl_group__dead_tag(const uint8_t* tags, size_t i) {
+    return nl_group__match(&tags[i & -NL_GROUP_SIZE], NL_TAG_EMPTY) ? NL_TAG_EMPTY : NL_TAG_DELETED;
+}
+
+inline static uint8_t nl_hash__tag(uint32_t h) {
+    return h >> 25;
+}
+
+// table capacity for holding at least cap items, it's at least a group
+inline static size_t nl_hash__exp(size_t cap) {
+    if (cap < NL_GROUP_SIZE) cap = NL_GROUP_SIZE;
+
+    #if defined(_MSC_VER) && !defined(__clang__)
+    return 64 - _lzcnt_u64(cap - 1);
+    #else
+    return 64 - __builtin_clzll(cap - 1);
+    #endif
+}
+
 /////////////////////////////////////////////////
 // internals
 /////////////////////////////////////////////////
@@ -104,6 +188,12 @@ typedef struct {
 typedef struct {
     size_t count;
     size_t exp;
+    // full + deleted slots, that's what makes probing long
+    size_t used;
+    uint8_t* tags;
+    // string maps keep each key's hash around so probes and rehashing
+    // don't need to go look at the strings.
+    uint32_t* hashes;
     char kv_table[];
 } NL_MapHeader;
 
@@ -111,13 +201,14 @@ inline static NL_Slice nl_slice__cstr(const char* key) {
     return (NL_Slice){strlen(key), (const uint8_t*)key};
 }
 
-NL_MapHeader* nl_map__alloc(size_t cap, size_t entry_size);
+NL_MapHeader* nl_map__alloc(size_t cap, size_t entry_size, bool is_strmap);
 NL_MapInsert nl_map__insert(void* map, size_t entry_size, size_t key_size, const void* key);
 NL_MapInsert nl_map__inserts(void* map, size_t entry_size, size_t key_size, const void* key);
 ptrdiff_t nl_map__get(NL_MapHeader* restrict table, size_t entry_size, size_t key_size, const void* key);
 ptrdiff_t nl_map__gets(NL_MapHeader* restrict table, size_t entry_size, size_t key_size, const void* key);
 void nl_map__free(NL_MapHeader* restrict table);
 void nl_map__remove(void* map, size_t entry_size, size_t key_size, const void* key);
+void nl_map__removes(void* map, size_t entry_size, size_t key_size, const void* key);
 
 inline static ptrdiff_t nl_map__check(ptrdiff_t x) {
     assert(x >= 0 && "map entry not found!");
@@ -128,236 +219,224 @@ inline static ptrdiff_t nl_map__check(ptrdiff_t x) {
 
 #ifdef NL_MAP_IMPL
 
-// FNV1A
 inline static uint32_t nl_map__raw_hash(size_t len, const void *key) {
+    // we're almost exclusively using this code for pointer keys
+    if (len == sizeof(uint64_t)) {
+        uint64_t x;
+        memcpy(&x, key, sizeof(x));
+        return nl_hash__mix((x * 11400714819323198485ull) >> 32ull);
+    }
+
+    // FNV1A
     const uint8_t* data = key;
     uint32_t h = 0x811C9DC5;
     for (size_t i = 0; i < len; i++) {
         h = (data[i] ^ h) * 0x01000193;
     }
 
-    return h;
+    return nl_hash__mix(h);
+}
+
+inline static uint32_t nl_map__str_hash(const NL_Slice* key) {
+    return nl_map__raw_hash(key->length, key->data);
 }
 
 void nl_map__free(NL_MapHeader* restrict table) {
     NL_FREE(table);
 }
 
-NL_MapHeader* nl_map__alloc(size_t cap, size_t entry_size) {
-    cap = (cap * 4) / 3;
-    if (cap < 4) cap = 4;
+static NL_MapHeader* nl_map__alloc_exp(size_t exp, size_t entry_size, bool is_strmap) {
+    size_t cap = (size_t) 1 << exp;
 
-    // next power of two
-    #if defined(_MSC_VER) && !defined(__clang__)
-    size_t exp = 64 - _lzcnt_u64(cap - 1);
-    #else
-    size_t exp = 64 - __builtin_clzll(cap - 1);
-    #endif
-
-    cap = (cap == 1 ? 1 : 1 << exp);
+    // [header] [kv_table] [tags] [hashes]
+    size_t tags_pos = sizeof(NL_MapHeader) + (cap * entry_size);
+    size_t hashes_pos = (tags_pos + cap + 3) & ~(size_t) 3;
+    size_t size = is_strmap ? hashes_pos + (cap * sizeof(uint32_t)) : tags_pos + cap;
 
-    NL_MapHeader* table = NL_CALLOC(1, sizeof(NL_MapHeader) + (cap * entry_size));
+    NL_MapHeader* table = NL_CALLOC(1, size);
     table->exp = exp;
     table->count = 0;
+    table->used = 0;
+    table->tags = (uint8_t*) table + tags_pos;
+    table->hashes = is_strmap ? (uint32_t*) ((char*) table + hashes_pos) : NULL;
+    memset(table->tags, NL_TAG_EMPTY, cap);
     return table;
 }
 
-static bool nl_map__is_zero(const char* ptr, size_t size) {
-    // we're almost exclusively using this code for pointer keys
-    if (size == sizeof(void*)) {
-        return *((uintptr_t*) ptr) == 0;
+NL_MapHeader* nl_map__alloc(size_t cap, size_t entry_size, bool is_strmap) {
+    return nl_map__alloc_exp(nl_hash__exp((cap * 8) / 7), entry_size, is_strmap);
+}
+
+inline static bool nl_map__key_equals(NL_MapHeader* restrict table, size_t i, size_t entry_size, size_t key_size, const void* key, uint32_t hash, bool is_strmap) {
+    const char* slot_entry = &table->kv_table[i * entry_size];
+    if (is_strmap) {
+        const NL_Slice* a = (const NL_Slice*) slot_entry;
+        const NL_Slice* b = key;
+        return table->hashes[i] == hash && a->length == b->length && memcmp(a->data, b->data, b->length) == 0;
+    } else if (key_size == sizeof(uint64_t)) {
+        uint64_t a, b;
+        memcpy(&a, slot_entry, sizeof(a));
+        memcpy(&b, key, sizeof(b));
+        return a == b;
     } else {
-        for (size_t i = 0; i < size; i++) {
-            if (ptr[i] != 0) return false;
+        return memcmp(slot_entry, key, key_size) == 0;
+    }
+}
+
+// groups are probed triangularly, since the group count is a power of two we
+// visit every one of them before looping.
+static ptrdiff_t nl_map__find(NL_MapHeader* restrict table, size_t entry_size, size_t key_size, const void* key, uint32_t hash, bool is_strmap) {
+    size_t group_mask = (((size_t) 1 << table->exp) / NL_GROUP_SIZE) - 1;
+    uint8_t tag = nl_hash__tag(hash);
+
+    size_t g = hash & group_mask;
+    for (size_t step = 0; step <= group_mask; step++) {
+        const uint8_t* tags = &table->tags[g * NL_GROUP_SIZE];
+        for (uint32_t m = nl_group__match(tags, tag); m; m &= m - 1) {
+            size_t i = g*NL_GROUP_SIZE + nl_group__ctz(m);
+            if (nl_map__key_equals(table, i, entry_size, key_size, key, hash, is_strmap)) {
+                return i;
+            }
         }
 
-        return true;
+        // an empty slot means the key would've stopped here
+        if (nl_group__match(tags, NL_TAG_EMPTY)) {
+            return -1;
+        }
+
+        g = (g + step + 1) & group_mask;
     }
+
+    return -1;
 }
 
-static bool nl_map__is_one(const char* ptr, size_t size) {
-    // we're almost exclusively using this code for pointer keys
-    if (size == sizeof(void*)) {
-        return *((uintptr_t*) ptr) == UINTPTR_MAX;
-    } else {
-        for (size_t i = 0; i < size; i++) {
-            if (ptr[i] != (char)0xFF) return false;
+// first empty or deleted slot along the probe sequence
+static size_t nl_map__find_free(NL_MapHeader* restrict table, uint32_t hash) {
+    size_t group_mask = (((size_t) 1 << table->exp) / NL_GROUP_SIZE) - 1;
+
+    size_t g = hash & group_mask;
+    for (size_t step = 0;; step++) {
+        uint32_t m = nl_group__free(&table->tags[g * NL_GROUP_SIZE]);
+        if (m) {
+            return g*NL_GROUP_SIZE + nl_group__ctz(m);
         }
 
-        return true;
+        assert(step < group_mask && "the load factor should've left us empty slots");
+        g = (g + step + 1) & group_mask;
+    }
+}
+
+static void nl_map__place(NL_MapHeader* restrict table, size_t i, uint32_t hash) {
+    if (table->tags[i] == NL_TAG_EMPTY) {
+        table->used++;
+    }
+
+    table->count++;
+    table->tags[i] = nl_hash__tag(hash);
+    if (table->hashes) {
+        table->hashes[i] = hash;
     }
 }
 
 NL_MapHeader* nl_map__rehash(NL_MapHeader* table, size_t entry_size, size_t key_size, bool is_strmap) {
-    size_t count = 1u << table->exp;
+    size_t count = (size_t) 1 << table->exp;
 
-    // Allocate bigger hashmap
-    NL_MapHeader* new_table = nl_map__alloc(count * 2, entry_size);
-    if (is_strmap) {
-        for (size_t i = 0; i < count; i++) {
-            NL_Slice* slot_entry = (NL_Slice*) &table->kv_table[i * entry_size];
-            if (slot_entry->length > 0) {
-                NL_MapInsert ins = nl_map__inserts(new_table->kv_table, entry_size, key_size, slot_entry);
-                memcpy(&new_table->kv_table[ins.index*entry_size + key_size], &slot_entry[1], entry_size - key_size);
-            }
-        }
-    } else {
-        for (size_t i = 0; i < count; i++) {
-            const char* slot_entry = (const char*) &table->kv_table[i * entry_size];
-            if (!nl_map__is_zero(slot_entry, key_size) && !nl_map__is_one(slot_entry, key_size)) {
-                NL_MapInsert ins = nl_map__insert(new_table->kv_table, entry_size, key_size, slot_entry);
-                memcpy(&new_table->kv_table[ins.index*entry_size + key_size], &slot_entry[key_size], entry_size - key_size);
-            }
-        }
+    // if it's mostly tombstones we just need to clean up, not grow
+    size_t new_exp = table->count >= count / 2 ? table->exp + 1 : table->exp;
+    NL_MapHeader* new_table = nl_map__alloc_exp(new_exp, entry_size, is_strmap);
+
+    for (size_t i = 0; i < count; i++) {
+        if (table->tags[i] & 0x80) continue;
+
+        const char* slot_entry = &table->kv_table[i * entry_size];
+        uint32_t hash = is_strmap ? table->hashes[i] : nl_map__raw_hash(key_size, slot_entry);
+
+        size_t j = nl_map__find_free(new_table, hash);
+        nl_map__place(new_table, j, hash);
+        memcpy(&new_table->kv_table[j * entry_size], slot_entry, entry_size);
     }
 
     nl_map__free(table);
     return new_table;
 }
 
-NL_MapInsert nl_map__insert(void* map, size_t entry_size, size_t key_size, const void* key) {
+static NL_MapInsert nl_map__insert_impl(void* map, size_t entry_size, size_t key_size, const void* key, bool is_strmap) {
     NL_MapHeader* table;
     if (map == NULL) {
-        table = nl_map__alloc(1024, entry_size);
+        table = nl_map__alloc(is_strmap ? 256 : 1024, entry_size, is_strmap);
         map = table->kv_table;
     } else {
         table = ((NL_MapHeader*)map) - 1;
     }
 
-    uint32_t cap = 1ull << table->exp;
-    if (table->count >= (cap * 3) / 4) {
-        // past 75% load... resize
-        table = nl_map__rehash(table, entry_size, key_size, false);
-        map = table->kv_table;
+    uint32_t hash = is_strmap ? nl_map__str_hash(key) : nl_map__raw_hash(key_size, key);
+    ptrdiff_t i = nl_map__find(table, entry_size, key_size, key, hash, is_strmap);
+    if (i >= 0) {
+        return (NL_MapInsert){ map, i };
     }
 
-    uint32_t exp = table->exp;
-    uint32_t mask = (1 << table->exp) - 1;
-    uint32_t hash = nl_map__raw_hash(key_size, key);
-
-    for (size_t i = hash;;) {
-        // hash table lookup
-        uint32_t step = (hash >> (32 - exp)) | 1;
-        i = (i + step) & mask;
-
-        void* slot_entry = &table->kv_table[i * entry_size];
-        if (nl_map__is_zero(slot_entry, key_size) || nl_map__is_one(slot_entry, key_size)) {
-            table->count++;
-            memcpy(slot_entry, key, key_size);
-            return (NL_MapInsert){ map, i };
-        } else if (memcmp(slot_entry, key, key_size) == 0) {
-            return (NL_MapInsert){ map, i };
-        }
+    size_t cap = (size_t) 1 << table->exp;
+    if (table->used + 1 > (cap * 7) / 8) {
+        // past 87.5% load... resize
+        table = nl_map__rehash(table, entry_size, key_size, is_strmap);
+        map = table->kv_table;
     }
+
+    size_t j = nl_map__find_free(table, hash);
+    nl_map__place(table, j, hash);
+    memcpy(&table->kv_table[j * entry_size], key, key_size);
+    return (NL_MapInsert){ map, j };
 }
 
-void nl_map__remove(void* map, size_t entry_size, size_t key_size, const void* key) {
+static void nl_map__remove_impl(void* map, size_t entry_size, size_t key_size, const void* key, bool is_strmap) {
     if (map == NULL) {
         return;
     }
 
     NL_MapHeader* table = ((NL_MapHeader*)map) - 1;
-
-    uint32_t exp = table->exp;
-    uint32_t mask = (1 << table->exp) - 1;
-    uint32_t hash = nl_map__raw_hash(key_size, key);
-
-    for (size_t i = hash;;) {
-        // hash table lookup
-        uint32_t step = (hash >> (32 - exp)) | 1;
-        i = (i + step) & mask;
-
-        void* slot_entry = &table->kv_table[i * entry_size];
-        if (nl_map__is_zero(slot_entry, key_size)) {
-            break;
-        } else if (memcmp(slot_entry, key, key_size) == 0) {
-            table->count--;
-            memset(slot_entry, 0xFF, key_size); // mark key as TOMBSTONE
-            break;
+    uint32_t hash = is_strmap ? nl_map__str_hash(key) : nl_map__raw_hash(key_size, key);
+    ptrdiff_t i = nl_map__find(table, entry_size, key_size, key, hash, is_strmap);
+    if (i >= 0) {
+        table->count--;
+        table->tags[i] = nl_group__dead_tag(table->tags, i);
+        if (table->tags[i] == NL_TAG_EMPTY) {
+            table->used--;
         }
-    }
-}
-
-NL_MapInsert nl_map__inserts(void* map, size_t entry_size, size_t key_size, const void* key) {
-    NL_MapHeader* table;
-    if (map == NULL) {
-        table = nl_map__alloc(256, entry_size);
-        map = table->kv_table;
-    } else {
-        table = ((NL_MapHeader*)map) - 1;
-    }
 
-    uint32_t cap = 1ull << table->exp;
-    if (table->count >= (cap * 3) / 4) {
-        // past 75% load... resize
-        table = nl_map__rehash(table, entry_size, key_size, true);
-        map = table->kv_table;
+        // the iterators still look at the keys: an empty string or all ones
+        // for everything else (TOMBSTONE)
+        memset(&table->kv_table[i * entry_size], is_strmap ? 0 : 0xFF, key_size);
     }
+}
 
-    const NL_Slice* key_entry = key;
+NL_MapInsert nl_map__insert(void* map, size_t entry_size, size_t key_size, const void* key) {
+    return nl_map__insert_impl(map, entry_size, key_size, key, false);
+}
 
-    uint32_t exp = table->exp;
-    uint32_t mask = (1 << table->exp) - 1;
-    uint32_t hash = nl_map__raw_hash(key_entry->length, key_entry->data);
+NL_MapInsert nl_map__inserts(void* map, size_t entry_size, size_t key_size, const void* key) {
+    return nl_map__insert_impl(map, entry_size, key_size, key, true);
+}
 
-    for (size_t i = hash;;) {
-        // hash table lookup
-        uint32_t step = (hash >> (32 - exp)) | 1;
-        i = (i + step) & mask;
+void nl_map__remove(void* map, size_t entry_size, size_t key_size, const void* key) {
+    nl_map__remove_impl(map, entry_size, key_size, key, false);
+}
 
-        NL_Slice* slot_entry = (NL_Slice*) &table->kv_table[i * entry_size];
-        if (slot_entry->length == 0) {
-            table->count++;
-            memcpy(slot_entry, key, key_size);
-            return (NL_MapInsert){ map, i };
-        } else if (slot_entry->length == key_entry->length && memcmp(slot_entry->data, key_entry->data, key_entry->length) == 0) {
-            return (NL_MapInsert){ map, i };
-        }
-    }
+void nl_map__removes(void* map, size_t entry_size, size_t key_size, const void* key) {
+    nl_map__remove_impl(map, entry_size, key_size, key, true);
 }
 
 ptrdiff_t nl_map__get(NL_MapHeader* restrict table, size_t entry_size, size_t key_size, const void* key) {
     if (table == NULL) return -1;
 
-    uint32_t exp = table->exp;
-    uint32_t mask = (1 << table->exp) - 1;
     uint32_t hash = nl_map__raw_hash(key_size, key);
-
-    for (size_t i = hash;;) {
-        // hash table lookup
-        uint32_t step = (hash >> (32 - exp)) | 1;
-        i = (i + step) & mask;
-
-        void* slot_entry = &table->kv_table[i * entry_size];
-        if (nl_map__is_zero(slot_entry, key_size)) {
-            return -1;
-        } else if (memcmp(slot_entry, key, key_size) == 0) {
-            return i;
-        }
-    }
+    return nl_map__find(table, entry_size, key_size, key, hash, false);
 }
 
 ptrdiff_t nl_map__gets(NL_MapHeader* restrict table, size_t entry_size, size_t key_size, const void* key) {
     if (table == NULL) return -1;
 
-    const NL_Slice* key_entry = key;
-
-    uint32_t exp = table->exp;
-    uint32_t mask = (1 << table->exp) - 1;
-    uint32_t hash = nl_map__raw_hash(key_entry->length, key_entry->data);
-
-    for (size_t i = hash;;) {
-        // hash table lookup
-        uint32_t step = (hash >> (32 - exp)) | 1;
-        i = (i + step) & mask;
-
-        NL_Slice* slot_entry = (NL_Slice*) &table->kv_table[i * entry_size];
-        if (slot_entry->length == 0) {
-            return -1;
-        } else if (slot_entry->length == key_entry->length && memcmp(slot_entry->data, key_entry->data, key_entry->length) == 0) {
-            return i;
-        }
-    }
+    uint32_t hash = nl_map__str_hash(key);
+    return nl_map__find(table, entry_size, key_size, key, hash, true);
 }
 
 #endif /* NL_MAP_IMPL */
@@ -2,6 +2,11 @@
 #ifndef NL_HASH_SET_H
 #define NL_HASH_SET_H
 
+// the tag groups live there
+#ifndef NL_HASH_MAP_H
+#include <hash_map.h>
+#endif
+
 #define NL_HASHSET_TOMB ((void*) UINTPTR_MAX)
 
 #define NL_HASHSET_HIGH_BIT (~(SIZE_MAX >> ((size_t) 1)))
@@ -12,6 +17,10 @@ typedef struct NL_HashSet {
 
     size_t exp, count;
     void** data;
+
+    // one tag per slot (see hash_map.h), used counts full + deleted slots
+    uint8_t* tags;
+    size_t used;
 } NL_HashSet;
 
 typedef uint32_t (*NL_HashFunc)(void* a);
@@ -40,96 +49,128 @@ void nl_hashset_remove2(NL_HashSet* restrict hs, void* ptr, NL_HashFunc hash, NL
 #ifdef NL_HASH_SET_IMPL
 #include <common.h>
 
-#define NL_HASHSET_HASH(ptr) ((((uintptr_t) ptr) * 11400714819323198485ull) >> 32ull)
-
-NL_HashSet nl_hashset_alloc(size_t cap) {
-    cap = (cap * 4) / 3;
-    if (cap < 4) cap = 4;
+#define NL_HASHSET_HASH(ptr) nl_hash__mix((((uintptr_t) ptr) * 11400714819323198485ull) >> 32ull)
 
-    // next power of two
-    #if defined(_MSC_VER) && !defined(__clang__)
-    size_t exp = 64 - _lzcnt_u64(cap - 1);
-    #else
-    size_t exp = 64 - __builtin_clzll(cap - 1);
-    #endif
+// data and tags share the allocation
+#define NL_HASHSET_SLOT_SIZE (sizeof(void*) + 1)
 
-    cap = (cap == 1 ? 1 : 1 << exp);
+NL_HashSet nl_hashset_alloc(size_t cap) {
+    size_t exp = nl_hash__exp((cap * 4) / 3);
+    cap = (size_t) 1 << exp;
 
-    return (NL_HashSet){ .exp = exp, .data = cuik_calloc(cap, sizeof(void*)) };
+    void** data = cuik_calloc(cap, NL_HASHSET_SLOT_SIZE);
+    uint8_t* tags = (uint8_t*) &data[cap];
+    memset(tags, NL_TAG_EMPTY, cap);
+    return (NL_HashSet){ .exp = exp, .data = data, .tags = tags };
 }
 
 NL_HashSet nl_hashset_arena_alloc(TB_Arena* arena, size_t cap) {
-    cap = (cap * 4) / 3;
-    if (cap < 4) cap = 4;
-
-    // next power of two
-    #if defined(_MSC_VER) && !defined(__clang__)
-    size_t exp = 64 - _lzcnt_u64(cap - 1);
-    #else
-    size_t exp = 64 - __builtin_clzll(cap - 1);
-    #endif
+    size_t exp = nl_hash__exp((cap * 4) / 3);
+    cap = (size_t) 1 << exp;
 
-    cap = (cap == 1 ? 1 : 1 << exp);
-
-    void* data = tb_arena_alloc(arena, cap * sizeof(void*));
+    void** data = tb_arena_alloc(arena, cap * NL_HASHSET_SLOT_SIZE);
+    uint8_t* tags = (uint8_t*) &data[cap];
     memset(data, 0, cap * sizeof(void*));
-    return (NL_HashSet){ .allocator = arena, .exp = exp, .data = data };
+    memset(tags, NL_TAG_EMPTY, cap);
+    return (NL_HashSet){ .allocator = arena, .exp = exp, .data = data, .tags = tags };
 }
 
 void nl_hashset_free(NL_HashSet hs) {
     if (hs.allocator == NULL) {
         cuik_free(hs.data);
     } else {
-        tb_arena_pop(hs.allocator, hs.data, (1ull << hs.exp) * sizeof(void*));
+        tb_arena_pop(hs.allocator, hs.data, (1ull << hs.exp) * NL_HASHSET_SLOT_SIZE);
     }
 }
 
-// lookup into hash map for ptr, it's also used to put things in
-size_t nl_hashset_lookup(NL_HashSet* restrict hs, void* ptr) {
-    assert(ptr);
-    uint32_t h = NL_HASHSET_HASH(ptr);
+// walks the groups for h (same probing as the maps) looking for ptr, or
+// anything cmp says is equal. returns the slot with the highest bit set when
+// found, otherwise the first free slot we saw (SIZE_MAX if there's none).
+static size_t nl_hashset__probe(NL_HashSet* restrict hs, void* ptr, uint32_t h, NL_CompareFunc cmp) {
+    size_t group_mask = (nl_hashset_capacity(hs) / NL_GROUP_SIZE) - 1;
+    uint8_t tag = nl_hash__tag(h);
+
+    size_t free_slot = SIZE_MAX;
+    size_t g = h & group_mask;
+    for (size_t step = 0; step <= group_mask; step++) {
+        const uint8_t* tags = &hs->tags[g * NL_GROUP_SIZE];
+        for (uint32_t m = nl_group__match(tags, tag); m; m &= m - 1) {
+            size_t i = g*NL_GROUP_SIZE + nl_group__ctz(m);
+            if (hs->data[i] == ptr || (cmp && cmp(hs->data[i], ptr))) {
+                return NL_HASHSET_HIGH_BIT | i;
+            }
+        }
 
-    size_t mask = (1 << hs->exp) - 1;
-    size_t first = h & mask, i = first;
+        uint32_t free_mask = nl_group__free(tags);
+        if (free_slot == SIZE_MAX && free_mask) {
+            free_slot = g*NL_GROUP_SIZE + nl_group__ctz(free_mask);
+        }
 
-    do {
-        if (hs->data[i] == NULL) {
-            return i;
-        } else if (hs->data[i] == ptr) {
-            return ~(SIZE_MAX >> ((size_t) 1)) | i; // highest bit set
+        // an empty slot means the key would've stopped here
+        if (nl_group__match(tags, NL_TAG_EMPTY)) {
+            break;
         }
 
-        i = (i + 1) & mask;
-    } while (i != first);
+        g = (g + step + 1) & group_mask;
+    }
+
+    return free_slot;
+}
+
+static void nl_hashset__place(NL_HashSet* restrict hs, size_t i, void* ptr, uint32_t h) {
+    if (hs->tags[i] == NL_TAG_EMPTY) {
+        hs->used++;
+    }
 
-    return SIZE_MAX;
+    hs->count++;
+    hs->tags[i] = nl_hash__tag(h);
+    hs->data[i] = ptr;
+}
+
+static void nl_hashset__kill(NL_HashSet* restrict hs, size_t i) {
+    hs->count--;
+    hs->tags[i] = nl_group__dead_tag(hs->tags, i);
+    if (hs->tags[i] == NL_TAG_EMPTY) {
+        hs->used--;
+        hs->data[i] = NULL;
+    } else {
+        hs->data[i] = NL_HASHSET_TOMB;
+    }
+}
+
+static bool nl_hashset__needs_grow(NL_HashSet* restrict hs) {
+    return hs->used + 1 > (nl_hashset_capacity(hs) * 7) / 8;
+}
+
+// lookup into hash map for ptr, it's also used to put things in
+size_t nl_hashset_lookup(NL_HashSet* restrict hs, void* ptr) {
+    assert(ptr);
+    return nl_hashset__probe(hs, ptr, NL_HASHSET_HASH(ptr), NULL);
 }
 
 bool nl_hashset_put(NL_HashSet* restrict hs, void* ptr) {
-    size_t index = nl_hashset_lookup(hs, ptr);
+    uint32_t h = NL_HASHSET_HASH(ptr);
+    size_t index = nl_hashset__probe(hs, ptr, h, NULL);
+    if (index != SIZE_MAX && (index & NL_HASHSET_HIGH_BIT)) {
+        // slot is already filled
+        return false;
+    }
 
-    // rehash (ideally only once? statistically not impossible for two?)
-    while (index == SIZE_MAX) {
+    // arena sets get to fill up all the way
+    if (index == SIZE_MAX || (hs->allocator == NULL && nl_hashset__needs_grow(hs))) {
         assert(hs->allocator == NULL && "arena hashsets can't be resized!");
-        NL_HashSet new_hs = nl_hashset_alloc(nl_hashset_capacity(hs));
+        NL_HashSet new_hs = nl_hashset_alloc(hs->count * 2);
         nl_hashset_for(p, hs) {
             nl_hashset_put(&new_hs, *p);
         }
         nl_hashset_free(*hs);
         *hs = new_hs;
 
-        // "tail" calls amirite
-        index = nl_hashset_lookup(hs, ptr);
+        index = nl_hashset__probe(hs, ptr, h, NULL);
     }
 
-    if (index & NL_HASHSET_HIGH_BIT) {
-        // slot is already filled
-        return false;
-    } else {
-        hs->count++;
-        hs->data[index] = ptr;
-        return true;
-    }
+    nl_hashset__place(hs, index, ptr, h);
+    return true;
 }
 
 bool nl_hashset_remove(NL_HashSet* restrict hs, void* ptr) {
@@ -138,85 +179,55 @@ bool nl_hashset_remove(NL_HashSet* restrict hs, void* ptr) {
         return false;
     }
 
-    hs->count--;
-    hs->data[index] = NL_HASHSET_TOMB;
+    nl_hashset__kill(hs, index & NL_HASHSET_INDEX_BITS);
     return true;
 }
 
 void nl_hashset_remove2(NL_HashSet* restrict hs, void* ptr, NL_HashFunc hash, NL_CompareFunc cmp) {
-    uint32_t h = hash(ptr);
-
-    size_t mask = (1 << hs->exp) - 1;
-    size_t first = h & mask, i = first;
-
-    do {
-        if (hs->data[i] == NULL) {
-            break;
-        } else if (hs->data[i] == ptr) {
-            hs->data[i] = NL_HASHSET_TOMB;
-            break;
-        }
-
-        i = (i + 1) & mask;
-    } while (i != first);
+    // only the exact pointer gets removed
+    size_t index = nl_hashset__probe(hs, ptr, nl_hash__mix(hash(ptr)), NULL);
+    if (index != SIZE_MAX && (index & NL_HASHSET_HIGH_BIT)) {
+        nl_hashset__kill(hs, index & NL_HASHSET_INDEX_BITS);
+    }
 }
 
 void* nl_hashset_get2(NL_HashSet* restrict hs, void* ptr, NL_HashFunc hash, NL_CompareFunc cmp) {
-    uint32_t h = hash(ptr);
-
-    size_t mask = (1 << hs->exp) - 1;
-    size_t first = h & mask, i = first;
-
-    do {
-        if (hs->data[i] == NULL) {
-            return NULL;
-        } else if (hs->data[i] == NL_HASHSET_TOMB) {
-            // go past it
-        } else if (hs->data[i] == ptr || cmp(hs->data[i], ptr)) {
-            return hs->data[i];
-        }
-
-        i = (i + 1) & mask;
-    } while (i != first);
+    size_t index = nl_hashset__probe(hs, ptr, nl_hash__mix(hash(ptr)), cmp);
+    if (index != SIZE_MAX && (index & NL_HASHSET_HIGH_BIT)) {
+        return hs->data[index & NL_HASHSET_INDEX_BITS];
+    }
 
     return NULL;
 }
 
 // returns old value
 void* nl_hashset_put2(NL_HashSet* restrict hs, void* ptr, NL_HashFunc hash, NL_CompareFunc cmp) {
-    uint32_t h = hash(ptr);
-
-    size_t mask = (1 << hs->exp) - 1;
-    size_t first = h & mask, i = first;
-
-    do {
-        if (hs->data[i] == NULL) {
-            hs->count++;
-            hs->data[i] = ptr;
-            return NULL;
-        } else if (hs->data[i] == NL_HASHSET_TOMB) {
-            // go past it
-        } else if (hs->data[i] == ptr || cmp(hs->data[i], ptr)) {
-            return hs->data[i];
-        }
+    uint32_t h = nl_hash__mix(hash(ptr));
+    size_t index = nl_hashset__probe(hs, ptr, h, cmp);
+    if (index != SIZE_MAX && (index & NL_HASHSET_HIGH_BIT)) {
+        return hs->data[index & NL_HASHSET_INDEX_BITS];
+    }
 
-        i = (i + 1) & mask;
-    } while (i != first);
+    if (index == SIZE_MAX || nl_hashset__needs_grow(hs)) {
+        NL_HashSet new_hs = nl_hashset_alloc(hs->count * 2);
+        nl_hashset_for(p, hs) {
+            nl_hashset_put2(&new_hs, *p, hash, cmp);
+        }
+        nl_hashset_free(*hs);
+        *hs = new_hs;
 
-    NL_HashSet new_hs = nl_hashset_alloc(nl_hashset_capacity(hs));
-    nl_hashset_for(p, hs) {
-        nl_hashset_put2(&new_hs, *p, hash, cmp);
+        index = nl_hashset__probe(hs, ptr, h, cmp);
     }
-    nl_hashset_free(*hs);
-    *hs = new_hs;
 
-    // "tail" calls amirite
-    return nl_hashset_put2(hs, ptr, hash, cmp);
+    nl_hashset__place(hs, index, ptr, h);
+    return NULL;
 }
 
 void nl_hashset_clear(NL_HashSet* restrict hs) {
     memset(hs->data, 0, nl_hashset_capacity(hs) * sizeof(void*));
+    memset(hs->tags, NL_TAG_EMPTY, nl_hashset_capacity(hs));
     hs->count = 0;
+    hs->used = 0;
 }
 
 #endif /* NL_HASH_SET_IMPL */
@@ -162,6 +162,224 @@ uint64_t cuik_time_in_nanos(void) {
     #endif
 }
 
+////////////////////////////////
+// Counters
+////////////////////////////////
+#ifdef _WIN32
+#define PSAPI_VERSION 2
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+// defined in common.c next to the allocators
+extern _Thread_local uint64_t cuikperf__arena_bytes;
+extern _Thread_local uint64_t cuikperf__valloc_bytes;
+
+const char* cuikperf_counter_names[CUIKPERF_COUNTER_COUNT] = {
+    [CUIKPERF_ARENA_BYTES]   = "arena_bytes",
+    [CUIKPERF_VALLOC_BYTES]  = "valloc_bytes",
+    [CUIKPERF_PEAK_RSS_KB]   = "peak_rss_kb",
+    [CUIKPERF_INSTRUCTIONS]  = "instructions",
+    [CUIKPERF_CYCLES]        = "cycles",
+    [CUIKPERF_L1D_MISSES]    = "l1d_misses",
+    [CUIKPERF_LLC_MISSES]    = "llc_misses",
+    [CUIKPERF_BRANCH_MISSES] = "branch_misses",
+};
+
+enum { HW_COUNTER_COUNT = CUIKPERF_COUNTER_COUNT - CUIKPERF_INSTRUCTIONS };
+
+static bool counters_enabled, hw_counters_enabled;
+
+// peak RSS is a syscall so it's only refreshed once a millisecond
+static _Atomic uint64_t peak_rss_kb, peak_rss_time;
+
+#ifdef __linux__
+typedef struct {
+    int fd;
+    // slot in the group read, -1 if the event couldn't join the group
+    int slot;
+    struct perf_event_mmap_page* page;
+} HWCounter;
+
+// opened lazily on each thread since perf events follow the thread
+// that opened them. they're all in one group so the read() path is
+// one syscall per sample rather than one per event.
+static _Thread_local bool hw_counters_init;
+static _Thread_local int hw_group_fd = -1, hw_group_size;
+static _Thread_local bool hw_use_rdpmc;
+static _Thread_local HWCounter hw_counters[HW_COUNTER_COUNT];
+
+static void hw_counters_read(uint64_t* out);
+
+static void hw_counters_open(void) {
+    #define CACHE_MISS(cache) ((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+    static const struct { uint32_t type; uint64_t config; } events[HW_COUNTER_COUNT] = {
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+        { PERF_TYPE_HW_CACHE, CACHE_MISS(PERF_COUNT_HW_CACHE_L1D) },
+        { PERF_TYPE_HW_CACHE, CACHE_MISS(PERF_COUNT_HW_CACHE_LL) },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    };
+    #undef CACHE_MISS
+
+    hw_counters_init = true;
+    for (int i = 0; i < HW_COUNTER_COUNT; i++) {
+        struct perf_event_attr pe = {
+            .type = events[i].type,
+            .size = sizeof(struct perf_event_attr),
+            .config = events[i].config,
+            .read_format = PERF_FORMAT_GROUP,
+            .exclude_kernel = 1,
+            .exclude_hv = 1,
+        };
+
+        // not every machine (or VM) has every event, those just read as 0
+        HWCounter* c = &hw_counters[i];
+        c->fd = syscall(SYS_perf_event_open, &pe, 0, -1, hw_group_fd, 0);
+        c->slot = -1;
+        c->page = NULL;
+        if (c->fd >= 0) {
+            if (hw_group_fd < 0) {
+                hw_group_fd = c->fd;
+            }
+
+            c->slot = hw_group_size++;
+            void* page = mmap(NULL, 4096, PROT_READ, MAP_SHARED, c->fd, 0);
+            c->page = page != MAP_FAILED ? page : NULL;
+        }
+    }
+
+    // rdpmc is usually ~30 cycles but hypervisors tend to trap it, at which point
+    // it's slower than just asking the kernel for the whole group at once. we
+    // just time both and go with the winner.
+    #ifdef CUIK__IS_X64
+    uint64_t tmp[HW_COUNTER_COUNT];
+    uint64_t t0 = cuik_time_in_nanos();
+    for (int j = 0; j < 8; j++) hw_counters_read(tmp);
+    uint64_t t1 = cuik_time_in_nanos();
+
+    hw_use_rdpmc = true;
+    for (int j = 0; j < 8; j++) hw_counters_read(tmp);
+    uint64_t t2 = cuik_time_in_nanos();
+
+    hw_use_rdpmc = t2 - t1 < t1 - t0;
+    #endif
+}
+
+#ifdef CUIK__IS_X64
+// user-space rdpmc, this is the sequence from the perf_event_mmap_page docs
+static bool hw_counter_rdpmc(HWCounter* c, uint64_t* out) {
+    struct perf_event_mmap_page* pc = c->page;
+    if (pc == NULL || !pc->cap_user_rdpmc) {
+        return false;
+    }
+
+    uint32_t seq, idx;
+    uint64_t count;
+    do {
+        seq = pc->lock;
+        atomic_signal_fence(memory_order_seq_cst);
+
+        idx = pc->index;
+        count = pc->offset;
+        if (idx != 0) {
+            int shift = 64 - pc->pmc_width;
+            count += (int64_t) (__rdpmc(idx - 1) << shift) >> shift;
+        }
+
+        atomic_signal_fence(memory_order_seq_cst);
+    } while (pc->lock != seq);
+
+    // idx is 0 whenever the event isn't on the PMU right now
+    *out = count;
+    return idx != 0;
+}
+#endif
+
+static void hw_counters_read(uint64_t* out) {
+    bool missed = !hw_use_rdpmc;
+    #ifdef CUIK__IS_X64
+    for (int i = 0; !missed && i < HW_COUNTER_COUNT; i++) {
+        if (hw_counters[i].fd >= 0 && !hw_counter_rdpmc(&hw_counters[i], &out[i])) {
+            missed = true;
+        }
+    }
+    #endif
+
+    if (missed && hw_group_fd >= 0) {
+        // { nr, values[nr] }
+        uint64_t buf[1 + HW_COUNTER_COUNT];
+        ssize_t expected = (1 + hw_group_size) * sizeof(uint64_t);
+        bool ok = read(hw_group_fd, buf, expected) == expected;
+
+        for (int i = 0; i < HW_COUNTER_COUNT; i++) {
+            int slot = hw_counters[i].slot;
+            out[i] = ok && slot >= 0 ? buf[1 + slot] : 0;
+        }
+    }
+}
+#endif
+
+void cuikperf_enable_counters(bool hardware) {
+    counters_enabled = true;
+    hw_counters_enabled = hardware;
+}
+
+bool cuikperf_has_counters(void) {
+    return counters_enabled;
+}
+
+uint64_t cuikperf_peak_rss_kb(void) {
+    #ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) {
+        return pmc.PeakWorkingSetSize / 1024;
+    }
+    return 0;
+    #else
+    struct rusage r;
+    if (getrusage(RUSAGE_SELF, &r) != 0) {
+        return 0;
+    }
+
+    #ifdef __APPLE__
+    return r.ru_maxrss / 1024; // bytes on macOS
+    #else
+    return r.ru_maxrss;
+    #endif
+    #endif
+}
+
+void cuikperf_read_counters(Cuik_PerfCounters* out) {
+    *out = (Cuik_PerfCounters){ 0 };
+    out->v[CUIKPERF_ARENA_BYTES] = cuikperf__arena_bytes;
+    out->v[CUIKPERF_VALLOC_BYTES] = cuikperf__valloc_bytes;
+
+    uint64_t now = cuik_time_in_nanos();
+    uint64_t last = peak_rss_time;
+    if (now - last >= 1000000 && atomic_compare_exchange_strong(&peak_rss_time, &last, now)) {
+        peak_rss_kb = cuikperf_peak_rss_kb();
+    }
+    out->v[CUIKPERF_PEAK_RSS_KB] = peak_rss_kb;
+
+    #ifdef __linux__
+    if (hw_counters_enabled) {
+        if (!hw_counters_init) {
+            hw_counters_open();
+        }
+
+        hw_counters_read(&out->v[CUIKPERF_INSTRUCTIONS]);
+    }
+    #endif
+}
+
 void cuikperf_region_start(const char* fmt, const char* extra) {
     if (profiler == NULL) return;
     uint64_t nanos = cuik_time_in_nanos();
@@ -169,7 +387,11 @@ void cuikperf_region_start(const char* fmt, const char* extra) {
     // lock if necessary
     if (should_lock_profiler) mtx_lock(&timer_mutex);
 
+    // profilers keep their own state around past any build step
+    Cuik_Heap* old_heap = cuik_heap_enter(NULL);
     profiler->begin_plot(profiler_userdata, nanos, fmt, extra ? extra : "");
+    cuik_heap_enter(old_heap);
+
     if (should_lock_profiler) mtx_unlock(&timer_mutex);
 }
 
@@ -178,6 +400,8 @@ void cuikperf_region_end(void) {
     uint64_t nanos = cuik_time_in_nanos();
 
     if (should_lock_profiler) mtx_lock(&timer_mutex);
+    Cuik_Heap* old_heap = cuik_heap_enter(NULL);
     profiler->end_plot(profiler_userdata, nanos);
+    cuik_heap_enter(old_heap);
     if (should_lock_profiler) mtx_unlock(&timer_mutex);
 }
@@ -33,6 +33,34 @@ uint64_t cuik_time_in_nanos(void);
 void cuikperf_region_start(const char* fmt, const char* extra);
 void cuikperf_region_end(void);
 
+// Per-thread counters which the profilers can sample around their regions, the
+// allocation ones are running totals for the calling thread, peak RSS is process
+// wide (refreshed at most once a millisecond) and the hardware ones are only
+// filled in once cuikperf_enable_counters(true) was called (Linux only).
+enum {
+    CUIKPERF_ARENA_BYTES,   // handed out by TB_Arenas
+    CUIKPERF_VALLOC_BYTES,  // mapped by cuik__valloc
+    CUIKPERF_PEAK_RSS_KB,
+    CUIKPERF_INSTRUCTIONS,
+    CUIKPERF_CYCLES,
+    CUIKPERF_L1D_MISSES,
+    CUIKPERF_LLC_MISSES,
+    CUIKPERF_BRANCH_MISSES,
+
+    CUIKPERF_COUNTER_COUNT
+};
+
+typedef struct {
+    uint64_t v[CUIKPERF_COUNTER_COUNT];
+} Cuik_PerfCounters;
+
+extern const char* cuikperf_counter_names[CUIKPERF_COUNTER_COUNT];
+
+void cuikperf_enable_counters(bool hardware);
+bool cuikperf_has_counters(void);
+void cuikperf_read_counters(Cuik_PerfCounters* out);
+uint64_t cuikperf_peak_rss_kb(void);
+
 // Usage:
 // CUIK_TIMED_BLOCK("Beans %d", 5) {
 //   ...
@@ -14,16 +14,34 @@
 #include <threads.h>
 #include <stdatomic.h>
 
+// the GL frontend only exists on Windows, everything else (dictionary, interpreter
+// and the JIT tiering) is platform-neutral and can run headless with -DFORTH_HEADLESS
+#if defined(_WIN32) && !defined(FORTH_HEADLESS)
+#define FORTH_GUI 1
+#else
+#define FORTH_GUI 0
+#endif
+
+#ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
-#include <GL/gl.h>
+#else
+#include <signal.h>
+#include <sys/mman.h>
+
+#define __debugbreak() __builtin_trap()
+#endif
 
 #include "../main/live.h"
 
+#if FORTH_GUI
+#include <GL/gl.h>
+
 #define STB_TRUETYPE_IMPLEMENTATION
 #include "stb_truetype.h"
 
 #pragma comment(lib, "opengl32.lib")
+#endif
 
 // no need for do while crap if it's an expression :p
 // it's basically an assert but it doesn't get vaporized
@@ -614,11 +632,17 @@ static void parse(Dictionary* dict, Parser* p, Word* w) {
     type_check(dict, w);
 }
 
+#if FORTH_GUI
 static void draw_rect2(uint32_t color, float x, float y, float w, float h);
+#else
+// headless builds have nowhere to draw, the graphics words are just no-ops
+static void draw_rect2(uint32_t color, float x, float y, float w, float h) {}
+#endif
 
 #include "forth_interp.h"
 #include "forth_jit.h"
 
+#if FORTH_GUI
 static bool is_opaque = true;
 
 static LRESULT CALLBACK WndProc(HWND hwnd, UINT message, WPARAM wparam, LPARAM lparam) {
@@ -787,6 +811,7 @@ static void draw_text(uint32_t color, float x, float y, const char* text) {
     glDisable(GL_BLEND);
     glDisable(GL_TEXTURE_2D);
 }
+#endif /* FORTH_GUI */
 
 static WordIndex load_forth(Dictionary* dict, const char* path) {
     static char* buffer;
@@ -825,6 +850,27 @@ static WordIndex load_forth(Dictionary* dict, const char* path) {
     return -1000 - i;
 }
 
+static void init_root_dict(void) {
+    init_word_pool();
+    dict_put(&root_dict, 1, "+",         OP_ADD);
+    dict_put(&root_dict, 1, "-",         OP_SUB);
+    dict_put(&root_dict, 1, "*",         OP_MUL);
+    dict_put(&root_dict, 1, "/",         OP_DIV);
+    dict_put(&root_dict, 1, ".",         OP_PRINT);
+    dict_put(&root_dict, 3, "dup",       OP_DUP);
+    dict_put(&root_dict, 4, "drop",      OP_DROP);
+    dict_put(&root_dict, 4, "swap",      OP_SWAP);
+    dict_put(&root_dict, 4, "emit",      OP_EMIT);
+    dict_put(&root_dict, 4, "dump",      OP_DUMP);
+    dict_put(&root_dict, 3, "key",       OP_KEY);
+    dict_put(&root_dict, 3, "if{",       OP_IF);
+    dict_put(&root_dict, 6, "}else{",    OP_ELSE);
+    dict_put(&root_dict, 1, "}",         OP_CLOSE);
+    dict_put(&root_dict, 4, "tail",      OP_TAIL);
+    dict_put(&root_dict, 9, "draw-rect", OP_RECT);
+}
+
+#if FORTH_GUI
 int main(int argc, const char** argv) {
     is_main_thread = true;
     SetProcessDPIAware();
@@ -873,24 +919,7 @@ int main(int argc, const char** argv) {
 
     LiveCompiler live = { 0 };
 
-    // initialize dictionary
-    init_word_pool();
-    dict_put(&root_dict, 1, "+",         OP_ADD);
-    dict_put(&root_dict, 1, "-",         OP_SUB);
-    dict_put(&root_dict, 1, "*",         OP_MUL);
-    dict_put(&root_dict, 1, "/",         OP_DIV);
-    dict_put(&root_dict, 1, ".",         OP_PRINT);
-    dict_put(&root_dict, 3, "dup",       OP_DUP);
-    dict_put(&root_dict, 4, "drop",      OP_DROP);
-    dict_put(&root_dict, 4, "swap",      OP_SWAP);
-    dict_put(&root_dict, 4, "emit",      OP_EMIT);
-    dict_put(&root_dict, 4, "dump",      OP_DUMP);
-    dict_put(&root_dict, 3, "key",       OP_KEY);
-    dict_put(&root_dict, 3, "if{",       OP_IF);
-    dict_put(&root_dict, 6, "}else{",    OP_ELSE);
-    dict_put(&root_dict, 1, "}",         OP_CLOSE);
-    dict_put(&root_dict, 4, "tail",      OP_TAIL);
-    dict_put(&root_dict, 9, "draw-rect", OP_RECT);
+    init_root_dict();
 
     {
         font_size = 36.0;
@@ -908,7 +937,7 @@ int main(int argc, const char** argv) {
         fclose(f);
     }
 
-    AddVectoredExceptionHandler(1, its_so_over);
+    vm_install_pause_handler();
 
     VM_Thread* env = vm_thread_new();
     while (jit.running) CUIK_TIMED_BLOCK("main loop") {
@@ -978,3 +1007,124 @@ int main(int argc, const char** argv) {
 
     return 0;
 }
+#else
+// headless driver, it runs the root word of a file and then calls 'update'
+// every "frame" like the GUI would (just with zeroed arguments).
+//
+//   forth [-bench N] [-spall] file.forth
+//
+// the benchmark runs 'update' N times with the JIT tier disabled and then again
+// after the call counters have promoted it, reporting the throughput of both.
+static uint64_t run_word(VM_Thread* env, Word* w, size_t n) {
+    uint64_t start = cuik_time_in_nanos();
+    for (size_t i = 0; i < n; i++) {
+        size_t arity = w->type.in_count;
+        for (size_t j = 0; j < arity; j++) {
+            push(env, 0);
+        }
+
+        vm_thread_resume(env, w, 0);
+        env->head -= w->type.out_count;
+        assert(env->head == 0 && "stack \"leak\"?");
+    }
+    return cuik_time_in_nanos() - start;
+}
+
+static void report_tier(const char* name, VM_Thread* env, size_t n, uint64_t nanos) {
+    double secs = nanos / 1000000000.0;
+    fprintf(stderr, "  %-6s %10zu calls in %8.3f ms (%12.1f calls/s, %llu interp calls, %llu jit calls)\n",
+        name, n, secs * 1000.0, n / secs, (unsigned long long) env->interp_calls, (unsigned long long) env->jit_calls);
+}
+
+int main(int argc, const char** argv) {
+    is_main_thread = true;
+
+    const char* path = NULL;
+    size_t bench_n = 0;
+    bool use_spall = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-bench") == 0 && i + 1 < argc) {
+            bench_n = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-spall") == 0) {
+            use_spall = true;
+        } else {
+            path = argv[i];
+        }
+    }
+
+    if (path == NULL) {
+        fprintf(stderr, "usage: %s [-bench N] [-spall] file.forth\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    cuik_init_terminal();
+    cuik_init_timer_system();
+    if (use_spall) {
+        cuikperf_start("forth.spall", &spall_profiler, false);
+    }
+
+    thrd_t jit_thread;
+    if (thrd_create(&jit_thread, jit_thread_routine, NULL) != thrd_success) {
+        fprintf(stderr, "error: could not create JIT thread");
+        return EXIT_FAILURE;
+    }
+
+    tb_arena_create(&young_gen, TB_ARENA_LARGE_CHUNK_SIZE);
+    init_root_dict();
+    vm_install_pause_handler();
+
+    // the interpreter tier runs fine without the JIT, but we
+    // want the benchmark to see both tiers.
+    while (!jit.running) thrd_yield();
+
+    Dictionary sandbox = { .parent = &root_dict };
+    WordIndex root_word = load_forth(&sandbox, path);
+    if (root_word >= 0) {
+        return EXIT_FAILURE;
+    }
+
+    VM_Thread* env = vm_thread_new();
+    vm_thread_resume(env, &words.entries[-1000 - root_word], 0);
+
+    WordIndex update_word = dict_get(&sandbox, -1, "update");
+    if (update_word < 0) {
+        Word* w = &words.entries[-1000 - update_word];
+
+        if (bench_n == 0) {
+            run_word(env, w, 1);
+        } else {
+            fprintf(stderr, "bench: %s ('update' x %zu)\n", path, bench_n);
+
+            // interpreter tier, the call counters don't move while the JIT is off
+            jit.enabled = false;
+            env->interp_calls = env->jit_calls = 0;
+            report_tier("interp", env, bench_n, run_word(env, w, bench_n));
+
+            // let the call counters promote the word and wait for
+            // the compile thread to finish it.
+            jit.enabled = true;
+            uint64_t warmup_start = cuik_time_in_nanos();
+            while (atomic_load(&w->jitted) == NULL) {
+                run_word(env, w, 1);
+
+                // some words never get compiled (records)
+                if (cuik_time_in_nanos() - warmup_start > 2000000000ull) {
+                    fprintf(stderr, "  warning: 'update' was never promoted to the JIT\n");
+                    break;
+                }
+            }
+
+            env->interp_calls = env->jit_calls = 0;
+            report_tier("jit", env, bench_n, run_word(env, w, bench_n));
+        }
+    }
+
+    jit.running = false;
+    thrd_join(jit_thread, NULL);
+    if (use_spall) {
+        cuikperf_stop();
+    }
+
+    return 0;
+}
+#endif /* FORTH_GUI */
@@ -1,5 +1,17 @@
 #include <setjmp.h>
 
+// the pause handler leaves through a signal handler on POSIX, so we need
+// the variant of setjmp which restores the signal mask
+#ifdef _WIN32
+typedef jmp_buf VM_JmpBuf;
+#define vm_setjmp(buf)     setjmp(buf)
+#define vm_longjmp(buf, v) longjmp(buf, v)
+#else
+typedef sigjmp_buf VM_JmpBuf;
+#define vm_setjmp(buf)     sigsetjmp(buf, 1)
+#define vm_longjmp(buf, v) siglongjmp(buf, v)
+#endif
+
 ////////////////////////////////
 // Interpreter
 ////////////////////////////////
@@ -50,6 +62,14 @@ struct VM_Thread {
     VM_Status status;
     bool single_step;
 
+    // set by vm_thread_pause, the interpreter checks it between words
+    // while JITted code gets stopped by the poll site.
+    _Atomic bool pause;
+
+    // tiering stats, how many word calls ran in each tier
+    uint64_t interp_calls;
+    uint64_t jit_calls;
+
     // interpreter state
     size_t head;
     size_t control_head;
@@ -58,7 +78,7 @@ struct VM_Thread {
     uint64_t control[32];
 
     // used by pause exception to safely leave
-    jmp_buf early_exit;
+    VM_JmpBuf early_exit;
 
     // thread-local poll site is used to manage the pause state.
     // it may be converted into a guard page to force a segfault.
@@ -72,14 +92,26 @@ static void vm_interp(VM_Thread* env, Word* w);
 
 // allocates thread state but doesn't run
 static VM_Thread* vm_thread_new(void) {
+    #ifdef _WIN32
     VM_Thread* t = VirtualAlloc(NULL, VM_STACK_SIZE, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    #else
+    VM_Thread* t = mmap(NULL, VM_STACK_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (t == MAP_FAILED) {
+        fprintf(stderr, "error: could not allocate VM thread!\n");
+        abort();
+    }
+    #endif
+
     t->cookie = VM_COOKIE;
     mtx_init(&t->lock, mtx_plain);
     t->next = NULL;
     t->single_step = false;
+    t->pause = false;
+    t->interp_calls = t->jit_calls = 0;
     return t;
 }
 
+#ifdef _WIN32
 static LONG its_so_over(EXCEPTION_POINTERS* e) {
     // read from PAUSE_ADDR means we hit a safepoint during a pause
     if (e->ExceptionRecord->ExceptionCode == EXCEPTION_GUARD_PAGE) {
@@ -97,6 +129,74 @@ static LONG its_so_over(EXCEPTION_POINTERS* e) {
     return EXCEPTION_CONTINUE_SEARCH;
 }
 
+static void vm_install_pause_handler(void) {
+    AddVectoredExceptionHandler(1, its_so_over);
+}
+
+static void vm_protect_poll_site(VM_Thread* t) {
+    // guard pages reset themselves once they're hit
+    DWORD old;
+    if (!VirtualProtect((void*) &t->poll_site[0], 4096, PAGE_GUARD | PAGE_READONLY, &old)) {
+        fprintf(stderr, "error: could not reset guard page!\n");
+        abort();
+    }
+}
+
+static void vm_unprotect_poll_site(VM_Thread* t) {
+    DWORD old;
+    VirtualProtect((void*) &t->poll_site[0], 4096, PAGE_READWRITE, &old);
+}
+#else
+// the thread which is currently inside of vm_thread_resume, the poll
+// fault always happens on the thread running the JITted code.
+static _Thread_local VM_Thread* vm_current;
+static struct sigaction vm_old_segv;
+
+static void vm_unprotect_poll_site(VM_Thread* t) {
+    if (mprotect((void*) &t->poll_site[0], 4096, PROT_READ | PROT_WRITE) != 0) {
+        abort();
+    }
+}
+
+static void its_so_over(int sig, siginfo_t* info, void* uctx) {
+    // read from the poll site means we hit a safepoint during a pause
+    VM_Thread* t = vm_current;
+    char* addr = info->si_addr;
+    if (t != NULL && t->cookie == VM_COOKIE && addr >= &t->poll_site[0] && addr < &t->poll_site[4096]) {
+        // no guard pages here, we'll reset it by hand (mprotect is fine
+        // to call from a signal handler on Linux)
+        vm_unprotect_poll_site(t);
+
+        // early out from resume site
+        t->status = VM_STATUS_BREAK;
+        vm_longjmp(t->early_exit, 1);
+    }
+
+    // not our fault, put back the old handler and let the
+    // instruction fault again.
+    sigaction(SIGSEGV, &vm_old_segv, NULL);
+}
+
+static void vm_install_pause_handler(void) {
+    struct sigaction sa = { 0 };
+    sa.sa_sigaction = its_so_over;
+    sa.sa_flags = SA_SIGINFO;
+    sigemptyset(&sa.sa_mask);
+
+    if (sigaction(SIGSEGV, &sa, &vm_old_segv) != 0) {
+        fprintf(stderr, "error: could not install pause handler!\n");
+        abort();
+    }
+}
+
+static void vm_protect_poll_site(VM_Thread* t) {
+    if (mprotect((void*) &t->poll_site[0], 4096, PROT_NONE) != 0) {
+        fprintf(stderr, "error: could not protect poll site!\n");
+        abort();
+    }
+}
+#endif
+
 // takes a paused thread (potentially just initialized) and
 // allows it to run.
 //
@@ -106,7 +206,10 @@ static void vm_thread_resume(VM_Thread* t, Word* w, int count, ...) {
     // this is unlocked either by the end of this call
     // or safepoint.
     mtx_lock(&t->lock);
-    if (setjmp(t->early_exit) == 0) {
+    #ifndef _WIN32
+    vm_current = t;
+    #endif
+    if (vm_setjmp(t->early_exit) == 0) {
         assert(t->head + count < 64);
 
         // extract varargs
@@ -121,19 +224,22 @@ static void vm_thread_resume(VM_Thread* t, Word* w, int count, ...) {
         // run
         vm_interp(t, w);
     }
+    #ifndef _WIN32
+    vm_current = NULL;
+    #endif
     mtx_unlock(&t->lock);
 }
 
 static void vm_thread_pause(VM_Thread* t, Word* w) {
-    // forces the JIT code to stop at the nearest safepoint
-    DWORD old;
-    if (!VirtualProtect((void*) &t->poll_site[0], 4096, PAGE_GUARD | PAGE_READONLY, &old)) {
-        fprintf(stderr, "error: could not reset guard page!\n");
-        abort();
-    }
+    // forces the JIT code to stop at the nearest safepoint, the
+    // interpreter will notice the flag between words.
+    t->pause = true;
+    vm_protect_poll_site(t);
 
     // steal the lock
     mtx_lock(&t->lock);
+    t->pause = false;
+    vm_unprotect_poll_site(t);
     mtx_unlock(&t->lock);
 }
 
@@ -189,9 +295,11 @@ static void vm_interp(VM_Thread* env, Word* w) {
         // we switch to directly calling the JIT soon
         int r = jit_try_call(env, w);
         if (r != VM_STATUS_NO_JIT) {
+            env->jit_calls += 1;
             env->status = r;
             return;
         } else {
+            env->interp_calls += 1;
             env->control[env->control_head++] = (w - words.entries) << 32ull;
         }
     }
@@ -213,8 +321,10 @@ static void vm_interp(VM_Thread* env, Word* w) {
                 int r = env->single_step ? VM_STATUS_NO_JIT : jit_try_call(env, w);
                 if (r != VM_STATUS_NO_JIT) {
                     // once the JIT finishes with a tail call, we just return
+                    env->jit_calls += 1;
                     break;
                 } else {
+                    env->interp_calls += 1;
                     i = 0;
                 }
             } else if (x <= -1000) {
@@ -222,8 +332,10 @@ static void vm_interp(VM_Thread* env, Word* w) {
 
                 int r = env->single_step ? VM_STATUS_NO_JIT : jit_try_call(env, new_w);
                 if (r != VM_STATUS_NO_JIT) {
+                    env->jit_calls += 1;
                     i += 1;
                 } else {
+                    env->interp_calls += 1;
                     // save return continuation
                     env->control[env->control_head - 1] = ((w - words.entries) << 32ull) | (i + 1);
 
@@ -307,7 +419,7 @@ static void vm_interp(VM_Thread* env, Word* w) {
                 i += 1;
             }
 
-            if (env->single_step) {
+            if (env->single_step || env->pause) {
                 // interpreter savepoint
                 env->control[env->control_head - 1] = ((w - words.entries) << 32ull) | i;
                 env->status = VM_STATUS_BREAK;
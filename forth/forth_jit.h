@@ -50,6 +50,10 @@ typedef int (*JIT_Caller)(VM_Thread* env, Value* args, void* fn);
 static struct {
     _Atomic bool running;
 
+    // when disabled, everything stays in the interpreter tier and
+    // the call counters don't tick (used for benchmarking).
+    _Atomic bool enabled;
+
     TB_Arena arena;
     TB_Module* mod;
     TB_JIT* jit;
@@ -83,13 +87,21 @@ static void jit__queue_push(uint32_t exp, _Atomic uint32_t* queue, void** elems,
 static void* jit__queue_pop(uint32_t exp, _Atomic uint32_t* queue, void** elems);
 
 int jit_try_call(VM_Thread* env, Word* w) {
-    if (w->tag == WORD_TYPE) {
+    if (w->tag == WORD_TYPE || !jit.enabled) {
         return VM_STATUS_NO_JIT;
     }
 
     void* fn = atomic_load(&w->jitted);
     if (fn == NULL) {
-        if (atomic_fetch_add(&w->trip_count, 1) == JIT_THRESHOLD) {
+        int trips = atomic_fetch_add(&w->trip_count, 1);
+        if (trips == JIT_RECOMPILE_THRESHOLD) {
+            // we might've picked a parent earlier which never got called again (a word
+            // spinning in a tail loop will do that), at this point it's hot enough alone.
+            if (atomic_compare_exchange_strong(&w->jit_mark, &(bool){ false }, true)) {
+                log_debug("jit: trip count exceeded for %.*s, ignoring the parent", (int) w->name.length, w->name.data);
+                jit__queue_push(8, &jit.queue, jit.queue_elems, w);
+            }
+        } else if (trips == JIT_THRESHOLD) {
             // check if a parent is more suited
             if (env->control_head >= 1) {
                 Word* best = w;
@@ -164,7 +176,8 @@ static JIT_Trampoline jit__get_trampoline(size_t arity, size_t outs) {
             params[i + 1] = (TB_PrototypeParam){ TB_TYPE_I64 };
         }
 
-        TB_PrototypeParam ret = { outs > 0 ? TB_TYPE_I64 : TB_TYPE_VOID };
+        // outputs are spilled onto the VM stack, the return value is the VM_Status
+        TB_PrototypeParam ret = { TB_TYPE_I32 };
         TB_FunctionPrototype* proto = tb_prototype_create(jit.mod, TB_STDCALL, arity + 1, params, 1, &ret, false);
 
         // compile caller
@@ -175,8 +188,8 @@ static JIT_Trampoline jit__get_trampoline(size_t arity, size_t outs) {
         snprintf(name, 32, "jit_caller_%zuary", arity);
 
         // generate caller
-        TB_Function* f = tb_function_create(jit.mod, -1, name, TB_LINKAGE_PUBLIC, TB_COMDAT_NONE);
-        tb_function_set_prototype(f, jit.proto, NULL);
+        TB_Function* f = tb_function_create(jit.mod, -1, name, TB_LINKAGE_PUBLIC);
+        tb_function_set_prototype(f, tb_module_get_text(jit.mod), jit.proto, NULL);
 
         // top of the stack is gonna be loaded into params
         TB_Node* tos = tb_inst_param(f, 1);
@@ -323,6 +336,7 @@ static int jit_thread_routine(void* arg) {
         JIT__BIND(GETCHAR, getchar,     TB_TYPE_I32);
         JIT__BIND(RECT,    jit__rect,   TB_TYPE_VOID, TB_TYPE_I32, TB_TYPE_I32, TB_TYPE_I32, TB_TYPE_I32);
 
+        jit.enabled = true;
         jit.running = true;
     }
 
@@ -562,6 +576,7 @@ static void jit__compile_word(JIT_Builder* ctx, Word* w) {
                 case OP_ADD: stack[head++] = tb_inst_add(f, args[0], args[1], 0); break;
                 case OP_SUB: stack[head++] = tb_inst_sub(f, args[0], args[1], 0); break;
                 case OP_MUL: stack[head++] = tb_inst_mul(f, args[0], args[1], 0); break;
+                case OP_DIV: stack[head++] = tb_inst_div(f, args[0], args[1], false); break;
 
                 // stack
                 case OP_DUP: stack[head] = args[0], stack[head+1] = args[0], head += 2; break;
@@ -671,8 +686,8 @@ static void jit__compile_blob(VM_Thread* env, Word* w, const char* name) {
     JIT_Trampoline t = jit__get_trampoline(w->type.in_count, w->type.out_count);
     mtx_unlock(&jit.trampoline_lock);
 
-    TB_Function* f = builder.f = tb_function_create(jit.mod, -1, name, TB_LINKAGE_PUBLIC, TB_COMDAT_NONE);
-    tb_function_set_prototype(f, t.proto, &jit.arena);
+    TB_Function* f = builder.f = tb_function_create(jit.mod, -1, name, TB_LINKAGE_PUBLIC);
+    tb_function_set_prototype(f, tb_module_get_text(jit.mod), t.proto, &jit.arena);
 
     CUIK_TIMED_BLOCK("IR") {
         builder.head = 0;
@@ -0,0 +1,50 @@
+// Profile runtime, cuik compiles this into -fprofile-generate programs. Every
+// instrumented function leaves a record in the cuikprof section and main starts
+// us up so we can append all the counts to the profile once the program exits.
+//
+// CUIK_PROFILE_FILE overrides the path the program was built with.
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+typedef struct {
+    uint64_t hash;
+    uint64_t count;
+    uint64_t* counters;
+    uint64_t pad;
+} CuikProfRecord;
+
+// the linker makes these for any section with a C identifier for a name
+extern CuikProfRecord __start_cuikprof;
+extern CuikProfRecord __stop_cuikprof;
+
+static const char* cuikprof_path;
+
+static void cuikprof_dump(void) {
+    FILE* out = fopen(cuikprof_path, "a");
+    if (out == NULL) {
+        perror(cuikprof_path);
+        return;
+    }
+
+    for (CuikProfRecord* r = &__start_cuikprof; r != &__stop_cuikprof; r++) {
+        // functions which never ran don't tell us anything
+        if (r->counters[0] == 0) {
+            continue;
+        }
+
+        fprintf(out, "%016llx %llu", (unsigned long long) r->hash, (unsigned long long) r->count);
+        for (uint64_t i = 0; i < r->count; i++) {
+            fprintf(out, " %llu", (unsigned long long) r->counters[i]);
+        }
+        fprintf(out, "\n");
+    }
+
+    fclose(out);
+}
+
+void __cuik_prof_start(const char* path) {
+    const char* env = getenv("CUIK_PROFILE_FILE");
+    cuikprof_path = env != NULL ? env : path;
+    atexit(cuikprof_dump);
+}
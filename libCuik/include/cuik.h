@@ -15,6 +15,7 @@ typedef struct CompilationUnit CompilationUnit;
 typedef struct TranslationUnit TranslationUnit;
 typedef struct Cuik_Toolchain Cuik_Toolchain;
 typedef struct Cuik_DriverArgs Cuik_DriverArgs;
+typedef struct Cuik_Profile Cuik_Profile;
 
 ////////////////////////////////////////////
 // Interfaces
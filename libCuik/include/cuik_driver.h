@@ -24,18 +24,51 @@ struct Cuik_DriverArgs {
 
     #ifdef CUIK_USE_TB
     TB_OutputFlavor flavor;
+
+    // -cache, whoever runs the build steps opens code_cache from the path
+    // and closes it once they're done.
+    const char* code_cache_path;
+    TB_CodeCache* code_cache;
+
+    // -live -r, the link step places (or hot-swaps) the module into this
+    // JIT rather than exporting it. Each link step is one unit, named
+    // after its first source.
+    TB_JIT* jit;
+
+    // -fprofile-generate, functions count how often each of their blocks run
+    // and the program appends those counts to this file when it exits.
+    const char* profile_generate;
+
+    // -fprofile-use, whoever runs the build steps loads profile from the path
+    // and frees it once they're done.
+    const char* profile_use;
+    Cuik_Profile* profile;
     #endif
 
     Cuik_Target* target;
     Cuik_Toolchain toolchain;
 
     int threads, opt_level;
+
+    // -mem-budget, optimized builds stream functions into the backend as
+    // they're generated, irgen stalls once this many bytes of IR are waiting
+    // on it (0 means the default).
+    size_t mem_budget;
+
     const char* output_name;
     const char* entrypoint;
 
+    // JSON compile statistics (-Tstats), lines_processed is filled
+    // in by the driver as it preprocesses.
+    const char* stats_output;
+    uint64_t lines_processed;
+
     void* diag_userdata;
     Cuik_DiagCallback diag_callback;
 
+    // where the build steps dump diagnostics, NULL means stderr
+    FILE* diag_file;
+
     DynArray(Cuik_Path*) sources;
     DynArray(Cuik_Path*) includes;
     DynArray(Cuik_Path*) libraries;
@@ -53,6 +86,8 @@ struct Cuik_DriverArgs {
     bool nocrt           : 1;
     bool live            : 1;
     bool time            : 1;
+    bool perf_counters   : 1;
+    bool hw_counters     : 1;
     bool verbose         : 1;
     bool syntax_only     : 1;
     bool test_preproc    : 1;
@@ -61,6 +96,9 @@ struct Cuik_DriverArgs {
     bool think           : 1;
     bool based           : 1;
     bool preserve_ast    : 1;
+    bool whole_program   : 1;
+    bool emit_module     : 1;
+    bool strict_aliasing : 1;
 };
 
 typedef struct Cuik_Arg Cuik_Arg;
@@ -77,6 +115,10 @@ CUIK_API Cuik_Arguments* cuik_alloc_args(void);
 CUIK_API void cuik_free_args(Cuik_Arguments* args);
 
 CUIK_API void cuik_parse_args(Cuik_Arguments* restrict args, int argc, const char* argv[]);
+
+// resolves the relative paths in args against dir rather than the current
+// working directory, used when the arguments came from another process.
+CUIK_API void cuik_args_rebase(Cuik_Arguments* restrict args, const char* dir);
 CUIK_API bool cuik_args_to_driver(Cuik_DriverArgs* comp_args, Cuik_Arguments* restrict args);
 
 CUIK_API bool cuik_parse_driver_args(Cuik_DriverArgs* comp_args, int argc, const char* argv[]);
@@ -37,7 +37,9 @@ CUIK_API bool cuikfs_canonicalize(Cuik_Path* out, const char* path, bool case_in
 #include <windows.h>
 #elif defined(__linux__)
 #include <dirent.h>
+#include <fcntl.h>
 #include <unistd.h>
+#include <sys/stat.h>
 #else
 #error "cuik_fs: unsupported on this platform (for now?)"
 #endif
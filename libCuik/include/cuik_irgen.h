@@ -22,5 +22,18 @@ CUIK_API void cuikcg_allocate_ir(TranslationUnit* restrict tu, Cuik_IThreadpool*
 // same as cuikcg_allocate_ir except it's used for single-TU setups
 CUIK_API void cuikcg_allocate_ir2(TranslationUnit* tu, TB_Module* m, bool debug);
 
+// -fprofile-use data, NULL if it couldn't be read
+CUIK_API Cuik_Profile* cuikcg_profile_load(const char* path);
+CUIK_API void cuikcg_profile_free(Cuik_Profile* prof);
+
+// with an output path the functions get instrumented and the program writes its
+// counts there when it exits, with a profile the counts become block frequencies.
+// call it before cuikcg_allocate_ir.
+CUIK_API void cuikcg_set_profile(TranslationUnit* tu, const char* output, Cuik_Profile* prof);
+
+// with strict aliasing the loads and stores get tagged with their C types so the
+// optimizer knows an int* and a float* can't point to the same thing.
+CUIK_API void cuikcg_set_strict_aliasing(TranslationUnit* tu, bool strict);
+
 // returns NULL on failure
 CUIK_API TB_Symbol* cuikcg_top_level(TranslationUnit* restrict tu, TB_Module* m, TB_Arena* arena, Stmt* restrict s);
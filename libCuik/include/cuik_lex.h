@@ -133,9 +133,48 @@ typedef struct TokenArray {
     size_t current;
 } TokenArray;
 
+// This is what the preprocessor hands to the parser, the spelling isn't stored
+// since it can be recovered from the location (it points into the file or macro
+// definition it came from), the rare tokens where that isn't possible (too long,
+// stringized, pasted, macro arguments, builtin macros) live in the token stream's
+// side table.
+enum { TOKEN_LENGTH_LONG = 127 };
+
+typedef struct PackedToken {
+    // it's a TknType, keywords start at 0x400000 so 23bits is plenty
+    unsigned type     : 23;
+    unsigned hit_line : 1;
+    // the content is in the side table
+    unsigned side     : 1;
+    // TOKEN_LENGTH_LONG means the length is in the side table too
+    unsigned length   : 7;
+
+    SourceLoc location;
+} PackedToken;
+
+typedef struct PackedTokenArray {
+    // DynArray(PackedToken)
+    struct PackedToken* tokens;
+    size_t current;
+} PackedTokenArray;
+
 typedef struct TokenStream {
     const char* filepath;
-    TokenArray list;
+    PackedTokenArray list;
+
+    // DynArray(String) spelling of every side token, in order
+    String* side_table;
+
+    // DynArray(uint64_t) one bit per token, set if it's a side token
+    uint64_t* side_bits;
+
+    // DynArray(uint32_t) [i] is how many side tokens come before token i*64,
+    // with a popcount of side_bits we can find any token's side table entry.
+    uint32_t* side_rank;
+
+    // DynArray(const unsigned char*), [macro_id] is what the offsets in
+    // that macro's locations are relative to (NULL if we haven't seen it)
+    const unsigned char** macro_bases;
 
     Cuik_Diagnostics* diag;
 
@@ -237,7 +276,8 @@ CUIK_API void cuikpp_finalize(Cuik_CPP* ctx);
 CUIK_API TokenStream* cuikpp_get_token_stream(Cuik_CPP* ctx);
 CUIK_API void cuiklex_free_tokens(TokenStream* tokens);
 
-CUIK_API Token* cuikpp_get_tokens(TokenStream* restrict s);
+CUIK_API PackedToken* cuikpp_get_tokens(TokenStream* restrict s);
+CUIK_API String cuikpp_get_token_content(TokenStream* restrict s, size_t i);
 CUIK_API size_t cuikpp_get_token_count(TokenStream* restrict s);
 
 CUIK_API Cuik_FileEntry* cuikpp_get_files(TokenStream* restrict s);
@@ -279,6 +319,10 @@ CUIK_API void cuiklex_canonicalize(size_t length, char* data);
 CUIK_API bool cuikpp_locate_file(void* user_data, const Cuik_Path* restrict input, Cuik_Path* output, bool case_insensitive);
 CUIK_API bool cuikpp_default_fs(void* user_data, const Cuik_Path* restrict input, Cuik_FileResult* out_result, bool case_insensitive);
 
+// makes cuikpp_default_fs hold onto the files it reads, it's meant for long
+// running processes which compile the same headers over and over.
+CUIK_API void cuikpp_enable_file_cache(void);
+
 // Returns entire preprocessor on input state
 CUIK_API Cuikpp_Status cuikpp_run(Cuik_CPP* restrict ctx);
 
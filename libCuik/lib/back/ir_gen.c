@@ -10,6 +10,14 @@ static thread_local const char* function_name;
 
 static thread_local TB_PassingRule func_return_rule;
 
+// set when nothing in the function can point into its frame, if so the call at the
+// root of tailcall_expr (a return statement) gets to reuse the frame.
+static thread_local bool function_can_tailcall;
+static thread_local Cuik_Expr* tailcall_expr;
+
+// win64 only has 4 parameter registers, anything past that goes in the caller's frame
+enum { TAILCALL_MAX_ARGS = 4 };
+
 static _Thread_local TB_Node* current_scope;
 
 static void emit_location(TranslationUnit* tu, TB_Function* func, SourceLoc loc);
@@ -272,6 +280,32 @@ static TB_Node* cast_reg(TB_Function* func, TB_Node* reg, const Cuik_Type* src,
     return reg;
 }
 
+// character types alias anything so they stay in class 0 (same as the aggregates
+// which are copied around as bytes), signedness doesn't matter either.
+static int alias_class(TranslationUnit* tu, Cuik_Type* t, bool may_alias) {
+    if (!tu->strict_aliasing || may_alias) {
+        return 0;
+    }
+
+    switch (t->kind) {
+        case KIND_SHORT:
+        case KIND_INT:
+        case KIND_LONG:
+        case KIND_LLONG:
+        case KIND_ENUM:
+        return t->size == 2 ? 1 : t->size == 4 ? 2 : t->size == 8 ? 3 : 0;
+
+        case KIND_FLOAT:  return 4;
+        case KIND_DOUBLE: return 5;
+        case KIND_PTR:    return 6;
+        default:          return 0;
+    }
+}
+
+static bool is_union_type(Cuik_QualType t) {
+    return cuik_canonical_type(t)->kind == KIND_UNION;
+}
+
 static TB_Node* cvt2rval(TranslationUnit* tu, TB_Function* func, IRVal* v) {
     Cuik_Type* dst = cuik_canonical_type(v->cast_type);
     Cuik_Type* src = cuik_canonical_type(v->type);
@@ -310,7 +344,9 @@ static TB_Node* cvt2rval(TranslationUnit* tu, TB_Function* func, IRVal* v) {
                 reg = v->reg;
             } else {
                 TB_DataType dt = ctype_to_tbtype(src);
+                tb_inst_set_alias_class(func, alias_class(tu, src, v->may_alias));
                 reg = tb_inst_load(func, dt, v->reg, src->align, is_volatile);
+                tb_inst_set_alias_class(func, 0);
             }
             break;
         }
@@ -790,11 +826,13 @@ static IRVal irgen_subexpr(TranslationUnit* tu, TB_Function* func, Cuik_Expr* _,
                 return (IRVal){
                     .value_type = LVALUE,
                     .reg = tb_inst_member_access(func, lhs.reg, e->dot_arrow.offset),
+                    .may_alias = lhs.may_alias || is_union_type(lhs.type),
                 };
             }
         }
         case EXPR_ARROW_R: {
             TB_Node* src = RVAL(0);
+            bool may_alias = is_union_type(cuik_canonical_type(GET_ARG(0).type)->ptr_to);
 
             Member* member = e->dot_arrow.member;
             assert(member != NULL);
@@ -812,6 +850,7 @@ static IRVal irgen_subexpr(TranslationUnit* tu, TB_Function* func, Cuik_Expr* _,
                 return (IRVal){
                     .value_type = LVALUE,
                     .reg = tb_inst_member_access(func, src, e->dot_arrow.offset),
+                    .may_alias = may_alias,
                 };
             }
         }
@@ -825,6 +864,7 @@ static IRVal irgen_subexpr(TranslationUnit* tu, TB_Function* func, Cuik_Expr* _,
             return (IRVal){
                 .value_type = LVALUE,
                 .reg = tb_inst_array_access(func, base, index, stride),
+                .may_alias = GET_ARG(0).may_alias,
             };
         }
         case EXPR_DEREF: {
@@ -849,9 +889,18 @@ static IRVal irgen_subexpr(TranslationUnit* tu, TB_Function* func, Cuik_Expr* _,
                 const char* name = (const char*) target->e->builtin_sym.name;
                 TB_Node* val = tu->target->compile_builtin(tu, func, name, arg_count + 1, args);
 
+                int expect = 0;
+                if (arg_count == 2 && strcmp(name, "__builtin_expect") == 0) {
+                    TB_Node* c = args[2].value_type == RVALUE ? args[2].reg : NULL;
+                    if (c != NULL && c->type == TB_INTEGER_CONST) {
+                        expect = TB_NODE_GET_EXTRA_T(c, TB_NodeInt)->value ? 1 : -1;
+                    }
+                }
+
                 return (IRVal){
                     .value_type = RVALUE,
                     .reg = val,
+                    .expect = expect,
                 };
             }
 
@@ -893,6 +942,12 @@ static IRVal irgen_subexpr(TranslationUnit* tu, TB_Function* func, Cuik_Expr* _,
                 ir_args[ir_arg_count++] = tb_inst_local(func, return_type->size, return_type->align);
             }
 
+            // tail calls can't leave anything in our frame (indirect arguments are copies
+            // on our stack) and every argument needs to fit in registers since we don't
+            // own the caller's argument space.
+            bool tailcall = tailcall_expr == _ && e == &_->exprs[_->count - 1] && return_rule == TB_PASSING_DIRECT &&
+                !func_type->func.has_varargs && real_arg_count <= TAILCALL_MAX_ARGS;
+
             size_t dbg_param_count = tb_debug_func_param_count(dbg);
             TB_DebugType** params = tb_debug_func_params(dbg);
             for (size_t i = 0; i < arg_count; i++) {
@@ -905,9 +960,22 @@ static IRVal irgen_subexpr(TranslationUnit* tu, TB_Function* func, Cuik_Expr* _,
 
                 TB_PassingRule rule = tb_get_passing_rule_from_dbg(tu->ir_mod, t, false);
                 ir_arg_count += pass_parameter(tu, func, rule, args[i + 1], i >= varargs_cutoff, &ir_args[ir_arg_count]);
+                tailcall &= (rule == TB_PASSING_DIRECT);
             }
             assert(ir_arg_count == real_arg_count);
 
+            if (tailcall) {
+                tb_inst_tailcall(func, call_prototype, target_node, real_arg_count, ir_args);
+                tls_restore(ir_args);
+
+                // lets the return statement know it's done
+                tailcall_expr = NULL;
+                return (IRVal){
+                    .value_type = RVALUE,
+                    .reg = NULL,
+                };
+            }
+
             TB_MultiOutput out = tb_inst_call(func, call_prototype, target_node, real_arg_count, ir_args);
             tls_restore(ir_args);
 
@@ -1264,7 +1332,9 @@ static IRVal irgen_subexpr(TranslationUnit* tu, TB_Function* func, Cuik_Expr* _,
             // writeback (the atomic form does this all in one go... as atomics do)
             if (!CUIK_QUAL_TYPE_HAS(GET_TYPE(), CUIK_QUAL_ATOMIC)) {
                 assert(address.value_type == LVALUE);
+                tb_inst_set_alias_class(func, alias_class(tu, type, address.may_alias));
                 tb_inst_store(func, dt, address.reg, operation, type->align, is_volatile);
+                tb_inst_set_alias_class(func, 0);
             }
 
             return (IRVal){
@@ -1377,7 +1447,9 @@ static IRVal irgen_subexpr(TranslationUnit* tu, TB_Function* func, Cuik_Expr* _,
                     TB_Node* arith = tb_inst_array_access(func, l, r, dir * stride);
 
                     assert(lhs.value_type == LVALUE);
+                    tb_inst_set_alias_class(func, alias_class(tu, type, lhs.may_alias));
                     tb_inst_store(func, TB_TYPE_PTR, lhs.reg, arith, type->align, is_volatile);
+                    tb_inst_set_alias_class(func, 0);
                     return lhs;
                 }
 
@@ -1404,7 +1476,9 @@ static IRVal irgen_subexpr(TranslationUnit* tu, TB_Function* func, Cuik_Expr* _,
                     }
 
                     assert(lhs.value_type == LVALUE);
+                    tb_inst_set_alias_class(func, alias_class(tu, type, lhs.may_alias));
                     tb_inst_store(func, dt, lhs.reg, data, type->align, is_volatile);
+                    tb_inst_set_alias_class(func, 0);
                 } else {
                     TB_Node* r = cvt2rval(tu, func, &rhs);
                     TB_ArithmeticBehavior ab = type->is_unsigned ? 0 : TB_ARITHMATIC_NSW;
@@ -1445,9 +1519,11 @@ static IRVal irgen_subexpr(TranslationUnit* tu, TB_Function* func, Cuik_Expr* _,
                         data = tb_inst_or(func, old_value, data);
                     } else {
                         assert(lhs.value_type == LVALUE);
+                        tb_inst_set_alias_class(func, alias_class(tu, type, lhs.may_alias));
                     }
 
                     tb_inst_store(func, dt, lhs.reg, data, type->align, is_volatile);
+                    tb_inst_set_alias_class(func, 0);
 
                     if (e->op == EXPR_ASSIGN) {
                         assert(data);
@@ -1698,9 +1774,24 @@ static void irgen_stmt(TranslationUnit* tu, TB_Function* func, Stmt* restrict s)
                 break;
             }
 
-            IRVal v = irgen_expr(tu, func, s->return_.expr);
-
+            // return f(...) can jump straight into f if it hands back exactly what we do
             Cuik_Type* type = cuik_canonical_type(get_root_cast(s->return_.expr));
+            if (function_can_tailcall && get_root_subexpr(s->return_.expr)->op == EXPR_CALL) {
+                Cuik_Type* ret_type = cuik_canonical_type(function_type->func.return_type);
+                Cuik_Type* call_type = cuik_canonical_type(get_root_type(s->return_.expr));
+
+                if (type == call_type && call_type->kind != KIND_STRUCT && call_type->kind != KIND_UNION &&
+                    ctype_to_tbtype(call_type).raw == ctype_to_tbtype(ret_type).raw) {
+                    tailcall_expr = s->return_.expr;
+                }
+            }
+
+            bool tailcall = tailcall_expr != NULL;
+            IRVal v = irgen_expr(tu, func, s->return_.expr);
+            if (tailcall && tailcall_expr == NULL) {
+                break;
+            }
+            tailcall_expr = NULL;
             if (func_return_rule == TB_PASSING_INDIRECT) {
                 // returning aggregates just copies into the first parameter
                 // which is agreed to be a caller owned buffer.
@@ -1756,6 +1847,13 @@ static void irgen_stmt(TranslationUnit* tu, TB_Function* func, Stmt* restrict s)
 
                 // Cast to bool
                 tb_inst_if(func, cvt2rval(tu, func, &cond), if_true, if_false);
+
+                // the unlikely side is fair game for the cold section
+                if (cond.expect > 0 && if_false != exit) {
+                    tb_inst_set_region_freq(func, if_false, 0.0f);
+                } else if (cond.expect < 0) {
+                    tb_inst_set_region_freq(func, if_true, 0.0f);
+                }
             }
 
             tb_inst_set_control(func, if_true);
@@ -1951,6 +2049,150 @@ static void irgen_stmt(TranslationUnit* tu, TB_Function* func, Stmt* restrict s)
     }
 }
 
+static bool is_global_symbol(Subexpr* e) {
+    if (e->op != EXPR_SYMBOL) {
+        return false;
+    }
+
+    Stmt* stmt = e->sym.stmt;
+    return stmt->op == STMT_GLOBAL_DECL || stmt->op == STMT_FUNC_DECL || (stmt->op == STMT_DECL && stmt->decl.attrs.is_static);
+}
+
+static bool init_leaks_frame(InitNode* n);
+
+// conservative, true if the expression could make a pointer into the frame
+static bool expr_leaks_frame(Cuik_Expr* e) {
+    if (e == NULL) {
+        return false;
+    }
+
+    for (size_t i = 0; i < e->count; i++) {
+        Subexpr* s = &e->exprs[i];
+
+        // arrays decay into a pointer to wherever they live
+        Cuik_Type* type = cuik_canonical_type(e->types[i]);
+        if (type != NULL && type->kind == KIND_ARRAY && s->op != EXPR_STR && s->op != EXPR_WSTR && !is_global_symbol(s)) {
+            return true;
+        }
+
+        switch (s->op) {
+            case EXPR_ADDR: {
+                // the operand comes right before in postfix order, anything
+                // we got through a pointer was already pointing somewhere.
+                Subexpr* src = &e->exprs[i - 1];
+                if (!is_global_symbol(src) && src->op != EXPR_DEREF && src->op != EXPR_ARROW && src->op != EXPR_ARROW_R) {
+                    return true;
+                }
+                break;
+            }
+
+            case EXPR_BUILTIN_SYMBOL:
+            if (strstr((const char*) s->builtin_sym.name, "alloca") != NULL) {
+                return true;
+            }
+            break;
+
+            case EXPR_INITIALIZER:
+            if (init_leaks_frame(s->init.root)) return true;
+            break;
+
+            case EXPR_TERNARY:
+            if (expr_leaks_frame(s->ternary.left) || expr_leaks_frame(s->ternary.right)) return true;
+            break;
+
+            case EXPR_LOGICAL_AND:
+            case EXPR_LOGICAL_OR:
+            if (expr_leaks_frame(s->logical_binop.left) || expr_leaks_frame(s->logical_binop.right)) return true;
+            break;
+
+            default: break;
+        }
+    }
+
+    return false;
+}
+
+static bool init_leaks_frame(InitNode* n) {
+    for (InitNode* k = n->kid; k != NULL; k = k->next) {
+        if (expr_leaks_frame(k->expr) || init_leaks_frame(k)) return true;
+    }
+
+    return false;
+}
+
+static bool stmt_leaks_frame(Stmt* s) {
+    if (s == NULL) {
+        return false;
+    }
+
+    switch (s->op) {
+        case STMT_COMPOUND:
+        for (size_t i = 0; i < s->compound.kids_count; i++) {
+            if (stmt_leaks_frame(s->compound.kids[i])) return true;
+        }
+        return false;
+
+        case STMT_DECL:     return expr_leaks_frame(s->decl.initial);
+        case STMT_EXPR:     return expr_leaks_frame(s->expr.expr);
+        case STMT_RETURN:   return expr_leaks_frame(s->return_.expr);
+        case STMT_GOTO:     return expr_leaks_frame(s->goto_.target);
+        case STMT_IF:       return expr_leaks_frame(s->if_.cond) || stmt_leaks_frame(s->if_.body) || stmt_leaks_frame(s->if_.next);
+        case STMT_WHILE:    return expr_leaks_frame(s->while_.cond) || stmt_leaks_frame(s->while_.body);
+        case STMT_DO_WHILE: return expr_leaks_frame(s->do_while.cond) || stmt_leaks_frame(s->do_while.body);
+        case STMT_SWITCH:   return expr_leaks_frame(s->switch_.condition) || stmt_leaks_frame(s->switch_.body);
+        case STMT_CASE:     return stmt_leaks_frame(s->case_.body);
+        case STMT_DEFAULT:  return stmt_leaks_frame(s->default_.body);
+        case STMT_FOR: {
+            return stmt_leaks_frame(s->for_.first) || expr_leaks_frame(s->for_.cond) ||
+                stmt_leaks_frame(s->for_.body) || expr_leaks_frame(s->for_.next);
+        }
+
+        default: return false;
+    }
+}
+
+// returns the counters if we're instrumenting the function
+static TB_Global* irgen_profile_begin(TranslationUnit* tu, TB_Module* m, TB_Function* func, Stmt* s) {
+    if (tu->prof_output != NULL) {
+        TB_Global* counters = tb_global_create(m, 0, NULL, NULL, TB_LINKAGE_PRIVATE);
+        tb_function_instrument(func, (TB_Symbol*) counters);
+
+        // the runtime dumps the counters when the program exits
+        if (strcmp(s->decl.name, "main") == 0) {
+            TB_PrototypeParam param = { TB_TYPE_PTR };
+            TB_FunctionPrototype* proto = tb_prototype_create(m, TB_CDECL, 1, &param, 0, NULL, false);
+
+            TB_Node* target = tb_inst_get_symbol_address(func, get_external(tu->parent, "__cuik_prof_start"));
+            TB_Node* path = tb_inst_cstring(func, tu->prof_output);
+            tb_inst_call(func, proto, target, 1, &path);
+        }
+        return counters;
+    } else if (tu->prof != NULL) {
+        uint64_t hash = cuikprof_function_hash(tu, s->decl.name, s->decl.attrs.is_static);
+        const uint64_t* counts = cuikprof_lookup(tu->prof, hash);
+        if (counts != NULL) {
+            tb_function_set_profile(func, counts[0], &counts[1]);
+        }
+    }
+
+    return NULL;
+}
+
+static void irgen_profile_end(TranslationUnit* tu, TB_Module* m, TB_Function* func, Stmt* s, TB_Global* counters) {
+    size_t count = tb_function_get_counter_count(func);
+    tb_global_set_storage(m, tb_module_get_data(m), counters, count * sizeof(uint64_t), sizeof(uint64_t), 0);
+
+    // the records are padded to 32 bytes, the linker might align each object's
+    // piece of the section to 16 and the runtime walks them as one array.
+    TB_Global* record = tb_global_create(m, 0, NULL, NULL, TB_LINKAGE_PRIVATE);
+    tb_global_set_storage(m, tu->parent->prof_section, record, 32, 8, 2);
+
+    uint64_t* data = tb_global_add_region(m, record, 0, 16);
+    data[0] = cuikprof_function_hash(tu, s->decl.name, s->decl.attrs.is_static);
+    data[1] = count;
+    tb_global_add_symbol_reloc(m, record, 16, (TB_Symbol*) counters);
+}
+
 TB_Symbol* cuikcg_top_level(TranslationUnit* restrict tu, TB_Module* m, TB_Arena* arena, Stmt* restrict s) {
     if (s->op == STMT_FUNC_DECL) {
         if ((s->decl.attrs.is_static || s->decl.attrs.is_inline) && !s->decl.attrs.is_used) {
@@ -1979,6 +2221,8 @@ TB_Symbol* cuikcg_top_level(TranslationUnit* restrict tu, TB_Module* m, TB_Arena
         size_t param_count;
         parameter_map = tb_function_set_prototype_from_dbg(func, section, dbg_type, arena, &param_count);
 
+        TB_Global* prof_counters = irgen_profile_begin(tu, m, func, s);
+
         if (cuik_canonical_type(type->func.return_type)->kind != KIND_VOID) {
             TB_DebugType* dbg_ret = tb_debug_func_returns(dbg_type)[0];
             func_return_rule = tb_get_passing_rule_from_dbg(tu->ir_mod, dbg_ret, true);
@@ -1998,6 +2242,11 @@ TB_Symbol* cuikcg_top_level(TranslationUnit* restrict tu, TB_Module* m, TB_Arena
             }
         }
 
+        // tail calls would eat the frames a debugger wants to see and varargs
+        // live in the frame.
+        function_can_tailcall = !tu->has_tb_debug_info && !type->func.has_varargs && !stmt_leaks_frame(s->decl.initial_as_stmt);
+        tailcall_expr = NULL;
+
         // compile body
         {
             function_type = type;
@@ -2019,6 +2268,10 @@ TB_Symbol* cuikcg_top_level(TranslationUnit* restrict tu, TB_Module* m, TB_Arena
             }
         }
 
+        if (prof_counters != NULL) {
+            irgen_profile_end(tu, m, func, s, prof_counters);
+        }
+
         // tb_inst_set_scope(func, old_tb_scope);
         return (TB_Symbol*) func;
     } else if (s->flags & STMT_FLAGS_HAS_IR_BACKING) {
@@ -2103,6 +2356,10 @@ static void ir_alloc_task(void* task) {
     }
 }
 
+void cuikcg_set_strict_aliasing(TranslationUnit* tu, bool strict) {
+    tu->strict_aliasing = strict;
+}
+
 void cuikcg_allocate_ir(TranslationUnit* restrict tu, Cuik_IThreadpool* restrict thread_pool, TB_Module* m, bool debug) {
     // we actually fill the remaining count while we dispatch tasks, it's ok for it to hit 0
     // occasionally (very rare realistically).
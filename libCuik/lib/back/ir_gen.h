@@ -22,6 +22,14 @@ typedef struct IRVal {
     IRValType value_type;
     Cuik_QualType type, cast_type;
 
+    // __builtin_expect result: 1 if it's probably non-zero, -1 if it's probably
+    // zero and 0 if we don't know.
+    int expect;
+
+    // the lvalue came through a union member, it might be type punning so it
+    // doesn't get a type-based alias class.
+    bool may_alias;
+
     union {
         TB_Node* reg;
         TB_Symbol* sym;
@@ -0,0 +1,121 @@
+////////////////////////////////////////////
+// Profile-guided optimization
+////////////////////////////////////////////
+// -fprofile-generate builds count how often each region of each function runs and
+// the program appends those counts to a profile when it exits, every line is:
+//
+//   <function hash> <slot count> <slot 0> <slot 1> ...
+//
+// slot 0 is the function entry and the rest are regions in the order irgen built
+// them, the function hash is FNV-1a of the name (with the file's name in front for
+// statics) so they survive rebuilds as long as the function doesn't change shape.
+// -fprofile-use sums up every run in the file and hands it to TB which turns it into
+// region frequencies.
+#include <cuik.h>
+#include <common.h>
+#include <hash_map.h>
+#include <dyn_array.h>
+#include "../front/parser.h"
+
+struct Cuik_Profile {
+    // counts[0] is the slot count, the slots follow
+    NL_Map(uint64_t, uint64_t*) funcs;
+    DynArray(uint64_t*) all;
+};
+
+static uint64_t cuikprof_hash(uint64_t h, const char* str) {
+    for (; *str; str++) {
+        h = (h ^ (uint8_t) *str) * 0x100000001b3ull;
+    }
+    return h;
+}
+
+static uint64_t cuikprof_function_hash(TranslationUnit* tu, const char* name, bool is_static) {
+    uint64_t h = 0xcbf29ce484222325ull;
+    if (is_static && tu->filepath != NULL) {
+        // only the file name, the directory we built from shouldn't matter
+        const char* file = tu->filepath;
+        for (const char* p = file; *p; p++) {
+            if (*p == '/' || *p == '\\') file = p + 1;
+        }
+
+        h = cuikprof_hash(h, file);
+        h = cuikprof_hash(h, ":");
+    }
+
+    return cuikprof_hash(h, name);
+}
+
+// NULL if we've got nothing on the function, otherwise the slot count
+// followed by the slots.
+static const uint64_t* cuikprof_lookup(Cuik_Profile* prof, uint64_t hash) {
+    ptrdiff_t search = nl_map_get(prof->funcs, hash);
+    return search >= 0 ? prof->funcs[search].v : NULL;
+}
+
+Cuik_Profile* cuikcg_profile_load(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "\x1b[31merror\x1b[0m: could not open profile '%s'\n", path);
+        return NULL;
+    }
+
+    Cuik_Profile* prof = cuik_calloc(1, sizeof(Cuik_Profile));
+    nl_map_create(prof->funcs, 256);
+
+    unsigned long long hash, count;
+    while (fscanf(file, "%llx %llu", &hash, &count) == 2) {
+        uint64_t key = hash;
+        ptrdiff_t search = nl_map_get(prof->funcs, key);
+
+        uint64_t* counts = NULL;
+        if (search < 0) {
+            counts = cuik_calloc(1 + count, sizeof(uint64_t));
+            counts[0] = count;
+            nl_map_put(prof->funcs, key, counts);
+            dyn_array_put(prof->all, counts);
+        } else if (prof->funcs[search].v[0] == count) {
+            counts = prof->funcs[search].v;
+        }
+
+        // a run from a different version of the function doesn't add up with
+        // the rest so we skip it.
+        for (uint64_t i = 0; i < count; i++) {
+            unsigned long long c;
+            if (fscanf(file, "%llu", &c) != 1) {
+                break;
+            }
+
+            if (counts) counts[1 + i] += c;
+        }
+    }
+
+    fclose(file);
+    return prof;
+}
+
+void cuikcg_profile_free(Cuik_Profile* prof) {
+    dyn_array_for(i, prof->all) {
+        cuik_free(prof->all[i]);
+    }
+    dyn_array_destroy(prof->all);
+    nl_map_free(prof->funcs);
+    cuik_free(prof);
+}
+
+void cuikcg_set_profile(TranslationUnit* tu, const char* output, Cuik_Profile* prof) {
+    tu->prof_output = output;
+    tu->prof = prof;
+
+    // every instrumented function leaves a record in here which the runtime walks
+    // with the __start/__stop symbols the linker makes for it.
+    CompilationUnit* cu = tu->parent;
+    if (output != NULL) {
+        cuik_lock_compilation_unit(cu);
+        if (!cu->has_prof_section) {
+            cu->prof_section = tb_module_create_section(cu->ir_mod, -1, "cuikprof", TB_MODULE_SECTION_WRITE, TB_COMDAT_NONE);
+            cu->has_prof_section = true;
+        }
+        cuik_unlock_compilation_unit(cu);
+    }
+}
@@ -79,6 +79,10 @@ static TB_Arena* get_ir_arena(void) {
     return &ir_arena;
 }
 
+static FILE* diag_file(const Cuik_DriverArgs* args) {
+    return args->diag_file ? args->diag_file : stderr;
+}
+
 static void step_error(Cuik_BuildStep* s) {
     if (s->anti_dep != NULL) {
         s->anti_dep->errors += 1;
@@ -137,16 +141,32 @@ static void sys_invoke(BuildStepInfo* info) {
 static void irgen(Cuik_IThreadpool* restrict thread_pool, Cuik_DriverArgs* restrict args, CompilationUnit* restrict cu, TB_Module* mod);
 
 static bool do_delayed_compile(const Cuik_DriverArgs* args) {
-    return args->opt_level > 0 || args->assembly || args->emit_ir || args->emit_dot;
+    return args->opt_level > 0 || args->assembly || args->emit_ir || args->emit_dot || args->whole_program || args->emit_module;
 }
 
-static void apply_func(TB_Function* f, void* arg) {
-    Cuik_DriverArgs* args = arg;
+static bool is_module_image(const char* path) {
+    size_t len = strlen(path);
+    return len > 4 && strcmp(path + len - 4, ".tbm") == 0;
+}
+
+static bool do_streaming_compile(const Cuik_DriverArgs* args) {
+    // whole program mode and module images need every function's IR at once,
+    // everything else can hand functions to the backend as soon as they're built.
+    return do_delayed_compile(args) && !args->whole_program && !args->emit_module;
+}
+
+static void compile_func(TB_Function* f, const Cuik_DriverArgs* args, TB_Arena* arena) {
     bool print_asm = args->assembly;
 
+    // printing the asm or IR needs the passes to actually run
+    TB_CodeCache* cache = print_asm || args->emit_ir || args->emit_dot ? NULL : args->code_cache;
+    if (cache != NULL && tb_code_cache_lookup(cache, f, args->opt_level)) {
+        return;
+    }
+
     const char* name = ((TB_Symbol*) f)->name;
     CUIK_TIMED_BLOCK_ARGS("passes", name) {
-        TB_Passes* p = tb_pass_enter(f, get_ir_arena());
+        TB_Passes* p = tb_pass_enter(f, arena);
 
         if (args->opt_level >= 1) {
             tb_pass_optimize(p);
@@ -164,11 +184,19 @@ static void apply_func(TB_Function* f, void* arg) {
                     printf("\n\n");
                 }
             }
+
+            if (cache != NULL) {
+                tb_code_cache_insert(cache, f);
+            }
         }
 
         tb_pass_exit(p);
     }
 }
+
+static void apply_func(TB_Function* f, void* arg) {
+    compile_func(f, arg, get_ir_arena());
+}
 #endif
 
 static void cc_invoke(BuildStepInfo* restrict info) {
@@ -182,6 +210,11 @@ static void cc_invoke(BuildStepInfo* restrict info) {
 
     log_debug("BuildStep %p: cc_invoke %s", s, s->cc.source);
 
+    // the frontend's allocations belong to the step, once the TU is destroyed
+    // they all go at once rather than one by one.
+    Cuik_Heap* heap = cuik_heap_create();
+    Cuik_Heap* old_heap = cuik_heap_enter(heap);
+
     // dispose the preprocessor crap since we didn't need it
     Cuik_CPP* cpp = s->cc.cpp = cuik_driver_preprocess(s->cc.source, args, true);
     if (cpp == NULL) {
@@ -190,6 +223,22 @@ static void cc_invoke(BuildStepInfo* restrict info) {
     }
 
     TokenStream* tokens = cuikpp_get_token_stream(cpp);
+    if (args->stats_output) {
+        // big files are split into chunks which share one line map
+        uint64_t lines = 0;
+        Cuik_FileEntry* files = cuikpp_get_files(tokens);
+        size_t file_count = cuikpp_get_file_count(tokens);
+        for (size_t i = 0; i < file_count; i++) {
+            if (files[i].file_pos_bias == 0) {
+                lines += dyn_array_length(files[i].line_map) - 1;
+            }
+        }
+
+        mtx_lock(info->mutex);
+        args->lines_processed += lines;
+        mtx_unlock(info->mutex);
+    }
+
     if (args->preprocess) {
         cuikpp_dump_tokens(tokens);
         goto done;
@@ -221,6 +270,8 @@ static void cc_invoke(BuildStepInfo* restrict info) {
     Cuik_ImportRequest* imports = result.imports;
     if (cu != NULL) {
         if (imports != NULL) {
+            // the args outlive the step
+            cuik_heap_enter(old_heap);
             cuik_lock_compilation_unit(cu);
             for (; imports != NULL; imports = imports->next) {
                 Cuik_Path* p = cuik_malloc(sizeof(Cuik_Path));
@@ -228,6 +279,7 @@ static void cc_invoke(BuildStepInfo* restrict info) {
                 dyn_array_put(args->libraries, p);
             }
             cuik_unlock_compilation_unit(cu);
+            cuik_heap_enter(heap);
         }
 
         cuik_add_to_compilation_unit(cu, tu);
@@ -250,11 +302,22 @@ static void cc_invoke(BuildStepInfo* restrict info) {
 
     // we wanna display diagnostics before any of the backend stuff
     mtx_lock(info->mutex);
-    cuikdg_dump_to_file(tokens, stderr);
+    cuikdg_dump_to_file(tokens, diag_file(args));
     mtx_unlock(info->mutex);
 
     #ifdef CUIK_USE_TB
+    // the IR is shared by the whole compilation unit
+    cuik_heap_enter(old_heap);
     TB_Module* mod = cu->ir_mod;
+
+    // the profile runtime itself doesn't get counted
+    if (args->profile_generate && strncmp(s->cc.source, "$cuik/", 6) != 0) {
+        cuikcg_set_profile(tu, args->profile_generate, NULL);
+    } else if (args->profile) {
+        cuikcg_set_profile(tu, NULL, args->profile);
+    }
+    cuikcg_set_strict_aliasing(tu, args->strict_aliasing);
+
     CUIK_TIMED_BLOCK("Allocate IR") {
         if (s->tp) {
             cuikcg_allocate_ir(tu, s->tp, mod, args->debug_info);
@@ -263,8 +326,9 @@ static void cc_invoke(BuildStepInfo* restrict info) {
         }
     }
 
-    bool delayed = do_delayed_compile(args);
-    if (delayed) {
+    if (do_delayed_compile(args) && !do_streaming_compile(args)) {
+        // whole program mode waits for the rest of the TUs, it'll
+        // run the backend in ld_invoke.
         CUIK_TIMED_BLOCK("IR Gen") {
             irgen(s->tp, args, cu, mod);
 
@@ -274,10 +338,6 @@ static void cc_invoke(BuildStepInfo* restrict info) {
                 cuikpp_free(cpp);
             }
         }
-
-        CUIK_TIMED_BLOCK("Backend") {
-            cuiksched_per_function(s->tp, args->threads, mod, args, apply_func);
-        }
     } else {
         CUIK_TIMED_BLOCK("Backend") {
             irgen(s->tp, args, cu, mod);
@@ -299,15 +359,81 @@ static void cc_invoke(BuildStepInfo* restrict info) {
         CUIK_TIMED_BLOCK("Free arena") {
             tb_arena_destroy(&s->cc.arena);
         }
+
+        CUIK_TIMED_BLOCK("Free heap") {
+            cuik_heap_enter(old_heap);
+            cuik_heap_destroy(heap);
+            heap = NULL;
+        }
     }
 
     goto done_no_cpp;
 
     // these are called for early exits
-    done: cuikdg_dump_to_file(tokens, stderr);
-    done_no_cpp: step_done(s);
+    done: cuikdg_dump_to_file(tokens, diag_file(args));
+    done_no_cpp:
+    // the TU is still around (early exits or -preserve-ast), it keeps the memory
+    cuik_heap_enter(old_heap);
+    cuik_heap_release(heap);
+    step_done(s);
+}
+
+#ifdef CUIK_USE_TB
+// a module image (-emit-mod) skips the frontend, it stands in for the
+// whole compilation unit's module.
+static void tbm_invoke(BuildStepInfo* restrict info) {
+    Cuik_BuildStep* s = info->step;
+    Cuik_DriverArgs* args = s->cc.args;
+    if (args->verbose) {
+        mtx_lock(info->mutex);
+        printf("LOAD %s\n", s->cc.source);
+        mtx_unlock(info->mutex);
+    }
+
+    Cuik_BuildStep* ld = s->anti_dep;
+    if (ld == NULL || ld->tag != BUILD_STEP_LD || ld->dep_count != 1) {
+        fprintf(stderr, "error: %s: a module image has to be the only input\n", s->cc.source);
+        step_error(s);
+        goto done;
+    }
+
+    CompilationUnit* cu = ld->ld.cu;
+    TB_Module* mod = tb_module_deserialize(s->cc.source, args->target->arch, (TB_System) cuik_get_target_system(args->target), args->run);
+    if (mod == NULL) {
+        step_error(s);
+        goto done;
+    }
+
+    tb_module_destroy(cu->ir_mod);
+    cu->ir_mod = mod;
+
+    if (!args->whole_program && !args->emit_module) {
+        CUIK_TIMED_BLOCK("Backend") {
+            cuiksched_per_function(s->tp, args->threads, mod, args, apply_func);
+        }
+    }
+
+    done: step_done(s);
 }
 
+static void whole_program_opt(Cuik_DriverArgs* args, TB_Module* mod) {
+    // only executables get to drop the public symbols, everything
+    // else might be getting linked against.
+    if (args->flavor != TB_FLAVOR_EXECUTABLE) {
+        tb_module_ipo(mod, 0, NULL);
+        return;
+    }
+
+    if (args->entrypoint) {
+        const char* roots[] = { args->entrypoint };
+        tb_module_ipo(mod, 1, roots);
+    } else {
+        const char* roots[] = { "main", "wmain", "WinMain", "wWinMain", "mainCRTStartup", "WinMainCRTStartup", "_start" };
+        tb_module_ipo(mod, COUNTOF(roots), roots);
+    }
+}
+#endif
+
 static void jit_entry(int fn(int, char**)) {
     char* argv[] = { "jit", "10" };
     fn(2, argv);
@@ -334,13 +460,52 @@ static void ld_invoke(BuildStepInfo* info) {
         cuik_destroy_compilation_unit(s->ld.cu);
     }
 
+    // the whole program is in the module now, we held off on the passes until here
+    bool has_ir = !args->test_preproc && !args->preprocess && !args->syntax_only && !args->ast;
+    if (args->emit_module) {
+        if (has_ir) {
+            Cuik_Path tbm_path;
+            if (args->output_name == NULL) {
+                cuik_path_set_ext(&tbm_path, args->sources[0], 4, ".tbm");
+            } else {
+                cuik_path_set(&tbm_path, args->output_name);
+            }
+
+            TB_ExportBuffer buffer;
+            CUIK_TIMED_BLOCK("Serialize") {
+                buffer = tb_module_serialize(mod);
+            }
+
+            if (!tb_export_buffer_to_file(buffer, tbm_path.data)) {
+                step_error(s);
+            }
+            tb_export_buffer_free(buffer);
+        }
+
+        tb_module_destroy(mod);
+        goto done;
+    }
+
+    if (args->whole_program && has_ir) {
+        CUIK_TIMED_BLOCK("Whole program") {
+            whole_program_opt(args, mod);
+        }
+
+        CUIK_TIMED_BLOCK("Backend") {
+            cuiksched_per_function(s->tp, args->threads, mod, args, apply_func);
+        }
+    }
+
     if (!cuik_driver_does_codegen(args)) {
         goto done;
     }
 
-    // TODO(NeGate): do a smarter system (just default to whatever the different platforms like)
-    TB_DebugFormat debug_fmt = (args->debug_info ? TB_DEBUGFMT_CODEVIEW : TB_DEBUGFMT_NONE);
+    // CodeView on Windows, DWARF everywhere else
     Cuik_System sys = cuik_get_target_system(args->target);
+    TB_DebugFormat debug_fmt = TB_DEBUGFMT_NONE;
+    if (args->debug_info) {
+        debug_fmt = sys == CUIK_SYSTEM_WINDOWS ? TB_DEBUGFMT_CODEVIEW : TB_DEBUGFMT_DWARF;
+    }
 
     Cuik_Path output_path;
     if (args->output_name == NULL) {
@@ -351,6 +516,18 @@ static void ld_invoke(BuildStepInfo* info) {
         cuik_path_set(&output_path, args->output_name);
     }
 
+    if (args->jit) {
+        CUIK_TIMED_BLOCK("JIT") {
+            int swapped = tb_jit_place_module(args->jit, mod, s->deps[0]->cc.source);
+            if (args->verbose) {
+                mtx_lock(info->mutex);
+                printf("JIT %s (%d functions swapped)\n", s->deps[0]->cc.source, swapped);
+                mtx_unlock(info->mutex);
+            }
+        }
+        goto done;
+    }
+
     if (args->run) {
         // TODO(NeGate): support more platforms with the JIT API
         #ifdef _WIN32
@@ -549,6 +726,11 @@ Cuik_BuildStep* cuik_driver_cc(Cuik_DriverArgs* args, const char* source) {
     Cuik_BuildStep* s = cuik_calloc(1, sizeof(Cuik_BuildStep));
     s->tag = BUILD_STEP_CC;
     s->invoke = cc_invoke;
+    #ifdef CUIK_USE_TB
+    if (is_module_image(source)) {
+        s->invoke = tbm_invoke;
+    }
+    #endif
     s->cc.source = source;
     s->cc.args = args;
     return s;
@@ -652,11 +834,11 @@ void cuikpp_dump_tokens(TokenStream* s) {
     const char* last_file = NULL;
     int last_line = 0;
 
-    Token* tokens = cuikpp_get_tokens(s);
+    PackedToken* tokens = cuikpp_get_tokens(s);
     size_t count = cuikpp_get_token_count(s);
 
     for (size_t i = 0; i < count; i++) {
-        Token* t = &tokens[i];
+        PackedToken* t = &tokens[i];
 
         ResolvedSourceLoc r = cuikpp_find_location(s, t->location);
         if (last_file != r.file->filename) {
@@ -689,7 +871,8 @@ void cuikpp_dump_tokens(TokenStream* s) {
             printf("L");
         }
 
-        printf("%.*s ", (int) t->content.length, t->content.data);
+        String content = cuikpp_get_token_content(s, i);
+        printf("%.*s ", (int) content.length, content.data);
     }
     printf("\n");
 }
@@ -733,7 +916,7 @@ static bool run_cpp(Cuik_CPP* cpp, const Cuik_DriverArgs* args, bool should_fina
 
     // run the preprocessor
     if (cuikpp_run(cpp) == CUIKPP_ERROR) {
-        cuikdg_dump_to_file(cuikpp_get_token_stream(cpp), stderr);
+        cuikdg_dump_to_file(cuikpp_get_token_stream(cpp), diag_file(args));
         cuikpp_free(cpp);
         return false;
     }
@@ -797,6 +980,136 @@ CUIK_API Cuik_CPP* cuik_driver_preprocess_cstr(const char* source, const Cuik_Dr
 }
 
 #ifdef CUIK_USE_TB
+// Streaming backend: each function is generated into its own arena and queued
+// up, the irgen jobs compile the queue whenever more than the budget of IR is
+// waiting on it (and drain it once they're out of statements). The arenas get
+// recycled as soon as the passes are done with them so only the functions in
+// flight are ever alive.
+enum { STREAM_DEFAULT_BUDGET = 64 * 1024 * 1024, STREAM_MAX_FREE_ARENAS = 16 };
+
+typedef struct StreamItem StreamItem;
+struct StreamItem {
+    StreamItem* next;
+
+    TB_Function* f;
+    TB_Arena* arena;
+    size_t size;
+};
+
+typedef struct {
+    const Cuik_DriverArgs* args;
+    size_t budget;
+
+    mtx_t lock;
+    StreamItem* head;
+    StreamItem* tail;
+    DynArray(TB_Arena*) free_arenas;
+
+    // bytes of IR which haven't gone through the backend yet, every
+    // release bumps the counter so stalled irgen jobs can wake up.
+    _Atomic size_t live;
+    _Atomic int waiters;
+    Futex released;
+} IRStream;
+
+static TB_Arena* stream_get_arena(IRStream* stream) {
+    TB_Arena* arena = NULL;
+    mtx_lock(&stream->lock);
+    if (dyn_array_length(stream->free_arenas)) {
+        arena = dyn_array_pop(stream->free_arenas);
+    }
+    mtx_unlock(&stream->lock);
+
+    if (arena == NULL) {
+        arena = cuik_malloc(sizeof(TB_Arena));
+        tb_arena_create(arena, TB_ARENA_MEDIUM_CHUNK_SIZE);
+    }
+    return arena;
+}
+
+static void stream_put_arena(IRStream* stream, TB_Arena* arena) {
+    tb_arena_clear(arena);
+
+    mtx_lock(&stream->lock);
+    if (dyn_array_length(stream->free_arenas) < STREAM_MAX_FREE_ARENAS) {
+        dyn_array_put(stream->free_arenas, arena);
+        arena = NULL;
+    }
+    mtx_unlock(&stream->lock);
+
+    if (arena != NULL) {
+        tb_arena_destroy(arena);
+        cuik_free(arena);
+    }
+}
+
+static void stream_push(IRStream* stream, TB_Function* f, TB_Arena* arena) {
+    // the arena keeps its first chunk around even for tiny functions, that's
+    // what we're really holding onto.
+    size_t size = tb_arena_current_size(arena);
+    if (size < TB_ARENA_MEDIUM_CHUNK_SIZE) {
+        size = TB_ARENA_MEDIUM_CHUNK_SIZE;
+    }
+
+    StreamItem* item = tb_arena_alloc(arena, sizeof(StreamItem));
+    *item = (StreamItem){ .f = f, .arena = arena, .size = size };
+    stream->live += size;
+
+    mtx_lock(&stream->lock);
+    if (stream->tail) {
+        stream->tail->next = item;
+    } else {
+        stream->head = item;
+    }
+    stream->tail = item;
+    mtx_unlock(&stream->lock);
+}
+
+// compiles one queued function, returns false if the queue was empty
+static bool stream_compile_one(IRStream* stream) {
+    mtx_lock(&stream->lock);
+    StreamItem* item = stream->head;
+    if (item != NULL) {
+        stream->head = item->next;
+        if (stream->head == NULL) stream->tail = NULL;
+    }
+    mtx_unlock(&stream->lock);
+
+    if (item == NULL) {
+        return false;
+    }
+
+    // the item lives in the arena we're about to recycle
+    size_t size = item->size;
+    TB_Arena* arena = item->arena;
+    compile_func(item->f, stream->args, arena);
+    stream_put_arena(stream, arena);
+
+    stream->live -= size;
+    stream->released += 1;
+    if (stream->waiters > 0) {
+        futex_broadcast(&stream->released);
+    }
+    return true;
+}
+
+// the backend fell behind, help it out until we're under the budget
+static void stream_throttle(IRStream* stream) {
+    while (stream->live > stream->budget) {
+        if (stream_compile_one(stream)) {
+            continue;
+        }
+
+        // everything that's left is being compiled by other threads
+        Futex old = stream->released;
+        stream->waiters += 1;
+        if (stream->live > stream->budget) {
+            futex_wait(&stream->released, old);
+        }
+        stream->waiters -= 1;
+    }
+}
+
 typedef struct {
     TB_Module* mod;
     TranslationUnit* tu;
@@ -805,6 +1118,9 @@ typedef struct {
     Stmt** stmts;
     size_t count;
 
+    // NULL if the backend doesn't stream (-O0 compiles in place, -wpo waits)
+    IRStream* stream;
+
     #if CUIK_ALLOW_THREADS
     Futex* remaining;
     #endif
@@ -813,6 +1129,7 @@ typedef struct {
 static void irgen_job(void* arg) {
     IRGenTask task = *((IRGenTask*) arg);
     TB_Module* mod = task.mod;
+    IRStream* stream = task.stream;
 
     // unoptimized builds can just compile functions without
     // the rest of the functions being ready.
@@ -825,30 +1142,67 @@ static void irgen_job(void* arg) {
             continue;
         }
 
+        TB_Arena* arena = allocator;
+        bool streamed = stream != NULL && task.stmts[i]->op == STMT_FUNC_DECL;
+        if (streamed) {
+            stream_throttle(stream);
+            arena = stream_get_arena(stream);
+        }
+
         const char* name = task.stmts[i]->decl.name;
         TB_Symbol* s;
         CUIK_TIMED_BLOCK_ARGS("irgen", name) {
-            s = cuikcg_top_level(task.tu, mod, allocator, task.stmts[i]);
+            s = cuikcg_top_level(task.tu, mod, arena, task.stmts[i]);
         }
 
-        if (do_compiles_immediately && s != NULL && s->tag == TB_SYMBOL_FUNCTION) {
-            CUIK_TIMED_BLOCK("codegen") {
-                TB_Passes* p = tb_pass_enter((TB_Function*) s, allocator);
-                tb_pass_codegen(p, false);
-                tb_pass_exit(p);
+        if (streamed) {
+            if (s != NULL) {
+                stream_push(stream, (TB_Function*) s, arena);
+            } else {
+                stream_put_arena(stream, arena);
+            }
+        } else if (do_compiles_immediately && s != NULL && s->tag == TB_SYMBOL_FUNCTION) {
+            TB_Function* f = (TB_Function*) s;
+            TB_CodeCache* cache = task.args->code_cache;
+
+            if (cache == NULL || !tb_code_cache_lookup(cache, f, task.args->opt_level)) {
+                CUIK_TIMED_BLOCK("codegen") {
+                    TB_Passes* p = tb_pass_enter(f, allocator);
+                    tb_pass_codegen(p, false);
+                    tb_pass_exit(p);
+                }
 
-                log_debug("%s: clearing IR arena %.1f KiB", name, tb_arena_current_size(allocator) / 1024.0f);
-                tb_arena_clear(allocator);
+                if (cache != NULL) {
+                    tb_code_cache_insert(cache, f);
+                }
             }
+
+            log_debug("%s: clearing IR arena %.1f KiB", name, tb_arena_current_size(allocator) / 1024.0f);
+            tb_arena_clear(allocator);
         }
     }
 
+    // whatever's still queued gets compiled before we report back, that
+    // way the backend is done once all the irgen jobs are.
+    if (stream != NULL) {
+        while (stream_compile_one(stream)) {}
+    }
+
     if (task.remaining) {
         futex_dec(task.remaining);
     }
 }
 
 static void irgen(Cuik_IThreadpool* restrict thread_pool, Cuik_DriverArgs* restrict args, CompilationUnit* restrict cu, TB_Module* mod) {
+    IRStream* stream = NULL;
+    if (do_streaming_compile(args)) {
+        stream = cuik_calloc(1, sizeof(IRStream));
+        stream->args = args;
+        stream->budget = args->mem_budget ? args->mem_budget : STREAM_DEFAULT_BUDGET;
+        stream->free_arenas = dyn_array_create(TB_Arena*, STREAM_MAX_FREE_ARENAS);
+        mtx_init(&stream->lock, mtx_plain);
+    }
+
     if (thread_pool != NULL) {
         #if CUIK_ALLOW_THREADS
         size_t stmt_count = 0;
@@ -881,6 +1235,7 @@ static void irgen(Cuik_IThreadpool* restrict thread_pool, Cuik_DriverArgs* restr
                     .args = args,
                     .stmts = &top_level[i],
                     .count = end - i,
+                    .stream = stream,
                     .remaining = &remaining
                 };
 
@@ -906,12 +1261,24 @@ static void irgen(Cuik_IThreadpool* restrict thread_pool, Cuik_DriverArgs* restr
                 .tu = tu,
                 .args = args,
                 .stmts = cuik_get_top_level_stmts(tu),
-                .count = c
+                .count = c,
+                .stream = stream,
             };
 
             irgen_job(&task);
         }
     }
+
+    if (stream != NULL) {
+        assert(stream->head == NULL && stream->live == 0);
+        dyn_array_for(i, stream->free_arenas) {
+            tb_arena_destroy(stream->free_arenas[i]);
+            cuik_free(stream->free_arenas[i]);
+        }
+        dyn_array_destroy(stream->free_arenas);
+        mtx_destroy(&stream->lock);
+        cuik_free(stream);
+    }
 }
 #endif
 
@@ -92,7 +92,9 @@ static Cuik_Arg* insert_arg(Cuik_Arguments* restrict args, int slot) {
 }
 
 CUIK_API Cuik_Arguments* cuik_alloc_args(void) {
-    return cuik_calloc(1, sizeof(Cuik_Arguments));
+    Cuik_Arguments* args = cuik_calloc(1, sizeof(Cuik_Arguments));
+    tb_arena_create(&args->arena, TB_ARENA_SMALL_CHUNK_SIZE);
+    return args;
 }
 
 CUIK_API void cuik_free_args(Cuik_Arguments* args) {
@@ -148,9 +150,34 @@ CUIK_API void cuik_parse_args(Cuik_Arguments* restrict args, int argc, const cha
     }
 }
 
+static bool is_absolute_path(const char* path) {
+    #ifdef _WIN32
+    if (path[0] && path[1] == ':') return true;
+    if (path[0] == '\\') return true;
+    #endif
+
+    return path[0] == '/';
+}
+
+CUIK_API void cuik_args_rebase(Cuik_Arguments* restrict args, const char* dir) {
+    // -l are library names, the linker searches for those
+    static const int path_args[] = { 0, ARG_INCLUDE, ARG_LIBDIR, ARG_OUTPUT, ARG_STATS, ARG_CODECACHE };
+
+    size_t dir_len = strlen(dir);
+    for (size_t i = 0; i < sizeof(path_args) / sizeof(path_args[0]); i++) {
+        FOR_ARGS(a, path_args[i]) {
+            if (a->value == arg_is_set || is_absolute_path(a->value)) continue;
+
+            size_t len = dir_len + strlen(a->value) + 2;
+            char* newstr = tb_arena_alloc(&args->arena, len);
+            snprintf(newstr, len, "%s%c%s", dir, CUIK_PATH_SLASH_SEP, a->value);
+            a->value = newstr;
+        }
+    }
+}
+
 CUIK_API bool cuik_parse_driver_args(Cuik_DriverArgs* comp_args, int argc, const char* argv[]) {
     Cuik_Arguments* args = cuik_alloc_args();
-    tb_arena_create(&args->arena, TB_ARENA_SMALL_CHUNK_SIZE);
 
     cuik_parse_args(args, argc, argv);
 
@@ -190,13 +217,19 @@ CUIK_API bool cuik_args_to_driver(Cuik_DriverArgs* comp_args, Cuik_Arguments* re
         }
     }
 
-    // initialize toolchain
-    comp_args->toolchain.ctx = comp_args->toolchain.init();
+    // initialize toolchain (unless the caller brought a warm one)
+    if (comp_args->toolchain.ctx == NULL) {
+        comp_args->toolchain.ctx = comp_args->toolchain.init();
+    }
 
     if (args->_[ARG_OUTPUT]) {
         comp_args->output_name = cuik_strdup(args->_[ARG_OUTPUT]->value);
     }
 
+    if (args->_[ARG_STATS]) {
+        comp_args->stats_output = cuik_strdup(args->_[ARG_STATS]->value);
+    }
+
     FOR_ARGS(a, 0) {
         append_input_path(comp_args, a->value);
     }
@@ -296,12 +329,27 @@ CUIK_API bool cuik_args_to_driver(Cuik_DriverArgs* comp_args, Cuik_Arguments* re
     #ifdef CUIK_USE_TB
     if (args->_[ARG_OBJECT]) comp_args->flavor = TB_FLAVOR_OBJECT;
     if (args->_[ARG_ASSEMBLY]) comp_args->assembly = true;
+    if (args->_[ARG_CODECACHE]) comp_args->code_cache_path = cuik_strdup(args->_[ARG_CODECACHE]->value);
+
+    // these take -fprofile-use=file too
+    if (args->_[ARG_PROFGEN]) {
+        const char* path = args->_[ARG_PROFGEN]->value;
+        comp_args->profile_generate = path + (path[0] == '=');
+    }
+    if (args->_[ARG_PROFUSE]) {
+        const char* path = args->_[ARG_PROFUSE]->value;
+        comp_args->profile_use = path + (path[0] == '=');
+    }
     #endif
 
     if (args->_[ARG_OPTLVL]) {
         comp_args->opt_level = atoi(args->_[ARG_OPTLVL]->value);
     }
 
+    if (args->_[ARG_MEMBUDGET]) {
+        comp_args->mem_budget = (size_t) atoi(args->_[ARG_MEMBUDGET]->value) << 20;
+    }
+
     TOGGLE(ARG_PP, preprocess);
     TOGGLE(ARG_PPTEST, test_preproc);
     TOGGLE(ARG_RUN, run);
@@ -310,14 +358,20 @@ CUIK_API bool cuik_args_to_driver(Cuik_DriverArgs* comp_args, Cuik_Arguments* re
     TOGGLE(ARG_SYNTAX, syntax_only);
     TOGGLE(ARG_VERBOSE, verbose);
     TOGGLE(ARG_THINK, think);
+    TOGGLE(ARG_STRICTALIAS, strict_aliasing);
     TOGGLE(ARG_BASED, based);
+    TOGGLE(ARG_WPO, whole_program);
     TOGGLE(ARG_TIME, time);
+    TOGGLE(ARG_COUNTERS, perf_counters);
+    TOGGLE(ARG_HWCOUNTERS, hw_counters);
     TOGGLE(ARG_DEBUG, debug_info);
     TOGGLE(ARG_EMITIR, emit_ir);
     TOGGLE(ARG_EMITDOT, emit_dot);
+    TOGGLE(ARG_EMITMOD, emit_module);
     TOGGLE(ARG_NOLIBC, nocrt);
 
-    if (comp_args->verbose) {
+    // not every toolchain has anything to say
+    if (comp_args->verbose && comp_args->toolchain.print_verbose) {
         comp_args->toolchain.print_verbose(comp_args->toolchain.ctx, comp_args);
     }
 
@@ -1,6 +1,6 @@
 X(HELP,        "h",        false, "print help")
 X(VERBOSE,     "V",        false, "print verbose messages")
-X(LIVE,        "live",     false, "runs compiler persistently, repeats compile step whenever the input changes")
+X(LIVE,        "live",     false, "runs compiler persistently, repeats compile step whenever the input changes (with -r it hot-swaps the running program)")
 // preprocessor
 X(DEFINE,      "D",        true,  "defines a macro before compiling")
 X(UNDEF,       "U",        true,  "undefines a macro before compiling")
@@ -13,9 +13,16 @@ X(AST,         "ast",      false, "print AST into stdout")
 X(SYNTAX,      "xe",       false, "type check only")
 // optimizer
 X(OPTLVL,      "O",        true,  "no optimizations")
+X(WPO,         "wpo",      false, "whole program optimization, symbols not reachable from the entrypoint get internalized")
+X(PROFGEN,     "fprofile-generate", true, "instrument the program, it writes how often each block ran into the given file when it exits")
+X(PROFUSE,     "fprofile-use", true, "optimize using the block counts written by a -fprofile-generate build")
+X(STRICTALIAS, "fstrict-aliasing", false, "assume pointers to different types don't point to the same memory (C's effective type rules)")
 // backend
 X(EMITIR,      "emit-ir",  false, "print IR into stdout")
 X(EMITDOT,     "emit-dot", false, "print graphviz into stdout")
+X(EMITMOD,     "emit-mod", false, "write the IR as a module image (.tbm) which can be compiled later")
+X(CODECACHE,   "cache",    true,  "reuse the machine code of unchanged functions, kept in the given file")
+X(MEMBUDGET,   "mem-budget",true, "how many MiB of IR the frontend can get ahead of the backend by (default 64)")
 X(OUTPUT,      "o",        true,  "set the output filepath")
 X(OBJECT,      "c",        false, "output object file")
 X(ASSEMBLY,    "S",        false, "output assembly to stdout")
@@ -30,6 +37,9 @@ X(ENTRY,       "e",        true,  "set entrypoint")
 // misc
 X(TARGET,      "target",   true,  "change the target system and arch")
 X(THREADS,     "j",        true,  "enabled multithreaded compilation")
+X(STATS,       "Tstats",   true,  "write phase times, peak memory and line counts as JSON")
+X(COUNTERS,    "Tcounters",false, "with -T or -Tstats, also track allocations and peak memory per region")
+X(HWCOUNTERS,  "Thw",      false, "like -Tcounters but with hardware counters too (instructions, cycles, cache & branch misses)")
 X(TIME,        "T",        false, "profile the compile times")
 X(THINK,       "think",    false, "aids in thinking about serious problems")
 // run
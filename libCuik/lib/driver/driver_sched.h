@@ -1,6 +1,6 @@
 #ifdef CUIK_USE_TB
 typedef struct {
-    Futex* remaining;
+    Futex* completed;
 
     TB_Function* f;
     void* arg;
@@ -12,8 +12,8 @@ static void per_func_task(void* arg) {
     PerFunction task = *((PerFunction*) arg);
     task.func(task.f, task.arg);
 
-    atomic_fetch_sub(task.remaining, 1);
-    futex_signal(task.remaining);
+    atomic_fetch_add(task.completed, 1);
+    futex_signal(task.completed);
 }
 
 static size_t good_batch_size(size_t n, size_t jobs) {
@@ -34,10 +34,12 @@ static size_t good_batch_size(size_t n, size_t jobs) {
 void cuiksched_per_function(Cuik_IThreadpool* restrict thread_pool, int num_threads, TB_Module* mod, void* arg, CuikSched_PerFunction func) {
     TB_SymbolIter it = tb_symbol_iter(mod);
     if (thread_pool != NULL) {
-        Futex remaining = 0;
+        // we don't know the function count ahead of time so we count
+        // the finished tasks up until they match the submitted ones.
+        Futex completed = 0;
         size_t count = 0;
 
-        PerFunction task = { .remaining = &remaining, .arg = arg, .func = func };
+        PerFunction task = { .completed = &completed, .arg = arg, .func = func };
 
         TB_Symbol* sym;
         while (sym = tb_symbol_iter_next(&it), sym) if (sym->tag == TB_SYMBOL_FUNCTION) {
@@ -46,7 +48,7 @@ void cuiksched_per_function(Cuik_IThreadpool* restrict thread_pool, int num_thre
             count++;
         }
 
-        futex_wait_eq(&remaining, count);
+        futex_wait_eq(&completed, count);
     } else {
         TB_Symbol* sym;
         while (sym = tb_symbol_iter_next(&it), sym) if (sym->tag == TB_SYMBOL_FUNCTION) {
@@ -54,12 +54,17 @@ Atom atoms_putuc(const unsigned char* str) {
     return atoms_put(strlen((const char*) str), str);
 }
 
+Atom atoms_put_token(TokenStream* restrict s, PackedToken* t) {
+    String str = tokens_content(s, t);
+    return atoms_put(str.length, str.data);
+}
+
 Atom atoms_eat_token(TokenStream* restrict s) {
-    Token* t = tokens_get(s);
+    PackedToken* t = tokens_get(s);
     if (t->type != TOKEN_IDENTIFIER) {
         return NULL;
     }
 
     tokens_next(s);
-    return atoms_put(t->content.length, t->content.data);
+    return atoms_put_token(s, t);
 }
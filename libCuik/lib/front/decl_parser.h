@@ -20,8 +20,8 @@ static Cuik_Attribute* parse_attributes(Cuik_Parser* restrict parser, TokenStrea
             if (tokens_get(s)->type != TOKEN_IDENTIFIER) {
                 diag_err(s, tokens_get_range(s), "expected an identifier");
             } else {
-                Token* t = tokens_get(s);
-                a->name = atoms_put(t->content.length, t->content.data);
+                PackedToken* t = tokens_get(s);
+                a->name = atoms_put_token(s, t);
                 tokens_next(s);
             }
             a->loc.end = tokens_get_location(s);
@@ -103,7 +103,7 @@ static Cuik_QualType parse_ptr_qualifiers(TokenStream* restrict s, Cuik_QualType
 }
 
 static bool is_typename(Cuik_Parser* restrict parser, TokenStream* restrict s) {
-    Token* t = tokens_get(s);
+    PackedToken* t = tokens_get(s);
 
     switch (t->type) {
         case TOKEN_KW_void:
@@ -152,8 +152,8 @@ static bool is_typename(Cuik_Parser* restrict parser, TokenStream* restrict s) {
 
         case TOKEN_IDENTIFIER: {
             // good question...
-            Token* t = tokens_get(s);
-            Atom name = atoms_put(t->content.length, t->content.data);
+            PackedToken* t = tokens_get(s);
+            Atom name = atoms_put_token(s, t);
 
             Symbol* loc = find_symbol(parser, s);
             if (loc != NULL) {
@@ -190,10 +190,10 @@ static ptrdiff_t skip_expression_in_braces(TokenStream* s, char open, char close
     size_t current = s->list.current;
     int depth = 1;
     while (depth) {
-        Token* t = tokens_get(s);
+        PackedToken* t = tokens_get(s);
 
         if (t->type == '\0') {
-            diag_err(s, get_token_range(t), "expression never terminated");
+            diag_err(s, tokens_range(s, t), "expression never terminated");
             return -1;
         } else if (t->type == open) {
             depth++;
@@ -222,7 +222,7 @@ static ptrdiff_t skip_expression_in_list(TokenStream* restrict s, SourceRange er
 
     int depth = 1;
     while (depth) {
-        Token* t = tokens_get(s);
+        PackedToken* t = tokens_get(s);
 
         if (t->type == '\0') {
             diag_err(s, error_loc, "Declaration was never closed");
@@ -265,10 +265,10 @@ static ptrdiff_t skip_expression_in_enum2(TokenStream* restrict s, ptrdiff_t* ou
 
     int depth = 1;
     while (depth) {
-        Token* t = tokens_get(s);
+        PackedToken* t = tokens_get(s);
 
         if (t->type == '\0') {
-            diag_err(s, get_token_range(t), "Declaration was never closed");
+            diag_err(s, tokens_range(s, t), "Declaration was never closed");
 
             // restore the token stream
             s->list.current = current + 1;
@@ -279,7 +279,7 @@ static ptrdiff_t skip_expression_in_enum2(TokenStream* restrict s, ptrdiff_t* ou
             depth--;
 
             if (depth == 0) {
-                diag_err(s, get_token_range(t), "Unbalanced parenthesis");
+                diag_err(s, tokens_range(s, t), "Unbalanced parenthesis");
 
                 s->list.current = current + 1;
                 return -1;
@@ -304,7 +304,7 @@ static ptrdiff_t skip_brackets(TokenStream* restrict s, SourceRange error_loc, b
 
     int depth = 1;
     while (depth) {
-        Token* t = tokens_get(s);
+        PackedToken* t = tokens_get(s);
 
         if (t->type == '\0') {
             diag_err(s, error_loc, "brackets ended in EOF");
@@ -536,8 +536,8 @@ static Cuik_QualType parse_declspec2(Cuik_Parser* restrict parser, TokenStream*
 
                 Atom name = NULL;
                 if (tokens_get(s)->type == TOKEN_IDENTIFIER) {
-                    Token* t = tokens_get(s);
-                    name = atoms_put(t->content.length, t->content.data);
+                    PackedToken* t = tokens_get(s);
+                    name = atoms_put_token(s, t);
                     tokens_next(s);
                 }
 
@@ -580,12 +580,12 @@ static Cuik_QualType parse_declspec2(Cuik_Parser* restrict parser, TokenStream*
 
                     while (tokens_get(s)->type != '}') {
                         // parse name
-                        Token* t = tokens_get(s);
+                        PackedToken* t = tokens_get(s);
                         if (t->type != TOKEN_IDENTIFIER) {
                             diag_err(s, tokens_get_range(s), "expected identifier for enum name entry.");
                         }
 
-                        Atom name = atoms_put(t->content.length, t->content.data);
+                        Atom name = atoms_put_token(s, t);
                         tokens_next(s);
 
                         int lexer_pos = 0;
@@ -612,7 +612,7 @@ static Cuik_QualType parse_declspec2(Cuik_Parser* restrict parser, TokenStream*
                         Symbol sym = {
                             .name = name,
                             .type = cuik_uncanonical_type(type),
-                            .loc = get_token_range(t),
+                            .loc = tokens_range(s, t),
                             .storage_class = STORAGE_ENUM,
                             .enum_value = count
                         };
@@ -675,8 +675,8 @@ static Cuik_QualType parse_declspec2(Cuik_Parser* restrict parser, TokenStream*
                 if (tokens_get(s)->type == TOKEN_IDENTIFIER) {
                     record_loc = tokens_get_range(s);
 
-                    Token* t = tokens_get(s);
-                    name = atoms_put(t->content.length, t->content.data);
+                    PackedToken* t = tokens_get(s);
+                    name = atoms_put_token(s, t);
 
                     tokens_next(s);
                 }
@@ -838,8 +838,8 @@ static Cuik_QualType parse_declspec2(Cuik_Parser* restrict parser, TokenStream*
             case TOKEN_IDENTIFIER: {
                 if (counter) goto done;
 
-                Token* t = tokens_get(s);
-                Atom name = atoms_put(t->content.length, t->content.data);
+                PackedToken* t = tokens_get(s);
+                Atom name = atoms_put_token(s, t);
 
                 Symbol* old_def = cuik_symtab_lookup(parser->symbols, name);
                 if (old_def != NULL) {
@@ -860,7 +860,7 @@ static Cuik_QualType parse_declspec2(Cuik_Parser* restrict parser, TokenStream*
                         type = type_alloc(&parser->types, true);
                         *type = (Cuik_Type){
                             .kind = KIND_PLACEHOLDER,
-                            .loc = get_token_range(t),
+                            .loc = tokens_range(s, t),
                             .placeholder = { name },
                         };
 
@@ -946,8 +946,8 @@ static Cuik_QualType parse_declspec2(Cuik_Parser* restrict parser, TokenStream*
             break;
 
             default: {
-                Token* last = &s->list.tokens[s->list.current];
-                diag_err(s, (SourceRange){ loc.start, tokens_get_last_location(s) }, "unknown typename %!S", last->content);
+                String last = tokens_content(s, tokens_get(s));
+                diag_err(s, (SourceRange){ loc.start, tokens_get_last_location(s) }, "unknown typename %!S", last);
                 tokens_next(s);
                 return CUIK_QUAL_TYPE_NULL;
             }
@@ -959,8 +959,8 @@ static Cuik_QualType parse_declspec2(Cuik_Parser* restrict parser, TokenStream*
     done:
     loc = (SourceRange){ loc.start, tokens_get_last_location(s) };
     if (type == 0) {
-        Token* last = &s->list.tokens[s->list.current];
-        diag_err(s, loc, "unknown typename %!S", last->content);
+        String last = tokens_content(s, tokens_get(s));
+        diag_err(s, loc, "unknown typename %!S", last);
         tokens_next(s);
         return CUIK_QUAL_TYPE_NULL;
     }
@@ -998,7 +998,7 @@ static Cuik_QualType parse_typename2(Cuik_Parser* restrict parser, TokenStream*
 }
 
 static Cuik_QualType parse_type_suffix2(Cuik_Parser* restrict parser, TokenStream* restrict s, Cuik_QualType type) {
-    Token* t = tokens_get(s);
+    PackedToken* t = tokens_get(s);
     if (t->type == '(') {
         // function type
         // void foo(int x)
@@ -1173,10 +1173,10 @@ static Decl parse_declarator_glsl(Cuik_Parser* restrict parser, TokenStream* res
     SourceLoc start_loc = tokens_get_location(s);
 
     Atom name = NULL;
-    Token* t = tokens_get(s);
+    PackedToken* t = tokens_get(s);
     if (!is_abstract && t->type == TOKEN_IDENTIFIER) {
         // simple name
-        name = atoms_put(t->content.length, t->content.data);
+        name = atoms_put_token(s, t);
         tokens_next(s);
     }
 
@@ -1221,13 +1221,13 @@ static Decl parse_declarator2(Cuik_Parser* restrict parser, TokenStream* restric
     //   direct-declarator ( parameter-type-list )
     //   direct-declarator ( identifier-listOPT )
     Atom name = NULL;
-    Token* t = tokens_get(s);
+    PackedToken* t = tokens_get(s);
 
     // non-negative if there's a nested declarator
     ptrdiff_t nested_start = -1, nested_end = -1;
     if (!is_abstract && t->type == TOKEN_IDENTIFIER) {
         // simple name
-        name = atoms_put(t->content.length, t->content.data);
+        name = atoms_put_token(s, t);
         tokens_next(s);
     } else if (t->type == '(') {
         // int (*name)(void);
@@ -162,8 +162,8 @@ static InitNode* parse_initializer_member2(Cuik_Parser* parser, TokenStream* res
             tokens_next(s);
             SourceLoc loc = tokens_get_location(s);
 
-            Token* t = tokens_get(s);
-            Atom name = atoms_put(t->content.length, t->content.data);
+            PackedToken* t = tokens_get(s);
+            Atom name = atoms_put_token(s, t);
             tokens_next(s);
 
             if (current == NULL) {
@@ -252,10 +252,11 @@ static void parse_string_literal(Cuik_Parser* parser, TokenStream* restrict s, S
     size_t saved_lexer_pos = s->list.current;
     size_t total_len = 0;
     while (!tokens_eof(s)) {
-        Token* t = tokens_get(s);
+        PackedToken* t = tokens_get(s);
+        String str = tokens_content(s, t);
         if (t->type == TOKEN_STRING_DOUBLE_QUOTE || t->type == TOKEN_STRING_WIDE_DOUBLE_QUOTE) {
-            total_len += t->content.length - 2;
-        } else if (string_equals_cstr(&t->content, "__func__")) {
+            total_len += str.length - 2;
+        } else if (string_equals_cstr(&str, "__func__")) {
             if (cuik__sema_function_stmt) total_len += strlen(cuik__sema_function_stmt->decl.name);
             else total_len += 3; // "???"
         } else {
@@ -273,11 +274,12 @@ static void parse_string_literal(Cuik_Parser* parser, TokenStream* restrict s, S
     // Fill up the buffer
     s->list.current = saved_lexer_pos;
     while (!tokens_eof(s)) {
-        Token* t = tokens_get(s);
+        PackedToken* t = tokens_get(s);
+        String str = tokens_content(s, t);
         if (t->type == TOKEN_STRING_DOUBLE_QUOTE || t->type == TOKEN_STRING_WIDE_DOUBLE_QUOTE) {
-            memcpy(&buffer[curr], t->content.data + 1, t->content.length - 2);
-            curr += t->content.length - 2;
-        } else if (string_equals_cstr(&t->content, "__func__")) {
+            memcpy(&buffer[curr], str.data + 1, str.length - 2);
+            curr += str.length - 2;
+        } else if (string_equals_cstr(&str, "__func__")) {
             if (cuik__sema_function_stmt) {
                 size_t len = strlen(cuik__sema_function_stmt->decl.name);
                 memcpy(&buffer[curr], cuik__sema_function_stmt->decl.name, len);
@@ -306,7 +308,7 @@ static void parse_string_literal(Cuik_Parser* parser, TokenStream* restrict s, S
 //   ( expression )
 //   generic-selection
 static void parse_primary_expr(Cuik_Parser* parser, TokenStream* restrict s) {
-    Token* t = tokens_get(s);
+    PackedToken* t = tokens_get(s);
 
     if (t->type == '(') {
         SourceLoc start_loc = tokens_get_location(s);
@@ -327,7 +329,8 @@ static void parse_primary_expr(Cuik_Parser* parser, TokenStream* restrict s) {
 
     switch (t->type) {
         case TOKEN_IDENTIFIER: {
-            if (string_equals_cstr(&t->content, "__va_arg")) {
+            String str = tokens_content(s, t);
+            if (string_equals_cstr(&str, "__va_arg")) {
                 tokens_next(s);
 
                 expect_char(s, '(');
@@ -344,7 +347,7 @@ static void parse_primary_expr(Cuik_Parser* parser, TokenStream* restrict s) {
                     .va_arg_ = { type },
                 };
                 break;
-            } else if (!parser->is_in_global_scope && string_equals_cstr(&t->content, "__func__")) {
+            } else if (!parser->is_in_global_scope && string_equals_cstr(&str, "__func__")) {
                 tokens_next(s);
                 Atom name = cuik__sema_function_stmt->decl.name;
 
@@ -359,8 +362,8 @@ static void parse_primary_expr(Cuik_Parser* parser, TokenStream* restrict s) {
 
             e = push_expr(parser);
 
-            Token* t = tokens_get(s);
-            Atom name = atoms_put(t->content.length, t->content.data);
+            PackedToken* t = tokens_get(s);
+            Atom name = atoms_put_token(s, t);
 
             Symbol* sym = NULL;
             ptrdiff_t builtin_search = nl_map_get_cstr(parser->target->builtin_func_map, name);
@@ -412,14 +415,15 @@ static void parse_primary_expr(Cuik_Parser* parser, TokenStream* restrict s) {
         }
 
         case TOKEN_FLOAT: {
-            Token* t = tokens_get(s);
-            bool is_float32 = t->content.data[t->content.length - 1] == 'f';
+            PackedToken* t = tokens_get(s);
+            String str = tokens_content(s, t);
+            bool is_float32 = str.data[str.length - 1] == 'f';
 
             char* end;
-            double f = strtod((const char*) t->content.data, &end);
-            if (end != (const char*) &t->content.data[t->content.length]) {
+            double f = strtod((const char*) str.data, &end);
+            if (end != (const char*) &str.data[str.length]) {
                 if (*end != 'l' && *end != 'L' && *end != 'f' && *end != 'd' && *end != 'F' && *end != 'D') {
-                    diag_err(s, get_token_range(t), "invalid float literal");
+                    diag_err(s, tokens_range(s, t), "invalid float literal");
                 }
             }
 
@@ -432,9 +436,10 @@ static void parse_primary_expr(Cuik_Parser* parser, TokenStream* restrict s) {
         }
 
         case TOKEN_INTEGER: {
-            Token* t = tokens_get(s);
+            PackedToken* t = tokens_get(s);
             Cuik_IntSuffix suffix;
-            uint64_t i = parse_int(t->content.length, (const char*) t->content.data, &suffix);
+            String str = tokens_content(s, t);
+            uint64_t i = parse_int(str.length, (const char*) str.data, &suffix);
 
             e = push_expr(parser);
             *e = (Subexpr){
@@ -446,12 +451,13 @@ static void parse_primary_expr(Cuik_Parser* parser, TokenStream* restrict s) {
 
         case TOKEN_STRING_SINGLE_QUOTE:
         case TOKEN_STRING_WIDE_SINGLE_QUOTE: {
-            Token* t = tokens_get(s);
+            PackedToken* t = tokens_get(s);
 
             int ch = 0;
-            ptrdiff_t distance = parse_char(t->content.length - 2, (const char*) &t->content.data[1], &ch);
+            String str = tokens_content(s, t);
+            ptrdiff_t distance = parse_char(str.length - 2, (const char*) &str.data[1], &ch);
             if (distance < 0) {
-                diag_err(s, get_token_range(t), "invalid character literal");
+                diag_err(s, tokens_range(s, t), "invalid character literal");
             }
 
             e = push_expr(parser);
@@ -468,7 +474,7 @@ static void parse_primary_expr(Cuik_Parser* parser, TokenStream* restrict s) {
             SourceLoc opening_loc = tokens_get_location(s);
             expect_char(s, '(');
 
-            String content = tokens_get(s)->content;
+            String content = tokens_content(s, tokens_get(s));
             tokens_next(s);
 
             Cuik_QualType char_type = cuik_uncanonical_type(&parser->target->signed_ints[CUIK_BUILTIN_CHAR]);
@@ -679,8 +685,8 @@ static void parse_postfix(Cuik_Parser* restrict parser, TokenStream* restrict s,
                 diag_err(s, tokens_get_range(s), "Expected identifier after member access a.b");
             }
 
-            Token* t = tokens_get(s);
-            Atom name = atoms_put(t->content.length, t->content.data);
+            PackedToken* t = tokens_get(s);
+            Atom name = atoms_put_token(s, t);
             tokens_next(s);
 
             SourceLoc end_loc = tokens_get_last_location(s);
@@ -703,8 +709,8 @@ static void parse_postfix(Cuik_Parser* restrict parser, TokenStream* restrict s,
                 diag_err(s, tokens_get_range(s), "Expected identifier after member access a.b");
             }
 
-            Token* t = tokens_get(s);
-            Atom name = atoms_put(t->content.length, t->content.data);
+            PackedToken* t = tokens_get(s);
+            Atom name = atoms_put_token(s, t);
             tokens_next(s);
 
             SourceLoc end_loc = tokens_get_last_location(s);
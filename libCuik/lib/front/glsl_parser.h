@@ -49,8 +49,8 @@ static Cuik_GlslQuals* parse_glsl_qualifiers(Cuik_Parser* restrict parser, Token
                 while (!tokens_eof(s) && tokens_get(s)->type != ')') {
                     SourceLoc start = tokens_get_location(s);
 
-                    Token* t = tokens_get(s);
-                    Atom key = atoms_put(t->content.length, t->content.data);
+                    PackedToken* t = tokens_get(s);
+                    Atom key = atoms_put_token(s, t);
                     tokens_next(s);
 
                     intmax_t value = -1;
@@ -96,7 +96,7 @@ static Cuik_Type* parse_glsl_type(Cuik_Parser* restrict parser, TokenStream* res
     Cuik_Type* int_type  = (Cuik_Type*) &parser->target->signed_ints[CUIK_BUILTIN_INT];
     Cuik_Type* uint_type = (Cuik_Type*) &parser->target->unsigned_ints[CUIK_BUILTIN_INT];
 
-    Token* t = tokens_get(s);
+    PackedToken* t = tokens_get(s);
     tokens_next(s);
 
     switch (t->type) {
@@ -128,7 +128,7 @@ static Cuik_Type* parse_glsl_type(Cuik_Parser* restrict parser, TokenStream* res
         case TOKEN_KW_ivec4: return cuik__new_vector2(&parser->types, int_type, 4);
 
         default:
-        diag_err(s, get_token_range(t), "unknown type name. https://www.khronos.org/opengl/wiki/Data_Type_(GLSL)", t->content);
+        diag_err(s, tokens_range(s, t), "unknown type name. https://www.khronos.org/opengl/wiki/Data_Type_(GLSL)", tokens_content(s, t));
         return NULL;
     }
 }
@@ -86,7 +86,7 @@ static size_t skip_expression_in_parens(TokenStream* restrict s, TknType* out_te
 
     int depth = 1;
     while (depth) {
-        Token* t = tokens_get(s);
+        PackedToken* t = tokens_get(s);
 
         if (t->type == '\0') {
             *out_terminator = '\0';
@@ -119,7 +119,7 @@ static size_t skip_expression_in_enum(TokenStream* restrict s, TknType* out_term
 
     int depth = 1;
     while (depth) {
-        Token* t = tokens_get(s);
+        PackedToken* t = tokens_get(s);
 
         if (t->type == '\0') {
             *out_terminator = '\0';
@@ -226,7 +226,7 @@ static bool expect_char(TokenStream* restrict s, char ch) {
         diag_err(s, tokens_get_range(s), "expected '%c', got end-of-file", ch);
         return false;
     } else if (tokens_get(s)->type != ch) {
-        diag_err(s, tokens_get_range(s), "expected '%c', got '%!S'", ch, tokens_get(s)->content);
+        diag_err(s, tokens_get_range(s), "expected '%c', got '%!S'", ch, tokens_content(s, tokens_get(s)));
         return false;
     } else {
         tokens_next(s);
@@ -449,8 +449,8 @@ size_t cuik_num_of_top_level_stmts(TranslationUnit* restrict tu) {
 }
 
 static Symbol* find_symbol(Cuik_Parser* parser, TokenStream* restrict s) {
-    Token* t = tokens_get(s);
-    return cuik_symtab_lookup(parser->symbols, atoms_put(t->content.length, t->content.data));
+    PackedToken* t = tokens_get(s);
+    return cuik_symtab_lookup(parser->symbols, atoms_put_token(s, t));
 }
 
 ////////////////////////////////
@@ -110,6 +110,13 @@ struct TranslationUnit {
     bool has_tb_debug_info;
     Cuik_Entrypoint entrypoint_status;
 
+    // see cuikcg_set_profile
+    const char* prof_output;
+    Cuik_Profile* prof;
+
+    // -fstrict-aliasing
+    bool strict_aliasing;
+
     // DynArray(Stmt*)
     Stmt** top_level_stmts;
 
@@ -133,6 +140,10 @@ struct CompilationUnit {
     #ifdef CUIK_USE_TB
     TB_Module* ir_mod;
     NL_Strmap(TB_Symbol*) export_table;
+
+    // -fprofile-generate records go here
+    bool has_prof_section;
+    TB_ModuleSectionHandle prof_section;
     #endif
 
     // linked list of all TUs referenced
@@ -222,14 +222,15 @@ static Stmt* parse_stmt2(Cuik_Parser* parser, TokenStream* restrict s) {
         if (tokens_get(s)->type == ',') {
             tokens_next(s);
 
-            Token* t = tokens_get(s);
+            PackedToken* t = tokens_get(s);
             if (t->type != TOKEN_STRING_DOUBLE_QUOTE) {
-                diag_err(s, get_token_range(t), "static assertion expects string literal");
+                diag_err(s, tokens_range(s, t), "static assertion expects string literal");
             }
             tokens_next(s);
 
             if (condition == 0) {
-                diag_err(s, (SourceRange){ start, end }, "static assertion failed! %.*s", (int) t->content.length, t->content.data);
+                String str = tokens_content(s, t);
+                diag_err(s, (SourceRange){ start, end }, "static assertion failed! %.*s", (int) str.length, str.data);
             }
         } else {
             if (condition == 0) {
@@ -529,9 +530,10 @@ static Stmt* parse_stmt2(Cuik_Parser* parser, TokenStream* restrict s) {
             }
 
             if (tokens_get(s)->type != TOKEN_KW_while) {
-                Token* t = tokens_get(s);
+                PackedToken* t = tokens_get(s);
 
-                diag_err(s, get_token_range(t), "expected 'while' got '%.*s'", (int)t->content.length, t->content.data);
+                String str = tokens_content(s, t);
+                diag_err(s, tokens_range(s, t), "expected 'while' got '%.*s'", (int)str.length, str.data);
             }
             tokens_next(s);
 
@@ -556,14 +558,14 @@ static Stmt* parse_stmt2(Cuik_Parser* parser, TokenStream* restrict s) {
         tokens_next(s);
 
         // read label name
-        Token* t = tokens_get(s);
-        SourceRange loc = get_token_range(t);
+        PackedToken* t = tokens_get(s);
+        SourceRange loc = tokens_range(s, t);
         if (t->type != TOKEN_IDENTIFIER) {
             diag_err(s, loc, "expected identifier for goto target name");
             return n;
         }
 
-        Atom name = atoms_put(t->content.length, t->content.data);
+        Atom name = atoms_put_token(s, t);
 
         // skip to the semicolon
         tokens_next(s);
@@ -598,8 +600,8 @@ static Stmt* parse_stmt2(Cuik_Parser* parser, TokenStream* restrict s) {
     } else if (peek == TOKEN_IDENTIFIER && tokens_peek(s)->type == TOKEN_COLON) {
         // label amirite
         // IDENTIFIER COLON STMT
-        Token* t = tokens_get(s);
-        Atom name = atoms_put(t->content.length, t->content.data);
+        PackedToken* t = tokens_get(s);
+        Atom name = atoms_put_token(s, t);
 
         ptrdiff_t search = nl_map_get_cstr(labels, name);
         if (search >= 0) {
@@ -13,10 +13,11 @@ static ParseResult parse_pragma(Cuik_Parser* restrict parser, TokenStream* restr
 
     // Slap it into a proper C string so we don't accidentally
     // walk off the end and go random places
-    size_t len = (tokens_get(s)->content.length) - 1;
+    String str = tokens_content(s, tokens_get(s));
+    size_t len = str.length - 1;
     unsigned char* out = tls_push(len);
     {
-        const char* in = (const char*) tokens_get(s)->content.data;
+        const char* in = (const char*) str.data;
 
         size_t out_i = 0, in_i = 1;
         while (in_i < len) {
@@ -109,9 +110,9 @@ static ParseResult parse_static_assert(Cuik_Parser* restrict parser, TokenStream
     if (tokens_get(s)->type == ',') {
         tokens_next(s);
 
-        Token* t = tokens_get(s);
+        PackedToken* t = tokens_get(s);
         if (t->type != TOKEN_STRING_DOUBLE_QUOTE) {
-            diag_err(s, get_token_range(t), "expected string literal");
+            diag_err(s, tokens_range(s, t), "expected string literal");
         }
         tokens_next(s);
     } else {
@@ -481,8 +482,12 @@ Cuik_ParseResult cuikparse_run(Cuik_Version version, TokenStream* restrict s, Cu
     }
     THROW_IF_ERROR();
 
-    // convert to translation unit
+    // convert to translation unit, it's linked into the compilation unit which
+    // outlives whatever heap the parse is in.
+    Cuik_Heap* old_heap = cuik_heap_enter(NULL);
     parser.tu = cuik_malloc(sizeof(TranslationUnit));
+    cuik_heap_enter(old_heap);
+
     *parser.tu = (TranslationUnit){
         .filepath = s->filepath,
         .version = parser.version,
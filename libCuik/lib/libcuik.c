@@ -33,6 +33,7 @@
 
 // IR Gen
 #ifdef CUIK_USE_TB
+#include "back/profile.c"
 #include "back/ir_gen.c"
 #endif
 
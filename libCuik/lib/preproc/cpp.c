@@ -166,7 +166,55 @@ static TokenArray convert_to_token_list(Cuik_CPP* restrict c, uint32_t file_id,
 }
 
 static String get_token_as_string(TokenStream* restrict in) {
-    return tokens_get(in)->content;
+    return tokens_content(in, tokens_get(in));
+}
+
+// appends to the final token stream, only the type & location are kept inline
+// since we can usually find the spelling again from the location.
+static void push_token(TokenStream* restrict s, const Token* t) {
+    assert(t->type >= 0 && t->type < (1 << 23));
+
+    SourceLoc loc = t->location;
+    bool is_long = t->content.length >= TOKEN_LENGTH_LONG;
+    PackedToken pt = { t->type, t->hit_line, false, is_long ? TOKEN_LENGTH_LONG : t->content.length, loc };
+
+    const unsigned char* expected = NULL;
+    if (loc.raw & SourceLoc_IsMacro) {
+        uint32_t macro_id  = (loc.raw >> SourceLoc_MacroOffsetBits) & ((1u << SourceLoc_MacroIDBits) - 1);
+        uint32_t macro_off = loc.raw & ((1u << SourceLoc_MacroOffsetBits) - 1);
+        while (dyn_array_length(s->macro_bases) <= macro_id) {
+            dyn_array_put(s->macro_bases, NULL);
+        }
+
+        // the first token we see from a macro decides what it's offsets are
+        // relative to, the clamped offsets are useless for this.
+        if (s->macro_bases[macro_id] == NULL && t->content.data != NULL && macro_off < (1u << SourceLoc_MacroOffsetBits) - 1) {
+            s->macro_bases[macro_id] = t->content.data - macro_off;
+        }
+
+        if (s->macro_bases[macro_id] != NULL) {
+            expected = s->macro_bases[macro_id] + macro_off;
+        }
+    } else {
+        Cuik_FileEntry* f = &s->files[loc.raw >> SourceLoc_FilePosBits];
+        if (f->content != NULL) {
+            expected = (const unsigned char*) &f->content[loc.raw & ((1u << SourceLoc_FilePosBits) - 1)];
+        }
+    }
+
+    size_t index = dyn_array_length(s->list.tokens);
+    if (index % 64 == 0) {
+        dyn_array_put(s->side_bits, 0);
+        dyn_array_put(s->side_rank, dyn_array_length(s->side_table));
+    }
+
+    if (is_long || expected == NULL || expected != t->content.data) {
+        s->side_bits[index / 64] |= 1ull << (index % 64);
+        dyn_array_put(s->side_table, t->content);
+        pt.side = true;
+    }
+
+    dyn_array_put(s->list.tokens, pt);
 }
 
 static LocateResult locate_file(Cuik_CPP* ctx, bool search_lib_first, const Cuik_Path* restrict dir, const char* og_path, Cuik_Path* restrict canonical) {
@@ -292,10 +340,14 @@ size_t cuikpp_get_file_count(TokenStream* restrict s) {
     return dyn_array_length(s->files) - 1;
 }
 
-Token* cuikpp_get_tokens(TokenStream* restrict s) {
+PackedToken* cuikpp_get_tokens(TokenStream* restrict s) {
     return &s->list.tokens[0];
 }
 
+String cuikpp_get_token_content(TokenStream* restrict s, size_t i) {
+    return tokens_content(s, &s->list.tokens[i]);
+}
+
 size_t cuikpp_get_token_count(TokenStream* restrict s) {
     // don't tell them about the EOF token :P
     return dyn_array_length(s->list.tokens) - 1;
@@ -317,6 +369,10 @@ void cuiklex_free_tokens(TokenStream* tokens) {
 
     dyn_array_destroy(tokens->files);
     dyn_array_destroy(tokens->list.tokens);
+    dyn_array_destroy(tokens->side_table);
+    dyn_array_destroy(tokens->side_bits);
+    dyn_array_destroy(tokens->side_rank);
+    dyn_array_destroy(tokens->macro_bases);
     dyn_array_destroy(tokens->invokes);
     cuikdg_free(tokens->diag);
 }
@@ -562,7 +618,11 @@ Cuikpp_Status cuikpp_run(Cuik_CPP* restrict ctx) {
     // estimate a good final token count, if we get this right we'll zip past without resizes
     size_t expected = dyn_array_length(slot->tokens.tokens);
     if (expected < 4096) expected = 4096;
-    s->list.tokens = dyn_array_create(Token, expected);
+    s->list.tokens = dyn_array_create(PackedToken, expected);
+    s->side_table = dyn_array_create(String, 256);
+    s->side_bits = dyn_array_create(uint64_t, (expected + 63) / 64);
+    s->side_rank = dyn_array_create(uint32_t, (expected + 63) / 64);
+    s->macro_bases = dyn_array_create(const unsigned char*, 256);
 
     for (;;) yield: {
         slot = &ctx->stack[ctx->stack_ptr - 1];
@@ -586,12 +646,12 @@ Cuikpp_Status cuikpp_run(Cuik_CPP* restrict ctx) {
                     if (!is_defined(ctx, first.content.data, first.content.length)) {
                         // FAST PATH
                         first.type = classify_ident(first.content.data, first.content.length, is_glsl);
-                        dyn_array_put(s->list.tokens, first);
+                        push_token(s, &first);
                     } else {
                         // SLOW PATH BECAUSE IT NEEDS TO SPAWN POSSIBLY METRIC SHIT LOADS
                         // OF TOKENS AND EXPAND WITH THE AVERAGE C PREPROCESSOR SPOOKIES
                         if (expand_builtin_idents(ctx, &first)) {
-                            dyn_array_put(s->list.tokens, first);
+                            push_token(s, &first);
                         } else {
                             in->current -= 1;
                             void* savepoint = tls_save();
@@ -605,7 +665,7 @@ Cuikpp_Status cuikpp_run(Cuik_CPP* restrict ctx) {
                                     t->type = classify_ident(t->content.data, t->content.length, is_glsl);
                                 }
 
-                                dyn_array_put(s->list.tokens, *t);
+                                push_token(s, t);
                             }
 
                             tls_restore(savepoint);
@@ -615,7 +675,7 @@ Cuikpp_Status cuikpp_run(Cuik_CPP* restrict ctx) {
                     // slow path
                     break;
                 } else {
-                    dyn_array_put(s->list.tokens, first);
+                    push_token(s, &first);
                 }
             }
 
@@ -698,7 +758,7 @@ Cuikpp_Status cuikpp_run(Cuik_CPP* restrict ctx) {
         // if this is the last file, just exit
         if (ctx->stack_ptr == 0) {
             // place last token
-            dyn_array_put(s->list.tokens, (Token){ 0 });
+            push_token(s, &(Token){ 0 });
 
             s->list.current = 0;
             return CUIKPP_DONE;
@@ -36,8 +36,8 @@ static DirectiveResult cpp__error(Cuik_CPP* restrict ctx, CPPStackSlot* restrict
 // passthrough all tokens raw
 static DirectiveResult cpp__version(Cuik_CPP* restrict ctx, CPPStackSlot* restrict slot, TokenArray* restrict in) {
     TokenStream* restrict s = &ctx->tokens;
-    dyn_array_put(s->list.tokens, in->tokens[in->current - 2]);
-    dyn_array_put(s->list.tokens, in->tokens[in->current - 1]);
+    push_token(s, &in->tokens[in->current - 2]);
+    push_token(s, &in->tokens[in->current - 1]);
 
     for (;;) {
         Token t = consume(in);
@@ -46,7 +46,7 @@ static DirectiveResult cpp__version(Cuik_CPP* restrict ctx, CPPStackSlot* restri
             return DIRECTIVE_SUCCESS;
         }
 
-        dyn_array_put(s->list.tokens, t);
+        push_token(s, &t);
     }
 }
 
@@ -77,13 +77,13 @@ static DirectiveResult cpp__pragma(Cuik_CPP* restrict ctx, CPPStackSlot* restric
         unsigned char* str = gimme_the_shtuffs(ctx, sizeof("_Pragma"));
         memcpy(str, "_Pragma", sizeof("_Pragma"));
         Token t = { TOKEN_KW_Pragma, false, false, loc, { 7, str } };
-        dyn_array_put(s->list.tokens, t);
+        push_token(s, &t);
 
         str = gimme_the_shtuffs(ctx, sizeof("("));
         str[0] = '(';
         str[1] = 0;
         t = (Token){ '(', false, false, loc, { 1, str } };
-        dyn_array_put(s->list.tokens, t);
+        push_token(s, &t);
 
         String payload = get_pp_tokens_until_newline(ctx, in);
 
@@ -105,14 +105,14 @@ static DirectiveResult cpp__pragma(Cuik_CPP* restrict ctx, CPPStackSlot* restric
             *curr++ = '\0';
 
             t = (Token){ TOKEN_STRING_DOUBLE_QUOTE, false, false, loc, { (curr - str) - 1, str } };
-            dyn_array_put(s->list.tokens, t);
+            push_token(s, &t);
         }
 
         str = gimme_the_shtuffs(ctx, sizeof(")"));
         str[0] = ')';
         str[1] = 0;
         t = (Token){ ')', false, false, loc, { 1, str } };
-        dyn_array_put(s->list.tokens, t);
+        push_token(s, &t);
     }
 
     return DIRECTIVE_SUCCESS;
@@ -429,11 +429,11 @@ static DirectiveResult cpp__embed(Cuik_CPP* restrict ctx, CPPStackSlot* restrict
     // convert #embed path => _Embed(path)
     unsigned char* str = gimme_the_shtuffs_fill(ctx, "_Embed");
     Token t = (Token){ TOKEN_KW_Embed, false, false, loc.start, { 7, str } };
-    dyn_array_put(s->list.tokens, t);
+    push_token(s, &t);
 
     str = gimme_the_shtuffs_fill(ctx, "(");
     t = (Token){ '(', false, false, loc.start, { 1, str } };
-    dyn_array_put(s->list.tokens, t);
+    push_token(s, &t);
 
     Cuik_FileResult next_file;
     if (!ctx->fs(ctx->user_data, &canonical, &next_file, ctx->case_insensitive)) {
@@ -444,11 +444,11 @@ static DirectiveResult cpp__embed(Cuik_CPP* restrict ctx, CPPStackSlot* restrict
     t = (Token){ TOKEN_MAGIC_EMBED_STRING, false, false, loc.start };
     t.content.length = next_file.length;
     t.content.data = (const unsigned char*) next_file.data;
-    dyn_array_put(s->list.tokens, t);
+    push_token(s, &t);
 
     str = gimme_the_shtuffs_fill(ctx, ")");
     t = (Token){ ')', false, false, loc.start, { 1, str } };
-    dyn_array_put(s->list.tokens, t);
+    push_token(s, &t);
 
     return DIRECTIVE_SUCCESS;
 }
@@ -6,11 +6,6 @@ static void dump(TokenNode* head) {
     printf("\n");
 }
 
-static Token* get_last_token(TokenStream* restrict s) {
-    assert(dyn_array_length(s->list.tokens) > 0);
-    return &s->list.tokens[dyn_array_length(s->list.tokens) - 1];
-}
-
 static bool concat_token(Cuik_CPP* restrict c, String a, String b, Token* out_token) {
     return true;
 }
@@ -1,4 +1,6 @@
 #include <log.h>
+#include <threads.h>
+#include <hash_map.h>
 #include "../front/atoms.h"
 
 #if USE_INTRIN && CUIK__IS_X64
@@ -45,6 +47,104 @@ bool cuikpp_locate_file(void* user_data, const Cuik_Path* restrict input, Cuik_P
     }
 }
 
+// Long running processes (the compile server) keep the canonicalized contents
+// of the files they've read around, a hit only costs a stat and a memcpy. The
+// size + last write time is checked on every hit so edits are still picked up.
+typedef struct {
+    uint64_t last_write;
+    size_t length;
+    char* data;
+} CachedFile;
+
+static bool file_cache_enabled;
+static mtx_t file_cache_lock;
+static NL_Strmap(CachedFile) file_cache;
+
+void cuikpp_enable_file_cache(void) {
+    if (!file_cache_enabled) {
+        mtx_init(&file_cache_lock, mtx_plain);
+        nl_map_create(file_cache, 256);
+        file_cache_enabled = true;
+    }
+}
+
+static bool get_file_stamp(const char* path, uint64_t* out_last_write, size_t* out_length) {
+    #ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExA(path, GetFileExInfoStandard, &data)) {
+        return false;
+    }
+
+    *out_last_write = ((uint64_t) data.ftLastWriteTime.dwHighDateTime << 32ull) | data.ftLastWriteTime.dwLowDateTime;
+    *out_length = ((size_t) data.nFileSizeHigh << 32ull) | data.nFileSizeLow;
+    #else
+    struct stat buffer;
+    if (stat(path, &buffer) != 0) {
+        return false;
+    }
+
+    #ifdef __APPLE__
+    *out_last_write = buffer.st_mtimespec.tv_sec*1000000000ull + buffer.st_mtimespec.tv_nsec;
+    #else
+    *out_last_write = buffer.st_mtim.tv_sec*1000000000ull + buffer.st_mtim.tv_nsec;
+    #endif
+    *out_length = buffer.st_size;
+    #endif
+    return true;
+}
+
+// the preprocessor owns the buffers it gets so we hand out copies
+static bool file_cache_get(const char* path, Cuik_FileResult* output) {
+    uint64_t last_write;
+    size_t length;
+    if (!get_file_stamp(path, &last_write, &length)) {
+        return false;
+    }
+
+    bool hit = false;
+    mtx_lock(&file_cache_lock);
+    ptrdiff_t search = nl_map_get_cstr(file_cache, path);
+    if (search >= 0) {
+        CachedFile* f = &file_cache[search].v;
+        if (f->last_write == last_write && f->length == length) {
+            char* buffer = cuik__valloc(length + 17);
+            memcpy(buffer, f->data, length);
+
+            output->length = length;
+            output->data = buffer;
+            hit = true;
+        }
+    }
+    mtx_unlock(&file_cache_lock);
+    return hit;
+}
+
+static void file_cache_put(const char* path, const Cuik_FileResult* file) {
+    uint64_t last_write;
+    size_t length;
+    if (!get_file_stamp(path, &last_write, &length) || length != file->length) {
+        return;
+    }
+
+    // the cache is shared by every build step so it can't live in their heaps
+    Cuik_Heap* old_heap = cuik_heap_enter(NULL);
+    char* data = cuik_malloc(length);
+    memcpy(data, file->data, length);
+
+    mtx_lock(&file_cache_lock);
+    ptrdiff_t search = nl_map_get_cstr(file_cache, path);
+    if (search >= 0) {
+        CachedFile* f = &file_cache[search].v;
+        cuik_free(f->data);
+        *f = (CachedFile){ last_write, length, data };
+    } else {
+        char* key = cuik_strdup(path);
+        nl_map_put_cstr(file_cache, key, ((CachedFile){ last_write, length, data }));
+    }
+    mtx_unlock(&file_cache_lock);
+    cuik_heap_enter(old_heap);
+}
+
 bool cuikpp_default_fs(void* user_data, const Cuik_Path* restrict input, Cuik_FileResult* output, bool case_insensitive) {
     if (input->length == 0) {
         if (user_data == NULL) return false;
@@ -70,6 +170,10 @@ bool cuikpp_default_fs(void* user_data, const Cuik_Path* restrict input, Cuik_Fi
         Cuik_Path path;
         cuikfs_canonicalize(&path, input->data, case_insensitive);
 
+        if (file_cache_enabled && file_cache_get(path.data, output)) {
+            return true;
+        }
+
         // read entire file into virtual memory block
         Cuik_File* file = cuikfs_open(path.data, false);
         if (file == NULL) return false;
@@ -85,6 +189,10 @@ bool cuikpp_default_fs(void* user_data, const Cuik_Path* restrict input, Cuik_Fi
         output->length = length;
         output->data = buffer;
         cuikfs_close(file);
+
+        if (file_cache_enabled) {
+            file_cache_put(path.data, output);
+        }
         return true;
 
         err:
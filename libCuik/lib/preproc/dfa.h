@@ -0,0 +1,362 @@
+// a = 12531264313017737726 (76 keywords, 586785 tries)
+#define PERFECT_HASH_SEED 12531264313017737726ULL
+static const uint8_t keywords_table[256] = {
+    [223] = 0 /* auto */, [227] = 1 /* break */, [214] = 2 /* case */, [193] = 3 /* char */, 
+    [212] = 4 /* const */, [156] = 5 /* continue */, [12] = 6 /* default */, [59] = 7 /* do */, 
+    [101] = 8 /* double */, [181] = 9 /* else */, [222] = 10 /* enum */, [206] = 11 /* extern */, 
+    [229] = 12 /* float */, [33] = 13 /* for */, [27] = 14 /* goto */, [207] = 15 /* if */, 
+    [25] = 16 /* inline */, [160] = 17 /* int */, [58] = 18 /* long */, [132] = 19 /* register */, 
+    [150] = 20 /* restrict */, [248] = 21 /* return */, [60] = 22 /* short */, [64] = 23 /* signed */, 
+    [91] = 24 /* sizeof */, [90] = 25 /* static */, [24] = 26 /* struct */, [15] = 27 /* switch */, 
+    [1] = 28 /* typedef */, [254] = 29 /* union */, [169] = 30 /* unsigned */, [120] = 31 /* void */, 
+    [83] = 32 /* volatile */, [126] = 33 /* while */, [125] = 34 /* _Alignas */, [187] = 35 /* _Alignof */, 
+    [231] = 36 /* _Atomic */, [147] = 37 /* _Bool */, [65] = 38 /* _Complex */, [96] = 39 /* _Embed */, 
+    [92] = 40 /* _Generic */, [78] = 41 /* _Imaginary */, [56] = 42 /* _Pragma */, [208] = 43 /* _Noreturn */, 
+    [170] = 44 /* _Static_assert */, [155] = 45 /* _Thread_local */, [174] = 46 /* _Typeof */, [195] = 47 /* _Vector */, 
+    [142] = 48 /* __asm__ */, [179] = 49 /* __attribute__ */, [202] = 50 /* __cdecl */, [216] = 51 /* __stdcall */, 
+    [74] = 52 /* __declspec */, [146] = 53 /* discard */, [165] = 54 /* layout */, [62] = 55 /* in */, 
+    [139] = 56 /* out */, [95] = 57 /* inout */, [72] = 58 /* uint */, [230] = 59 /* buffer */, 
+    [192] = 60 /* uniform */, [154] = 61 /* flat */, [238] = 62 /* smooth */, [30] = 63 /* noperspective */, 
+    [211] = 64 /* vec2 */, [129] = 65 /* vec3 */, [47] = 66 /* vec4 */, [249] = 67 /* ivec2 */, 
+    [167] = 68 /* ivec3 */, [85] = 69 /* ivec4 */, [217] = 70 /* uvec2 */, [135] = 71 /* uvec3 */, 
+    [53] = 72 /* uvec4 */, [114] = 73 /* dvec2 */, [31] = 74 /* dvec3 */, [205] = 75 /* dvec4 */, 
+};
+
+static const char keywords[][16] = {
+    "auto",
+    "break",
+    "case",
+    "char",
+    "const",
+    "continue",
+    "default",
+    "do",
+    "double",
+    "else",
+    "enum",
+    "extern",
+    "float",
+    "for",
+    "goto",
+    "if",
+    "inline",
+    "int",
+    "long",
+    "register",
+    "restrict",
+    "return",
+    "short",
+    "signed",
+    "sizeof",
+    "static",
+    "struct",
+    "switch",
+    "typedef",
+    "union",
+    "unsigned",
+    "void",
+    "volatile",
+    "while",
+    "_Alignas",
+    "_Alignof",
+    "_Atomic",
+    "_Bool",
+    "_Complex",
+    "_Embed",
+    "_Generic",
+    "_Imaginary",
+    "_Pragma",
+    "_Noreturn",
+    "_Static_assert",
+    "_Thread_local",
+    "_Typeof",
+    "_Vector",
+    "__asm__",
+    "__attribute__",
+    "__cdecl",
+    "__stdcall",
+    "__declspec",
+    "discard",
+    "layout",
+    "in",
+    "out",
+    "inout",
+    "uint",
+    "buffer",
+    "uniform",
+    "flat",
+    "smooth",
+    "noperspective",
+    "vec2",
+    "vec3",
+    "vec4",
+    "ivec2",
+    "ivec3",
+    "ivec4",
+    "uvec2",
+    "uvec3",
+    "uvec4",
+    "dvec2",
+    "dvec3",
+    "dvec4",
+};
+
+static const uint64_t dfa[256][2] = {
+    { 0x0000000000000000, 0x0000000000000000 },
+    { 0x0000000000000000, 0x0000000000000000 },
+    { 0x0000000000000000, 0x0000000000000000 },
+    { 0x0000000000000000, 0x0000000000000000 },
+    { 0x0000000000000000, 0x0000000000000000 },
+    { 0x0000000000000000, 0x0000000000000000 },
+    { 0x0000000000000000, 0x0000000000000000 },
+    { 0x0000000000000000, 0x0000000000000000 },
+    { 0x0000000000000000, 0x0000000000000000 },
+    { 0x0000000000000000, 0x0000000000000000 },
+    { 0x0000000000000000, 0x0000000000000000 },
+    { 0x0000000000000000, 0x0000000000000000 },
+    { 0x0000000000000000, 0x0000000000000000 },
+    { 0x0000000000000000, 0x0000000000000000 },
+    { 0x0000000000000000, 0x0000000000000000 },
+    { 0x0000000000000000, 0x0000000000000000 },
+    { 0x0000000000000000, 0x0000000000000000 },
+    { 0x0000000000000000, 0x0000000000000000 },
+    { 0x0000000000000000, 0x0000000000000000 },
+    { 0x0000000000000000, 0x0000000000000000 },
+    { 0x0000000000000000, 0x0000000000000000 },
+    { 0x0000000000000000, 0x0000000000000000 },
+    { 0x0000000000000000, 0x0000000000000000 },
+    { 0x0000000000000000, 0x0000000000000000 },
+    { 0x0000000000000000, 0x0000000000000000 },
+    { 0x0000000000000000, 0x0000000000000000 },
+    { 0x0000000000000000, 0x0000000000000000 },
+    { 0x0000000000000000, 0x0000000000000000 },
+    { 0x0000000000000000, 0x0000000000000000 },
+    { 0x0000000000000000, 0x0000000000000000 },
+    { 0x0000000000000000, 0x0000000000000000 },
+    { 0x0000000000000000, 0x0000000000000000 },
+    { 0x0000000000000000, 0x0000000000000000 },
+    { 0x0000000000000019, 0x0000000000000000 },
+    { 0x078000000000001e, 0x0000000000000000 },
+    { 0x0000000000000031, 0x0002000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0000000000000019, 0x0000000000000000 },
+    { 0x0000000000040012, 0x0000000000000000 },
+    { 0x078000000000001e, 0x0000000000000000 },
+    { 0x0000000000000037, 0x0000000000000000 },
+    { 0x0000000000000037, 0x0000000000000000 },
+    { 0x0000000000000019, 0x0000000000000000 },
+    { 0x0000000001000018, 0x0000000000000000 },
+    { 0x0000000000000037, 0x0000000000000000 },
+    { 0x000000000000002b, 0x0000080000000000 },
+    { 0x000000000000d00c, 0x0000000000002000 },
+    { 0x0000000000000019, 0x0000000000000000 },
+    { 0x0180000000000187, 0x0000000000000380 },
+    { 0x0180000000000187, 0x0000000000000380 },
+    { 0x0180000000000187, 0x0000000000000380 },
+    { 0x0180000000000187, 0x0000000000000380 },
+    { 0x0180000000000187, 0x0000000000000380 },
+    { 0x0180000000000187, 0x0000000000000380 },
+    { 0x0180000000000187, 0x0000000000000380 },
+    { 0x0180000000000187, 0x0000000000000380 },
+    { 0x0180000000000187, 0x0000000000000380 },
+    { 0x0180000000000187, 0x0000000000000380 },
+    { 0x0000000000000037, 0x0000000000000000 },
+    { 0x0000000000000037, 0x0000000000000000 },
+    { 0x000000000000001f, 0x0000001200000000 },
+    { 0x0001041001040030, 0x0000082082080000 },
+    { 0x0000000000000025, 0x00000d4000000000 },
+    { 0x0000000000000037, 0x0000000000000000 },
+    { 0x0000000000000037, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x01800000000001b6, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0000000000000037, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0000000000000037, 0x0000000000000000 },
+    { 0x0000000000000019, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0000000000000000, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0000000000000037, 0x0000000000000000 },
+    { 0x0000000000000013, 0x0000000000080000 },
+    { 0x0000000000000037, 0x0000000000000000 },
+    { 0x0000000000000019, 0x0000000000000000 },
+    { 0x0000000000000000, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+    { 0x0180000000000186, 0x0000000000000000 },
+};
+
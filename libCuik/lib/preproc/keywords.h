@@ -0,0 +1,76 @@
+TOKEN_KW_auto = 0x400000,
+TOKEN_KW_break,
+TOKEN_KW_case,
+TOKEN_KW_char,
+TOKEN_KW_const,
+TOKEN_KW_continue,
+TOKEN_KW_default,
+TOKEN_KW_do,
+TOKEN_KW_double,
+TOKEN_KW_else,
+TOKEN_KW_enum,
+TOKEN_KW_extern,
+TOKEN_KW_float,
+TOKEN_KW_for,
+TOKEN_KW_goto,
+TOKEN_KW_if,
+TOKEN_KW_inline,
+TOKEN_KW_int,
+TOKEN_KW_long,
+TOKEN_KW_register,
+TOKEN_KW_restrict,
+TOKEN_KW_return,
+TOKEN_KW_short,
+TOKEN_KW_signed,
+TOKEN_KW_sizeof,
+TOKEN_KW_static,
+TOKEN_KW_struct,
+TOKEN_KW_switch,
+TOKEN_KW_typedef,
+TOKEN_KW_union,
+TOKEN_KW_unsigned,
+TOKEN_KW_void,
+TOKEN_KW_volatile,
+TOKEN_KW_while,
+TOKEN_KW_Alignas,
+TOKEN_KW_Alignof,
+TOKEN_KW_Atomic,
+TOKEN_KW_Bool,
+TOKEN_KW_Complex,
+TOKEN_KW_Embed,
+TOKEN_KW_Generic,
+TOKEN_KW_Imaginary,
+TOKEN_KW_Pragma,
+TOKEN_KW_Noreturn,
+TOKEN_KW_Static_assert,
+TOKEN_KW_Thread_local,
+TOKEN_KW_Typeof,
+TOKEN_KW_Vector,
+TOKEN_KW_asm,
+TOKEN_KW_attribute,
+TOKEN_KW_cdecl,
+TOKEN_KW_stdcall,
+TOKEN_KW_declspec,
+TOKEN_KW_discard,
+TOKEN_KW_layout,
+TOKEN_KW_in,
+TOKEN_KW_out,
+TOKEN_KW_inout,
+TOKEN_KW_uint,
+TOKEN_KW_buffer,
+TOKEN_KW_uniform,
+TOKEN_KW_flat,
+TOKEN_KW_smooth,
+TOKEN_KW_noperspective,
+TOKEN_KW_vec2,
+TOKEN_KW_vec3,
+TOKEN_KW_vec4,
+TOKEN_KW_ivec2,
+TOKEN_KW_ivec3,
+TOKEN_KW_ivec4,
+TOKEN_KW_uvec2,
+TOKEN_KW_uvec3,
+TOKEN_KW_uvec4,
+TOKEN_KW_dvec2,
+TOKEN_KW_dvec3,
+TOKEN_KW_dvec4,
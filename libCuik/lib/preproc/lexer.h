@@ -88,7 +88,8 @@ typedef enum TknType {
     TOKEN_INCREMENT         = TKN2('+', '+'),
     TOKEN_DECREMENT         = TKN2('-', '-'),
 
-    // Keywords (they start far higher up to avoid problems)
+    // Keywords (they start far higher up to avoid problems but still need
+    // to fit into PackedToken's 23bit type field)
     #include "keywords.h"
 } TknType;
 
@@ -148,9 +149,52 @@ static SourceLoc get_end_location(Token* t) {
     return (SourceLoc){ t->location.raw + t->content.length };
 }
 
+// where the token's spelling starts, only valid for tokens which aren't in the
+// side table (push_token made sure of it).
+static const unsigned char* tokens_loc_data(TokenStream* restrict s, SourceLoc loc) {
+    if (loc.raw & SourceLoc_IsMacro) {
+        uint32_t macro_id  = (loc.raw >> SourceLoc_MacroOffsetBits) & ((1u << SourceLoc_MacroIDBits) - 1);
+        uint32_t macro_off = loc.raw & ((1u << SourceLoc_MacroOffsetBits) - 1);
+        return s->macro_bases[macro_id] + macro_off;
+    } else {
+        uint32_t file_id = loc.raw >> SourceLoc_FilePosBits;
+        uint32_t pos = loc.raw & ((1u << SourceLoc_FilePosBits) - 1);
+        return (const unsigned char*) &s->files[file_id].content[pos];
+    }
+}
+
+static String tokens_side_lookup(TokenStream* restrict s, size_t index) {
+    uint64_t bits = s->side_bits[index / 64] & ((1ull << (index % 64)) - 1);
+
+    #ifdef _MSC_VER
+    size_t i = s->side_rank[index / 64] + __popcnt64(bits);
+    #else
+    size_t i = s->side_rank[index / 64] + __builtin_popcountll(bits);
+    #endif
+
+    assert(i < dyn_array_length(s->side_table));
+    return s->side_table[i];
+}
+
+static String tokens_content(TokenStream* restrict s, PackedToken* t) {
+    if (!t->side) {
+        return (String){ t->length, tokens_loc_data(s, t->location) };
+    }
+
+    return tokens_side_lookup(s, t - s->list.tokens);
+}
+
+static size_t tokens_length(TokenStream* restrict s, PackedToken* t) {
+    return t->length != TOKEN_LENGTH_LONG ? t->length : tokens_side_lookup(s, t - s->list.tokens).length;
+}
+
+static SourceRange tokens_range(TokenStream* restrict s, PackedToken* t) {
+    return (SourceRange){ t->location, { t->location.raw + tokens_length(s, t) } };
+}
+
 static SourceLoc tokens_get_last_location(TokenStream* restrict s) {
-    Token* t = &s->list.tokens[s->list.current - 1];
-    return (SourceLoc){ t->location.raw + t->content.length };
+    PackedToken* t = &s->list.tokens[s->list.current - 1];
+    return (SourceLoc){ t->location.raw + tokens_length(s, t) };
 }
 
 static SourceLoc tokens_get_location(TokenStream* restrict s) {
@@ -158,13 +202,11 @@ static SourceLoc tokens_get_location(TokenStream* restrict s) {
 }
 
 static SourceRange tokens_get_last_range(TokenStream* restrict s) {
-    Token* t = &s->list.tokens[s->list.current - 1];
-    return (SourceRange){ t->location, { t->location.raw + t->content.length } };
+    return tokens_range(s, &s->list.tokens[s->list.current - 1]);
 }
 
 static SourceRange tokens_get_range(TokenStream* restrict s) {
-    Token* t = &s->list.tokens[s->list.current];
-    return (SourceRange){ t->location, { t->location.raw + t->content.length } };
+    return tokens_range(s, &s->list.tokens[s->list.current]);
 }
 
 static bool tokens_hit_line(TokenStream* restrict s) {
@@ -181,17 +223,18 @@ static bool tokens_is(TokenStream* restrict s, TknType type) {
 }
 
 static bool tokens_match(TokenStream* restrict s, size_t len, const char* str) {
-    return string_equals(&s->list.tokens[s->list.current].content, &(String){ len, (const unsigned char*) str });
+    String content = tokens_content(s, &s->list.tokens[s->list.current]);
+    return string_equals(&content, &(String){ len, (const unsigned char*) str });
 }
 
 // this is used by the parser to get the next token
-static Token* tokens_get(TokenStream* restrict s) {
+static PackedToken* tokens_get(TokenStream* restrict s) {
     return &s->list.tokens[s->list.current];
 }
 
 // there should be a NULL token so as long as we can read [current]
 // we can read one ahead.
-static Token* tokens_peek(TokenStream* restrict s) {
+static PackedToken* tokens_peek(TokenStream* restrict s) {
     return &s->list.tokens[s->list.current + 1];
 }
 
@@ -1,5 +1,24 @@
+// -live keeps the compiler around and rebuilds whenever one of the sources
+// is saved. With -r the program runs inside a JIT, only the translation unit
+// which changed gets recompiled and its functions are hot-swapped into the
+// running program.
+#if CUIK_ALLOW_THREADS
+#include <threads.h>
+#endif
+
 typedef struct {
-    uint64_t og_last_write;
+    int count;
+    const char** sources;
+
+    #if defined(__linux__)
+    int fd;
+    // per source, the watch on its directory (editors like to save by renaming
+    // a temporary over the file which a watch on the file itself would miss).
+    int* wd;
+    const char** names;
+    #else
+    uint64_t* last_write;
+    #endif
 } LiveCompiler;
 
 #if _WIN32
@@ -18,36 +37,313 @@ static uint64_t get_last_write_time(const char* filepath) {
     return i.QuadPart;
 }
 
-// returns false if no changes are made, true if the file is ready to be reloaded
-static bool live_compile_watch(LiveCompiler* l, const char* source_file) {
-    // Wait for the user to save again
-    uint64_t current_last_write;
-    if (current_last_write = get_last_write_time(source_file), l->og_last_write == current_last_write) {
+static void live_sleep(int ms) {
+    SleepEx(ms, FALSE);
+}
+#elif defined(__linux__)
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#else
+#include <unistd.h>
+#include <sys/stat.h>
+
+static uint64_t get_last_write_time(const char* filepath) {
+    struct stat s;
+    if (stat(filepath, &s) != 0) {
+        return 0;
+    }
+
+    return s.st_mtime;
+}
+
+static void live_sleep(int ms) {
+    usleep(ms * 1000);
+}
+#endif
+
+static bool live_compile_init(LiveCompiler* l, int count, const char** sources) {
+    l->count = count;
+    l->sources = sources;
+
+    #if defined(__linux__)
+    l->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (l->fd < 0) {
         return false;
     }
 
-    l->og_last_write = current_last_write;
+    l->wd = cuik_malloc(count * sizeof(int));
+    l->names = cuik_malloc(count * sizeof(const char*));
+    for (int i = 0; i < count; i++) {
+        const char* slash = strrchr(sources[i], '/');
+        char dir[FILENAME_MAX];
+        if (slash == NULL) {
+            strcpy(dir, ".");
+            l->names[i] = sources[i];
+        } else {
+            snprintf(dir, sizeof(dir), "%.*s", (int) (slash - sources[i]), sources[i]);
+            l->names[i] = slash + 1;
+        }
 
-    // wait for it to finish writing before trying to compile
-    int ticks = 0;
-    while (GetFileAttributesA(source_file) == INVALID_FILE_ATTRIBUTES) {
-        SleepEx(1, FALSE);
+        // watching the same directory twice hands back the same descriptor
+        l->wd[i] = inotify_add_watch(l->fd, dir[0] ? dir : "/", IN_CLOSE_WRITE | IN_MOVED_TO);
+        if (l->wd[i] < 0) {
+            return false;
+        }
+    }
+    #else
+    l->last_write = cuik_malloc(count * sizeof(uint64_t));
+    for (int i = 0; i < count; i++) {
+        l->last_write[i] = get_last_write_time(sources[i]);
+    }
+    #endif
+
+    return true;
+}
+
+static void live_compile_free(LiveCompiler* l) {
+    #if defined(__linux__)
+    close(l->fd);
+    cuik_free(l->wd);
+    cuik_free(l->names);
+    #else
+    cuik_free(l->last_write);
+    #endif
+}
+
+#if defined(__linux__)
+// marks which sources the pending events were about, returns true if any
+static bool live__drain_events(LiveCompiler* l, bool* changed) {
+    bool any = false;
+    _Alignas(struct inotify_event) char buf[4096];
 
-        if (ticks++ > 100) {
-            printf("live-compiler error: file locked (tried multiple times)\n");
+    ssize_t len;
+    while (len = read(l->fd, buf, sizeof(buf)), len > 0) {
+        for (char* ptr = buf; ptr < buf + len;) {
+            struct inotify_event* e = (struct inotify_event*) ptr;
+            for (int i = 0; e->len && i < l->count; i++) {
+                if (l->wd[i] == e->wd && strcmp(l->names[i], e->name) == 0) {
+                    changed[i] = any = true;
+                }
+            }
+
+            ptr += sizeof(struct inotify_event) + e->len;
+        }
+    }
+
+    return any;
+}
+#endif
+
+// waits up to timeout_ms (negative means forever) for one of the sources to be
+// saved, returns true and marks the ones which changed if so.
+static bool live_compile_watch(LiveCompiler* l, bool* changed, int timeout_ms) {
+    memset(changed, 0, l->count * sizeof(bool));
+
+    #if defined(__linux__)
+    for (;;) {
+        struct pollfd p = { l->fd, POLLIN };
+        if (poll(&p, 1, timeout_ms) <= 0) {
             return false;
         }
+
+        if (live__drain_events(l, changed)) {
+            break;
+        }
+    }
+
+    // saves tend to come in bursts (and multiple files at once with
+    // things like a project-wide replace), give it a moment to settle.
+    for (;;) {
+        struct pollfd p = { l->fd, POLLIN };
+        if (poll(&p, 1, 5) <= 0) {
+            break;
+        }
+        live__drain_events(l, changed);
     }
 
     return true;
+    #else
+    int waited = 0;
+    for (;;) {
+        bool any = false;
+        for (int i = 0; i < l->count; i++) {
+            uint64_t current_last_write = get_last_write_time(l->sources[i]);
+            if (l->last_write[i] != current_last_write) {
+                l->last_write[i] = current_last_write;
+                changed[i] = any = true;
+            }
+        }
+
+        if (any) {
+            break;
+        } else if (timeout_ms >= 0 && waited >= timeout_ms) {
+            return false;
+        }
+
+        live_sleep(20);
+        waited += 20;
+    }
+
+    #if _WIN32
+    // wait for it to finish writing before trying to compile
+    for (int i = 0; i < l->count; i++) {
+        int ticks = 0;
+        while (changed[i] && GetFileAttributesA(l->sources[i]) == INVALID_FILE_ATTRIBUTES) {
+            SleepEx(1, FALSE);
+
+            if (ticks++ > 100) {
+                printf("live-compiler error: file locked (tried multiple times)\n");
+                changed[i] = false;
+            }
+        }
+    }
+    #endif
+
+    return true;
+    #endif
 }
-#else
-static uint64_t get_last_write_time(const char* filepath) {
+
+static bool live_build(Cuik_DriverArgs* args, Cuik_IThreadpool* tp, int count, const char** sources) {
+    Cuik_BuildStep** objs = cuik_malloc(count * sizeof(Cuik_BuildStep*));
+    for (int i = 0; i < count; i++) {
+        objs[i] = cuik_driver_cc(args, sources[i]);
+    }
+
+    Cuik_BuildStep* linked = cuik_driver_ld(args, count, objs);
+    bool ok = cuik_step_run(linked, tp);
+
+    cuik_step_free(linked);
+    cuik_free(objs);
+    return ok;
+}
+
+#if defined(CUIK_USE_TB) && CUIK_ALLOW_THREADS
+typedef struct {
+    int (*entry)(int, char**);
+    char* argv[2];
+
+    _Atomic bool done;
+    int status;
+    thrd_t thread;
+} LiveProgram;
+
+static int live_program_run(void* arg) {
+    LiveProgram* p = arg;
+    p->status = p->entry(1, p->argv);
+    p->done = true;
     return 0;
 }
 
-static bool live_compile_watch(LiveCompiler* l, const char* source_file) {
-    l->og_last_write = get_last_write_time(source_file);
-    return false;
+static bool live_program_start(LiveProgram* p, TB_JIT* jit) {
+    const char* missing = tb_jit_unresolved(jit);
+    if (missing != NULL) {
+        fprintf(stderr, "live-compiler error: undefined symbol '%s'\n", missing);
+        return false;
+    }
+
+    p->entry = tb_jit_get_entry(jit, "main");
+    if (p->entry == NULL) {
+        fprintf(stderr, "live-compiler error: no main function\n");
+        return false;
+    }
+
+    p->done = false;
+    if (thrd_create(&p->thread, live_program_run, p) != thrd_success) {
+        fprintf(stderr, "live-compiler error: could not start the program\n");
+        return false;
+    }
+
+    return true;
+}
+
+static int live_main_jit(Cuik_DriverArgs* args, Cuik_IThreadpool* tp, LiveCompiler* l) {
+    // every source is its own unit so an edit only recompiles the one it touched
+    args->jit = tb_jit_begin(NULL, 256*1024*1024);
+
+    bool ok = true;
+    for (int i = 0; i < l->count; i++) {
+        ok &= live_build(args, tp, 1, &l->sources[i]);
+    }
+
+    LiveProgram p = { .argv = { (char*) l->sources[0], NULL } };
+    bool running = ok && live_program_start(&p, args->jit);
+
+    bool* changed = cuik_malloc(l->count * sizeof(bool));
+    for (;;) {
+        if (!live_compile_watch(l, changed, 100)) {
+            if (running && p.done) {
+                thrd_join(p.thread, NULL);
+                printf("live-compiler: program exited with %d, waiting on changes...\n", p.status);
+                fflush(stdout);
+                running = false;
+            }
+            continue;
+        }
+
+        uint64_t start = cuik_time_in_nanos();
+        ok = true;
+        for (int i = 0; i < l->count; i++) {
+            if (changed[i]) {
+                ok &= live_build(args, tp, 1, &l->sources[i]);
+            }
+        }
+
+        // the functions are swapped in as soon as each unit is done, this is
+        // just to report how long the whole thing took.
+        printf("live-compiler: %s (%.1f ms)\n", ok ? "reloaded" : "failed to reload", (cuik_time_in_nanos() - start) / 1000000.0);
+        fflush(stdout);
+
+        // programs which ran to completion just get run again
+        if (ok && !running) {
+            running = live_program_start(&p, args->jit);
+        }
+    }
+
+    cuik_free(changed);
+    tb_jit_end(args->jit);
+    args->jit = NULL;
+    return EXIT_SUCCESS;
 }
 #endif
+
+static int live_main(Cuik_DriverArgs* args, Cuik_IThreadpool* tp) {
+    int count = dyn_array_length(args->sources);
+    const char** sources = cuik_malloc(count * sizeof(const char*));
+    for (int i = 0; i < count; i++) {
+        sources[i] = args->sources[i]->data;
+    }
+
+    LiveCompiler l;
+    if (!live_compile_init(&l, count, sources)) {
+        fprintf(stderr, "live-compiler error: could not watch the source files\n");
+        return EXIT_FAILURE;
+    }
+
+    int status = EXIT_SUCCESS;
+    if (args->run) {
+        #if defined(CUIK_USE_TB) && CUIK_ALLOW_THREADS
+        status = live_main_jit(args, tp, &l);
+        #else
+        fprintf(stderr, "live-compiler error: -r needs the TB backend and threads\n");
+        status = EXIT_FAILURE;
+        #endif
+    } else {
+        // no JIT, just rebuild everything whenever anything changes
+        bool* changed = cuik_malloc(count * sizeof(bool));
+        for (;;) {
+            uint64_t start = cuik_time_in_nanos();
+            bool ok = live_build(args, tp, count, sources);
+
+            printf("live-compiler: %s (%.1f ms)\n", ok ? "built" : "failed to build", (cuik_time_in_nanos() - start) / 1000000.0);
+            fflush(stdout);
+
+            while (!live_compile_watch(&l, changed, -1)) {}
+        }
+        cuik_free(changed);
+    }
+
+    live_compile_free(&l);
+    cuik_free(sources);
+    return status;
+}
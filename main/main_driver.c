@@ -3,6 +3,7 @@
 #include <dyn_array.h>
 
 #include "live.h"
+#include "server.h"
 
 // hacky but i dont care
 #include <file_map.h>
@@ -14,6 +15,7 @@
 
 #include "bindgen.h"
 #include "spall_perf.h"
+#include "stats_perf.h"
 
 #if CUIK_ALLOW_THREADS
 #include <threads.h>
@@ -111,6 +113,10 @@ int main(int argc, const char** argv) {
         #endif
 
         if (strcmp(argv[1], "-bindgen") == 0) return run_bindgen(argc - 2, argv + 2);
+        if (strcmp(argv[1], "-server")  == 0) return run_server(argc - 2, argv + 2);
+
+        // if there's a compile server running, let it do the work
+        if (server_forward(argc - 1, argv + 1, &status)) return status;
     }
 
     log_set_level(LOG_DEBUG);
@@ -177,13 +183,34 @@ int main(int argc, const char** argv) {
         printf("\n");
     }
 
+    if (args.perf_counters || args.hw_counters) {
+        cuikperf_enable_counters(args.hw_counters);
+    }
+
     if (args.time) {
+        // with counters it's a JSON trace (spall reads those too)
+        const char* ext = cuikperf_has_counters() ? "spall.json" : "spall";
         char* perf_output_path = cuik_malloc(FILENAME_MAX);
-        snprintf(perf_output_path, FILENAME_MAX, "%s.spall", args.output_name ? args.output_name : args.sources[0]->data);
+        snprintf(perf_output_path, FILENAME_MAX, "%s.%s", args.output_name ? args.output_name : args.sources[0]->data, ext);
 
         cuikperf_start(perf_output_path, &spall_profiler, false);
         cuik_free(perf_output_path);
+    } else if (args.stats_output) {
+        cuikperf_start(NULL, &stats_profiler, true);
+    }
+
+    #ifdef CUIK_USE_TB
+    if (args.code_cache_path) {
+        args.code_cache = tb_code_cache_open(args.code_cache_path);
+    }
+
+    if (args.profile_use) {
+        args.profile = cuikcg_profile_load(args.profile_use);
+        if (args.profile == NULL) {
+            return EXIT_FAILURE;
+        }
     }
+    #endif
 
     // spin up worker threads
     Cuik_IThreadpool* tp = NULL;
@@ -195,13 +222,25 @@ int main(int argc, const char** argv) {
     }
     #endif
 
+    if (args.live) {
+        status = live_main(&args, tp);
+        goto cleanup;
+    }
+
     // compile source files
     size_t obj_count = dyn_array_length(args.sources);
-    Cuik_BuildStep** objs = cuik_malloc(obj_count * sizeof(Cuik_BuildStep*));
+    Cuik_BuildStep** objs = cuik_malloc((obj_count + 1) * sizeof(Cuik_BuildStep*));
     dyn_array_for(i, args.sources) {
         objs[i] = cuik_driver_cc(&args, args.sources[i]->data);
     }
 
+    #ifdef CUIK_USE_TB
+    // instrumented programs carry the runtime which writes out the counts
+    if (args.profile_generate && cuik_driver_does_codegen(&args)) {
+        objs[obj_count++] = cuik_driver_cc(&args, "$cuik/cuikprof.h");
+    }
+    #endif
+
     // link (if no codegen is performed this doesn't *really* do much)
     Cuik_BuildStep* linked = cuik_driver_ld(&args, obj_count, objs);
     if (!cuik_step_run(linked, tp)) {
@@ -211,11 +250,36 @@ int main(int argc, const char** argv) {
     cuik_step_free(linked);
     cuik_free(objs);
 
+    cleanup:
     #if CUIK_ALLOW_THREADS
     cuik_threadpool_destroy(tp);
     #endif
 
-    if (args.time) cuikperf_stop();
+    #ifdef CUIK_USE_TB
+    if (args.code_cache) {
+        if (args.verbose) {
+            TB_CodeCacheStats s = tb_code_cache_stats(args.code_cache);
+            uint64_t total = s.hits + s.misses + s.uncacheable;
+
+            printf("Code cache: %llu/%llu functions reused (%.1f%%), %llu uncacheable, saved %.3f ms\n",
+                (unsigned long long) s.hits, (unsigned long long) total, total ? (s.hits * 100.0) / total : 0.0,
+                (unsigned long long) s.uncacheable, s.saved_nanos / 1000000.0);
+        }
+
+        tb_code_cache_close(args.code_cache);
+    }
+
+    if (args.profile) {
+        cuikcg_profile_free(args.profile);
+    }
+    #endif
+
+    if (args.time) {
+        cuikperf_stop();
+    } else if (args.stats_output) {
+        cuikperf_stop();
+        if (!stats_write(&args)) status = EXIT_FAILURE;
+    }
     cuik_free_thread_resources();
 
     done:
@@ -0,0 +1,392 @@
+// Compile server, "cuik -server [-j N] [socket]" keeps one process around with
+// the toolchain, thread pool and file cache warmed up. Every other cuik invocation
+// with CUIK_SERVER=<socket> in its environment forwards the command line over the
+// socket and only prints what comes back, requests which the server can't handle
+// (anything that prints to stdout, profiling, JIT) get declined and the client
+// compiles them in process like normal.
+//
+// Protocol (all integers are native endian since it never leaves the machine):
+//   request:  u32 count, count * (u32 length, bytes) where the first string is the
+//             client's working directory and the rest is argv
+//   response: u32 status, u32 length, bytes of diagnostics
+#ifndef _WIN32
+#include <errno.h>
+#include <signal.h>
+#include <threads.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+enum {
+    SERVER_OK,
+    SERVER_FAILED,
+    SERVER_DECLINED,
+};
+
+// we won't take anything bigger than this from a client
+#define SERVER_MAX_STRING (1u << 20)
+#define SERVER_MAX_ARGS   4096
+
+// All the clients share the pool so their build steps end up on the same
+// workers, the pool's queue only expects one producer at a time though.
+typedef struct {
+    Cuik_IThreadpool super;
+    Cuik_IThreadpool* inner;
+    mtx_t lock;
+} ServerPool;
+
+typedef struct {
+    Cuik_Toolchain toolchain;
+    Cuik_Target* target;
+    ServerPool pool;
+    int threads;
+} Server;
+
+typedef struct {
+    Server* server;
+    int fd;
+} ServerClient;
+
+static const char* server_path;
+
+static bool server_read(int fd, void* data, size_t size) {
+    char* p = data;
+    while (size) {
+        ssize_t r = read(fd, p, size);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return false;
+
+        p += r, size -= r;
+    }
+    return true;
+}
+
+static bool server_write(int fd, const void* data, size_t size) {
+    const char* p = data;
+    while (size) {
+        ssize_t r = write(fd, p, size);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return false;
+
+        p += r, size -= r;
+    }
+    return true;
+}
+
+static bool server_write_string(int fd, const char* str) {
+    uint32_t len = strlen(str);
+    return server_write(fd, &len, sizeof(len)) && server_write(fd, str, len);
+}
+
+static bool server_respond(int fd, uint32_t status, size_t diag_len, const char* diag) {
+    uint32_t header[2] = { status, diag_len };
+    return server_write(fd, header, sizeof(header)) && server_write(fd, diag, diag_len);
+}
+
+static void server_pool_submit(void* user_data, Cuik_TaskFn fn, size_t arg_size, void* arg) {
+    ServerPool* p = user_data;
+    mtx_lock(&p->lock);
+    CUIK_CALL(p->inner, submit, fn, arg_size, arg);
+    mtx_unlock(&p->lock);
+}
+
+static void server_pool_work_one_job(void* user_data) {
+    ServerPool* p = user_data;
+    CUIK_CALL(p->inner, work_one_job);
+}
+
+// NULL if the client hung up or sent garbage
+static char** server_read_request(int fd, uint32_t* out_count) {
+    uint32_t count;
+    if (!server_read(fd, &count, sizeof(count)) || count < 1 || count > SERVER_MAX_ARGS) {
+        return NULL;
+    }
+
+    char** strs = cuik_calloc(count, sizeof(char*));
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t len;
+        if (!server_read(fd, &len, sizeof(len)) || len > SERVER_MAX_STRING) goto err;
+
+        strs[i] = cuik_malloc(len + 1);
+        if (!server_read(fd, strs[i], len)) goto err;
+        strs[i][len] = 0;
+    }
+
+    *out_count = count;
+    return strs;
+
+    err:
+    for (uint32_t i = 0; i < count; i++) cuik_free(strs[i]);
+    cuik_free(strs);
+    return NULL;
+}
+
+// anything which writes to stdout or touches the global profiler isn't something
+// we can multiplex between clients.
+static bool server_can_handle(const Cuik_DriverArgs* args) {
+    return cuik_driver_does_codegen(args) && !args->assembly && !args->run && !args->live
+        && !args->time && !args->stats_output && !args->think && !args->verbose
+        #ifdef CUIK_USE_TB
+        && !args->profile_generate && !args->profile_use
+        #endif
+        && dyn_array_length(args->sources) > 0;
+}
+
+static uint32_t server_compile(Server* server, Cuik_DriverArgs* args, const char* cwd) {
+    // the default executable name is relative to the working directory
+    #ifdef CUIK_USE_TB
+    if (args->output_name == NULL && args->flavor != TB_FLAVOR_OBJECT) {
+        const char* name = cuik_get_target_system(args->target) == CUIK_SYSTEM_WINDOWS ? "a.exe" : "a.out";
+
+        size_t len = strlen(cwd) + strlen(name) + 2;
+        char* path = cuik_malloc(len);
+        snprintf(path, len, "%s/%s", cwd, name);
+        args->output_name = path;
+    }
+    #endif
+
+    #ifdef CUIK_USE_TB
+    if (args->code_cache_path) {
+        args->code_cache = tb_code_cache_open(args->code_cache_path);
+    }
+    #endif
+
+    size_t obj_count = dyn_array_length(args->sources);
+    Cuik_BuildStep** objs = cuik_malloc(obj_count * sizeof(Cuik_BuildStep*));
+    dyn_array_for(i, args->sources) {
+        objs[i] = cuik_driver_cc(args, args->sources[i]->data);
+    }
+
+    Cuik_BuildStep* linked = cuik_driver_ld(args, obj_count, objs);
+    bool success = cuik_step_run(linked, server->pool.inner ? &server->pool.super : NULL);
+
+    cuik_step_free(linked);
+    cuik_free(objs);
+
+    #ifdef CUIK_USE_TB
+    if (args->code_cache) {
+        tb_code_cache_close(args->code_cache);
+    }
+    #endif
+    return success ? SERVER_OK : SERVER_FAILED;
+}
+
+static int server_client(void* arg) {
+    ServerClient client = *(ServerClient*) arg;
+    Server* server = client.server;
+    cuik_free(arg);
+
+    uint32_t count;
+    char** strs = server_read_request(client.fd, &count);
+    if (strs == NULL) {
+        close(client.fd);
+        return 0;
+    }
+
+    const char* cwd = strs[0];
+    Cuik_DriverArgs args = {
+        .version   = CUIK_VERSION_C23,
+        .toolchain = server->toolchain,
+        .threads   = server->threads,
+
+        #ifdef CUIK_USE_TB
+        .flavor    = TB_FLAVOR_EXECUTABLE,
+        #endif
+    };
+
+    Cuik_Arguments* parsed = cuik_alloc_args();
+    cuik_parse_args(parsed, count - 1, (const char**) &strs[1]);
+    cuik_args_rebase(parsed, cwd);
+
+    char* diag = NULL;
+    size_t diag_len = 0;
+    uint32_t status = SERVER_DECLINED;
+    if (cuik_args_to_driver(&args, parsed) && server_can_handle(&args)) {
+        // -j is up to the server, the pool is shared
+        args.threads = server->threads;
+        if (args.target == NULL) {
+            args.target = server->target;
+        }
+
+        args.diag_file = open_memstream(&diag, &diag_len);
+        status = server_compile(server, &args, cwd);
+        fclose(args.diag_file);
+    }
+
+    if (!server_respond(client.fd, status, diag_len, diag)) {
+        log_warn("compile server: lost client before it could get a response");
+    }
+    close(client.fd);
+    free(diag);
+
+    // -target brings its own target & toolchain
+    if (args.target != NULL && args.target != server->target) {
+        cuik_free_target(args.target);
+    }
+    if (args.toolchain.ctx != server->toolchain.ctx) {
+        cuik_toolchain_free(&args.toolchain);
+    }
+
+    cuik_free((char*) args.output_name);
+    cuik_free((char*) args.stats_output);
+    #ifdef CUIK_USE_TB
+    cuik_free((char*) args.code_cache_path);
+    #endif
+    cuik_free_args(parsed);
+    cuik_free_driver_args(&args);
+    for (uint32_t i = 0; i < count; i++) cuik_free(strs[i]);
+    cuik_free(strs);
+
+    cuik_free_thread_resources();
+    return 0;
+}
+
+static void server_shutdown(int sig) {
+    unlink(server_path);
+    _exit(0);
+}
+
+static int run_server(int argc, const char** argv) {
+    int threads = 1;
+    const char* path = getenv("CUIK_SERVER");
+    for (int i = 0; i < argc; i++) {
+        if (strncmp(argv[i], "-j", 2) == 0) {
+            threads = atoi(argv[i][2] ? &argv[i][2] : (i + 1 < argc ? argv[++i] : "1"));
+        } else {
+            path = argv[i];
+        }
+    }
+
+    if (path == NULL) {
+        fprintf(stderr, "usage: cuik -server [-j N] <socket path>\n");
+        return EXIT_FAILURE;
+    }
+
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "error: socket path is too long: %s\n", path);
+        return EXIT_FAILURE;
+    }
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(path);
+    if (fd < 0 || bind(fd, (struct sockaddr*) &addr, sizeof(addr)) < 0 || listen(fd, 64) < 0) {
+        fprintf(stderr, "error: could not listen on %s: %s\n", path, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    server_path = path;
+    signal(SIGINT, server_shutdown);
+    signal(SIGTERM, server_shutdown);
+    signal(SIGPIPE, SIG_IGN);
+
+    // the stuff every cuik invocation pays for, we only do it once here
+    Server server = { .threads = threads };
+    server.toolchain = cuik_toolchain_host();
+    server.toolchain.ctx = server.toolchain.init();
+    server.target = cuik_target_host();
+    cuikpp_enable_file_cache();
+
+    #if CUIK_ALLOW_THREADS
+    if (threads > 1) {
+        server.pool.super = (Cuik_IThreadpool){ server_pool_submit, server_pool_work_one_job };
+        server.pool.inner = cuik_threadpool_create(threads);
+        mtx_init(&server.pool.lock, mtx_plain);
+    }
+    #endif
+
+    printf("cuik server listening on %s (%d threads)\n", path, threads);
+    fflush(stdout);
+
+    for (;;) {
+        int client_fd = accept(fd, NULL, NULL);
+        if (client_fd < 0) {
+            if (errno == EINTR) continue;
+
+            fprintf(stderr, "error: accept failed: %s\n", strerror(errno));
+            break;
+        }
+
+        ServerClient* client = cuik_malloc(sizeof(ServerClient));
+        *client = (ServerClient){ &server, client_fd };
+
+        thrd_t t;
+        if (thrd_create(&t, server_client, client) != thrd_success) {
+            close(client_fd);
+            cuik_free(client);
+            continue;
+        }
+        thrd_detach(t);
+    }
+
+    close(fd);
+    unlink(path);
+    return EXIT_FAILURE;
+}
+
+// returns true if the server took care of the request, out_status is the exit code
+static bool server_forward(int argc, const char** argv, int* out_status) {
+    const char* path = getenv("CUIK_SERVER");
+    if (path == NULL) {
+        return false;
+    }
+
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        return false;
+    }
+    strcpy(addr.sun_path, path);
+
+    char cwd[FILENAME_MAX];
+    if (getcwd(cwd, sizeof(cwd)) == NULL) {
+        return false;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return false;
+    }
+
+    // no server? just compile it ourselves
+    if (connect(fd, (struct sockaddr*) &addr, sizeof(addr)) < 0) {
+        close(fd);
+        return false;
+    }
+
+    uint32_t count = argc + 1;
+    bool ok = server_write(fd, &count, sizeof(count)) && server_write_string(fd, cwd);
+    for (int i = 0; ok && i < argc; i++) {
+        ok = server_write_string(fd, argv[i]);
+    }
+
+    uint32_t header[2];
+    if (!ok || !server_read(fd, header, sizeof(header)) || header[0] == SERVER_DECLINED) {
+        close(fd);
+        return false;
+    }
+
+    // stream the diagnostics out
+    char buffer[4096];
+    for (size_t left = header[1]; left > 0;) {
+        size_t chunk = left < sizeof(buffer) ? left : sizeof(buffer);
+        if (!server_read(fd, buffer, chunk)) break;
+
+        fwrite(buffer, chunk, 1, stderr);
+        left -= chunk;
+    }
+
+    close(fd);
+    *out_status = header[0] == SERVER_OK ? EXIT_SUCCESS : EXIT_FAILURE;
+    return true;
+}
+#else
+static int run_server(int argc, const char** argv) {
+    fprintf(stderr, "error: the compile server needs unix domain sockets\n");
+    return EXIT_FAILURE;
+}
+
+static bool server_forward(int argc, const char** argv, int* out_status) {
+    return false;
+}
+#endif
@@ -47,7 +47,12 @@ void spallperf__stop_thread(void) {
 
 static void spallperf__start(void* user_data) {
     #ifndef CUIK_USE_SPALL_AUTO
-    ctx = spall_init_file((char*) user_data, 1.0 / 1000.0);
+    // counter tracks only exist in the JSON flavor of the trace
+    if (cuikperf_has_counters()) {
+        ctx = spall_init_file_json((char*) user_data, 1.0 / 1000.0);
+    } else {
+        ctx = spall_init_file((char*) user_data, 1.0 / 1000.0);
+    }
     spallperf__start_thread();
     #endif
 }
@@ -55,10 +60,60 @@ static void spallperf__start(void* user_data) {
 static void spallperf__stop(void* user_data) {
     #ifndef CUIK_USE_SPALL_AUTO
     spallperf__stop_thread();
+    if (ctx.is_json) {
+        // spall opens the file in append mode so the seek it does to drop the
+        // trailing comma doesn't do anything, we just end on an entry without one.
+        static const char last[] = "{\"ph\":\"M\",\"pid\":0,\"name\":\"process_name\",\"args\":{\"name\":\"cuik\"}}";
+        ctx.write(&ctx, last, sizeof(last) - 1);
+    }
     spall_quit(&ctx);
     #endif
 }
 
+#ifndef CUIK_USE_SPALL_AUTO
+// counters get sampled at region boundaries but no more than once every 100us
+// per thread, the hardware ones are turned into rates over the last sample.
+static _Thread_local uint64_t spall_last_sample;
+static _Thread_local Cuik_PerfCounters spall_last_counters;
+
+static void spallperf__counter(uint32_t tid, uint64_t nanos, const char* name, bool per_thread, double value) {
+    char buf[256];
+    int len = snprintf(buf, sizeof(buf), "{\"ph\":\"C\",\"ts\":%f,\"pid\":0,\"tid\":%u,\"name\":\"%s", nanos * ctx.timestamp_unit, tid, name);
+    if (per_thread) {
+        len += snprintf(buf + len, sizeof(buf) - len, " (%u)", tid);
+    }
+    len += snprintf(buf + len, sizeof(buf) - len, "\",\"args\":{\"value\":%f}},\n", value);
+    spall__buffer_write(&ctx, &muh_buffer, buf, len);
+}
+
+static void spallperf__sample_counters(uint32_t tid, uint64_t nanos) {
+    if (!cuikperf_has_counters() || nanos - spall_last_sample < 100000) {
+        return;
+    }
+
+    Cuik_PerfCounters c;
+    cuikperf_read_counters(&c);
+
+    spallperf__counter(tid, nanos, "arena MiB", true, c.v[CUIKPERF_ARENA_BYTES] / 1048576.0);
+    spallperf__counter(tid, nanos, "valloc MiB", true, c.v[CUIKPERF_VALLOC_BYTES] / 1048576.0);
+    spallperf__counter(tid, nanos, "peak RSS MiB", false, c.v[CUIKPERF_PEAK_RSS_KB] / 1024.0);
+
+    uint64_t* last = spall_last_counters.v;
+    uint64_t insts = c.v[CUIKPERF_INSTRUCTIONS] - last[CUIKPERF_INSTRUCTIONS];
+    uint64_t cycles = c.v[CUIKPERF_CYCLES] - last[CUIKPERF_CYCLES];
+    if (insts > 0 && cycles > 0 && spall_last_sample != 0) {
+        double kinsts = insts / 1000.0;
+        spallperf__counter(tid, nanos, "IPC", true, (double) insts / (double) cycles);
+        spallperf__counter(tid, nanos, "L1D MPKI", true, (c.v[CUIKPERF_L1D_MISSES] - last[CUIKPERF_L1D_MISSES]) / kinsts);
+        spallperf__counter(tid, nanos, "LLC MPKI", true, (c.v[CUIKPERF_LLC_MISSES] - last[CUIKPERF_LLC_MISSES]) / kinsts);
+        spallperf__counter(tid, nanos, "branch MPKI", true, (c.v[CUIKPERF_BRANCH_MISSES] - last[CUIKPERF_BRANCH_MISSES]) / kinsts);
+    }
+
+    spall_last_sample = nanos;
+    spall_last_counters = c;
+}
+#endif
+
 static void spallperf__begin_plot(void* user_data, uint64_t nanos, const char* label, const char* extra) {
     #ifndef CUIK_USE_SPALL_AUTO
     #if _WIN32
@@ -67,6 +122,7 @@ static void spallperf__begin_plot(void* user_data, uint64_t nanos, const char* l
     uint32_t tid = pthread_self();
     #endif
 
+    spallperf__sample_counters(tid, nanos);
     spall_buffer_begin_args(&ctx, &muh_buffer, label, strlen(label), extra, strlen(extra), nanos, tid, 0);
     #endif
 }
@@ -80,6 +136,7 @@ static void spallperf__end_plot(void* user_data, uint64_t nanos) {
     #endif
 
     spall_buffer_end_ex(&ctx, &muh_buffer, nanos, tid, 0);
+    spallperf__sample_counters(tid, nanos);
     #endif
 }
 
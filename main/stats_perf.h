@@ -0,0 +1,167 @@
+// Aggregating profiler for -Tstats, instead of recording every region like spall
+// it sums up the time spent per CUIK_TIMED_BLOCK label and dumps it as JSON along
+// with the peak memory usage once the compile is done.
+#include <stdio.h>
+#include <string.h>
+
+#define STATS_MAX_PHASES 256
+#define STATS_MAX_DEPTH  64
+
+typedef struct {
+    char* label;
+    uint64_t total, count;
+
+    // -Tcounters, summed up deltas (peak RSS is how much it grew)
+    uint64_t counters[CUIKPERF_COUNTER_COUNT];
+} StatsPhase;
+
+typedef struct {
+    const char* label;
+    uint64_t start;
+    Cuik_PerfCounters counters;
+} StatsFrame;
+
+// cuikperf serializes the callbacks for us (lock_on_plot) so only
+// the region stacks need to be per thread.
+static size_t stats_phase_count;
+static StatsPhase stats_phases[STATS_MAX_PHASES];
+
+static _Thread_local int stats_depth;
+static _Thread_local StatsFrame stats_stack[STATS_MAX_DEPTH];
+
+static void statsperf__start(void* user_data) {
+    stats_phase_count = 0;
+}
+
+static void statsperf__stop(void* user_data) {
+}
+
+static void statsperf__begin_plot(void* user_data, uint64_t nanos, const char* label, const char* extra) {
+    if (stats_depth < STATS_MAX_DEPTH) {
+        StatsFrame* f = &stats_stack[stats_depth];
+        f->label = label;
+        f->start = nanos;
+        if (cuikperf_has_counters()) {
+            cuikperf_read_counters(&f->counters);
+        }
+    }
+    stats_depth++;
+}
+
+static void statsperf__end_plot(void* user_data, uint64_t nanos) {
+    if (stats_depth == 0 || --stats_depth >= STATS_MAX_DEPTH) {
+        return;
+    }
+
+    // recursive regions (nested #includes) are only counted at the outermost
+    // level so the inclusive times don't end up bigger than the wall time.
+    StatsFrame* f = &stats_stack[stats_depth];
+    for (int j = 0; j < stats_depth; j++) {
+        if (strcmp(stats_stack[j].label, f->label) == 0) return;
+    }
+
+    size_t i = 0;
+    for (; i < stats_phase_count; i++) {
+        if (strcmp(stats_phases[i].label, f->label) == 0) break;
+    }
+
+    if (i == stats_phase_count) {
+        if (stats_phase_count == STATS_MAX_PHASES) return;
+
+        // labels aren't always string literals
+        stats_phases[stats_phase_count++] = (StatsPhase){ cuik_strdup(f->label) };
+    }
+
+    stats_phases[i].total += nanos - f->start;
+    stats_phases[i].count += 1;
+
+    if (cuikperf_has_counters()) {
+        Cuik_PerfCounters end;
+        cuikperf_read_counters(&end);
+        for (int j = 0; j < CUIKPERF_COUNTER_COUNT; j++) {
+            stats_phases[i].counters[j] += end.v[j] - f->counters.v[j];
+        }
+    }
+}
+
+static Cuik_IProfiler stats_profiler = {
+    .start      = statsperf__start,
+    .stop       = statsperf__stop,
+    .begin_plot = statsperf__begin_plot,
+    .end_plot   = statsperf__end_plot,
+};
+
+static void stats_write_string(FILE* out, const char* str) {
+    fputc('"', out);
+    for (; *str; str++) {
+        if (*str == '"' || *str == '\\') {
+            fprintf(out, "\\%c", *str);
+        } else if ((unsigned char) *str < 0x20) {
+            fprintf(out, "\\u%04x", *str);
+        } else {
+            fputc(*str, out);
+        }
+    }
+    fputc('"', out);
+}
+
+static void stats_write_counters(FILE* out, const uint64_t* c, bool hw) {
+    int count = hw ? CUIKPERF_COUNTER_COUNT : CUIKPERF_INSTRUCTIONS;
+    for (int i = 0; i < count; i++) {
+        fprintf(out, ", \"%s\": %llu", cuikperf_counter_names[i], (unsigned long long) c[i]);
+    }
+
+    // the ratios are what tell memory-bound phases apart from compute-bound ones
+    if (hw && c[CUIKPERF_CYCLES] > 0 && c[CUIKPERF_INSTRUCTIONS] > 0) {
+        double kinsts = c[CUIKPERF_INSTRUCTIONS] / 1000.0;
+        fprintf(out, ", \"ipc\": %.3f", (double) c[CUIKPERF_INSTRUCTIONS] / (double) c[CUIKPERF_CYCLES]);
+        fprintf(out, ", \"l1d_mpki\": %.3f", c[CUIKPERF_L1D_MISSES] / kinsts);
+        fprintf(out, ", \"llc_mpki\": %.3f", c[CUIKPERF_LLC_MISSES] / kinsts);
+        fprintf(out, ", \"branch_mpki\": %.3f", c[CUIKPERF_BRANCH_MISSES] / kinsts);
+    }
+}
+
+static bool stats_write(const Cuik_DriverArgs* args) {
+    FILE* out = fopen(args->stats_output, "wb");
+    if (out == NULL) {
+        fprintf(stderr, "error: could not open %s for writing\n", args->stats_output);
+        return false;
+    }
+
+    // the root region opened by cuikperf_start covers the whole compile
+    uint64_t wall = 0;
+    for (size_t i = 0; i < stats_phase_count; i++) {
+        if (strcmp(stats_phases[i].label, "main thread") == 0) {
+            wall = stats_phases[i].total;
+        }
+    }
+
+    double wall_sec = wall / 1000000000.0;
+    fprintf(out, "{\n");
+    fprintf(out, "  \"source\": ");
+    stats_write_string(out, dyn_array_length(args->sources) ? args->sources[0]->data : "");
+    fprintf(out, ",\n");
+    fprintf(out, "  \"opt_level\": %d,\n", args->opt_level);
+    fprintf(out, "  \"threads\": %d,\n", args->threads);
+    fprintf(out, "  \"wall_ms\": %.3f,\n", wall / 1000000.0);
+    fprintf(out, "  \"peak_rss_kb\": %llu,\n", (unsigned long long) cuikperf_peak_rss_kb());
+    fprintf(out, "  \"lines\": %llu,\n", (unsigned long long) args->lines_processed);
+    fprintf(out, "  \"lines_per_sec\": %.1f,\n", wall_sec > 0.0 ? args->lines_processed / wall_sec : 0.0);
+    fprintf(out, "  \"phases\": {");
+    for (size_t i = 0; i < stats_phase_count; i++) {
+        fprintf(out, i ? ",\n    " : "\n    ");
+        stats_write_string(out, stats_phases[i].label);
+        fprintf(out, ": { \"ms\": %.3f, \"count\": %llu", stats_phases[i].total / 1000000.0, (unsigned long long) stats_phases[i].count);
+        if (cuikperf_has_counters()) {
+            stats_write_counters(out, stats_phases[i].counters, args->hw_counters);
+        }
+        fprintf(out, " }");
+
+        cuik_free(stats_phases[i].label);
+    }
+    fprintf(out, "\n  }\n}\n");
+    fclose(out);
+
+    stats_phase_count = 0;
+    return true;
+}
@@ -570,6 +570,10 @@ typedef struct { // any integer binary operator
 
 typedef struct {
     TB_CharUnits align;
+
+    // type-based aliasing, accesses with different non-zero
+    // classes never overlap (see tb_inst_set_alias_class).
+    int alias_class;
 } TB_NodeMemAccess;
 
 typedef struct {
@@ -640,6 +644,9 @@ typedef struct {
     // magic factor for hot-code, higher means run more often
     float freq;
 
+    // profile counter slot (see tb_function_instrument), IR building only.
+    uint32_t prof_id;
+
     // used for IR building only, stale after that.
     TB_Node *mem_in, *mem_out;
 } TB_NodeRegion;
@@ -681,10 +688,17 @@ typedef struct {
     void* userdata;
 
     uint32_t ip;    // relative to the function body.
-    uint32_t count; // same as node->input_count
+    uint32_t count; // number of data inputs on the safepoint
     int32_t values[];
 } TB_Safepoint;
 
+// each safepoint value describes where the data input lives at that IP:
+//   register:   (reg << 1),          GPRs come first then XMMs (16 + xmm)
+//   stack slot: (offset << 1) | 1,   offset is relative to the frame pointer
+#define TB_SAFEPOINT_IS_SLOT(v) ((v) & 1)
+#define TB_SAFEPOINT_REG(v)     ((v) >> 1)
+#define TB_SAFEPOINT_OFFSET(v)  ((v) >> 1)
+
 typedef enum {
     TB_MODULE_SECTION_WRITE = 1,
     TB_MODULE_SECTION_EXEC  = 2,
@@ -772,6 +786,9 @@ typedef struct {
 TB_SymbolIter tb_symbol_iter(TB_Module* mod);
 TB_Symbol* tb_symbol_iter_next(TB_SymbolIter* iter);
 
+// removes the symbol from the module, it won't be iterated or exported anymore
+TB_API void tb_module_kill_symbol(TB_Module* m, TB_Symbol* sym);
+
 ////////////////////////////////
 // Compiled code introspection
 ////////////////////////////////
@@ -799,7 +816,9 @@ TB_API TB_Location* tb_output_get_locations(TB_FunctionOutput* out, size_t* out_
 // returns NULL if no assembly was generated
 TB_API TB_Assembly* tb_output_get_asm(TB_FunctionOutput* out);
 
-// this is relative to the start of the function (the start of the prologue)
+// this is relative to the start of the function (the start of the prologue), on
+// x64 the IP of a poll site is the faulting instruction. Returns NULL if there's
+// no safepoint at that exact IP.
 TB_API TB_Safepoint* tb_safepoint_get(TB_Function* f, uint32_t relative_ip);
 
 ////////////////////////////////
@@ -810,11 +829,25 @@ typedef struct TB_CPUContext TB_CPUContext;
 
 // passing 0 to jit_heap_capacity will default to 4MiB
 TB_API TB_JIT* tb_jit_begin(TB_Module* m, size_t jit_heap_capacity);
+// returns the function's entry trampoline, every call (and function pointer)
+// goes through one of these so they follow tb_jit_place_module swaps.
 TB_API void* tb_jit_place_function(TB_JIT* jit, TB_Function* f);
 TB_API void* tb_jit_place_global(TB_JIT* jit, TB_Global* g);
 TB_API void tb_jit_dump_heap(TB_JIT* jit);
 TB_API void tb_jit_end(TB_JIT* jit);
 
+// Places every function of m (the JIT takes ownership of it), private symbols are
+// scoped to the unit name. If the unit was placed before, this is a hot-swap: functions
+// which didn't change keep their code, the rest get a new body and their trampolines
+// are repointed (atomically, it's fine for other threads to be running the old ones).
+// Named globals keep their storage & contents. Returns how many functions got swapped.
+//
+// Symbols can be referenced before any unit defines them, tb_jit_unresolved
+// returns the name of one that's still missing (or NULL).
+TB_API int tb_jit_place_module(TB_JIT* jit, TB_Module* m, const char* unit);
+TB_API void* tb_jit_get_entry(TB_JIT* jit, const char* name);
+TB_API const char* tb_jit_unresolved(TB_JIT* jit);
+
 typedef struct {
     TB_Symbol* base;
     uint32_t offset;
@@ -878,6 +911,17 @@ TB_API TB_ExportBuffer tb_module_object_export(TB_Module* m, TB_DebugFormat debu
 TB_API bool tb_export_buffer_to_file(TB_ExportBuffer buffer, const char* path);
 TB_API void tb_export_buffer_free(TB_ExportBuffer buffer);
 
+////////////////////////////////
+// Module images
+////////////////////////////////
+// A flat binary copy of the module's IR, it has to be made before any function is
+// compiled and loading it gives back a module which is ready for the passes. The image
+// stays mapped until the module is destroyed so names & global contents aren't copied.
+TB_API TB_ExportBuffer tb_module_serialize(TB_Module* m);
+
+// NULL if the image came from a different build of TB or a different target
+TB_API TB_Module* tb_module_deserialize(const char* path, TB_Arch arch, TB_System sys, bool is_jit);
+
 ////////////////////////////////
 // Linker exporter
 ////////////////////////////////
@@ -1080,6 +1124,19 @@ TB_API const char* tb_symbol_get_name(TB_Symbol* s);
 TB_API void tb_function_set_prototype(TB_Function* f, TB_ModuleSectionHandle section, TB_FunctionPrototype* p, TB_Arena* arena);
 TB_API TB_FunctionPrototype* tb_function_get_prototype(TB_Function* f);
 
+// Profile-guided optimization, regions get numbered in the order they're built (slot
+// 0 is the function entry) so both of these must be called right after the prototype.
+//
+// tb_function_instrument makes entering each region bump a 64bit counter in the
+// counters symbol, once the body is built tb_function_get_counter_count says how
+// many slots it needs.
+TB_API void tb_function_instrument(TB_Function* f, TB_Symbol* counters);
+TB_API size_t tb_function_get_counter_count(TB_Function* f);
+
+// tb_function_set_profile takes the counts from an instrumented build of the same
+// function and turns them into region frequencies. counts must outlive the IR building.
+TB_API void tb_function_set_profile(TB_Function* f, size_t count, const uint64_t* counts);
+
 TB_API void tb_inst_set_control(TB_Function* f, TB_Node* control);
 TB_API TB_Node* tb_inst_get_control(TB_Function* f);
 
@@ -1088,6 +1145,10 @@ TB_API TB_Node* tb_inst_region(TB_Function* f);
 // if len is -1, it's null terminated
 TB_API void tb_inst_set_region_name(TB_Function* f, TB_Node* n, ptrdiff_t len, const char* name);
 
+// hints how often the region runs relative to the function entry (0 being basically
+// never), it's ignored if the function has a profile.
+TB_API void tb_inst_set_region_freq(TB_Function* f, TB_Node* n, float freq);
+
 TB_API void tb_inst_unreachable(TB_Function* f);
 TB_API void tb_inst_debugbreak(TB_Function* f);
 TB_API void tb_inst_trap(TB_Function* f);
@@ -1110,6 +1171,11 @@ TB_API TB_Node* tb_inst_local(TB_Function* f, TB_CharUnits size, TB_CharUnits al
 TB_API TB_Node* tb_inst_load(TB_Function* f, TB_DataType dt, TB_Node* addr, TB_CharUnits align, bool is_volatile);
 TB_API void tb_inst_store(TB_Function* f, TB_DataType dt, TB_Node* addr, TB_Node* val, TB_CharUnits align, bool is_volatile);
 
+// loads and stores made after this get tagged with the alias class, the optimizer
+// assumes accesses with different non-zero classes don't overlap (think C's strict
+// aliasing). 0 is the default and it can alias anything.
+TB_API void tb_inst_set_alias_class(TB_Function* f, int alias_class);
+
 TB_API void tb_inst_safepoint_poll(TB_Function* f, TB_Node* addr, int input_count, TB_Node** inputs);
 
 TB_API TB_Node* tb_inst_bool(TB_Function* f, bool imm);
@@ -1264,6 +1330,13 @@ typedef struct TB_Passes TB_Passes;
 TB_API TB_Passes* tb_pass_enter(TB_Function* f, TB_Arena* arena);
 TB_API void tb_pass_exit(TB_Passes* opt);
 
+// whole program optimizations, this has to run once all the IR is built and
+// before any function enters the passes. public symbols not named in roots are
+// made private (NULL roots leaves linkage alone, good for objects & libraries),
+// constants and integer ranges get propagated into params, hot call sites with
+// constant arguments call specialized clones and unreachable symbols are removed.
+TB_API void tb_module_ipo(TB_Module* m, size_t root_count, const char** roots);
+
 // transformation passes:
 //   peephole: 99% of the optimizer, i'm sea of nodes pilled so i
 //     break down most optimizations into local rewrites, it's
@@ -1276,10 +1349,14 @@ TB_API void tb_pass_exit(TB_Passes* opt);
 //
 //   SROA: splits LOCALs into multiple to allow for more dataflow
 //     analysis later on.
+//
+//   tail recursion: self tail calls become a loop back to the entry, it
+//     walks the terminator list so it has to run before anything else.
 TB_API void tb_pass_peephole(TB_Passes* opt, TB_PeepholeFlags flags);
 TB_API void tb_pass_sroa(TB_Passes* opt);
 TB_API bool tb_pass_mem2reg(TB_Passes* opt);
 TB_API bool tb_pass_loop(TB_Passes* opt);
+TB_API bool tb_pass_tail_recursion(TB_Passes* opt);
 
 // this just runs the optimizer in the default configuration
 TB_API void tb_pass_optimize(TB_Passes* opt);
@@ -1293,6 +1370,33 @@ TB_API void tb_pass_print_dot(TB_Passes* opt, TB_PrintCallback callback, void* u
 // codegen
 TB_API TB_FunctionOutput* tb_pass_codegen(TB_Passes* opt, bool emit_asm);
 
+////////////////////////////////
+// Code cache
+////////////////////////////////
+// on disk store of compiled functions keyed by a hash of the IR, prototype, target
+// and the salt (whatever else changes the output, like the opt level). it's safe
+// to share between threads and between processes.
+typedef struct TB_CodeCache TB_CodeCache;
+
+typedef struct {
+    uint64_t hits, misses, uncacheable;
+
+    // roughly how long the hits took to compile the first time around
+    uint64_t saved_nanos;
+} TB_CodeCacheStats;
+
+// it's fine if the file doesn't exist yet, closing writes out the new entries.
+TB_API TB_CodeCache* tb_code_cache_open(const char* path);
+TB_API void tb_code_cache_close(TB_CodeCache* cache);
+TB_API TB_CodeCacheStats tb_code_cache_stats(TB_CodeCache* cache);
+
+// call before tb_pass_enter, returns true if the function's output was filled in
+// from the cache (the IR is consumed and it shouldn't go through the passes).
+TB_API bool tb_code_cache_lookup(TB_CodeCache* cache, TB_Function* f, uint64_t salt);
+
+// call after tb_pass_codegen on a function which missed
+TB_API void tb_code_cache_insert(TB_CodeCache* cache, TB_Function* f);
+
 TB_API void tb_pass_kill_node(TB_Passes* opt, TB_Node* n);
 TB_API void tb_pass_mark(TB_Passes* opt, TB_Node* n);
 TB_API void tb_pass_mark_users(TB_Passes* opt, TB_Node* n);
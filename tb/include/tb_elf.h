@@ -79,6 +79,7 @@ typedef enum {
     TB_ELF_X86_64_GOT32    = 3,
     TB_ELF_X86_64_PLT32    = 4,
     TB_ELF_X86_64_GOTPCREL = 9,
+    TB_ELF_X86_64_32       = 10,
 } TB_ELF_RelocType;
 
 // ST_TYPE
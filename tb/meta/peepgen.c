@@ -0,0 +1,583 @@
+// Peephole rule compiler, this takes the rules in tb/src/opt/peeps.rules and
+// builds a decision tree matcher out of them (tb/src/opt/peeps.h) which the
+// optimizer calls before the hand-written idealizations.
+//
+//   (add (add x C1) C2) => (add x [C1 + C2])
+//
+// lowercase names match any node (using a name twice means it's the same node),
+// uppercase names match any integer constant and bind its value, numbers match
+// a specific constant and [...] is a C expression over the bound constants. The
+// optional `if [...]` at the end of a rule is the guard, n is the root node.
+//
+// Rules are tried in the order they're written, the generated code switches on
+// node types first (shared between any rules which agree on them) and then does
+// the rest of the checks one rule at a time.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <ctype.h>
+
+#define MAX_RULES 256
+#define MAX_PATS  2048
+#define MAX_TESTS 32
+
+typedef enum {
+    PAT_OP,    // (name kids...)
+    PAT_VAR,   // x
+    PAT_CONST, // C
+    PAT_INT,   // 123
+    PAT_EXPR,  // [C expr], only as a replacement
+} PatKind;
+
+typedef struct Pat Pat;
+struct Pat {
+    PatKind kind;
+    char name[32];
+    char* expr;
+
+    int kid_count;
+    Pat* kids[4];
+};
+
+// TYPE tests are the ones which go into the decision tree, the rest are done
+// once all the node types of the rule are known.
+typedef enum { TEST_TYPE, TEST_VALUE, TEST_SAME } TestKind;
+typedef struct {
+    TestKind kind;
+    char path[128];
+    char value[64];
+} Test;
+
+typedef struct {
+    int line;
+    char* text;
+
+    Pat* lhs;
+    Pat* rhs;
+    char* guard;
+
+    int test_count;
+    Test tests[MAX_TESTS];
+
+    // bindings in the order they were first seen
+    int bind_count;
+    struct { char name[32]; char path[128]; bool is_const; } binds[MAX_TESTS];
+} Rule;
+
+static Pat pats[MAX_PATS];
+static int pat_count;
+
+static Rule rules[MAX_RULES];
+static int rule_count;
+
+static const char* src_path;
+static char* src;
+static int line = 1;
+
+static void error(const char* msg) {
+    fprintf(stderr, "%s:%d: error: %s\n", src_path, line, msg);
+    exit(1);
+}
+
+////////////////////////////////
+// Parsing
+////////////////////////////////
+static void skip_space(void) {
+    for (;;) {
+        if (*src == '\n') {
+            line++, src++;
+        } else if (isspace(*src)) {
+            src++;
+        } else if (*src == '#') {
+            while (*src && *src != '\n') src++;
+        } else {
+            break;
+        }
+    }
+}
+
+static char* parse_expr(void) {
+    // [ ... ] with nesting, we don't care what's inside
+    const char* start = ++src;
+    int depth = 1;
+    while (*src && depth) {
+        if (*src == '[') depth++;
+        if (*src == ']') depth--;
+        if (*src == '\n') line++;
+        src++;
+    }
+
+    if (depth) error("unterminated [");
+    size_t len = (src - 1) - start;
+    char* s = malloc(len + 1);
+    memcpy(s, start, len);
+    s[len] = 0;
+    return s;
+}
+
+static void parse_name(char* out) {
+    int i = 0;
+    while (isalnum(*src) || *src == '_') {
+        if (i >= 31) error("name too long");
+        out[i++] = *src++;
+    }
+    out[i] = 0;
+}
+
+static Pat* parse_pat(void) {
+    skip_space();
+    if (pat_count >= MAX_PATS) error("too many patterns");
+
+    Pat* p = &pats[pat_count++];
+    if (*src == '(') {
+        src++, skip_space();
+
+        p->kind = PAT_OP;
+        parse_name(p->name);
+        if (p->name[0] == 0) error("expected op name");
+
+        for (;;) {
+            skip_space();
+            if (*src == ')') break;
+            if (*src == 0) error("unterminated (");
+            if (p->kid_count >= 4) error("too many inputs");
+            p->kids[p->kid_count++] = parse_pat();
+        }
+        src++;
+    } else if (*src == '[') {
+        p->kind = PAT_EXPR;
+        p->expr = parse_expr();
+    } else if (isdigit(*src) || *src == '-') {
+        const char* start = src++;
+        while (isalnum(*src)) src++;
+
+        p->kind = PAT_INT;
+        snprintf(p->name, sizeof(p->name), "%.*s", (int) (src - start), start);
+    } else if (isalpha(*src)) {
+        parse_name(p->name);
+        p->kind = isupper(p->name[0]) ? PAT_CONST : PAT_VAR;
+    } else {
+        error("expected pattern");
+    }
+
+    return p;
+}
+
+static void parse_rules(void) {
+    for (;;) {
+        skip_space();
+        if (*src == 0) break;
+        if (rule_count >= MAX_RULES) error("too many rules");
+
+        Rule* r = &rules[rule_count++];
+        r->line = line;
+
+        const char* start = src;
+        r->lhs = parse_pat();
+        if (r->lhs->kind != PAT_OP) error("rules must match on an op");
+
+        skip_space();
+        if (src[0] != '=' || src[1] != '>') error("expected =>");
+        src += 2;
+
+        r->rhs = parse_pat();
+
+        // optional guard, it has to be on the same line
+        while (*src == ' ' || *src == '\t') src++;
+        if (src[0] == 'i' && src[1] == 'f' && !isalnum(src[2])) {
+            src += 2, skip_space();
+            if (*src != '[') error("expected [ after if");
+            r->guard = parse_expr();
+        }
+
+        size_t len = src - start;
+        r->text = malloc(len + 1);
+        memcpy(r->text, start, len);
+        r->text[len] = 0;
+    }
+}
+
+////////////////////////////////
+// Lowering patterns into tests
+////////////////////////////////
+static int find_bind(Rule* r, const char* name) {
+    for (int i = 0; i < r->bind_count; i++) {
+        if (strcmp(r->binds[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+static Test* new_test(Rule* r, TestKind kind, const char* path) {
+    if (r->test_count >= MAX_TESTS) error("rule is too big");
+    Test* t = &r->tests[r->test_count++];
+    t->kind = kind;
+    snprintf(t->path, sizeof(t->path), "%s", path);
+    return t;
+}
+
+static void op_type_name(char* out, size_t cap, const char* name) {
+    int len = snprintf(out, cap, "TB_");
+    for (const char* s = name; *s && len + 1 < cap; s++) {
+        out[len++] = toupper(*s);
+    }
+    out[len] = 0;
+}
+
+static void lower_pat(Rule* r, Pat* p, const char* path, bool is_root) {
+    switch (p->kind) {
+        case PAT_OP: {
+            if (!is_root) {
+                Test* t = new_test(r, TEST_TYPE, path);
+                op_type_name(t->value, sizeof(t->value), p->name);
+            }
+
+            for (int i = 0; i < p->kid_count; i++) {
+                char kid_path[128];
+                snprintf(kid_path, sizeof(kid_path), "%s->inputs[%d]", path, i + 1);
+                lower_pat(r, p->kids[i], kid_path, false);
+            }
+            break;
+        }
+
+        case PAT_VAR: {
+            // these are taken by the generated code
+            if (strcmp(p->name, "n") == 0 || strcmp(p->name, "p") == 0 || strcmp(p->name, "f") == 0 || (p->name[0] == 't' && isdigit(p->name[1]))) {
+                error("reserved name");
+            }
+
+            int i = find_bind(r, p->name);
+            if (i >= 0) {
+                if (r->binds[i].is_const) error("name used as both a node and a constant");
+                Test* t = new_test(r, TEST_SAME, path);
+                snprintf(t->value, sizeof(t->value), "%s", p->name);
+            } else {
+                i = r->bind_count++;
+                snprintf(r->binds[i].name, sizeof(r->binds[i].name), "%s", p->name);
+                snprintf(r->binds[i].path, sizeof(r->binds[i].path), "%s", path);
+                r->binds[i].is_const = false;
+            }
+            break;
+        }
+
+        case PAT_CONST:
+        case PAT_INT: {
+            Test* t = new_test(r, TEST_TYPE, path);
+            snprintf(t->value, sizeof(t->value), "TB_INTEGER_CONST");
+
+            if (p->kind == PAT_INT) {
+                t = new_test(r, TEST_VALUE, path);
+                snprintf(t->value, sizeof(t->value), "%s", p->name);
+            } else if (find_bind(r, p->name) >= 0) {
+                error("constants can't be matched twice, use a guard");
+            } else {
+                int i = r->bind_count++;
+                snprintf(r->binds[i].name, sizeof(r->binds[i].name), "%s", p->name);
+                snprintf(r->binds[i].path, sizeof(r->binds[i].path), "%s", path);
+                r->binds[i].is_const = true;
+            }
+            break;
+        }
+
+        default:
+        error("[...] can only be used in replacements");
+    }
+}
+
+////////////////////////////////
+// Code generation
+////////////////////////////////
+static FILE* out;
+
+// the facts we know along the current branch of the decision tree
+static int known_count;
+static struct { const char* path; const char* type; } known[MAX_TESTS * 4];
+
+static void indent(int depth) {
+    fprintf(out, "%*s", depth * 4, "");
+}
+
+static const char* known_type(const char* path) {
+    for (int i = known_count; i--;) {
+        if (strcmp(known[i].path, path) == 0) return known[i].type;
+    }
+    return NULL;
+}
+
+static Test* first_unknown(Rule* r) {
+    for (int i = 0; i < r->test_count; i++) {
+        if (r->tests[i].kind == TEST_TYPE && known_type(r->tests[i].path) == NULL) {
+            return &r->tests[i];
+        }
+    }
+    return NULL;
+}
+
+static Test* test_at(Rule* r, const char* path) {
+    for (int i = 0; i < r->test_count; i++) {
+        if (r->tests[i].kind == TEST_TYPE && strcmp(r->tests[i].path, path) == 0) {
+            return &r->tests[i];
+        }
+    }
+    return NULL;
+}
+
+static bool is_binop_int(const char* name) {
+    static const char* ops[] = { "add", "sub", "mul", "and", "or", "xor", "shl", "shr", "sar", "rol", "ror" };
+    for (int i = 0; i < sizeof(ops) / sizeof(*ops); i++) {
+        if (strcmp(ops[i], name) == 0) return true;
+    }
+    return false;
+}
+
+// writes the replacement into a temporary, returns its number
+static int gen_rhs(Rule* r, Pat* p, int* tmp, int depth) {
+    int t = (*tmp)++;
+    indent(depth);
+    switch (p->kind) {
+        case PAT_VAR:
+        if (find_bind(r, p->name) < 0) error("unbound name in replacement");
+        fprintf(out, "TB_Node* t%d = %s;\n", t, p->name);
+        break;
+
+        case PAT_CONST:
+        if (find_bind(r, p->name) < 0) error("unbound constant in replacement");
+        fprintf(out, "TB_Node* t%d = make_int_node(f, p, n->dt, %s);\n", t, p->name);
+        break;
+
+        case PAT_INT:
+        fprintf(out, "TB_Node* t%d = make_int_node(f, p, n->dt, %s);\n", t, p->name);
+        break;
+
+        case PAT_EXPR:
+        fprintf(out, "TB_Node* t%d = make_int_node(f, p, n->dt, %s);\n", t, p->expr);
+        break;
+
+        case PAT_OP: {
+            if (!is_binop_int(p->name) || p->kid_count != 2) error("replacements can only build integer binops");
+
+            char type[64];
+            op_type_name(type, sizeof(type), p->name);
+            fprintf(out, "TB_Node* t%d = tb_alloc_node(f, %s, n->dt, 3, sizeof(TB_NodeBinopInt));\n", t, type);
+            for (int i = 0; i < 2; i++) {
+                int k = gen_rhs(r, p->kids[i], tmp, depth);
+                indent(depth), fprintf(out, "set_input(p, t%d, t%d, %d);\n", t, k, i + 1);
+            }
+
+            // the root gets pushed by the peephole loop
+            if (t != 0) {
+                indent(depth), fprintf(out, "tb_pass_mark(p, t%d);\n", t);
+            }
+            break;
+        }
+    }
+    return t;
+}
+
+static void gen_leaf(int rule_i, int depth) {
+    Rule* r = &rules[rule_i];
+
+    indent(depth), fprintf(out, "// %s\n", r->text);
+    indent(depth), fprintf(out, "{\n");
+    depth++;
+
+    for (int i = 0; i < r->bind_count; i++) {
+        indent(depth);
+        if (r->binds[i].is_const) {
+            fprintf(out, "uint64_t %s = TB_NODE_GET_EXTRA_T(%s, TB_NodeInt)->value;\n", r->binds[i].name, r->binds[i].path);
+        } else {
+            fprintf(out, "TB_Node* %s = %s;\n", r->binds[i].name, r->binds[i].path);
+        }
+    }
+
+    // silence the unused warnings for names only used in tests
+    for (int i = 0; i < r->bind_count; i++) {
+        indent(depth), fprintf(out, "(void) %s;\n", r->binds[i].name);
+    }
+
+    // the cheap checks go first
+    int conds = 0;
+    indent(depth), fprintf(out, "if (");
+    for (int i = 0; i < r->test_count; i++) {
+        Test* t = &r->tests[i];
+        if (t->kind == TEST_TYPE) continue;
+
+        if (conds++) fprintf(out, " && ");
+        if (t->kind == TEST_VALUE) {
+            fprintf(out, "TB_NODE_GET_EXTRA_T(%s, TB_NodeInt)->value == (uint64_t) %s", t->path, t->value);
+        } else {
+            fprintf(out, "%s == %s", t->path, t->value);
+        }
+    }
+
+    if (r->guard) {
+        if (conds++) fprintf(out, " && ");
+        fprintf(out, "(%s)", r->guard);
+    }
+
+    if (conds == 0) fprintf(out, "true");
+    fprintf(out, ") {\n");
+
+    int tmp = 0;
+    gen_rhs(r, r->rhs, &tmp, depth + 1);
+    indent(depth + 1), fprintf(out, "DO_IF(TB_OPTDEBUG_STATS)(peep_rule_hits[%d]++);\n", rule_i);
+    indent(depth + 1), fprintf(out, "return t0;\n");
+    indent(depth), fprintf(out, "}\n");
+
+    depth--;
+    indent(depth), fprintf(out, "}\n");
+}
+
+static void gen_tree(int* list, int count, int depth) {
+    int* sub = malloc(count * sizeof(int));
+
+    int i = 0;
+    while (i < count) {
+        Test* t = first_unknown(&rules[list[i]]);
+        if (t == NULL) {
+            gen_leaf(list[i], depth);
+            i++;
+            continue;
+        }
+
+        // every following rule which also looks at this path shares the switch
+        const char* path = t->path;
+        int end = i + 1;
+        while (end < count && test_at(&rules[list[end]], path) != NULL && known_type(path) == NULL) {
+            end++;
+        }
+
+        indent(depth), fprintf(out, "switch (%s->type) {\n", path);
+        for (int j = i; j < end; j++) {
+            const char* type = test_at(&rules[list[j]], path)->value;
+
+            // only emit each case once
+            bool seen = false;
+            for (int k = i; k < j; k++) {
+                if (strcmp(test_at(&rules[list[k]], path)->value, type) == 0) seen = true;
+            }
+            if (seen) continue;
+
+            int sub_count = 0;
+            for (int k = j; k < end; k++) {
+                if (strcmp(test_at(&rules[list[k]], path)->value, type) == 0) sub[sub_count++] = list[k];
+            }
+
+            indent(depth + 1), fprintf(out, "case %s: {\n", type);
+            known[known_count].path = path;
+            known[known_count].type = type;
+            known_count++;
+
+            int* copy = malloc(sub_count * sizeof(int));
+            memcpy(copy, sub, sub_count * sizeof(int));
+            gen_tree(copy, sub_count, depth + 2);
+            free(copy);
+
+            known_count--;
+            indent(depth + 2), fprintf(out, "break;\n");
+            indent(depth + 1), fprintf(out, "}\n");
+        }
+        indent(depth + 1), fprintf(out, "default: break;\n");
+        indent(depth), fprintf(out, "}\n");
+
+        i = end;
+    }
+
+    free(sub);
+}
+
+static void gen_string(const char* s) {
+    fputc('"', out);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') fputc('\\', out);
+        if (*s == '\n') {
+            fputc(' ', out);
+            continue;
+        }
+        fputc(*s, out);
+    }
+    fputc('"', out);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        printf("Usage:\n\tpeepgen <rules> <output>\n");
+        return 1;
+    }
+
+    src_path = argv[1];
+    FILE* in = fopen(src_path, "rb");
+    if (in == NULL) {
+        fprintf(stderr, "Error opening file: %s.\n", src_path);
+        return 1;
+    }
+
+    fseek(in, 0, SEEK_END);
+    long size = ftell(in);
+    fseek(in, 0, SEEK_SET);
+
+    char* text = malloc(size + 1);
+    text[fread(text, 1, size, in)] = 0;
+    fclose(in);
+
+    src = text;
+    parse_rules();
+
+    for (int i = 0; i < rule_count; i++) {
+        line = rules[i].line;
+        lower_pat(&rules[i], rules[i].lhs, "n", true);
+    }
+
+    out = fopen(argv[2], "wb");
+    if (out == NULL) {
+        fprintf(stderr, "Error opening file: %s.\n", argv[2]);
+        return 1;
+    }
+
+    fprintf(out, "// generated by tb/meta/peepgen.c from %s, don't edit.\n", src_path);
+    fprintf(out, "enum { PEEP_RULE_COUNT = %d };\n\n", rule_count);
+
+    fprintf(out, "#if TB_OPTDEBUG_STATS\n");
+    fprintf(out, "static int peep_rule_hits[PEEP_RULE_COUNT];\n");
+    fprintf(out, "static const char* peep_rule_names[PEEP_RULE_COUNT] = {\n");
+    for (int i = 0; i < rule_count; i++) {
+        fprintf(out, "    ");
+        gen_string(rules[i].text);
+        fprintf(out, ",\n");
+    }
+    fprintf(out, "};\n");
+    fprintf(out, "#endif\n\n");
+
+    fprintf(out, "static TB_Node* peep_rules(TB_Passes* restrict p, TB_Function* f, TB_Node* n) {\n");
+    fprintf(out, "    if (n->dt.type != TB_INT) return NULL;\n\n");
+    fprintf(out, "    switch (n->type) {\n");
+
+    // group the rules by the root op, order within each op is kept
+    int* list = malloc(rule_count * sizeof(int));
+    for (int i = 0; i < rule_count; i++) {
+        bool seen = false;
+        for (int j = 0; j < i; j++) {
+            if (strcmp(rules[j].lhs->name, rules[i].lhs->name) == 0) seen = true;
+        }
+        if (seen) continue;
+
+        int count = 0;
+        for (int j = i; j < rule_count; j++) {
+            if (strcmp(rules[j].lhs->name, rules[i].lhs->name) == 0) list[count++] = j;
+        }
+
+        char type[64];
+        op_type_name(type, sizeof(type), rules[i].lhs->name);
+        fprintf(out, "        case %s: {\n", type);
+        gen_tree(list, count, 3);
+        fprintf(out, "            break;\n");
+        fprintf(out, "        }\n\n");
+    }
+
+    fprintf(out, "        default: break;\n");
+    fprintf(out, "    }\n\n");
+    fprintf(out, "    return NULL;\n");
+    fprintf(out, "}\n");
+    fclose(out);
+    return 0;
+}
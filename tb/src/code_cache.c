@@ -0,0 +1,881 @@
+// Function-granular machine code cache. Each TB_Function's IR graph is hashed
+// along with its prototype, the target and a salt from the frontend (opt level),
+// if that key is already in the store then the code, relocations and line info
+// are copied into a fresh TB_FunctionOutput and the function never goes through
+// the optimizer or the code generator.
+//
+// The store is a flat file of records, it's memory-mapped when the cache is
+// opened and new records are buffered up and appended when it's closed.
+//
+//   header: CacheHeader
+//   record: CacheRecord, code, patches, cold jumps, frame changes, stack slots, const globals, locations
+//
+// Patches can't store pointers so the symbols get rebuilt from the IR: every
+// symbol node is numbered in graph order and patches refer to that number, debug
+// stack slots do the same with the variable attributes. The
+// small read-only globals which the code generator makes on its own (float
+// constants, lookup & jump tables) are stored by value and remade on a hit.
+#include <file_map.h>
+
+#define CACHE_VERSION 3
+
+// once the store is bigger than this, closing it rewrites the file with only
+// the records used in this session.
+#define CACHE_SIZE_LIMIT (256u * 1024 * 1024)
+
+enum {
+    CACHE_PATCH_GLOBAL    = 0x80000000u, // | index into the record's globals
+    CACHE_PATCH_SELF      = 0xFFFFFFFDu, // jump tables are relative to the function
+    CACHE_PATCH_TLS_INDEX = 0xFFFFFFFEu,
+    CACHE_PATCH_CHKSTK    = 0xFFFFFFFFu,
+};
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+
+    // the code generator changes between builds of TB, it's not worth trusting
+    // code from a different one.
+    char stamp[24];
+} CacheHeader;
+
+typedef struct {
+    uint64_t key[2];
+    uint32_t size; // whole record, multiple of 8
+    uint32_t code_size;
+    uint32_t patch_count;
+    uint32_t global_count;
+    uint32_t location_count;
+    uint32_t slot_count;
+    uint32_t prologue_length;
+    uint32_t cold_start;
+    uint32_t cold_jump_count;
+    uint32_t prologue_pos;
+    uint32_t frame_change_count;
+    uint32_t reserved;
+    uint64_t stack_usage;
+
+    // what it cost to compile the first time, hits save about this much
+    uint64_t compile_nanos;
+} CacheRecord;
+
+typedef struct {
+    uint32_t pos, target;
+} CachePatch;
+
+typedef struct {
+    int32_t position;
+    uint32_t var;
+} CacheSlot;
+
+typedef struct {
+    uint32_t pos, has_frame;
+} CacheFrameChange;
+
+typedef struct {
+    uint32_t size, align, name_len;
+    // followed by the name then the data, padded to 4 bytes
+} CacheGlobal;
+
+typedef struct {
+    uint32_t pos;
+    int32_t line, column;
+    uint32_t path_len;
+    // followed by the path, padded to 4 bytes
+} CacheLocation;
+
+// the pointers in the output we can rebuild from the IR, in graph order
+typedef struct {
+    DynArray(TB_Symbol*) syms;
+    DynArray(TB_Attrib*) vars;
+} CacheRefs;
+
+typedef struct TB_CodeCacheMiss TB_CodeCacheMiss;
+struct TB_CodeCacheMiss {
+    uint64_t key[2];
+    uint64_t start;
+
+    // the IR won't look like this once it's been through the optimizer
+    CacheRefs refs;
+};
+
+struct TB_CodeCache {
+    char* path;
+    FileMap file;
+    bool has_file;
+
+    // first half of the key -> record offset in the file
+    NL_Map(uint64_t, size_t) records;
+    // which records were hit, we keep those if the store gets compacted
+    _Atomic(uint8_t)* used;
+
+    mtx_t lock;
+    TB_Emitter pending;
+
+    _Atomic uint64_t hits, misses, uncacheable;
+    _Atomic uint64_t saved_nanos;
+};
+
+static const CacheHeader cache_header = { "TBCC", CACHE_VERSION, __DATE__ " " __TIME__ };
+
+////////////////////////////////
+// Hashing
+////////////////////////////////
+// two independent 64bit lanes, a collision has to happen on both of them to
+// hand back the wrong code.
+typedef struct {
+    uint64_t a, b;
+} CacheHasher;
+
+static void cache_hash(CacheHasher* h, size_t len, const void* data) {
+    const uint8_t* p = data;
+    uint64_t a = h->a, b = h->b;
+    FOREACH_N(i, 0, len) {
+        a = (a ^ p[i]) * 0x100000001b3ull;
+        b = (b + p[i] + 1) * 0x9E3779B97F4A7C15ull;
+        b ^= b >> 29;
+    }
+    h->a = a, h->b = b;
+}
+
+static void cache_hash_u64(CacheHasher* h, uint64_t x) {
+    cache_hash(h, sizeof(x), &x);
+}
+
+static void cache_hash_str(CacheHasher* h, const char* str) {
+    size_t len = str ? strlen(str) : 0;
+    cache_hash_u64(h, len);
+    cache_hash(h, len, str);
+}
+
+static void cache_hash_proto(CacheHasher* h, const TB_FunctionPrototype* proto) {
+    if (proto == NULL) {
+        cache_hash_u64(h, 0);
+        return;
+    }
+
+    size_t count = proto->param_count + proto->return_count;
+    cache_hash_u64(h, 1 + proto->call_conv);
+    cache_hash_u64(h, proto->return_count);
+    cache_hash_u64(h, proto->param_count);
+    cache_hash_u64(h, proto->has_varargs);
+    FOREACH_N(i, 0, count) {
+        cache_hash_u64(h, proto->params[i].dt.raw);
+    }
+}
+
+// the code doesn't care which symbol it's referring to (that's a relocation),
+// only what kind of symbol it is.
+static void cache_hash_symbol(CacheHasher* h, const TB_Symbol* s) {
+    cache_hash_u64(h, s->tag);
+    switch (s->tag) {
+        case TB_SYMBOL_EXTERNAL: cache_hash_u64(h, ((TB_External*) s)->type);    break;
+        case TB_SYMBOL_GLOBAL:   cache_hash_u64(h, ((TB_Global*) s)->linkage);   break;
+        case TB_SYMBOL_FUNCTION: cache_hash_u64(h, ((TB_Function*) s)->linkage); break;
+        default: break;
+    }
+}
+
+// returns false if the function has something we can't cache, the symbols and
+// variables are pushed into refs in the same order every time for the same graph.
+static bool cache_hash_function(TB_Function* f, uint64_t salt, uint64_t key[2], CacheRefs* refs) {
+    TB_Module* m = f->super.module;
+    CacheHasher h = { 0xcbf29ce484222325ull, 0x2545F4914F6CDD1Dull };
+    cache_hash_u64(&h, m->target_arch);
+    cache_hash_u64(&h, m->target_system);
+    cache_hash_u64(&h, m->target_abi);
+    cache_hash_u64(&h, m->is_jit);
+    cache_hash(&h, sizeof(m->features), &m->features);
+    cache_hash_u64(&h, salt);
+
+    cache_hash_proto(&h, f->prototype);
+    cache_hash_u64(&h, f->linkage);
+    cache_hash_u64(&h, f->param_count);
+    if (f->param_ranges) {
+        FOREACH_N(i, 0, f->param_count) {
+            TB_ParamRange* r = &f->param_ranges[i];
+            cache_hash_u64(&h, r->known);
+            cache_hash_u64(&h, r->min);
+            cache_hash_u64(&h, r->max);
+        }
+    }
+
+    // number the nodes in walk order, the GVN numbers depend on how the
+    // frontend got there and not just the graph.
+    Worklist ws = { 0 };
+    worklist_alloc(&ws, f->node_count);
+    dyn_array_for(i, f->terminators) {
+        worklist_push(&ws, f->terminators[i]);
+    }
+
+    for (size_t i = 0; i < dyn_array_length(ws.items); i++) {
+        TB_Node* n = ws.items[i];
+        FOREACH_N(j, 0, n->input_count) if (n->inputs[j]) {
+            worklist_push(&ws, n->inputs[j]);
+        }
+
+        if (n->type == TB_CALL || n->type == TB_SYSCALL) {
+            TB_NodeCall* c = TB_NODE_GET_EXTRA(n);
+            FOREACH_N(j, 0, c->proj_count) if (c->projs[j]) {
+                worklist_push(&ws, c->projs[j]);
+            }
+        } else if (n->type >= TB_ATOMIC_LOAD && n->type <= TB_ATOMIC_CAS) {
+            TB_NodeAtomic* a = TB_NODE_GET_EXTRA(n);
+            if (a->proj0) worklist_push(&ws, a->proj0);
+            if (a->proj1) worklist_push(&ws, a->proj1);
+        }
+    }
+
+    size_t node_count = dyn_array_length(ws.items);
+    uint32_t* ids = tb_platform_heap_alloc(f->node_count * sizeof(uint32_t));
+    FOREACH_N(i, 0, node_count) {
+        ids[ws.items[i]->gvn] = i;
+    }
+
+    bool ok = true;
+    cache_hash_u64(&h, node_count);
+    FOREACH_N(i, 0, node_count) {
+        TB_Node* n = ws.items[i];
+        if (n->type == TB_MACHINE_OP || n->type == TB_SAFEPOINT_POLL) {
+            ok = false;
+            break;
+        }
+
+        cache_hash_u64(&h, n->type);
+        cache_hash_u64(&h, n->dt.raw);
+        cache_hash_u64(&h, n->input_count);
+        FOREACH_N(j, 0, n->input_count) {
+            cache_hash_u64(&h, n->inputs[j] ? ids[n->inputs[j]->gvn] : UINT32_MAX);
+        }
+
+        // variables only matter for the debug stack slots
+        ptrdiff_t search = nl_map_get(f->attribs, n);
+        if (search >= 0) {
+            DynArray(TB_Attrib) attribs = f->attribs[search].v;
+            dyn_array_for(j, attribs) {
+                cache_hash_u64(&h, attribs[j].tag);
+                if (attribs[j].tag == TB_ATTRIB_VARIABLE) {
+                    cache_hash_str(&h, attribs[j].var.name);
+                    dyn_array_put(refs->vars, &attribs[j]);
+                }
+            }
+        }
+
+        switch (n->type) {
+            case TB_SYMBOL: {
+                TB_Symbol* sym = TB_NODE_GET_EXTRA_T(n, TB_NodeSymbol)->sym;
+                cache_hash_symbol(&h, sym);
+                dyn_array_put(refs->syms, sym);
+                break;
+            }
+
+            case TB_CALL:
+            case TB_SYSCALL: {
+                TB_NodeCall* c = TB_NODE_GET_EXTRA(n);
+                cache_hash_proto(&h, c->proto);
+                cache_hash_u64(&h, c->proj_count);
+                break;
+            }
+
+            case TB_TAILCALL:
+            cache_hash_proto(&h, TB_NODE_GET_EXTRA_T(n, TB_NodeTailcall)->proto);
+            break;
+
+            case TB_START:
+            case TB_REGION: {
+                TB_NodeRegion* r = TB_NODE_GET_EXTRA(n);
+                cache_hash_str(&h, r->tag);
+                cache_hash(&h, sizeof(r->freq), &r->freq);
+                break;
+            }
+
+            case TB_ATOMIC_LOAD:
+            case TB_ATOMIC_XCHG:
+            case TB_ATOMIC_ADD:
+            case TB_ATOMIC_SUB:
+            case TB_ATOMIC_AND:
+            case TB_ATOMIC_XOR:
+            case TB_ATOMIC_OR:
+            case TB_ATOMIC_CAS: {
+                TB_NodeAtomic* a = TB_NODE_GET_EXTRA(n);
+                cache_hash_u64(&h, a->order);
+                cache_hash_u64(&h, a->order2);
+                break;
+            }
+
+            case TB_SAFEPOINT_NOP: {
+                TB_NodeSafepoint* sp = TB_NODE_GET_EXTRA(n);
+                cache_hash_str(&h, sp->file ? (const char*) sp->file->path : NULL);
+                cache_hash_u64(&h, sp->line);
+                cache_hash_u64(&h, sp->column);
+                break;
+            }
+
+            // no pointers in the rest
+            default:
+            cache_hash(&h, extra_bytes(n), n->extra);
+            break;
+        }
+    }
+
+    tb_platform_heap_free(ids);
+    worklist_free(&ws);
+
+    // zero is the empty slot in the record map
+    key[0] = h.a ? h.a : 1, key[1] = h.b;
+    return ok;
+}
+
+////////////////////////////////
+// Store
+////////////////////////////////
+// NULL once we're past the last record, a writer which died halfway leaves a
+// truncated record so we just stop reading there.
+static const CacheRecord* cache_record_at(const FileMap* file, size_t pos) {
+    if (pos + sizeof(CacheRecord) > file->size) {
+        return NULL;
+    }
+
+    const CacheRecord* rec = (const CacheRecord*) ((const uint8_t*) file->data + pos);
+    if (rec->size < sizeof(CacheRecord) || rec->size % 8 != 0 || rec->size > file->size - pos) {
+        return NULL;
+    }
+    return rec;
+}
+
+static void cache_load(TB_CodeCache* cache) {
+    FileMap file = open_file_map(cache->path);
+    if (file.data == NULL) {
+        return;
+    }
+
+    // anything that doesn't line up just means we're starting from scratch
+    if (file.size < sizeof(CacheHeader) || memcmp(file.data, &cache_header, sizeof(CacheHeader)) != 0) {
+        close_file_map(&file);
+        return;
+    }
+
+    cache->file = file;
+    cache->has_file = true;
+
+    // records are at least sizeof(CacheRecord) apart so that's our bucket size
+    size_t used_count = file.size / sizeof(CacheRecord) + 1;
+    cache->used = tb_platform_heap_alloc(used_count);
+    memset(cache->used, 0, used_count);
+
+    const CacheRecord* rec;
+    for (size_t pos = sizeof(CacheHeader); (rec = cache_record_at(&file, pos)) != NULL; pos += rec->size) {
+        uint64_t key = rec->key[0];
+        nl_map_put(cache->records, key, pos);
+    }
+}
+
+TB_CodeCache* tb_code_cache_open(const char* path) {
+    TB_CodeCache* cache = tb_platform_heap_alloc(sizeof(TB_CodeCache));
+    *cache = (TB_CodeCache){ 0 };
+
+    size_t len = strlen(path);
+    cache->path = tb_platform_heap_alloc(len + 1);
+    memcpy(cache->path, path, len + 1);
+    mtx_init(&cache->lock, mtx_plain);
+
+    CUIK_TIMED_BLOCK("code cache open") {
+        cache_load(cache);
+    }
+    return cache;
+}
+
+static bool cache_write(FILE* out, size_t size, const void* data) {
+    return size == 0 || fwrite(data, size, 1, out) == 1;
+}
+
+static void cache_flush(TB_CodeCache* cache) {
+    size_t old_size = cache->has_file ? cache->file.size : 0;
+    bool compact = old_size + cache->pending.count > CACHE_SIZE_LIMIT;
+
+    // the records we're keeping have to be pulled out before the mapping goes away
+    TB_Emitter kept = { 0 };
+    if (compact) {
+        const CacheRecord* rec;
+        for (size_t pos = sizeof(CacheHeader); (rec = cache_record_at(&cache->file, pos)) != NULL; pos += rec->size) {
+            if (cache->used[pos / sizeof(CacheRecord)]) {
+                tb_outs(&kept, rec->size, rec);
+            }
+        }
+    }
+
+    if (cache->has_file) {
+        close_file_map(&cache->file);
+    }
+
+    if (compact || old_size == 0) {
+        // write the new store off to the side so a concurrent reader never
+        // sees half of it.
+        size_t len = strlen(cache->path) + 8;
+        char* tmp = tb_platform_heap_alloc(len);
+        snprintf(tmp, len, "%s.tmp", cache->path);
+
+        FILE* out = fopen(tmp, "wb");
+        if (out != NULL) {
+            bool ok = cache_write(out, sizeof(CacheHeader), &cache_header)
+                && cache_write(out, kept.count, kept.data)
+                && cache_write(out, cache->pending.count, cache->pending.data);
+
+            ok &= fclose(out) == 0;
+            if (!ok || rename(tmp, cache->path) != 0) {
+                remove(tmp);
+            }
+        }
+        tb_platform_heap_free(tmp);
+    } else if (cache->pending.count > 0) {
+        // every record goes out in one write so concurrent appends from other
+        // compiles don't interleave.
+        FILE* out = fopen(cache->path, "ab");
+        if (out != NULL) {
+            cache_write(out, cache->pending.count, cache->pending.data);
+            fclose(out);
+        }
+    }
+
+    tb_platform_heap_free(kept.data);
+}
+
+void tb_code_cache_close(TB_CodeCache* cache) {
+    CUIK_TIMED_BLOCK("code cache close") {
+        cache_flush(cache);
+    }
+
+    nl_map_free(cache->records);
+    tb_platform_heap_free(cache->used);
+    tb_platform_heap_free(cache->pending.data);
+    tb_platform_heap_free(cache->path);
+    mtx_destroy(&cache->lock);
+    tb_platform_heap_free(cache);
+}
+
+TB_CodeCacheStats tb_code_cache_stats(TB_CodeCache* cache) {
+    return (TB_CodeCacheStats){
+        .hits = cache->hits,
+        .misses = cache->misses,
+        .uncacheable = cache->uncacheable,
+        .saved_nanos = cache->saved_nanos,
+    };
+}
+
+////////////////////////////////
+// Lookup
+////////////////////////////////
+typedef struct {
+    const uint8_t* p;
+    const uint8_t* end;
+} CacheReader;
+
+// NULL if the record is lying about its size
+static const void* cache_read(CacheReader* r, size_t size) {
+    if (size > (size_t) (r->end - r->p)) {
+        return NULL;
+    }
+
+    const void* p = r->p;
+    r->p += (size + 3) & ~3;
+    if (r->p > r->end) r->p = r->end;
+    return p;
+}
+
+static bool cache_apply(TB_CodeCache* cache, TB_Function* f, const CacheRecord* rec, const CacheRefs* refs) {
+    TB_Module* m = f->super.module;
+    CacheReader r = { (const uint8_t*) &rec[1], (const uint8_t*) rec + rec->size };
+
+    const uint8_t* code = cache_read(&r, rec->code_size);
+    const CachePatch* patches = cache_read(&r, rec->patch_count * sizeof(CachePatch));
+    const uint32_t* cold_jumps = cache_read(&r, rec->cold_jump_count * sizeof(uint32_t));
+    const CacheFrameChange* changes = cache_read(&r, rec->frame_change_count * sizeof(CacheFrameChange));
+    const CacheSlot* slots = cache_read(&r, rec->slot_count * sizeof(CacheSlot));
+    if (code == NULL || patches == NULL || cold_jumps == NULL || changes == NULL || slots == NULL || rec->cold_start > rec->code_size) {
+        return false;
+    }
+
+    // validate everything before we touch the module
+    const CacheGlobal** globals = tb_platform_heap_alloc((rec->global_count + rec->location_count + 1) * sizeof(void*));
+    const CacheLocation** locs = (const CacheLocation**) &globals[rec->global_count];
+
+    bool ok = true;
+    FOREACH_N(i, 0, rec->global_count) {
+        const CacheGlobal* g = cache_read(&r, sizeof(CacheGlobal));
+        if (g == NULL || g->size == 0 || g->align == 0 || !tb_is_power_of_two(g->align) || cache_read(&r, g->name_len + g->size) == NULL) {
+            ok = false;
+            break;
+        }
+        globals[i] = g;
+    }
+
+    for (size_t i = 0; ok && i < rec->location_count; i++) {
+        const CacheLocation* l = cache_read(&r, sizeof(CacheLocation));
+        if (l == NULL || cache_read(&r, l->path_len) == NULL) {
+            ok = false;
+            break;
+        }
+        locs[i] = l;
+    }
+
+    for (size_t i = 0; ok && i < rec->patch_count; i++) {
+        uint32_t t = patches[i].target;
+        if (patches[i].pos + 4 > rec->code_size) {
+            ok = false;
+        } else if (t == CACHE_PATCH_SELF) {
+            ok = true;
+        } else if (t == CACHE_PATCH_CHKSTK) {
+            ok = m->chkstk_extern != NULL;
+        } else if (t == CACHE_PATCH_TLS_INDEX) {
+            ok = m->tls_index_extern != NULL;
+        } else if (t & CACHE_PATCH_GLOBAL) {
+            ok = (t & ~CACHE_PATCH_GLOBAL) < rec->global_count;
+        } else {
+            ok = t < dyn_array_length(refs->syms);
+        }
+    }
+
+    for (size_t i = 0; ok && i < rec->cold_jump_count; i++) {
+        ok = cold_jumps[i] + 4 <= rec->code_size;
+    }
+
+    for (size_t i = 0; ok && i < rec->frame_change_count; i++) {
+        ok = changes[i].pos <= rec->code_size;
+    }
+
+    for (size_t i = 0; ok && i < rec->slot_count; i++) {
+        ok = slots[i].var < dyn_array_length(refs->vars);
+    }
+
+    if (!ok) {
+        tb_platform_heap_free(globals);
+        return false;
+    }
+
+    TB_FunctionOutput* out = tb__alloc_function_output(f, rec->code_size);
+    memcpy(out->code, code, rec->code_size);
+    out->prologue_length = rec->prologue_length;
+    out->prologue_pos = rec->prologue_pos;
+    out->stack_usage = rec->stack_usage;
+    out->cold_start = rec->cold_start;
+
+    if (rec->cold_jump_count) {
+        out->cold_jumps = dyn_array_create(uint32_t, rec->cold_jump_count);
+        FOREACH_N(i, 0, rec->cold_jump_count) {
+            dyn_array_put(out->cold_jumps, cold_jumps[i]);
+        }
+    }
+
+    if (rec->frame_change_count) {
+        out->frame_changes = dyn_array_create(TB_FrameChange, rec->frame_change_count);
+        FOREACH_N(i, 0, rec->frame_change_count) {
+            TB_FrameChange c = { changes[i].pos, changes[i].has_frame };
+            dyn_array_put(out->frame_changes, c);
+        }
+    }
+
+    // remake the codegen's own globals
+    TB_Global** made = tb_platform_heap_alloc((rec->global_count + 1) * sizeof(TB_Global*));
+    FOREACH_N(i, 0, rec->global_count) {
+        const CacheGlobal* g = globals[i];
+        const char* name = (const char*) &g[1];
+        const uint8_t* data = (const uint8_t*) name + g->name_len;
+
+        if (g->name_len == 0 && g->size <= 16 && g->align == g->size) {
+            made[i] = tb__small_data_intern(m, g->size, data);
+        } else {
+            made[i] = tb_global_create(m, g->name_len, name, NULL, TB_LINKAGE_PRIVATE);
+            tb_global_set_storage(m, tb_module_get_rdata(m), made[i], g->size, g->align, 1);
+
+            void* dst = tb_global_add_region(m, made[i], 0, g->size);
+            memcpy(dst, data, g->size);
+        }
+    }
+
+    FOREACH_N(i, 0, rec->patch_count) {
+        uint32_t t = patches[i].target;
+
+        const TB_Symbol* target;
+        if (t == CACHE_PATCH_SELF) {
+            target = &f->super;
+        } else if (t == CACHE_PATCH_CHKSTK) {
+            target = m->chkstk_extern;
+        } else if (t == CACHE_PATCH_TLS_INDEX) {
+            target = m->tls_index_extern;
+        } else if (t & CACHE_PATCH_GLOBAL) {
+            target = (TB_Symbol*) made[t & ~CACHE_PATCH_GLOBAL];
+        } else {
+            target = refs->syms[t];
+        }
+
+        tb_emit_symbol_patch(out, target, patches[i].pos);
+    }
+
+    if (rec->slot_count) {
+        out->stack_slots = dyn_array_create(TB_StackSlot, rec->slot_count);
+        FOREACH_N(i, 0, rec->slot_count) {
+            TB_Attrib* a = refs->vars[slots[i].var];
+
+            TB_StackSlot slot = { slots[i].position, a->var.name, a->var.storage };
+            dyn_array_put(out->stack_slots, slot);
+        }
+    }
+
+    if (rec->location_count) {
+        out->locations = dyn_array_create(TB_Location, rec->location_count);
+
+        char path[FILENAME_MAX];
+        FOREACH_N(i, 0, rec->location_count) {
+            const CacheLocation* l = locs[i];
+
+            TB_SourceFile* file = NULL;
+            if (l->path_len > 0 && l->path_len < FILENAME_MAX) {
+                memcpy(path, &l[1], l->path_len);
+                path[l->path_len] = 0;
+                file = tb_get_source_file(m, path);
+            }
+
+            TB_Location loc = { file, l->line, l->column, l->pos };
+            dyn_array_put(out->locations, loc);
+        }
+    }
+
+    tb_platform_heap_free(made);
+    tb_platform_heap_free(globals);
+
+    atomic_fetch_add(&m->compiled_function_count, 1);
+    f->output = out;
+    return true;
+}
+
+static bool cache_lookup(TB_CodeCache* cache, TB_Function* f, uint64_t salt) {
+    uint64_t start = cuik_time_in_nanos();
+
+    uint64_t key[2];
+    CacheRefs refs = { 0 };
+    if (!cache_hash_function(f, salt, key, &refs)) {
+        cache->uncacheable += 1;
+        dyn_array_destroy(refs.syms);
+        dyn_array_destroy(refs.vars);
+        return false;
+    }
+
+    bool hit = false;
+    ptrdiff_t search = nl_map_get(cache->records, key[0]);
+    if (search >= 0) {
+        size_t pos = cache->records[search].v;
+        const CacheRecord* rec = (const CacheRecord*) ((const uint8_t*) cache->file.data + pos);
+
+        if (rec->key[1] == key[1]) {
+            char extra[64];
+            snprintf(extra, sizeof(extra), "saved %.3f ms", rec->compile_nanos / 1000000.0);
+
+            CUIK_TIMED_BLOCK_ARGS("code cache hit", extra) {
+                hit = cache_apply(cache, f, rec, &refs);
+            }
+        }
+
+        if (hit) {
+            cache->used[pos / sizeof(CacheRecord)] = 1;
+            cache->hits += 1;
+            cache->saved_nanos += rec->compile_nanos;
+
+            // we skip the passes so this is the last stop for the IR
+            dyn_array_destroy(f->terminators);
+            f->terminators = NULL;
+        }
+    }
+
+    if (hit) {
+        dyn_array_destroy(refs.syms);
+        dyn_array_destroy(refs.vars);
+    } else {
+        TB_CodeCacheMiss* miss = tb_platform_heap_alloc(sizeof(TB_CodeCacheMiss));
+        *miss = (TB_CodeCacheMiss){ { key[0], key[1] }, start, refs };
+
+        f->cache_miss = miss;
+        cache->misses += 1;
+    }
+
+    return hit;
+}
+
+bool tb_code_cache_lookup(TB_CodeCache* cache, TB_Function* f, uint64_t salt) {
+    f->cache_miss = NULL;
+
+    bool hit;
+    CUIK_TIMED_BLOCK_ARGS("code cache lookup", f->super.name) {
+        hit = cache_lookup(cache, f, salt);
+    }
+    return hit;
+}
+
+////////////////////////////////
+// Insertion
+////////////////////////////////
+static void cache_pad(TB_Emitter* e, size_t align) {
+    tb_out_zero(e, align_up(e->count, align) - e->count);
+}
+
+// const globals the code generator made for itself, we can't use a symbol which
+// isn't in the IR unless it's just bytes.
+static bool cache_is_const_global(TB_Module* m, const TB_Symbol* s) {
+    if (s->tag != TB_SYMBOL_GLOBAL) {
+        return false;
+    }
+
+    const TB_Global* g = (const TB_Global*) s;
+    if (g->linkage != TB_LINKAGE_PRIVATE || g->parent != tb_module_get_rdata(m) || g->size == 0) {
+        return false;
+    }
+
+    FOREACH_N(i, 0, g->obj_count) {
+        if (g->objects[i].type != TB_INIT_OBJ_REGION) return false;
+    }
+    return true;
+}
+
+// writes out the record, false if the code points at something we can't rebuild
+static bool cache_serialize(TB_Module* m, TB_CodeCacheMiss* miss, TB_FunctionOutput* out, TB_Emitter* e) {
+    if (dyn_array_length(out->safepoints) || out->code_size > UINT32_MAX) {
+        return false;
+    }
+
+    CacheRecord rec = {
+        .key = { miss->key[0], miss->key[1] },
+        .code_size = out->code_size,
+        .patch_count = out->patch_count,
+        .location_count = dyn_array_length(out->locations),
+        .slot_count = dyn_array_length(out->stack_slots),
+        .prologue_length = out->prologue_length,
+        .cold_start = out->cold_start,
+        .cold_jump_count = dyn_array_length(out->cold_jumps),
+        .prologue_pos = out->prologue_pos,
+        .frame_change_count = dyn_array_length(out->frame_changes),
+        .stack_usage = out->stack_usage,
+        .compile_nanos = cuik_time_in_nanos() - miss->start,
+    };
+    tb_outs(e, sizeof(rec), &rec);
+    tb_outs(e, out->code_size, out->code);
+    cache_pad(e, 4);
+
+    DynArray(const TB_Global*) globals = NULL;
+    for (TB_SymbolPatch* p = out->first_patch; p; p = p->next) {
+        const TB_Symbol* s = p->target;
+
+        uint32_t target = UINT32_MAX;
+        dyn_array_for(i, miss->refs.syms) {
+            if (miss->refs.syms[i] == s) { target = i; break; }
+        }
+
+        if (target != UINT32_MAX) {
+            // found it in the IR
+        } else if (s == &out->parent->super) {
+            target = CACHE_PATCH_SELF;
+        } else if (s == m->chkstk_extern) {
+            target = CACHE_PATCH_CHKSTK;
+        } else if (s == m->tls_index_extern) {
+            target = CACHE_PATCH_TLS_INDEX;
+        } else if (cache_is_const_global(m, s)) {
+            size_t i = 0, count = dyn_array_length(globals);
+            while (i < count && globals[i] != (const TB_Global*) s) i++;
+
+            if (i == count) dyn_array_put(globals, (const TB_Global*) s);
+            target = CACHE_PATCH_GLOBAL | i;
+        } else {
+            dyn_array_destroy(globals);
+            return false;
+        }
+
+        CachePatch cp = { p->pos, target };
+        tb_outs(e, sizeof(cp), &cp);
+    }
+
+    dyn_array_for(i, out->cold_jumps) {
+        tb_outs(e, sizeof(uint32_t), &out->cold_jumps[i]);
+    }
+
+    dyn_array_for(i, out->frame_changes) {
+        CacheFrameChange cf = { out->frame_changes[i].pos, out->frame_changes[i].has_frame };
+        tb_outs(e, sizeof(cf), &cf);
+    }
+
+    dyn_array_for(i, out->stack_slots) {
+        TB_StackSlot* slot = &out->stack_slots[i];
+
+        uint32_t var = UINT32_MAX;
+        dyn_array_for(j, miss->refs.vars) {
+            TB_Attrib* a = miss->refs.vars[j];
+            if (a->var.name == slot->name && a->var.storage == slot->storage_type) { var = j; break; }
+        }
+
+        if (var == UINT32_MAX) {
+            dyn_array_destroy(globals);
+            return false;
+        }
+
+        CacheSlot cs = { slot->position, var };
+        tb_outs(e, sizeof(cs), &cs);
+    }
+
+    dyn_array_for(i, globals) {
+        const TB_Global* g = globals[i];
+        const char* name = g->super.name ? g->super.name : "";
+
+        CacheGlobal cg = { g->size, g->align, strlen(name) };
+        tb_outs(e, sizeof(cg), &cg);
+        tb_outs(e, cg.name_len, name);
+
+        size_t data = e->count;
+        tb_out_zero(e, g->size);
+        FOREACH_N(j, 0, g->obj_count) {
+            const TB_InitObj* o = &g->objects[j];
+            if (o->offset + o->region.size <= g->size) {
+                memcpy(&e->data[data + o->offset], o->region.ptr, o->region.size);
+            }
+        }
+        cache_pad(e, 4);
+    }
+
+    dyn_array_for(i, out->locations) {
+        TB_Location* l = &out->locations[i];
+        CacheLocation cl = { l->pos, l->line, l->column, l->file ? l->file->len : 0 };
+        tb_outs(e, sizeof(cl), &cl);
+        if (cl.path_len) tb_outs(e, cl.path_len, l->file->path);
+        cache_pad(e, 4);
+    }
+    cache_pad(e, 8);
+
+    CacheRecord* r = (CacheRecord*) e->data;
+    r->size = e->count;
+    r->global_count = dyn_array_length(globals);
+    dyn_array_destroy(globals);
+    return true;
+}
+
+void tb_code_cache_insert(TB_CodeCache* cache, TB_Function* f) {
+    TB_CodeCacheMiss* miss = f->cache_miss;
+    TB_FunctionOutput* out = f->output;
+    if (miss == NULL || out == NULL) {
+        return;
+    }
+
+    f->cache_miss = NULL;
+    CUIK_TIMED_BLOCK("code cache insert") {
+        TB_Emitter e = { 0 };
+        if (cache_serialize(f->super.module, miss, out, &e)) {
+            mtx_lock(&cache->lock);
+            tb_outs(&cache->pending, e.count, e.data);
+            mtx_unlock(&cache->lock);
+        } else {
+            cache->misses -= 1;
+            cache->uncacheable += 1;
+        }
+
+        tb_platform_heap_free(e.data);
+    }
+
+    dyn_array_destroy(miss->refs.syms);
+    dyn_array_destroy(miss->refs.vars);
+    tb_platform_heap_free(miss);
+}
@@ -0,0 +1,716 @@
+#include "../tb_internal.h"
+#include "dwarf.h"
+#include <tb_elf.h>
+
+// DWARF 5 output, we generate .debug_abbrev, .debug_info, .debug_line and .eh_frame
+//
+// relocations in the section group don't refer to symbols, the object writer
+// resolves them like so:
+//
+//   ADDR64  8 bytes, symbol_index is a TB_ModuleSection index and the addend is
+//           the offset into it.
+//   REL32   4 bytes, same targets as ADDR64 but PC-relative to the patch site.
+//   SECREL  4 bytes, symbol_index is a section index within the debug section
+//           group and the addend is the offset into it.
+enum {
+    DWARF_SECTION_ABBREV,
+    DWARF_SECTION_INFO,
+    DWARF_SECTION_LINE,
+    DWARF_SECTION_EH_FRAME,
+
+    DWARF_SECTION_COUNT
+};
+
+enum {
+    ABBREV_NONE,
+
+    ABBREV_COMPILE_UNIT,
+    ABBREV_COMPILE_UNIT_RANGE,
+    ABBREV_SUBPROGRAM,
+    ABBREV_SUBPROGRAM_VOID,
+    ABBREV_VARIABLE,
+    ABBREV_GLOBAL_VARIABLE,
+    ABBREV_BASE_TYPE,
+    ABBREV_POINTER,
+    ABBREV_TYPEDEF,
+    ABBREV_STRUCT,
+    ABBREV_STRUCT_ANON,
+    ABBREV_STRUCT_DECL,
+    ABBREV_UNION,
+    ABBREV_UNION_ANON,
+    ABBREV_UNION_DECL,
+    ABBREV_MEMBER,
+    ABBREV_ARRAY,
+    ABBREV_SUBRANGE,
+    ABBREV_SUBROUTINE,
+    ABBREV_SUBROUTINE_VOID,
+    ABBREV_FORMAL_PARAM,
+    ABBREV_VARARGS,
+    ABBREV_VOID,
+};
+
+// each abbreviation is a tag, a children flag and then attribute/form pairs
+// terminated by zero.
+static const uint8_t dwarf_abbrevs[][24] = {
+    [ABBREV_COMPILE_UNIT]       = { DW_TAG_compile_unit, DW_CHILDREN_yes, DW_AT_producer, DW_FORM_string, DW_AT_language, DW_FORM_data2, DW_AT_name, DW_FORM_string, DW_AT_comp_dir, DW_FORM_string, DW_AT_stmt_list, DW_FORM_sec_offset, DW_AT_low_pc, DW_FORM_addr },
+    [ABBREV_COMPILE_UNIT_RANGE] = { DW_TAG_compile_unit, DW_CHILDREN_yes, DW_AT_producer, DW_FORM_string, DW_AT_language, DW_FORM_data2, DW_AT_name, DW_FORM_string, DW_AT_comp_dir, DW_FORM_string, DW_AT_stmt_list, DW_FORM_sec_offset, DW_AT_low_pc, DW_FORM_addr, DW_AT_high_pc, DW_FORM_data8 },
+    [ABBREV_SUBPROGRAM]         = { DW_TAG_subprogram, DW_CHILDREN_yes, DW_AT_name, DW_FORM_string, DW_AT_external, DW_FORM_flag, DW_AT_low_pc, DW_FORM_addr, DW_AT_high_pc, DW_FORM_data4, DW_AT_frame_base, DW_FORM_exprloc, DW_AT_type, DW_FORM_ref4 },
+    [ABBREV_SUBPROGRAM_VOID]    = { DW_TAG_subprogram, DW_CHILDREN_yes, DW_AT_name, DW_FORM_string, DW_AT_external, DW_FORM_flag, DW_AT_low_pc, DW_FORM_addr, DW_AT_high_pc, DW_FORM_data4, DW_AT_frame_base, DW_FORM_exprloc },
+    [ABBREV_VARIABLE]           = { DW_TAG_variable, DW_CHILDREN_no, DW_AT_name, DW_FORM_string, DW_AT_type, DW_FORM_ref4, DW_AT_location, DW_FORM_exprloc },
+    [ABBREV_GLOBAL_VARIABLE]    = { DW_TAG_variable, DW_CHILDREN_no, DW_AT_name, DW_FORM_string, DW_AT_type, DW_FORM_ref4, DW_AT_external, DW_FORM_flag, DW_AT_location, DW_FORM_exprloc },
+    [ABBREV_BASE_TYPE]          = { DW_TAG_base_type, DW_CHILDREN_no, DW_AT_name, DW_FORM_string, DW_AT_encoding, DW_FORM_data1, DW_AT_byte_size, DW_FORM_data1 },
+    [ABBREV_POINTER]            = { DW_TAG_pointer_type, DW_CHILDREN_no, DW_AT_byte_size, DW_FORM_data1, DW_AT_type, DW_FORM_ref4 },
+    [ABBREV_TYPEDEF]            = { DW_TAG_typedef, DW_CHILDREN_no, DW_AT_name, DW_FORM_string, DW_AT_type, DW_FORM_ref4 },
+    [ABBREV_STRUCT]             = { DW_TAG_structure_type, DW_CHILDREN_yes, DW_AT_name, DW_FORM_string, DW_AT_byte_size, DW_FORM_udata },
+    [ABBREV_STRUCT_ANON]        = { DW_TAG_structure_type, DW_CHILDREN_yes, DW_AT_byte_size, DW_FORM_udata },
+    [ABBREV_STRUCT_DECL]        = { DW_TAG_structure_type, DW_CHILDREN_no, DW_AT_name, DW_FORM_string, DW_AT_declaration, DW_FORM_flag_present },
+    [ABBREV_UNION]              = { DW_TAG_union_type, DW_CHILDREN_yes, DW_AT_name, DW_FORM_string, DW_AT_byte_size, DW_FORM_udata },
+    [ABBREV_UNION_ANON]         = { DW_TAG_union_type, DW_CHILDREN_yes, DW_AT_byte_size, DW_FORM_udata },
+    [ABBREV_UNION_DECL]         = { DW_TAG_union_type, DW_CHILDREN_no, DW_AT_name, DW_FORM_string, DW_AT_declaration, DW_FORM_flag_present },
+    [ABBREV_MEMBER]             = { DW_TAG_member, DW_CHILDREN_no, DW_AT_name, DW_FORM_string, DW_AT_type, DW_FORM_ref4, DW_AT_data_member_location, DW_FORM_udata },
+    [ABBREV_ARRAY]              = { DW_TAG_array_type, DW_CHILDREN_yes, DW_AT_type, DW_FORM_ref4 },
+    [ABBREV_SUBRANGE]           = { DW_TAG_subrange_type, DW_CHILDREN_no, DW_AT_count, DW_FORM_udata },
+    [ABBREV_SUBROUTINE]         = { DW_TAG_subroutine_type, DW_CHILDREN_yes, DW_AT_prototyped, DW_FORM_flag_present, DW_AT_type, DW_FORM_ref4 },
+    [ABBREV_SUBROUTINE_VOID]    = { DW_TAG_subroutine_type, DW_CHILDREN_yes, DW_AT_prototyped, DW_FORM_flag_present },
+    [ABBREV_FORMAL_PARAM]       = { DW_TAG_formal_parameter, DW_CHILDREN_no, DW_AT_type, DW_FORM_ref4 },
+    [ABBREV_VARARGS]            = { DW_TAG_unspecified_parameters, DW_CHILDREN_no },
+    [ABBREV_VOID]               = { DW_TAG_unspecified_type, DW_CHILDREN_no, DW_AT_name, DW_FORM_string },
+};
+
+typedef struct {
+    uint32_t pos;
+    TB_DebugType* type;
+} DWARF_TypeRef;
+
+typedef struct {
+    TB_Emitter info;
+    TB_ObjectSection* sections;
+    size_t reloc_cap[DWARF_SECTION_COUNT];
+
+    // debug type -> DIE offset, types get emitted once all the
+    // functions are done so every reference is backpatched.
+    NL_Map(TB_DebugType*, uint32_t) type_offsets;
+    DynArray(TB_DebugType*) type_worklist;
+    DynArray(DWARF_TypeRef) type_refs;
+} DWARF_Ctx;
+
+static void dwarf_uleb(TB_Emitter* e, uint64_t x) {
+    do {
+        uint8_t b = x & 0x7F;
+        x >>= 7;
+        tb_out1b(e, x ? b | 0x80 : b);
+    } while (x);
+}
+
+static void dwarf_sleb(TB_Emitter* e, int64_t x) {
+    for (;;) {
+        uint8_t b = x & 0x7F;
+        x >>= 7;
+
+        if ((x == 0 && (b & 0x40) == 0) || (x == -1 && (b & 0x40) != 0)) {
+            tb_out1b(e, b);
+            break;
+        }
+        tb_out1b(e, b | 0x80);
+    }
+}
+
+static void dwarf_string(TB_Emitter* e, const char* str) {
+    tb_outs(e, strlen(str) + 1, str);
+}
+
+static void dwarf_file_name(TB_Emitter* e, TB_SourceFile* f) {
+    if (f != NULL) {
+        tb_outs(e, f->len, f->path);
+        tb_out1b(e, 0);
+    } else {
+        dwarf_string(e, "fallback.c");
+    }
+}
+
+static void dwarf_reloc(DWARF_Ctx* ctx, int section, TB_ObjectRelocType type, uint32_t target, uint32_t pos, int64_t addend) {
+    TB_ObjectSection* s = &ctx->sections[section];
+    if (s->relocation_count == ctx->reloc_cap[section]) {
+        ctx->reloc_cap[section] = ctx->reloc_cap[section] ? ctx->reloc_cap[section] * 2 : 64;
+        s->relocations = tb_platform_heap_realloc(s->relocations, ctx->reloc_cap[section] * sizeof(TB_ObjectReloc));
+    }
+
+    s->relocations[s->relocation_count++] = (TB_ObjectReloc){ type, target, pos, addend };
+}
+
+// 8 byte address into a module section
+static void dwarf_addr(DWARF_Ctx* ctx, int section, TB_Emitter* e, uint32_t module_section, uint64_t offset) {
+    dwarf_reloc(ctx, section, TB_OBJECT_RELOC_ADDR64, module_section, e->count, offset);
+    tb_out8b(e, 0);
+}
+
+static void dwarf_type_ref(DWARF_Ctx* ctx, TB_DebugType* t) {
+    if (nl_map_get(ctx->type_offsets, t) < 0) {
+        nl_map_put(ctx->type_offsets, t, 0);
+        dyn_array_put(ctx->type_worklist, t);
+    }
+
+    DWARF_TypeRef ref = { ctx->info.count, t };
+    dyn_array_put(ctx->type_refs, ref);
+    tb_out4b(&ctx->info, 0);
+}
+
+static const char* dwarf_int_name(bool is_signed, int bits) {
+    if (bits <= 8)  return is_signed ? "char"      : "unsigned char";
+    if (bits <= 16) return is_signed ? "short"     : "unsigned short";
+    if (bits <= 32) return is_signed ? "int"       : "unsigned int";
+    return is_signed ? "long long" : "unsigned long long";
+}
+
+static void dwarf_base_type(TB_Emitter* e, const char* name, int encoding, int size) {
+    dwarf_uleb(e, ABBREV_BASE_TYPE);
+    dwarf_string(e, name);
+    tb_out1b(e, encoding);
+    tb_out1b(e, size);
+}
+
+static void dwarf_emit_type(DWARF_Ctx* ctx, TB_DebugType* t) {
+    TB_Emitter* e = &ctx->info;
+
+    switch (t->tag) {
+        case TB_DEBUG_TYPE_VOID:
+        dwarf_uleb(e, ABBREV_VOID);
+        dwarf_string(e, "void");
+        break;
+
+        case TB_DEBUG_TYPE_BOOL:
+        dwarf_base_type(e, "_Bool", DW_ATE_boolean, 1);
+        break;
+
+        case TB_DEBUG_TYPE_INT:
+        case TB_DEBUG_TYPE_UINT: {
+            bool is_signed = t->tag == TB_DEBUG_TYPE_INT;
+            int size = (t->int_bits + 7) / 8;
+
+            int encoding = is_signed ? DW_ATE_signed : DW_ATE_unsigned;
+            if (size == 1) {
+                encoding = is_signed ? DW_ATE_signed_char : DW_ATE_unsigned_char;
+            }
+
+            dwarf_base_type(e, dwarf_int_name(is_signed, t->int_bits), encoding, size);
+            break;
+        }
+
+        case TB_DEBUG_TYPE_FLOAT:
+        if (t->float_fmt == TB_FLT_32) {
+            dwarf_base_type(e, "float", DW_ATE_float, 4);
+        } else {
+            dwarf_base_type(e, "double", DW_ATE_float, 8);
+        }
+        break;
+
+        case TB_DEBUG_TYPE_POINTER:
+        dwarf_uleb(e, ABBREV_POINTER);
+        tb_out1b(e, 8);
+        dwarf_type_ref(ctx, t->ptr_to);
+        break;
+
+        case TB_DEBUG_TYPE_ALIAS:
+        dwarf_uleb(e, ABBREV_TYPEDEF);
+        dwarf_string(e, t->alias.name);
+        dwarf_type_ref(ctx, t->alias.type);
+        break;
+
+        case TB_DEBUG_TYPE_ARRAY:
+        dwarf_uleb(e, ABBREV_ARRAY);
+        dwarf_type_ref(ctx, t->array.base);
+        dwarf_uleb(e, ABBREV_SUBRANGE);
+        dwarf_uleb(e, t->array.count);
+        tb_out1b(e, 0);
+        break;
+
+        case TB_DEBUG_TYPE_STRUCT:
+        case TB_DEBUG_TYPE_UNION: {
+            bool is_struct = t->tag == TB_DEBUG_TYPE_STRUCT;
+            const char* tag = t->record.tag;
+
+            if (t->record.count == 0) {
+                // incomplete type, just forward declare it
+                dwarf_uleb(e, is_struct ? ABBREV_STRUCT_DECL : ABBREV_UNION_DECL);
+                dwarf_string(e, tag ? tag : "");
+                break;
+            }
+
+            if (tag) {
+                dwarf_uleb(e, is_struct ? ABBREV_STRUCT : ABBREV_UNION);
+                dwarf_string(e, tag);
+            } else {
+                dwarf_uleb(e, is_struct ? ABBREV_STRUCT_ANON : ABBREV_UNION_ANON);
+            }
+            dwarf_uleb(e, t->record.size);
+
+            FOREACH_N(i, 0, t->record.count) {
+                const TB_DebugType* f = t->record.members[i];
+                assert(f->tag == TB_DEBUG_TYPE_FIELD);
+
+                dwarf_uleb(e, ABBREV_MEMBER);
+                dwarf_string(e, f->field.name);
+                dwarf_type_ref(ctx, f->field.type);
+                dwarf_uleb(e, f->field.offset);
+            }
+            tb_out1b(e, 0);
+            break;
+        }
+
+        case TB_DEBUG_TYPE_FUNCTION: {
+            if (t->func.return_count == 1) {
+                dwarf_uleb(e, ABBREV_SUBROUTINE);
+                dwarf_type_ref(ctx, t->func.returns[0]);
+            } else {
+                dwarf_uleb(e, ABBREV_SUBROUTINE_VOID);
+            }
+
+            FOREACH_N(i, 0, t->func.param_count) {
+                TB_DebugType* param = t->func.params[i];
+                if (param->tag == TB_DEBUG_TYPE_FIELD) {
+                    param = param->field.type;
+                }
+
+                dwarf_uleb(e, ABBREV_FORMAL_PARAM);
+                dwarf_type_ref(ctx, param);
+            }
+
+            if (t->func.has_varargs) {
+                dwarf_uleb(e, ABBREV_VARARGS);
+            }
+            tb_out1b(e, 0);
+            break;
+        }
+
+        default:
+        tb_todo();
+    }
+}
+
+static TB_ObjectSection dwarf_abbrev_section(void) {
+    TB_Emitter e = { 0 };
+    FOREACH_N(i, 1, COUNTOF(dwarf_abbrevs)) {
+        const uint8_t* a = dwarf_abbrevs[i];
+
+        dwarf_uleb(&e, i);
+        dwarf_uleb(&e, a[0]);
+        tb_out1b(&e, a[1]);
+
+        for (size_t j = 2; a[j]; j += 2) {
+            dwarf_uleb(&e, a[j]);
+            dwarf_uleb(&e, a[j + 1]);
+        }
+        tb_out2b(&e, 0);
+    }
+    tb_out1b(&e, 0);
+
+    return (TB_ObjectSection){ .name = { sizeof(".debug_abbrev") - 1, (const uint8_t*) ".debug_abbrev" }, .raw_data = { e.count, e.data } };
+}
+
+// each function is its own sequence since they're relocated separately
+static void dwarf_line_program(DWARF_Ctx* ctx, TB_Emitter* e, uint32_t section, TB_FunctionOutput* out_f) {
+    enum { LINE_BASE = -5, LINE_RANGE = 14, OPCODE_BASE = 13 };
+
+    // DW_LNE_set_address
+    tb_out1b(e, 0);
+    dwarf_uleb(e, 9);
+    tb_out1b(e, DW_LNE_set_address);
+    dwarf_addr(ctx, DWARF_SECTION_LINE, e, section, out_f->code_pos);
+
+    int file = 1, line = 1, column = 0;
+    uint32_t pc = 0;
+
+    dyn_array_for(i, out_f->locations) {
+        TB_Location loc = out_f->locations[i];
+        if (loc.file->id + 1 != file) {
+            file = loc.file->id + 1;
+            tb_out1b(e, DW_LNS_set_file);
+            dwarf_uleb(e, file);
+        }
+
+        if (loc.column != column) {
+            column = loc.column;
+            tb_out1b(e, DW_LNS_set_column);
+            dwarf_uleb(e, column);
+        }
+
+        int line_delta = loc.line - line;
+        uint32_t addr_delta = loc.pos - pc;
+        line = loc.line, pc = loc.pos;
+
+        // try to fit it into a special opcode first
+        if (line_delta >= LINE_BASE && line_delta < LINE_BASE + LINE_RANGE) {
+            uint32_t op = (line_delta - LINE_BASE) + (LINE_RANGE * addr_delta) + OPCODE_BASE;
+            if (op <= 255) {
+                tb_out1b(e, op);
+                continue;
+            }
+        }
+
+        if (line_delta) {
+            tb_out1b(e, DW_LNS_advance_line);
+            dwarf_sleb(e, line_delta);
+        }
+
+        if (addr_delta) {
+            tb_out1b(e, DW_LNS_advance_pc);
+            dwarf_uleb(e, addr_delta);
+        }
+        tb_out1b(e, DW_LNS_copy);
+    }
+
+    if (out_f->code_size > pc) {
+        tb_out1b(e, DW_LNS_advance_pc);
+        dwarf_uleb(e, out_f->code_size - pc);
+    }
+
+    tb_out1b(e, 0);
+    dwarf_uleb(e, 1);
+    tb_out1b(e, DW_LNE_end_sequence);
+}
+
+static TB_Emitter dwarf_line_section(DWARF_Ctx* ctx, TB_Module* m, TB_SourceFile** files, size_t file_count) {
+    TB_Emitter e = { 0 };
+
+    size_t length_patch = e.count;
+    tb_out4b(&e, 0);
+    tb_out2b(&e, 5); // version
+    tb_out1b(&e, 8); // address size
+    tb_out1b(&e, 0); // segment selector size
+
+    size_t header_length_patch = e.count;
+    tb_out4b(&e, 0);
+
+    tb_out1b(&e, 1);  // minimum instruction length
+    tb_out1b(&e, 1);  // maximum operations per instruction
+    tb_out1b(&e, 1);  // default is_stmt
+    tb_out1b(&e, -5); // line base
+    tb_out1b(&e, 14); // line range
+    tb_out1b(&e, 13); // opcode base
+
+    static const uint8_t standard_opcode_lengths[12] = { 0, 1, 1, 1, 1, 0, 0, 0, 1, 0, 0, 1 };
+    tb_outs(&e, sizeof(standard_opcode_lengths), standard_opcode_lengths);
+
+    // directory table, just the compilation directory
+    tb_out1b(&e, 1);
+    dwarf_uleb(&e, DW_LNCT_path), dwarf_uleb(&e, DW_FORM_string);
+    dwarf_uleb(&e, 1);
+    dwarf_string(&e, ".");
+
+    // file table, DWARF 5 wants file 0 to be the primary source file so
+    // we just duplicate the first one.
+    tb_out1b(&e, 2);
+    dwarf_uleb(&e, DW_LNCT_path), dwarf_uleb(&e, DW_FORM_string);
+    dwarf_uleb(&e, DW_LNCT_directory_index), dwarf_uleb(&e, DW_FORM_udata);
+    dwarf_uleb(&e, file_count + 1);
+    FOREACH_N(i, 0, file_count + 1) {
+        dwarf_file_name(&e, files[i ? i - 1 : 0]);
+        dwarf_uleb(&e, 0);
+    }
+    tb_patch4b(&e, header_length_patch, e.count - (header_length_patch + 4));
+
+    dyn_array_for(i, m->sections) {
+        DynArray(TB_FunctionOutput*) funcs = m->sections[i].funcs;
+        dyn_array_for(j, funcs) {
+            dwarf_line_program(ctx, &e, i, funcs[j]);
+        }
+    }
+
+    tb_patch4b(&e, length_patch, e.count - (length_patch + 4));
+    return e;
+}
+
+static void dwarf_cfa_pad(TB_Emitter* e, size_t start) {
+    // entries are padded to the address size with DW_CFA_nop
+    while ((e->count - start) % 8) {
+        tb_out1b(e, DW_CFA_nop);
+    }
+    tb_patch4b(e, start, e->count - (start + 4));
+}
+
+static void dwarf_cfa_advance(TB_Emitter* e, uint32_t* loc, uint32_t pos) {
+    uint32_t delta = pos - *loc;
+    if (delta == 0) {
+        return;
+    } else if (delta < 64) {
+        tb_out1b(e, DW_CFA_advance_loc | delta);
+    } else if (delta <= UINT8_MAX) {
+        tb_out1b(e, DW_CFA_advance_loc1);
+        tb_out1b(e, delta);
+    } else if (delta <= UINT16_MAX) {
+        tb_out1b(e, DW_CFA_advance_loc2);
+        tb_out2b(e, delta);
+    } else {
+        tb_out1b(e, DW_CFA_advance_loc4);
+        tb_out4b(e, delta);
+    }
+    *loc = pos;
+}
+
+// CFA is RBP+16 and the old RBP is right below the return address
+static void dwarf_cfa_frame(TB_Emitter* e) {
+    tb_out1b(e, DW_CFA_def_cfa);
+    dwarf_uleb(e, DW_X64_RBP);
+    dwarf_uleb(e, 16);
+    tb_out1b(e, DW_CFA_offset | DW_X64_RBP);
+    dwarf_uleb(e, 2);
+}
+
+// back to the CIE's rules
+static void dwarf_cfa_no_frame(TB_Emitter* e) {
+    tb_out1b(e, DW_CFA_def_cfa);
+    dwarf_uleb(e, DW_X64_RSP);
+    dwarf_uleb(e, 8);
+    tb_out1b(e, DW_CFA_restore | DW_X64_RBP);
+}
+
+static TB_Emitter dwarf_eh_frame_section(DWARF_Ctx* ctx, TB_Module* m) {
+    TB_Emitter e = { 0 };
+
+    // CIE: at entry the CFA is RSP+8 and the return address sits right below it
+    size_t cie_start = e.count;
+    tb_out4b(&e, 0);
+    tb_out4b(&e, 0); // CIE id
+    tb_out1b(&e, 1); // version
+    dwarf_string(&e, "zR");
+    dwarf_uleb(&e, 1);  // code alignment factor
+    dwarf_sleb(&e, -8); // data alignment factor
+    dwarf_uleb(&e, DW_X64_RIP);
+    dwarf_uleb(&e, 1);  // augmentation data length
+    tb_out1b(&e, DW_EH_PE_pcrel | DW_EH_PE_sdata4);
+
+    tb_out1b(&e, DW_CFA_def_cfa);
+    dwarf_uleb(&e, DW_X64_RSP);
+    dwarf_uleb(&e, 8);
+    tb_out1b(&e, DW_CFA_offset | DW_X64_RIP);
+    dwarf_uleb(&e, 1);
+    dwarf_cfa_pad(&e, cie_start);
+
+    dyn_array_for(i, m->sections) {
+        DynArray(TB_FunctionOutput*) funcs = m->sections[i].funcs;
+        dyn_array_for(j, funcs) {
+            TB_FunctionOutput* out_f = funcs[j];
+
+            size_t fde_start = e.count;
+            tb_out4b(&e, 0);
+            tb_out4b(&e, e.count - cie_start); // CIE pointer
+
+            dwarf_reloc(ctx, DWARF_SECTION_EH_FRAME, TB_OBJECT_RELOC_REL32, i, e.count, out_f->code_pos);
+            tb_out4b(&e, 0);
+            tb_out4b(&e, out_f->code_size);
+            dwarf_uleb(&e, 0); // augmentation data length
+
+            // the x64 prologue is either nothing or:
+            //   push rbp       (1 byte)
+            //   mov rbp, rsp   (3 bytes)
+            //   sub rsp, N
+            //
+            // it's not always at the entry (shrink wrapping) so we walk the
+            // places where the frame comes and goes.
+            uint32_t loc = 0;
+            bool has_frame = false;
+            dyn_array_for(k, out_f->frame_changes) {
+                TB_FrameChange* c = &out_f->frame_changes[k];
+                if (c->has_frame && c->pos == out_f->prologue_pos && out_f->prologue_length > 0) {
+                    if (has_frame) {
+                        dwarf_cfa_advance(&e, &loc, c->pos);
+                        dwarf_cfa_no_frame(&e);
+                    }
+
+                    dwarf_cfa_advance(&e, &loc, c->pos + 1);
+                    tb_out1b(&e, DW_CFA_def_cfa_offset);
+                    dwarf_uleb(&e, 16);
+                    tb_out1b(&e, DW_CFA_offset | DW_X64_RBP);
+                    dwarf_uleb(&e, 2);
+                    dwarf_cfa_advance(&e, &loc, c->pos + 4);
+                    tb_out1b(&e, DW_CFA_def_cfa_register);
+                    dwarf_uleb(&e, DW_X64_RBP);
+                } else if (c->has_frame != has_frame) {
+                    dwarf_cfa_advance(&e, &loc, c->pos);
+                    if (c->has_frame) {
+                        dwarf_cfa_frame(&e);
+                    } else {
+                        dwarf_cfa_no_frame(&e);
+                    }
+                }
+                has_frame = c->has_frame;
+            }
+            dwarf_cfa_pad(&e, fde_start);
+        }
+    }
+
+    return e;
+}
+
+static bool dwarf_supported_target(TB_Module* m) {
+    return m->target_arch == TB_ARCH_X86_64;
+}
+
+static int dwarf_number_of_debug_sections(TB_Module* m) {
+    return DWARF_SECTION_COUNT;
+}
+
+static TB_SectionGroup dwarf_generate_debug_info(TB_Module* m, TB_TemporaryStorage* tls) {
+    TB_ObjectSection* sections = tb_platform_heap_alloc(DWARF_SECTION_COUNT * sizeof(TB_ObjectSection));
+    DWARF_Ctx ctx = { .sections = sections };
+
+    sections[DWARF_SECTION_ABBREV] = dwarf_abbrev_section();
+    sections[DWARF_SECTION_INFO]   = (TB_ObjectSection){ .name = { sizeof(".debug_info") - 1, (const uint8_t*) ".debug_info" } };
+    sections[DWARF_SECTION_LINE]   = (TB_ObjectSection){ .name = { sizeof(".debug_line") - 1, (const uint8_t*) ".debug_line" } };
+    sections[DWARF_SECTION_EH_FRAME] = (TB_ObjectSection){ .name = { sizeof(".eh_frame") - 1, (const uint8_t*) ".eh_frame" }, .flags = TB_SHF_ALLOC };
+
+    // assign file IDs in a stable order
+    size_t file_count = m->files ? nl_map__get_header(m->files)->count : 0;
+    TB_SourceFile** files = tb_tls_push(tls, (file_count ? file_count : 1) * sizeof(TB_SourceFile*));
+    {
+        size_t counter = 0;
+        nl_map_for_str(i, m->files) {
+            TB_SourceFile* f = m->files[i].v;
+            f->id = counter;
+            files[counter++] = f;
+        }
+    }
+
+    if (file_count == 0) {
+        files[0] = NULL;
+    }
+
+    // if all the code lives in one section we can describe the CU with a single range
+    int code_section = -1;
+    dyn_array_for(i, m->sections) {
+        if (dyn_array_length(m->sections[i].funcs) == 0) continue;
+
+        code_section = code_section == -1 ? i : -2;
+    }
+
+    nl_map_create(ctx.type_offsets, 64);
+    dyn_array_create(ctx.type_worklist, 64);
+    dyn_array_create(ctx.type_refs, 64);
+
+    TB_Emitter* e = &ctx.info;
+    CUIK_TIMED_BLOCK("dwarf: info") {
+        size_t length_patch = e->count;
+        tb_out4b(e, 0);
+        tb_out2b(e, 5); // version
+        tb_out1b(e, DW_UT_compile);
+        tb_out1b(e, 8); // address size
+        dwarf_reloc(&ctx, DWARF_SECTION_INFO, TB_OBJECT_RELOC_SECREL, DWARF_SECTION_ABBREV, e->count, 0);
+        tb_out4b(e, 0);
+
+        dwarf_uleb(e, code_section >= 0 ? ABBREV_COMPILE_UNIT_RANGE : ABBREV_COMPILE_UNIT);
+        dwarf_string(e, "TB " STR(TB_VERSION_MAJOR) "." STR(TB_VERSION_MINOR) "." STR(TB_VERSION_PATCH));
+        tb_out2b(e, DW_LANG_C11);
+        dwarf_file_name(e, files[0]);
+        dwarf_string(e, ".");
+        dwarf_reloc(&ctx, DWARF_SECTION_INFO, TB_OBJECT_RELOC_SECREL, DWARF_SECTION_LINE, e->count, 0);
+        tb_out4b(e, 0);
+        if (code_section >= 0) {
+            dwarf_addr(&ctx, DWARF_SECTION_INFO, e, code_section, 0);
+            tb_out8b(e, m->sections[code_section].total_size);
+        } else {
+            // functions carry their own ranges, this is just the base address
+            tb_out8b(e, 0);
+        }
+
+        dyn_array_for(i, m->sections) {
+            DynArray(TB_Global*) globals = m->sections[i].globals;
+            dyn_array_for(j, globals) {
+                TB_Global* g = globals[j];
+                if (g->super.name == NULL || g->dbg_type == NULL) continue;
+
+                dwarf_uleb(e, ABBREV_GLOBAL_VARIABLE);
+                dwarf_string(e, g->super.name);
+                dwarf_type_ref(&ctx, g->dbg_type);
+                tb_out1b(e, g->linkage == TB_LINKAGE_PUBLIC);
+                dwarf_uleb(e, 9);
+                tb_out1b(e, DW_OP_addr);
+                dwarf_addr(&ctx, DWARF_SECTION_INFO, e, i, g->pos);
+            }
+        }
+
+        dyn_array_for(i, m->sections) {
+            DynArray(TB_FunctionOutput*) funcs = m->sections[i].funcs;
+            dyn_array_for(j, funcs) {
+                TB_FunctionOutput* out_f = funcs[j];
+                TB_Function* f = out_f->parent;
+                const TB_FunctionPrototype* proto = f->prototype;
+
+                TB_DebugType* ret_type = NULL;
+                if (proto->return_count == 1) {
+                    ret_type = TB_PROTOTYPE_RETURNS(proto)[0].debug_type;
+                }
+
+                dwarf_uleb(e, ret_type ? ABBREV_SUBPROGRAM : ABBREV_SUBPROGRAM_VOID);
+                dwarf_string(e, f->super.name);
+                tb_out1b(e, f->linkage == TB_LINKAGE_PUBLIC);
+                dwarf_addr(&ctx, DWARF_SECTION_INFO, e, i, out_f->code_pos);
+                tb_out4b(e, out_f->code_size);
+                dwarf_uleb(e, 1);
+                tb_out1b(e, DW_OP_call_frame_cfa);
+                if (ret_type) {
+                    dwarf_type_ref(&ctx, ret_type);
+                }
+
+                // stack slots are RBP-relative
+                dyn_array_for(k, out_f->stack_slots) {
+                    TB_StackSlot* s = &out_f->stack_slots[k];
+                    if (s->name == NULL || s->storage_type == NULL) continue;
+
+                    dwarf_uleb(e, ABBREV_VARIABLE);
+                    dwarf_string(e, s->name);
+                    dwarf_type_ref(&ctx, s->storage_type);
+
+                    size_t loc_patch = e->count;
+                    tb_out1b(e, 0);
+                    tb_out1b(e, DW_OP_breg0 + DW_X64_RBP);
+                    dwarf_sleb(e, s->position);
+                    tb_patch1b(e, loc_patch, e->count - (loc_patch + 1));
+                }
+                tb_out1b(e, 0);
+            }
+        }
+
+        // types get appended as children of the CU, emitting one might
+        // queue up more.
+        for (size_t i = 0; i < dyn_array_length(ctx.type_worklist); i++) {
+            TB_DebugType* t = ctx.type_worklist[i];
+            ctx.type_offsets[nl_map_get(ctx.type_offsets, t)].v = e->count;
+            dwarf_emit_type(&ctx, t);
+        }
+        tb_out1b(e, 0);
+
+        dyn_array_for(i, ctx.type_refs) {
+            DWARF_TypeRef ref = ctx.type_refs[i];
+            tb_patch4b(e, ref.pos, nl_map_get_checked(ctx.type_offsets, ref.type));
+        }
+
+        tb_patch4b(e, length_patch, e->count - (length_patch + 4));
+    }
+
+    TB_Emitter line, eh_frame;
+    CUIK_TIMED_BLOCK("dwarf: line") {
+        line = dwarf_line_section(&ctx, m, files, file_count ? file_count : 1);
+    }
+
+    CUIK_TIMED_BLOCK("dwarf: eh_frame") {
+        eh_frame = dwarf_eh_frame_section(&ctx, m);
+    }
+
+    sections[DWARF_SECTION_INFO].raw_data = (TB_Slice){ e->count, e->data };
+    sections[DWARF_SECTION_LINE].raw_data = (TB_Slice){ line.count, line.data };
+    sections[DWARF_SECTION_EH_FRAME].raw_data = (TB_Slice){ eh_frame.count, eh_frame.data };
+
+    nl_map_free(ctx.type_offsets);
+    dyn_array_destroy(ctx.type_worklist);
+    dyn_array_destroy(ctx.type_refs);
+    tb_tls_restore(tls, files);
+
+    return (TB_SectionGroup) { DWARF_SECTION_COUNT, sections };
+}
+
+IDebugFormat tb__dwarf_debug_format = {
+    "DWARF",
+    dwarf_supported_target,
+    dwarf_number_of_debug_sections,
+    dwarf_generate_debug_info
+};
@@ -0,0 +1,135 @@
+#pragma once
+
+// DWARF 5 constants, only the subset TB actually emits
+enum {
+    DW_UT_compile = 0x01,
+};
+
+enum {
+    DW_TAG_array_type       = 0x01,
+    DW_TAG_member           = 0x0d,
+    DW_TAG_pointer_type     = 0x0f,
+    DW_TAG_compile_unit     = 0x11,
+    DW_TAG_structure_type   = 0x13,
+    DW_TAG_subroutine_type  = 0x15,
+    DW_TAG_typedef          = 0x16,
+    DW_TAG_union_type       = 0x17,
+    DW_TAG_formal_parameter = 0x05,
+    DW_TAG_unspecified_parameters = 0x18,
+    DW_TAG_subrange_type    = 0x21,
+    DW_TAG_base_type        = 0x24,
+    DW_TAG_subprogram       = 0x2e,
+    DW_TAG_variable         = 0x34,
+    DW_TAG_unspecified_type = 0x3b,
+};
+
+enum {
+    DW_CHILDREN_no  = 0,
+    DW_CHILDREN_yes = 1,
+};
+
+enum {
+    DW_AT_location             = 0x02,
+    DW_AT_name                 = 0x03,
+    DW_AT_byte_size            = 0x0b,
+    DW_AT_stmt_list            = 0x10,
+    DW_AT_low_pc               = 0x11,
+    DW_AT_high_pc              = 0x12,
+    DW_AT_language             = 0x13,
+    DW_AT_comp_dir             = 0x1b,
+    DW_AT_producer             = 0x25,
+    DW_AT_prototyped           = 0x27,
+    DW_AT_count                = 0x37,
+    DW_AT_data_member_location = 0x38,
+    DW_AT_declaration          = 0x3c,
+    DW_AT_encoding             = 0x3e,
+    DW_AT_external             = 0x3f,
+    DW_AT_frame_base           = 0x40,
+    DW_AT_type                 = 0x49,
+};
+
+enum {
+    DW_FORM_addr         = 0x01,
+    DW_FORM_data2        = 0x05,
+    DW_FORM_data4        = 0x06,
+    DW_FORM_data8        = 0x07,
+    DW_FORM_string       = 0x08,
+    DW_FORM_data1        = 0x0b,
+    DW_FORM_flag         = 0x0c,
+    DW_FORM_udata        = 0x0f,
+    DW_FORM_ref4         = 0x13,
+    DW_FORM_sec_offset   = 0x17,
+    DW_FORM_exprloc      = 0x18,
+    DW_FORM_flag_present = 0x19,
+};
+
+enum {
+    DW_ATE_boolean       = 0x02,
+    DW_ATE_float         = 0x04,
+    DW_ATE_signed        = 0x05,
+    DW_ATE_signed_char   = 0x06,
+    DW_ATE_unsigned      = 0x07,
+    DW_ATE_unsigned_char = 0x08,
+};
+
+enum {
+    DW_LANG_C11 = 0x1d,
+};
+
+enum {
+    DW_OP_addr           = 0x03,
+    DW_OP_breg0          = 0x70,
+    DW_OP_call_frame_cfa = 0x9c,
+};
+
+// line number program
+enum {
+    DW_LNS_copy             = 0x01,
+    DW_LNS_advance_pc       = 0x02,
+    DW_LNS_advance_line     = 0x03,
+    DW_LNS_set_file         = 0x04,
+    DW_LNS_set_column       = 0x05,
+    DW_LNS_negate_stmt      = 0x06,
+    DW_LNS_set_basic_block  = 0x07,
+    DW_LNS_const_add_pc     = 0x08,
+    DW_LNS_fixed_advance_pc = 0x09,
+    DW_LNS_set_prologue_end = 0x0a,
+    DW_LNS_set_epilogue_begin = 0x0b,
+    DW_LNS_set_isa          = 0x0c,
+};
+
+enum {
+    DW_LNE_end_sequence = 0x01,
+    DW_LNE_set_address  = 0x02,
+};
+
+enum {
+    DW_LNCT_path            = 0x1,
+    DW_LNCT_directory_index = 0x2,
+};
+
+// call frame instructions
+enum {
+    DW_CFA_advance_loc        = 0x40,
+    DW_CFA_offset             = 0x80,
+    DW_CFA_restore            = 0xc0,
+    DW_CFA_nop                = 0x00,
+    DW_CFA_advance_loc1       = 0x02,
+    DW_CFA_advance_loc2       = 0x03,
+    DW_CFA_advance_loc4       = 0x04,
+    DW_CFA_def_cfa            = 0x0c,
+    DW_CFA_def_cfa_register   = 0x0d,
+    DW_CFA_def_cfa_offset     = 0x0e,
+};
+
+enum {
+    DW_EH_PE_sdata4 = 0x0b,
+    DW_EH_PE_pcrel  = 0x10,
+};
+
+// x86-64 DWARF register numbers
+enum {
+    DW_X64_RBP = 6,
+    DW_X64_RSP = 7,
+    DW_X64_RIP = 16,
+};
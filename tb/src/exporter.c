@@ -7,7 +7,7 @@ TB_ExportBuffer tb_wasm_write_output(TB_Module* restrict m, const IDebugFormat*
 
 static const IDebugFormat* find_debug_format(TB_DebugFormat debug_fmt) {
     switch (debug_fmt) {
-        // case TB_DEBUGFMT_DWARF: return &tb__dwarf_debug_format;
+        case TB_DEBUGFMT_DWARF: return &tb__dwarf_debug_format;
         case TB_DEBUGFMT_CODEVIEW: return &tb__codeview_debug_format;
         default: return NULL;
     }
@@ -91,8 +91,104 @@ static void layout_section(TB_ModuleSection* restrict section) {
     }
 }
 
-ExportList tb_module_layout_sections(TB_Module* m) {
+// the cold part of the function becomes its own TB_FunctionOutput in .text.cold,
+// patches are moved over and the jumps between the two now hold the target's
+// offset within the other part.
+static TB_FunctionOutput* split_cold_part(TB_Module* m, TB_FunctionOutput* out_f) {
+    if (out_f->cold_part != NULL) {
+        // we've already split it in a previous export
+        return out_f->cold_part;
+    }
+
+    uint32_t cold_start = out_f->cold_start;
+    TB_FunctionOutput* cold = tb__alloc_function_output(out_f->parent, 0);
+    cold->section = m->text_cold;
+    cold->code = out_f->code + cold_start;
+    cold->code_size = out_f->code_size - cold_start;
+    cold->hot_part = out_f;
+    out_f->cold_part = cold;
+    out_f->code_size = cold_start;
+
+    TB_SymbolPatch* p = out_f->first_patch;
+    out_f->first_patch = out_f->last_patch = NULL;
+    out_f->patch_count = 0;
+    while (p != NULL) {
+        TB_SymbolPatch* next = p->next;
+        TB_FunctionOutput* part = out_f;
+        if (p->pos >= cold_start) {
+            p->pos -= cold_start;
+            part = cold;
+        }
+
+        p->next = NULL;
+        if (part->last_patch) {
+            part->last_patch->next = p;
+        } else {
+            part->first_patch = p;
+        }
+        part->last_patch = p;
+        part->patch_count += 1;
+        p = next;
+    }
+
+    // the cold part starts with whatever frame state the hot code left off with
+    DynArray(TB_FrameChange) changes = out_f->frame_changes;
+    out_f->frame_changes = NULL;
+    bool has_frame = false;
+    dyn_array_for(i, changes) {
+        TB_FrameChange c = changes[i];
+        if (c.pos < cold_start) {
+            dyn_array_put(out_f->frame_changes, c);
+            has_frame = c.has_frame;
+            continue;
+        }
+
+        if (dyn_array_length(cold->frame_changes) == 0 && c.pos > cold_start && has_frame) {
+            dyn_array_put(cold->frame_changes, (TB_FrameChange){ 0, true });
+        }
+
+        c.pos -= cold_start;
+        dyn_array_put(cold->frame_changes, c);
+    }
+
+    if (dyn_array_length(cold->frame_changes) == 0 && has_frame) {
+        dyn_array_put(cold->frame_changes, (TB_FrameChange){ 0, true });
+    }
+    dyn_array_destroy(changes);
+
+    if (out_f->prologue_pos >= cold_start) {
+        cold->prologue_pos = out_f->prologue_pos - cold_start;
+        cold->prologue_length = out_f->prologue_length;
+        out_f->prologue_length = 0;
+    }
+
+    DynArray(uint32_t) jumps = out_f->cold_jumps;
+    out_f->cold_jumps = NULL;
+    dyn_array_for(i, jumps) {
+        uint32_t pos = jumps[i];
+
+        int32_t disp;
+        memcpy(&disp, &out_f->code[pos], sizeof(disp));
+        uint32_t target = pos + 4 + disp;
+
+        if (pos < cold_start) {
+            // into the cold part
+            target -= cold_start;
+            dyn_array_put(out_f->cold_jumps, pos);
+        } else {
+            dyn_array_put(cold->cold_jumps, pos - cold_start);
+        }
+
+        memcpy(&out_f->code[pos], &target, sizeof(target));
+    }
+    dyn_array_destroy(jumps);
+
+    return cold;
+}
+
+ExportList tb_module_layout_sections(TB_Module* m, bool split_cold) {
     TB_Arena* arena = &tb_thread_info(m)->tmp_arena;
+    DynArray(TB_FunctionOutput*) to_split = NULL;
 
     size_t external_count = 0;
     TB_External** externals = tb_arena_alloc(arena, m->symbol_count[TB_SYMBOL_EXTERNAL] * sizeof(TB_External*));
@@ -104,8 +200,9 @@ ExportList tb_module_layout_sections(TB_Module* m) {
         TB_ThreadInfo* next = info->next_in_module;
 
         // unpack symbols
+        // threads which never made a symbol don't have a table
         TB_Symbol** syms = (TB_Symbol**) info->symbols.data;
-        size_t cap = 1ull << info->symbols.exp;
+        size_t cap = syms ? 1ull << info->symbols.exp : 0;
         for (size_t i = 0; i < cap; i++) {
             TB_Symbol* s = syms[i];
             if (s == NULL || s == NL_HASHSET_TOMB) continue;
@@ -120,6 +217,10 @@ ExportList tb_module_layout_sections(TB_Module* m) {
                     if (out_f != NULL) {
                         out_f->ordinal = f->super.ordinal;
                         dyn_array_put(sec->funcs, out_f);
+
+                        if (split_cold && out_f->cold_start > 0) {
+                            dyn_array_put(to_split, out_f);
+                        }
                     }
                     break;
                 }
@@ -140,6 +241,19 @@ ExportList tb_module_layout_sections(TB_Module* m) {
         info = next;
     }
 
+    if (dyn_array_length(to_split) > 0) {
+        if (m->text_cold == 0) {
+            m->text_cold = tb_module_create_section(m, -1, ".text.cold", TB_MODULE_SECTION_EXEC, TB_COMDAT_NONE);
+        }
+
+        dyn_array_for(i, to_split) {
+            TB_FunctionOutput* cold = split_cold_part(m, to_split[i]);
+            cold->ordinal = to_split[i]->ordinal;
+            dyn_array_put(m->sections[m->text_cold].funcs, cold);
+        }
+    }
+    dyn_array_destroy(to_split);
+
     dyn_array_for(i, m->sections) {
         TB_ModuleSection* sec = &m->sections[i];
 
@@ -209,7 +323,13 @@ size_t tb__layout_relocations(TB_Module* m, DynArray(TB_ModuleSection) sections,
         size_t reloc_count = 0;
 
         dyn_array_for(i, sec->funcs) {
-            reloc_count += code_gen->emit_call_patches(m, sec->funcs[i]);
+            TB_FunctionOutput* out_f = sec->funcs[i];
+            reloc_count += code_gen->emit_call_patches(m, out_f);
+
+            // jumps between the hot and cold parts of a split function
+            if (out_f->cold_part || out_f->hot_part) {
+                reloc_count += dyn_array_length(out_f->cold_jumps);
+            }
         }
 
         dyn_array_for(j, sec->globals) {
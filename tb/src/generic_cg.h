@@ -46,6 +46,9 @@ typedef struct MachineBB {
     int start, end;
     int terminator;
 
+    // copied from the TB_BasicBlock, it weighs the uses for spilling
+    float freq;
+
     // local live sets
     Set gen, kill;
     // global
@@ -84,6 +87,13 @@ typedef struct {
     int bb_count;
     int* bb_order;
 
+    // bb_order[cold_bb...] are the cold blocks (see layout_blocks), bb_count
+    // if there's none. When there is, emit_code tracks where every rel32 jump
+    // to a label ended up so we know which ones cross between the hot and cold
+    // code.
+    int cold_bb;
+    DynArray(uint32_t) label_refs;
+
     // Scheduling
     TB_CFG cfg;
     Worklist worklist; // reusing from TB_Passes.
@@ -104,12 +114,18 @@ typedef struct {
     // Line info
     DynArray(TB_Location) locations;
 
+    // Stack maps
+    DynArray(TB_SafepointKey) safepoints;
+
     // Stack
     uint32_t stack_usage;
     NL_Map(TB_Node*, int) stack_slots;
     DynArray(TB_StackSlot) debug_stack_slots;
 
     uint64_t regs_to_save;
+
+    // Shrink wrapping
+    int* wrap_doms;
 } Ctx;
 
 typedef struct {
@@ -140,6 +156,7 @@ static bool should_rematerialize(TB_Node* n);
 
 static void emit_code(Ctx* restrict ctx, TB_FunctionOutput* restrict func_out);
 static void mark_callee_saved_constraints(Ctx* restrict ctx, uint64_t callee_saved[CG_REGISTER_CLASSES]);
+static bool needs_frame(Ctx* restrict ctx, Inst* inst);
 
 static void add_debug_local(Ctx* restrict ctx, TB_Node* n, int pos) {
     ptrdiff_t search = nl_map_get(ctx->f->attribs, n);
@@ -424,6 +441,166 @@ static Inst* inst_op_zero(TB_DataType dt, RegIndex dst) {
     return i;
 }
 
+// safepoints attach their data inputs as saves, they don't care about
+// memory or reg, just that they're available at that instruction.
+static Inst* inst_add_saves(Inst* inst, int save_count, RegIndex* saves) {
+    if (save_count == 0) {
+        return inst;
+    }
+
+    assert(save_count <= UINT8_MAX);
+    int total = inst->out_count + inst->in_count + inst->tmp_count;
+    Inst* i = tb_arena_alloc(tmp_arena, sizeof(Inst) + ((total + save_count) * sizeof(RegIndex)));
+    memcpy(i, inst, sizeof(Inst) + (total * sizeof(RegIndex)));
+    memcpy(&i->operands[total], saves, save_count * sizeof(RegIndex));
+    i->save_count = save_count;
+    return i;
+}
+
+////////////////////////////////
+// Shrink wrapping
+////////////////////////////////
+// the frame and the callee saves don't need to be set up at the entry, just
+// before any of the blocks which use them. We start at the nearest common
+// dominator of those blocks and hoist it up until it's not in a loop and
+// everything reachable from it can only be entered through it (the epilogues
+// undo whatever we did so they can't be reachable through paths which skipped
+// it), worst case we're back at the entry.
+//
+// returns -1 for unreachable preds, unlike get_pred we want the branch
+// projections as their own blocks since the edge into a loop is usually where
+// the wrap point ends up.
+static int shrink_wrap_pred(Ctx* restrict ctx, TB_Node* bb, int i) {
+    TB_Node* n = bb->inputs[i];
+    while (!cfg_is_bb_entry(n)) {
+        n = n->inputs[0];
+    }
+
+    ptrdiff_t search = nl_map_get(ctx->cfg.node_to_block, n);
+    return search >= 0 ? ctx->cfg.node_to_block[search].v.id : -1;
+}
+
+static int shrink_wrap_common_dom(int* doms, int a, int b) {
+    while (a != b) {
+        while (a > b) a = doms[a];
+        while (b > a) b = doms[b];
+    }
+    return a;
+}
+
+// the dominator tree from the scheduler skips over those edge blocks so we
+// compute our own over the blocks codegen actually has.
+static void shrink_wrap_doms(Ctx* restrict ctx) {
+    TB_Node** bbs = ctx->worklist.items;
+    size_t n = ctx->cfg.block_count;
+
+    int* doms = tb_arena_alloc(tmp_arena, n * sizeof(int));
+    FOREACH_N(i, 0, n) doms[i] = -1;
+    doms[0] = 0;
+
+    // block ids are already in reverse postorder
+    bool changed = true;
+    while (changed) {
+        changed = false;
+
+        FOREACH_N(i, 1, n) {
+            int new_idom = -1;
+            size_t pred_count = bbs[i]->type == TB_REGION ? bbs[i]->input_count : 1;
+            FOREACH_N(j, 0, pred_count) {
+                int p = shrink_wrap_pred(ctx, bbs[i], j);
+                if (p >= 0 && doms[p] >= 0) {
+                    new_idom = new_idom < 0 ? p : shrink_wrap_common_dom(doms, new_idom, p);
+                }
+            }
+
+            if (doms[i] != new_idom) {
+                doms[i] = new_idom;
+                changed = true;
+            }
+        }
+    }
+
+    ctx->wrap_doms = doms;
+}
+
+static void shrink_wrap_push(Ctx* restrict ctx, TB_Node* succ, bool* reached, int* stack, int* top) {
+    int id = nl_map_get_checked(ctx->cfg.node_to_block, succ).id;
+    if (!reached[id]) {
+        reached[id] = true;
+        stack[(*top)++] = id;
+    }
+}
+
+// reached ends up being the region the point covers
+static bool shrink_wrap_valid(Ctx* restrict ctx, int point, bool* reached, int* stack) {
+    TB_Node** bbs = ctx->worklist.items;
+    memset(reached, 0, ctx->cfg.block_count * sizeof(bool));
+
+    int top = 0;
+    stack[top++] = point;
+    while (top > 0) {
+        TB_BasicBlock* bb = &nl_map_get_checked(ctx->cfg.node_to_block, bbs[stack[--top]]);
+
+        TB_Node* end = bb->end;
+        if (end->type == TB_BRANCH) {
+            for (User* u = end->users; u; u = u->next) {
+                if (u->n->type == TB_PROJ) {
+                    shrink_wrap_push(ctx, cfg_next_bb_after_cproj(u->n), reached, stack, &top);
+                }
+            }
+        } else if (!cfg_is_endpoint(end)) {
+            TB_Node* succ = cfg_next_control(end);
+            if (succ) shrink_wrap_push(ctx, succ, reached, stack, &top);
+        }
+    }
+
+    if (reached[point]) {
+        return false;
+    }
+
+    // nothing can come in from the side
+    FOREACH_N(i, 0, ctx->cfg.block_count) if (reached[i] && bbs[i]->type == TB_REGION) {
+        FOREACH_N(j, 0, bbs[i]->input_count) {
+            int pred = shrink_wrap_pred(ctx, bbs[i], j);
+            if (pred >= 0 && pred != point && !reached[pred]) return false;
+        }
+    }
+
+    reached[point] = true;
+    return true;
+}
+
+// uses is indexed by block id, returns the block which should do the setup or
+// -1 if none of them need it. covered[i] is set for the blocks which run after
+// the setup.
+static int shrink_wrap_point(Ctx* restrict ctx, bool* uses, bool* covered) {
+    size_t n = ctx->cfg.block_count;
+    int* doms = ctx->wrap_doms;
+
+    int point = -1;
+    FOREACH_N(i, 0, n) if (uses[i]) {
+        point = point < 0 ? i : shrink_wrap_common_dom(doms, point, i);
+    }
+
+    if (point < 0) {
+        memset(covered, 0, n * sizeof(bool));
+        return -1;
+    }
+
+    TB_ArenaSavepoint sp = tb_arena_save(tmp_arena);
+    int* stack = tb_arena_alloc(tmp_arena, n * sizeof(int));
+    while (point != 0 && !shrink_wrap_valid(ctx, point, covered, stack)) {
+        point = doms[point];
+    }
+    tb_arena_restore(tmp_arena, sp);
+
+    if (point == 0) {
+        FOREACH_N(i, 0, n) covered[i] = true;
+    }
+
+    return point;
+}
+
 ////////////////////////////////
 // Register allocation
 ////////////////////////////////
@@ -446,6 +623,96 @@ static int alloc_vreg(Ctx* restrict ctx, TB_Node* n, TB_DataType dt) {
     return i;
 }
 
+// values which live across calls get callee saved registers, if they're also
+// live before the calls then the save ends up there too even if that code
+// doesn't need it (early outs which read params). Anything live into the
+// region where the frame's needed gets copied into a new vreg at the start of
+// it so the regalloc can keep the two parts in different registers.
+static void shrink_wrap_split(Ctx* restrict ctx) {
+    size_t n = ctx->cfg.block_count;
+    bool* uses = tb_arena_alloc(tmp_arena, n * sizeof(bool));
+    bool* covered = tb_arena_alloc(tmp_arena, n * sizeof(bool));
+    memset(uses, 0, n * sizeof(bool));
+
+    int bb = 0;
+    for (Inst* inst = ctx->first; inst; inst = inst->next) {
+        if (inst->type == INST_LABEL) {
+            bb = nl_map_get_checked(ctx->cfg.node_to_block, inst->n).id;
+        } else if (!uses[bb] && needs_frame(ctx, inst)) {
+            uses[bb] = true;
+        }
+    }
+
+    int point = shrink_wrap_point(ctx, uses, covered);
+    if (point <= 0) {
+        return;
+    }
+
+    // which vregs show up on both sides
+    size_t interval_count = dyn_array_length(ctx->intervals);
+    uint8_t* sides = tb_arena_alloc(tmp_arena, interval_count);
+    memset(sides, 0, interval_count);
+
+    Inst* label = NULL;
+    bool inside = false;
+    for (Inst* inst = ctx->first; inst; inst = inst->next) {
+        if (inst->type == INST_LABEL) {
+            int id = nl_map_get_checked(ctx->cfg.node_to_block, inst->n).id;
+            inside = covered[id];
+            if (id == point) label = inst;
+            continue;
+        }
+
+        FOREACH_N(i, 0, inst->out_count + inst->in_count + inst->tmp_count + inst->save_count) {
+            if (inst->operands[i] >= 0) sides[inst->operands[i]] |= inside ? 2 : 1;
+        }
+    }
+
+    RegIndex* remap = tb_arena_alloc(tmp_arena, interval_count * sizeof(RegIndex));
+    FOREACH_N(i, 0, interval_count) {
+        remap[i] = i;
+
+        // physical registers stay put
+        if (i < 32 || sides[i] != 3) continue;
+
+        LiveInterval* old = &ctx->intervals[i];
+        remap[i] = dyn_array_length(ctx->intervals);
+        dyn_array_put(ctx->intervals, (LiveInterval){
+                .reg_class = old->reg_class,
+                .n = old->n, .reg = -1, .hint = -1, .assigned = -1,
+                .dt = old->dt, .split_kid = -1
+            });
+
+        LiveInterval* it = &ctx->intervals[remap[i]];
+        it->ranges = tb_platform_heap_alloc(4 * sizeof(LiveRange));
+        it->range_count = 1;
+        it->range_cap = 4;
+        it->ranges[0] = (LiveRange){ INT_MAX, INT_MAX };
+    }
+
+    inside = false;
+    for (Inst* inst = ctx->first; inst; inst = inst->next) {
+        if (inst->type == INST_LABEL) {
+            inside = covered[nl_map_get_checked(ctx->cfg.node_to_block, inst->n).id];
+        } else if (inside) {
+            FOREACH_N(i, 0, inst->out_count + inst->in_count + inst->tmp_count + inst->save_count) {
+                if (inst->operands[i] >= 0) inst->operands[i] = remap[inst->operands[i]];
+            }
+        }
+    }
+
+    // copy into the new vregs as we enter the region
+    FOREACH_N(i, 32, interval_count) if (remap[i] != i) {
+        TB_X86_DataType dt = ctx->intervals[i].dt;
+        Inst* mov = tb_arena_alloc(tmp_arena, sizeof(Inst) + (2 * sizeof(RegIndex)));
+        *mov = (Inst){ .type = dt >= TB_X86_TYPE_SSE_SS ? FP_MOV : MOV, .dt = dt, .out_count = 1, 1 };
+        mov->operands[0] = remap[i];
+        mov->operands[1] = i;
+        mov->next = label->next;
+        label->next = mov;
+    }
+}
+
 static void hint_reg(Ctx* restrict ctx, int i, int j) {
     if (ctx->intervals[i].hint < 0) {
         ctx->intervals[i].hint = j;
@@ -471,6 +738,7 @@ static DynArray(int) liveness(Ctx* restrict ctx, TB_Function* f) {
 
         MachineBB mbb = {
             .end_node = bb->end,
+            .freq = bb->freq,
             .gen = set_create_in_arena(arena, interval_count),
             .kill = set_create_in_arena(arena, interval_count),
             .live_in = set_create_in_arena(arena, interval_count),
@@ -527,6 +795,13 @@ static DynArray(int) liveness(Ctx* restrict ctx, TB_Function* f) {
                     }
                 }
 
+                RegIndex* saves = ins + inst->in_count + inst->tmp_count;
+                FOREACH_N(i, 0, inst->save_count) {
+                    if (!set_get(kill, saves[i])) {
+                        set_put(gen, saves[i]);
+                    }
+                }
+
                 RegIndex* outs = inst->operands;
                 FOREACH_N(i, 0, inst->out_count) {
                     set_put(kill, outs[i]);
@@ -895,6 +1170,162 @@ static void isel_region(Ctx* restrict ctx, TB_Node* bb_start, TB_Node* end, size
     dyn_array_set_length(ctx->worklist.items, ctx->cfg.block_count);
 }
 
+////////////////////////////////
+// Block layout
+////////////////////////////////
+// Pettis-Hansen chaining, every block starts out as its own chain and we walk the
+// forward edges from hottest to coldest. An edge which leaves the tail of one chain
+// for the head of another glues them together so it becomes a fallthrough. Back
+// edges don't take part so loops keep their header on top (and since forward edges
+// always go up in RPO the chains can't cycle).
+//
+// Chains are placed in the RPO order of their heads, except for the cold ones which
+// all go at the end of the function where the exporter may split them off.
+typedef struct {
+    int from, to, order;
+    float weight;
+} LayoutEdge;
+
+static int compare_layout_edges(const void* a, const void* b) {
+    const LayoutEdge* x = a;
+    const LayoutEdge* y = b;
+    if (x->weight != y->weight) {
+        return x->weight < y->weight ? 1 : -1;
+    }
+
+    return x->order - y->order;
+}
+
+static void layout_blocks(Ctx* restrict ctx) {
+    TB_Node** bbs = ctx->worklist.items;
+    int n = ctx->cfg.block_count;
+
+    TB_ArenaSavepoint sp = tb_arena_save(tmp_arena);
+    float* freq    = tb_arena_alloc(tmp_arena, n * sizeof(float));
+    bool* cold     = tb_arena_alloc(tmp_arena, n * sizeof(bool));
+    bool* hot_pred = tb_arena_alloc(tmp_arena, n * sizeof(bool));
+    int* next      = tb_arena_alloc(tmp_arena, n * sizeof(int));
+    int* prev      = tb_arena_alloc(tmp_arena, n * sizeof(int));
+    int* succ_start = tb_arena_alloc(tmp_arena, (n + 1) * sizeof(int));
+
+    // flatten the successor lists
+    int succ_count = 0;
+    FOREACH_N(i, 0, n) {
+        TB_BasicBlock* bb = &nl_map_get_checked(ctx->cfg.node_to_block, bbs[i]);
+        freq[i] = bb->freq;
+        cold[i] = hot_pred[i] = false;
+        next[i] = prev[i] = -1;
+
+        succ_start[i] = succ_count;
+        if (bb->end->type == TB_BRANCH) {
+            succ_count += TB_NODE_GET_EXTRA_T(bb->end, TB_NodeBranch)->succ_count;
+        } else if (!cfg_is_endpoint(bb->end)) {
+            succ_count += 1;
+        }
+    }
+    succ_start[n] = succ_count;
+
+    int* succ = tb_arena_alloc(tmp_arena, succ_count * sizeof(int));
+    FOREACH_N(i, 0, n) {
+        TB_Node* end = nl_map_get_checked(ctx->cfg.node_to_block, bbs[i]).end;
+        int* s = &succ[succ_start[i]];
+
+        if (end->type == TB_BRANCH) {
+            for (User* u = end->users; u; u = u->next) {
+                if (u->n->type == TB_PROJ) {
+                    int index = TB_NODE_GET_EXTRA_T(u->n, TB_NodeProj)->index;
+                    TB_Node* succ_n = cfg_next_bb_after_cproj(u->n);
+                    s[index] = nl_map_get_checked(ctx->cfg.node_to_block, succ_n).id;
+                }
+            }
+        } else if (!cfg_is_endpoint(end)) {
+            TB_Node* succ_n = cfg_next_control(end);
+            s[0] = nl_map_get_checked(ctx->cfg.node_to_block, succ_n).id;
+        }
+    }
+
+    // cold blocks are the ones which end in a trap or unreachable (error paths
+    // which call abort and friends), the ones the profile says never ran, the
+    // ones which can only go into cold blocks and the ones which can only be
+    // reached through cold blocks. The entry is never cold.
+    for (int i = n - 1; i > 0; i--) {
+        TB_Node* end = nl_map_get_checked(ctx->cfg.node_to_block, bbs[i]).end;
+        if (end->type == TB_TRAP || end->type == TB_UNREACHABLE || freq[i] <= BB_LOW_FREQ) {
+            cold[i] = true;
+        } else if (succ_start[i] < succ_start[i + 1]) {
+            // back edges haven't been decided yet, they don't count as cold
+            cold[i] = true;
+            FOREACH_N(j, succ_start[i], succ_start[i + 1]) {
+                if (succ[j] <= i || !cold[succ[j]]) cold[i] = false;
+            }
+        }
+    }
+
+    hot_pred[0] = true;
+    FOREACH_N(i, 0, n) {
+        if (!hot_pred[i]) {
+            cold[i] = true;
+            continue;
+        }
+
+        if (!cold[i]) {
+            FOREACH_N(j, succ_start[i], succ_start[i + 1]) {
+                if (succ[j] > i) hot_pred[succ[j]] = true;
+            }
+        }
+    }
+
+    // we don't know the edge frequencies, only the block ones so we split the
+    // block's frequency between the successors by how hot they are.
+    int edge_count = 0;
+    LayoutEdge* edges = tb_arena_alloc(tmp_arena, succ_count * sizeof(LayoutEdge));
+    FOREACH_N(i, 0, n) {
+        float total = 0.0f;
+        FOREACH_N(j, succ_start[i], succ_start[i + 1]) {
+            total += freq[succ[j]];
+        }
+
+        FOREACH_N(j, succ_start[i], succ_start[i + 1]) {
+            int s = succ[j];
+
+            // hot code shouldn't fall into cold code
+            if (s > i && cold[s] == cold[i]) {
+                edges[edge_count] = (LayoutEdge){ i, s, edge_count, freq[i] * (freq[s] / total) };
+                edge_count += 1;
+            }
+        }
+    }
+    qsort(edges, edge_count, sizeof(LayoutEdge), compare_layout_edges);
+
+    FOREACH_N(i, 0, edge_count) {
+        int a = edges[i].from, b = edges[i].to;
+        if (next[a] < 0 && prev[b] < 0) {
+            next[a] = b, prev[b] = a;
+        }
+    }
+
+    // place hot chains then cold ones
+    int* order = ctx->bb_order;
+    int count = 0;
+    FOREACH_N(pass, 0, 2) {
+        if (pass == 1) {
+            ctx->cold_bb = count;
+        }
+
+        FOREACH_N(i, 0, n) {
+            if (prev[i] < 0 && cold[i] == (pass == 1)) {
+                for (int j = i; j >= 0; j = next[j]) {
+                    order[count++] = j;
+                }
+            }
+        }
+    }
+    assert(count == n);
+    ctx->bb_count = n;
+
+    tb_arena_restore(tmp_arena, sp);
+}
+
 // Codegen through here is done in phases
 static void compile_function(TB_Passes* restrict p, TB_FunctionOutput* restrict func_out, const TB_FeatureSet* features, uint8_t* out, size_t out_capacity, bool emit_asm) {
     verify_tmp_arena(p);
@@ -911,6 +1342,13 @@ static void compile_function(TB_Passes* restrict p, TB_FunctionOutput* restrict
     }
     #endif
 
+    // each return gets its own epilogue in optimized code, it's where
+    // shrink wrapping can skip the frame. This makes nodes so it goes
+    // before anything sizes itself off the node count.
+    if (p->optimized) {
+        tb_pass_split_returns(p);
+    }
+
     Ctx ctx = {
         .module = f->super.module,
         .f = f,
@@ -936,7 +1374,7 @@ static void compile_function(TB_Passes* restrict p, TB_FunctionOutput* restrict
 
     // And perform global scheduling
     tb_pass_schedule(p, ctx.cfg);
-    ctx.sched = greedy_scheduler;
+    ctx.sched = p->optimized ? list_scheduler : greedy_scheduler;
     ctx.worklist = p->worklist;
 
     // allocate more stuff now that we've run stats on the IR
@@ -944,7 +1382,6 @@ static void compile_function(TB_Passes* restrict p, TB_FunctionOutput* restrict
     ctx.emit.labels = tb_arena_alloc(tmp_arena, ctx.cfg.block_count * sizeof(uint32_t));
 
     nl_map_create(ctx.stack_slots, 8);
-    dyn_array_create(ctx.debug_stack_slots, 8);
 
     worklist_clear_visited(&ctx.worklist);
 
@@ -959,8 +1396,7 @@ static void compile_function(TB_Passes* restrict p, TB_FunctionOutput* restrict
     CUIK_TIMED_BLOCK("isel") {
         assert(dyn_array_length(ctx.worklist.items) == ctx.cfg.block_count);
 
-        // define all PHIs early and sort BB order
-        int stop_bb = -1;
+        // define all PHIs early
         FOREACH_N(i, 0, ctx.cfg.block_count) {
             TB_Node* bb = ctx.worklist.items[i];
 
@@ -972,26 +1408,20 @@ static void compile_function(TB_Passes* restrict p, TB_FunctionOutput* restrict
                     ctx.values[n->gvn].vreg = -1;
                 }
             }
-
-            TB_Node* end = nl_map_get_checked(ctx.cfg.node_to_block, bb).end;
-            if (end->type == TB_END) {
-                stop_bb = i;
-            } else {
-                bb_order[ctx.bb_count++] = i;
-            }
         }
 
-        // enter END block at the... end
-        if (stop_bb >= 0) {
-            bb_order[ctx.bb_count++] = stop_bb;
+        CUIK_TIMED_BLOCK("layout") {
+            layout_blocks(&ctx);
         }
 
         TB_Node** bbs = ctx.worklist.items;
         FOREACH_N(i, 0, ctx.bb_count) {
             TB_Node* bb = bbs[bb_order[i]];
 
+            // the last hot block can't fall into the cold code, it might get
+            // moved somewhere else entirely.
             ctx.emit.labels[bb_order[i]] = 0;
-            if (i + 1 < ctx.bb_count) {
+            if (i + 1 < ctx.bb_count && i + 1 != ctx.cold_bb) {
                 ctx.fallthrough = bb_order[i + 1];
                 /*if (i + 2 < ctx.bb_count && cfg_basically_empty_only_mem_phis(bbs[ctx.fallthrough])) {
                     ctx.fallthrough = bb_order[i + 2];
@@ -1013,6 +1443,13 @@ static void compile_function(TB_Passes* restrict p, TB_FunctionOutput* restrict
     }
     p->worklist = ctx.worklist;
 
+    // values which live across the wrap point get a fresh vreg inside of it so
+    // the early exits don't pin callee saved registers for the whole function.
+    CUIK_TIMED_BLOCK("shrink wrap") {
+        shrink_wrap_doms(&ctx);
+        if (p->optimized) shrink_wrap_split(&ctx);
+    }
+
     {
         DynArray(int) end;
         CUIK_TIMED_BLOCK("data flow") {
@@ -1022,6 +1459,7 @@ static void compile_function(TB_Passes* restrict p, TB_FunctionOutput* restrict
         // we can in theory have other regalloc solutions and eventually will put
         // graph coloring here.
         ctx.stack_usage = linear_scan(&ctx, f, ctx.stack_usage, end);
+        dyn_array_destroy(end);
 
         // Arch-specific: convert instruction buffer into actual instructions
         CUIK_TIMED_BLOCK("emit code") {
@@ -1036,6 +1474,25 @@ static void compile_function(TB_Passes* restrict p, TB_FunctionOutput* restrict
                 *ctx.jump_table_patches[i].pos = target & ~0x80000000;
             }
         }
+
+        // mark where the cold code starts and which jumps cross over for the
+        // exporters. Jump tables are relative to the start of the function so
+        // we can't split those up.
+        if (ctx.cold_bb < ctx.bb_count && dyn_array_length(ctx.jump_table_patches) == 0) {
+            uint32_t cold_start = ctx.emit.labels[bb_order[ctx.cold_bb]] & ~0x80000000;
+            dyn_array_for(i, ctx.label_refs) {
+                uint32_t pos = ctx.label_refs[i];
+
+                int32_t disp;
+                memcpy(&disp, &ctx.emit.data[pos], sizeof(disp));
+                if ((pos < cold_start) != (pos + 4 + disp < cold_start)) {
+                    dyn_array_put(func_out->cold_jumps, pos);
+                }
+            }
+
+            func_out->cold_start = cold_start;
+        }
+        dyn_array_destroy(ctx.label_refs);
     }
 
     if (emit_asm) CUIK_TIMED_BLOCK("dissassembly") {
@@ -1043,8 +1500,8 @@ static void compile_function(TB_Passes* restrict p, TB_FunctionOutput* restrict
 
         Disasm d = { func_out->first_patch, ctx.locations, &ctx.locations[dyn_array_length(ctx.locations)] };
 
-        // dump prologue
-        disassemble(&ctx.emit, &d, -1, 0, func_out->prologue_length);
+        // dump prologue (if it's at the entry, shrink wrapped ones are part of their block)
+        disassemble(&ctx.emit, &d, -1, 0, ctx.emit.labels[bb_order[0]] & ~0x80000000);
 
         TB_Node** bbs = ctx.worklist.items;
         FOREACH_N(i, 0, ctx.bb_count) {
@@ -1076,6 +1533,7 @@ static void compile_function(TB_Passes* restrict p, TB_FunctionOutput* restrict
     func_out->code_size = ctx.emit.count;
     func_out->stack_usage = ctx.stack_usage;
     func_out->locations = ctx.locations;
+    func_out->safepoints = ctx.safepoints;
     func_out->stack_slots = ctx.debug_stack_slots;
     nl_map_free(ctx.stack_slots);
 }
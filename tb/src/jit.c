@@ -5,6 +5,9 @@
 #ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
+#else
+#include <dlfcn.h>
+#include <sys/mman.h>
 #endif
 
 enum {
@@ -35,6 +38,43 @@ typedef struct {
     void* v;
 } Tag;
 
+// Every function gets an entry, callers only ever go through the trampoline
+// so the body can be swapped out from under them (even while they're running).
+// The trampoline is "jmp [rip+2]; int3; int3; dq target" which keeps the target
+// 8-byte aligned, a swap is a single atomic store.
+typedef struct {
+    uint8_t* trampoline;
+
+    // currently installed definition, f is NULL once the module
+    // that defined it is gone (the code sticks around tho).
+    TB_Function* f;
+    void* code;
+
+    char key[];
+} JITEntry;
+
+// named globals keep their storage across reloads
+typedef struct {
+    void* address;
+    size_t size;
+    char key[];
+} JITGlobal;
+
+// references to symbols nobody has defined yet, they're
+// filled in once some unit defines them.
+typedef struct {
+    void* at;
+    bool rel32;
+    char* key;
+} JITFixup;
+
+// every tb_jit_place_module call names a unit, placing it again
+// replaces the previous version.
+typedef struct {
+    char* name;
+    TB_Module* m;
+} JITUnit;
+
 struct TB_JIT {
     size_t capacity;
     mtx_t lock;
@@ -42,6 +82,15 @@ struct TB_JIT {
     DynArray(TB_Breakpoint) breakpoints;
     DynArray(Tag) tags;
 
+    NL_Strmap(JITEntry*) entries;
+    NL_Strmap(JITGlobal*) globals;
+    DynArray(JITFixup) fixups;
+    DynArray(JITUnit) units;
+
+    // entries jump here until they're defined
+    uint8_t* unresolved;
+    size_t swap_count;
+
     FreeList heap;
 };
 
@@ -230,7 +279,18 @@ void tb_jit_free_obj(TB_JIT* jit, void* ptr, size_t s) {
     tb_todo();
 }
 
+static char* jit__strdup(const char* str) {
+    size_t len = strlen(str);
+    char* out = tb_platform_heap_alloc(len + 1);
+    memcpy(out, str, len + 1);
+    return out;
+}
+
 static void* get_proc(TB_JIT* jit, const char* name) {
+    // check cache first
+    ptrdiff_t search = nl_map_get_cstr(jit->loaded_funcs, name);
+    if (search >= 0) return jit->loaded_funcs[search].v;
+
     #ifdef _WIN32
     static HMODULE kernel32, user32, gdi32, opengl32, msvcrt;
     if (user32 == NULL) {
@@ -241,97 +301,253 @@ static void* get_proc(TB_JIT* jit, const char* name) {
         msvcrt   = LoadLibrary("msvcrt.dll");
     }
 
-    // check cache first
-    ptrdiff_t search = nl_map_get_cstr(jit->loaded_funcs, name);
-    if (search >= 0) return jit->loaded_funcs[search].v;
-
     void* addr = GetProcAddress(NULL, name);
     if (addr == NULL) addr = GetProcAddress(kernel32, name);
     if (addr == NULL) addr = GetProcAddress(user32, name);
     if (addr == NULL) addr = GetProcAddress(gdi32, name);
     if (addr == NULL) addr = GetProcAddress(opengl32, name);
     if (addr == NULL) addr = GetProcAddress(msvcrt, name);
+    #else
+    // anything the host process (or the libraries it loaded) exports
+    void* addr = dlsym(RTLD_DEFAULT, name);
+    #endif
 
     // printf("JIT: loaded %s (%p)\n", name, addr);
-    nl_map_put_cstr(jit->loaded_funcs, name, addr);
+    // the symbol names die with their modules, the cache outlives them
+    nl_map_put_cstr(jit->loaded_funcs, jit__strdup(name), addr);
     return addr;
-    #else
+}
+
+// public symbols are shared between units, private ones are scoped to the unit
+static const char* jit__key(char* buf, size_t cap, const TB_Symbol* s, TB_Linkage linkage, const char* unit) {
+    if (linkage != TB_LINKAGE_PRIVATE || unit == NULL) {
+        return s->name;
+    }
+
+    snprintf(buf, cap, "%s:%s", unit, s->name);
+    return buf;
+}
+
+static void jit__retag(TB_JIT* jit, void* ptr, void* tag) {
+    mtx_lock(&jit->lock);
+    uint32_t offset = (char*) ptr - (char*) jit;
+    dyn_array_for(i, jit->tags) {
+        if (jit->tags[i].k == offset) {
+            jit->tags[i].v = tag;
+            break;
+        }
+    }
+    mtx_unlock(&jit->lock);
+}
+
+static void jit__resolve_fixups(TB_JIT* jit, const char* key, void* addr) {
+    size_t j = 0, count = dyn_array_length(jit->fixups);
+    if (count == 0) {
+        return;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        JITFixup fixup = jit->fixups[i];
+        if (strcmp(fixup.key, key) != 0) {
+            jit->fixups[j++] = fixup;
+            continue;
+        }
+
+        if (fixup.rel32) {
+            int32_t* patch = fixup.at;
+            *patch += (intptr_t)addr - ((intptr_t)patch + 4);
+        } else {
+            *(uintptr_t*) fixup.at += (uintptr_t) addr;
+        }
+        tb_platform_heap_free(fixup.key);
+    }
+    dyn_array_set_length(jit->fixups, j);
+}
+
+static void jit__set_target(JITEntry* e, void* code) {
+    // callers might be mid-jump through here, they either see the
+    // old body or the new one, never a torn address.
+    e->code = code;
+    atomic_store_explicit((_Atomic(void*)*) &e->trampoline[8], code, memory_order_release);
+}
+
+static JITEntry* jit__entry(TB_JIT* jit, const char* key) {
+    ptrdiff_t search = nl_map_get_cstr(jit->entries, key);
+    if (search >= 0) return jit->entries[search].v;
+
+    size_t len = strlen(key);
+    JITEntry* e = tb_platform_heap_alloc(sizeof(JITEntry) + len + 1);
+    memcpy(e->key, key, len + 1);
+    e->f = NULL;
+    e->code = NULL;
+
+    static const uint8_t jmp[8] = { 0xFF, 0x25, 0x02, 0x00, 0x00, 0x00, 0xCC, 0xCC };
+    e->trampoline = tb_jit_alloc_obj(jit, NULL, 16, 16);
+    memcpy(e->trampoline, jmp, sizeof(jmp));
+    assert(((uintptr_t) &e->trampoline[8] & 7) == 0);
+    jit__set_target(e, jit->unresolved);
+    e->code = NULL;
+
+    nl_map_put_cstr(jit->entries, e->key, e);
+    jit__resolve_fixups(jit, e->key, e->trampoline);
+    return e;
+}
+
+static void* jit__lookup(TB_JIT* jit, const char* key) {
+    ptrdiff_t search = nl_map_get_cstr(jit->entries, key);
+    if (search >= 0) return jit->entries[search].v->trampoline;
+
+    search = nl_map_get_cstr(jit->globals, key);
+    if (search >= 0) return jit->globals[search].v->address;
+
     return NULL;
-    #endif
 }
 
-static void* get_symbol_address(const TB_Symbol* s) {
+static void* jit__place_function(TB_JIT* jit, TB_Function* f, const char* unit);
+static void* jit__place_global(TB_JIT* jit, TB_Global* g, const char* unit);
+
+// NULL means it's not defined anywhere yet
+static void* jit__external_address(TB_JIT* jit, TB_External* e) {
+    // another unit might've defined it
+    void* addr = jit__lookup(jit, e->super.name);
+    if (addr == NULL) addr = e->super.address;
+    if (addr == NULL) addr = get_proc(jit, e->super.name);
+    return addr;
+}
+
+static void* jit__symbol_address(TB_JIT* jit, const TB_Symbol* s, const char* unit) {
     if (s->tag == TB_SYMBOL_GLOBAL) {
-        return ((TB_Global*) s)->address;
+        return jit__place_global(jit, (TB_Global*) s, unit);
     } else if (s->tag == TB_SYMBOL_FUNCTION) {
-        return ((TB_Function*) s)->compiled_pos;
+        return jit__place_function(jit, (TB_Function*) s, unit);
+    } else if (s->tag == TB_SYMBOL_EXTERNAL) {
+        return jit__external_address(jit, (TB_External*) s);
     } else {
         tb_todo();
     }
 }
 
-void* tb_jit_place_function(TB_JIT* jit, TB_Function* f) {
-    TB_FunctionOutput* func_out = f->output;
+static void jit__patch_external(TB_JIT* jit, int32_t* patch, TB_External* e) {
+    void* addr = jit__external_address(jit, e);
+    if (addr == NULL) {
+        JITFixup fixup = { patch, true, jit__strdup(e->super.name) };
+        dyn_array_put(jit->fixups, fixup);
+        return;
+    }
+
+    ptrdiff_t rel = (intptr_t)addr - ((intptr_t)patch + 4);
+    if (rel != (int32_t) rel) {
+        // far calls go through an entry of their own, same as every other function
+        JITEntry* thunk = jit__entry(jit, e->super.name);
+        jit__set_target(thunk, addr);
+        addr = thunk->trampoline;
+    }
+
+    *patch += (intptr_t)addr - ((intptr_t)patch + 4);
+}
+
+// anonymous globals (string literals and such) are compared by their contents, everything
+// else by name. It's only used to tell if a function changed so it's fine to be conservative.
+static bool jit__same_symbol(const TB_Symbol* a, const TB_Symbol* b) {
+    if (a->tag != b->tag) {
+        return false;
+    } else if (a->name != NULL && a->name[0] != 0) {
+        return b->name != NULL && strcmp(a->name, b->name) == 0;
+    } else if (a->tag != TB_SYMBOL_GLOBAL) {
+        return false;
+    }
+
+    const TB_Global* ga = (const TB_Global*) a;
+    const TB_Global* gb = (const TB_Global*) b;
+    if (ga->size != gb->size || ga->align != gb->align || ga->obj_count != gb->obj_count) {
+        return false;
+    }
+
+    FOREACH_N(k, 0, ga->obj_count) {
+        const TB_InitObj* x = &ga->objects[k];
+        const TB_InitObj* y = &gb->objects[k];
+        if (x->type != y->type || x->offset != y->offset) {
+            return false;
+        }
+
+        if (x->type == TB_INIT_OBJ_REGION) {
+            if (x->region.size != y->region.size || memcmp(x->region.ptr, y->region.ptr, x->region.size) != 0) {
+                return false;
+            }
+        } else {
+            const TB_Symbol* rx = x->reloc;
+            const TB_Symbol* ry = y->reloc;
+            if (rx->name == NULL || rx->name[0] == 0 || ry->name == NULL || strcmp(rx->name, ry->name) != 0) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+static bool jit__same_code(TB_Function* old, TB_Function* f) {
+    TB_FunctionOutput* a = old->output;
+    TB_FunctionOutput* b = f->output;
+    if (a->code_size != b->code_size || memcmp(a->code, b->code, a->code_size) != 0) {
+        return false;
+    }
+
+    TB_SymbolPatch* p = a->first_patch;
+    TB_SymbolPatch* q = b->first_patch;
+    for (; p && q; p = p->next, q = q->next) {
+        if (p->pos != q->pos || !jit__same_symbol(p->target, q->target)) {
+            return false;
+        }
+    }
+
+    return p == NULL && q == NULL;
+}
+
+// returns the entry trampoline
+static void* jit__place_function(TB_JIT* jit, TB_Function* f, const char* unit) {
+    char tmp[1024];
+    JITEntry* e = jit__entry(jit, jit__key(tmp, sizeof(tmp), &f->super, f->linkage, unit));
     if (f->compiled_pos != NULL) {
-        return f->compiled_pos;
+        return e->trampoline;
+    }
+
+    // nothing changed since the last version, the new symbol takes over the old body
+    if (e->f != NULL && jit__same_code(e->f, f)) {
+        f->compiled_pos = e->code;
+        e->f = f;
+        jit__retag(jit, e->code, f);
+        return e->trampoline;
     }
 
     // copy machine code
+    TB_FunctionOutput* func_out = f->output;
     char* dst = tb_jit_alloc_obj(jit, f, func_out->code_size, 16);
     memcpy(dst, func_out->code, func_out->code_size);
     f->compiled_pos = dst;
 
+    bool swapped = e->code != NULL;
+    e->f = f;
+
     log_debug("jit: apply function %s (%p)", f->super.name, dst);
 
-    // apply relocations, any leftovers are mapped to thunks
+    // apply relocations, calls go through the entry trampolines so they
+    // pick up any later swaps.
     for (TB_SymbolPatch* p = func_out->first_patch; p; p = p->next) {
         size_t actual_pos = p->pos;
         TB_SymbolTag tag = p->target->tag;
 
         int32_t* patch = (int32_t*) &dst[actual_pos];
         if (tag == TB_SYMBOL_FUNCTION) {
-            TB_Function* f = (TB_Function*) p->target;
-            void* addr = tb_jit_place_function(jit, f);
+            void* addr = jit__place_function(jit, (TB_Function*) p->target, unit);
 
             int32_t rel32 = (intptr_t)addr - ((intptr_t)patch + 4);
             *patch += rel32;
         } else if (tag == TB_SYMBOL_EXTERNAL) {
-            TB_External* e = (TB_External*) p->target;
-
-            void* addr = e->thunk ? e->thunk : p->target->address;
-            if (addr == NULL) {
-                addr = get_proc(jit, p->target->name);
-                if (addr == NULL) {
-                    tb_panic("Could not find procedure: %s", p->target->name);
-                }
-            }
-
-            ptrdiff_t rel = (intptr_t)addr - ((intptr_t)patch + 4);
-            int32_t rel32 = rel;
-            if (rel == rel32) {
-                memcpy(dst + actual_pos, &rel32, sizeof(int32_t));
-            } else {
-                // generate thunk to make far call
-                char* thunk = tb_jit_alloc_obj(jit, NULL, 6 + sizeof(void*), 1);
-                thunk[0] = 0xFF; // jmp qword [rip]
-                thunk[1] = 0x25;
-                thunk[2] = 0x00;
-                thunk[3] = 0x00;
-                thunk[4] = 0x00;
-                thunk[5] = 0x00;
-
-                // write final address into the thunk
-                memcpy(thunk + 6, &addr, sizeof(void*));
-                e->thunk = thunk;
-
-                int32_t rel32 = (intptr_t)thunk - ((intptr_t)patch + 4);
-                *patch += rel32;
-            }
+            jit__patch_external(jit, patch, (TB_External*) p->target);
         } else if (tag == TB_SYMBOL_GLOBAL) {
-            TB_Global* g = (TB_Global*) p->target;
-            void* addr = tb_jit_place_global(jit, g);
+            void* addr = jit__place_global(jit, (TB_Global*) p->target, unit);
 
-            int32_t* patch = (int32_t*) &dst[actual_pos];
             int32_t rel32 = (intptr_t)addr - ((intptr_t)patch + 4);
             *patch += rel32;
         } else {
@@ -339,19 +555,53 @@ void* tb_jit_place_function(TB_JIT* jit, TB_Function* f) {
         }
     }
 
-    return dst;
+    // only publish once the body is ready
+    jit__set_target(e, dst);
+    jit->swap_count += swapped;
+    return e->trampoline;
 }
 
-void* tb_jit_place_global(TB_JIT* jit, TB_Global* g) {
+static void* jit__place_global(TB_JIT* jit, TB_Global* g, const char* unit) {
     if (g->address != NULL) {
         return g->address;
     }
 
+    // named globals keep their storage (and contents) as long as they still fit
+    char tmp[1024];
+    const char* key = NULL;
+    JITGlobal* kept = NULL;
+    if (g->super.name != NULL && g->super.name[0] != 0) {
+        key = jit__key(tmp, sizeof(tmp), &g->super, g->linkage, unit);
+
+        ptrdiff_t search = nl_map_get_cstr(jit->globals, key);
+        if (search >= 0) {
+            kept = jit->globals[search].v;
+            if (kept->size >= g->size && ((uintptr_t) kept->address & (g->align - 1)) == 0) {
+                g->address = kept->address;
+                jit__retag(jit, kept->address, g);
+                return kept->address;
+            }
+        }
+    }
+
     char* data = tb_jit_alloc_obj(jit, g, g->size, g->align);
     g->address = data;
 
     log_debug("jit: apply global %s (%p)", g->super.name ? g->super.name : "<unnamed>", data);
 
+    if (key != NULL) {
+        if (kept == NULL) {
+            size_t len = strlen(key);
+            kept = tb_platform_heap_alloc(sizeof(JITGlobal) + len + 1);
+            memcpy(kept->key, key, len + 1);
+            nl_map_put_cstr(jit->globals, kept->key, kept);
+        }
+
+        kept->address = data;
+        kept->size = g->size;
+        jit__resolve_fixups(jit, kept->key, data);
+    }
+
     memset(data, 0, g->size);
     FOREACH_N(k, 0, g->obj_count) {
         if (g->objects[k].type == TB_INIT_OBJ_REGION) {
@@ -361,9 +611,14 @@ void* tb_jit_place_global(TB_JIT* jit, TB_Global* g) {
 
     FOREACH_N(k, 0, g->obj_count) {
         if (g->objects[k].type == TB_INIT_OBJ_RELOC) {
-            uintptr_t addr = (uintptr_t) get_symbol_address(g->objects[k].reloc);
-
             uintptr_t* dst = (uintptr_t*) &data[g->objects[k].offset];
+            const TB_Symbol* target = g->objects[k].reloc;
+
+            uintptr_t addr = (uintptr_t) jit__symbol_address(jit, target, unit);
+            if (addr == 0) {
+                JITFixup fixup = { dst, false, jit__strdup(target->name) };
+                dyn_array_put(jit->fixups, fixup);
+            }
             *dst += addr;
         }
     }
@@ -371,12 +626,132 @@ void* tb_jit_place_global(TB_JIT* jit, TB_Global* g) {
     return data;
 }
 
+void* tb_jit_place_function(TB_JIT* jit, TB_Function* f) {
+    return jit__place_function(jit, f, NULL);
+}
+
+void* tb_jit_place_global(TB_JIT* jit, TB_Global* g) {
+    return jit__place_global(jit, g, NULL);
+}
+
+// whatever's left of the old module got replaced, it's only the code & data
+// that we keep around (someone might still be running it).
+static void jit__drop_module(TB_JIT* jit, TB_Module* m) {
+    mtx_lock(&jit->lock);
+    size_t j = 0, count = dyn_array_length(jit->tags);
+    for (size_t i = 0; i < count; i++) {
+        TB_Symbol* s = jit->tags[i].v;
+        if (s->module != m) {
+            jit->tags[j++] = jit->tags[i];
+        }
+    }
+    if (count > 0) {
+        dyn_array_set_length(jit->tags, j);
+    }
+    mtx_unlock(&jit->lock);
+
+    nl_map_for_str(i, jit->entries) {
+        JITEntry* e = jit->entries[i].v;
+        if (e->f != NULL && e->f->super.module == m) {
+            e->f = NULL;
+        }
+    }
+
+    tb_module_destroy(m);
+}
+
+int tb_jit_place_module(TB_JIT* jit, TB_Module* m, const char* unit) {
+    jit->swap_count = 0;
+
+    TB_Symbol* sym;
+    for (TB_SymbolIter it = tb_symbol_iter(m); sym = tb_symbol_iter_next(&it), sym;) {
+        if (sym->tag == TB_SYMBOL_FUNCTION) {
+            if (((TB_Function*) sym)->output != NULL) {
+                jit__place_function(jit, (TB_Function*) sym, unit);
+            }
+        } else if (sym->tag == TB_SYMBOL_GLOBAL && sym->name != NULL && sym->name[0] != 0) {
+            // the named ones go in eagerly so other units can find them
+            jit__place_global(jit, (TB_Global*) sym, unit);
+        }
+    }
+
+    JITUnit* slot = NULL;
+    dyn_array_for(i, jit->units) {
+        if (strcmp(jit->units[i].name, unit) == 0) {
+            slot = &jit->units[i];
+            break;
+        }
+    }
+
+    if (slot == NULL) {
+        JITUnit u = { jit__strdup(unit), m };
+        dyn_array_put(jit->units, u);
+    } else {
+        TB_Module* old = slot->m;
+        slot->m = m;
+        jit__drop_module(jit, old);
+    }
+
+    return jit->swap_count;
+}
+
+void* tb_jit_get_entry(TB_JIT* jit, const char* name) {
+    ptrdiff_t search = nl_map_get_cstr(jit->entries, name);
+    if (search < 0 || jit->entries[search].v->code == NULL) {
+        return NULL;
+    }
+
+    return jit->entries[search].v->trampoline;
+}
+
+const char* tb_jit_unresolved(TB_JIT* jit) {
+    if (dyn_array_length(jit->fixups) > 0) {
+        return jit->fixups[0].key;
+    }
+
+    // entries which got called but never defined
+    nl_map_for_str(i, jit->entries) {
+        if (jit->entries[i].v->code == NULL) {
+            return jit->entries[i].v->key;
+        }
+    }
+
+    return NULL;
+}
+
+static void* jit__valloc(size_t size) {
+    #if defined(_WIN32) || !defined(CUIK__IS_X64)
+    return tb_platform_valloc(size);
+    #else
+    // try to land within rel32 of our own image, calls into it (and more importantly
+    // loads from its copy-relocated data, like stdout) don't need to go through thunks.
+    uintptr_t self = (uintptr_t) &tb_jit_begin;
+    uintptr_t step = (size + (64u << 20) - 1) & -(uintptr_t) (64u << 20);
+    for (uintptr_t i = 1; i <= 16 && i * step < self; i++) {
+        void* hint = (void*) ((self - i * step) & -(uintptr_t) 4096);
+        void* ptr = mmap(hint, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ptr == MAP_FAILED) {
+            break;
+        }
+
+        intptr_t dist = (intptr_t) self - (intptr_t) ptr;
+        if (dist > 0 && dist < (1ll << 30)) {
+            return ptr;
+        }
+        munmap(ptr, size);
+    }
+
+    return tb_platform_valloc(size);
+    #endif
+}
+
 TB_JIT* tb_jit_begin(TB_Module* m, size_t jit_heap_capacity) {
     if (jit_heap_capacity == 0) {
         jit_heap_capacity = 2*1024*1024;
     }
 
-    TB_JIT* jit = tb_platform_valloc(jit_heap_capacity);
+    TB_JIT* jit = jit__valloc(jit_heap_capacity);
+    memset(jit, 0, sizeof(TB_JIT));
     mtx_init(&jit->lock, mtx_plain);
     jit->capacity = jit_heap_capacity;
     jit->heap.cookie = ALLOC_COOKIE;
@@ -384,10 +759,43 @@ TB_JIT* tb_jit_begin(TB_Module* m, size_t jit_heap_capacity) {
 
     // a lil unsafe... im sorry momma
     tb_platform_vprotect(jit, jit_heap_capacity, TB_PAGE_RXW);
+
+    // ud2, where calls to undefined functions end up
+    jit->unresolved = tb_jit_alloc_obj(jit, NULL, 2, 1);
+    jit->unresolved[0] = 0x0F;
+    jit->unresolved[1] = 0x0B;
     return jit;
 }
 
 void tb_jit_end(TB_JIT* jit) {
+    dyn_array_for(i, jit->units) {
+        tb_module_destroy(jit->units[i].m);
+        tb_platform_heap_free(jit->units[i].name);
+    }
+    dyn_array_destroy(jit->units);
+
+    dyn_array_for(i, jit->fixups) {
+        tb_platform_heap_free(jit->fixups[i].key);
+    }
+    dyn_array_destroy(jit->fixups);
+
+    nl_map_for_str(i, jit->entries) {
+        tb_platform_heap_free(jit->entries[i].v);
+    }
+    nl_map_free(jit->entries);
+
+    nl_map_for_str(i, jit->globals) {
+        tb_platform_heap_free(jit->globals[i].v);
+    }
+    nl_map_free(jit->globals);
+
+    nl_map_for_str(i, jit->loaded_funcs) {
+        tb_platform_heap_free((void*) jit->loaded_funcs[i].k.data);
+    }
+    nl_map_free(jit->loaded_funcs);
+
+    dyn_array_destroy(jit->tags);
+    dyn_array_destroy(jit->breakpoints);
     mtx_destroy(&jit->lock);
     tb_platform_vfree(jit, jit->capacity);
 }
@@ -16,6 +16,8 @@ void* tb_jit_stack_create(void);
 
 // Optimizer
 #include "opt/optimizer.c"
+#include "code_cache.c"
+#include "serialize.c"
 
 // Parsers
 #define TB_COFF_IMPL
@@ -23,6 +25,7 @@ void* tb_jit_stack_create(void);
 
 // Debug
 #include "debug/cv.c"
+#include "debug/dwarf.c"
 #include "debug/fut.c"
 
 // Objects
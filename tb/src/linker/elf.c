@@ -12,7 +12,7 @@ static void elf_append_library(TB_Linker* l, TB_LinkerThreadInfo* info, TB_Slice
 
 static void elf_append_module(TB_Linker* l, TB_LinkerThreadInfo* info, TB_Module* m) {
     CUIK_TIMED_BLOCK("layout section") {
-        tb_module_layout_sections(m);
+        tb_module_layout_sections(m, false);
     }
 
     TB_LinkerInputHandle mod_index = tb__track_module(l, 0, m);
@@ -26,6 +26,75 @@ static void elf_append_module(TB_Linker* l, TB_LinkerThreadInfo* info, TB_Module
     }
 
     tb__append_module_symbols(l, m);
+
+    // only modules with line info asked for debug info
+    if (nl_map_get_capacity(m->files) > 0) {
+        const IDebugFormat* dbg = &tb__dwarf_debug_format;
+        if (dbg->supported_target(m)) {
+            TB_LinkerDebugInfo info = { m };
+            CUIK_TIMED_BLOCK("generate debug") {
+                info.group = dbg->generate_debug_info(m, tb_tls_allocate());
+            }
+
+            info.pieces = tb_platform_heap_alloc(info.group.length * sizeof(TB_LinkerSectionPiece*));
+            FOREACH_N(i, 0, info.group.length) {
+                TB_ObjectSection* s = &info.group.data[i];
+
+                // debug sections aren't reachable from the entrypoint, they're always kept
+                const char* name = tb__arena_strdup(m, s->name.length, (const char*) s->name.data);
+                TB_LinkerSection* ls = tb__find_or_create_section(l, name, s->flags & TB_SHF_ALLOC ? TB_PF_R : 0);
+                info.pieces[i] = tb__append_piece(ls, PIECE_NORMAL, s->raw_data.length, s->raw_data.data, mod_index);
+                info.pieces[i]->flags |= TB_LINKER_PIECE_LIVE;
+            }
+
+            dyn_array_put(l->debug_info, info);
+        }
+    }
+}
+
+// see debug/dwarf.c for how these relocations are meant to be interpreted
+static void elf_apply_debug_relocs(TB_Linker* l, TB_LinkerDebugInfo* info, uint8_t* output) {
+    TB_Module* m = info->module;
+
+    FOREACH_N(i, 0, info->group.length) {
+        TB_ObjectSection* s = &info->group.data[i];
+        TB_LinkerSectionPiece* piece = info->pieces[i];
+        uint8_t* base = &output[piece->parent->offset + piece->offset];
+
+        FOREACH_N(j, 0, s->relocation_count) {
+            TB_ObjectReloc* r = &s->relocations[j];
+            uint8_t* dst = &base[r->virtual_address];
+
+            switch (r->type) {
+                case TB_OBJECT_RELOC_ADDR64:
+                case TB_OBJECT_RELOC_REL32: {
+                    // the referenced code might've been GC'd
+                    TB_LinkerSectionPiece* target = m->sections[r->symbol_index].piece;
+                    if (target == NULL || (target->flags & TB_LINKER_PIECE_LIVE) == 0) {
+                        break;
+                    }
+
+                    uint64_t addr = target->parent->address + target->offset + r->addend;
+                    if (r->type == TB_OBJECT_RELOC_ADDR64) {
+                        memcpy(dst, &addr, sizeof(uint64_t));
+                    } else {
+                        uint64_t site = piece->parent->address + piece->offset + r->virtual_address;
+                        int32_t rel = addr - site;
+                        memcpy(dst, &rel, sizeof(int32_t));
+                    }
+                    break;
+                }
+
+                case TB_OBJECT_RELOC_SECREL: {
+                    uint32_t offset = info->pieces[r->symbol_index]->offset + r->addend;
+                    memcpy(dst, &offset, sizeof(uint32_t));
+                    break;
+                }
+
+                default: tb_todo();
+            }
+        }
+    }
 }
 
 static TB_LinkerSymbol* elf_resolve_sym(TB_Linker* l, TB_LinkerSymbol* sym, TB_Slice name, TB_Slice* alt, uint32_t reloc_i) {
@@ -66,7 +135,8 @@ static TB_ExportBuffer elf_export(TB_Linker* l) {
     tb_out_reserve(&strtbl, 1024);
     tb_out1b(&strtbl, 0); // null string in the table
 
-    size_t final_section_count = 0;
+    // non-allocated sections (debug info) don't get program headers
+    size_t final_section_count = 0, load_section_count = 0;
     nl_map_for_str(i, l->sections) {
         if (l->sections[i].v->generic_flags & TB_LINKER_SECTION_DISCARD) continue;
 
@@ -77,10 +147,11 @@ static TB_ExportBuffer elf_export(TB_Linker* l) {
 
         // we're keeping it for export
         final_section_count += 1;
+        load_section_count += (l->sections[i].v->flags != 0);
     }
 
     TB_Elf64_Shdr strtab = {
-        .name = tb_outstr_nul_UNSAFE(&strtbl, ".strtab"),
+        .name = tb_outstr_nul(&strtbl, ".strtab"),
         .type = TB_SHT_STRTAB,
         .flags = 0,
         .addralign = 1,
@@ -88,7 +159,7 @@ static TB_ExportBuffer elf_export(TB_Linker* l) {
     };
 
     size_t size_of_headers = sizeof(TB_Elf64_Ehdr)
-        + (final_section_count * sizeof(TB_Elf64_Phdr))
+        + (load_section_count * sizeof(TB_Elf64_Phdr))
         + ((2+final_section_count) * sizeof(TB_Elf64_Shdr));
 
     size_t section_content_size = 0;
@@ -101,8 +172,10 @@ static TB_ExportBuffer elf_export(TB_Linker* l) {
             s->offset = size_of_headers + section_content_size;
             section_content_size += s->total_size;
 
-            s->address = virt_addr;
-            virt_addr += s->total_size;
+            if (s->flags != 0) {
+                s->address = virt_addr;
+                virt_addr += s->total_size;
+            }
             // virt_addr = align_up(virt_addr + s->total_size, 4096);
         }
     }
@@ -146,9 +219,9 @@ static TB_ExportBuffer elf_export(TB_Linker* l) {
 
         .phentsize = sizeof(TB_Elf64_Phdr),
         .phoff     = sizeof(TB_Elf64_Ehdr),
-        .phnum     = final_section_count,
+        .phnum     = load_section_count,
 
-        .shoff = sizeof(TB_Elf64_Ehdr) + (sizeof(TB_Elf64_Phdr) * final_section_count),
+        .shoff = sizeof(TB_Elf64_Ehdr) + (sizeof(TB_Elf64_Phdr) * load_section_count),
         .shentsize = sizeof(TB_Elf64_Shdr),
         .shnum = final_section_count + 2,
         .shstrndx  = 1,
@@ -173,6 +246,8 @@ static TB_ExportBuffer elf_export(TB_Linker* l) {
     // write program headers
     nl_map_for_str(i, l->sections) {
         TB_LinkerSection* s = l->sections[i].v;
+        if ((s->generic_flags & TB_LINKER_SECTION_DISCARD) || s->flags == 0) continue;
+
         TB_Elf64_Phdr sec = {
             .type   = TB_PT_LOAD,
             .flags  = s->flags,
@@ -190,10 +265,12 @@ static TB_ExportBuffer elf_export(TB_Linker* l) {
     WRITE(&strtab, sizeof(strtab));
     nl_map_for_str(i, l->sections) {
         TB_LinkerSection* s = l->sections[i].v;
+        if (s->generic_flags & TB_LINKER_SECTION_DISCARD) continue;
+
         TB_Elf64_Shdr sec = {
             .name = s->name_pos,
             .type = TB_SHT_PROGBITS,
-            .flags = TB_SHF_ALLOC | ((s->flags & TB_PF_X) ? TB_SHF_EXECINSTR : 0) | ((s->flags & TB_PF_W) ? TB_SHF_WRITE : 0),
+            .flags = (s->flags ? TB_SHF_ALLOC : 0) | ((s->flags & TB_PF_X) ? TB_SHF_EXECINSTR : 0) | ((s->flags & TB_PF_W) ? TB_SHF_WRITE : 0),
             .addralign = 1,
             .size = s->total_size,
             .addr = s->address,
@@ -216,6 +293,10 @@ static TB_ExportBuffer elf_export(TB_Linker* l) {
             tb__apply_module_relocs(l, l->ir_modules[i], output);
         }
 
+        dyn_array_for(i, l->debug_info) {
+            elf_apply_debug_relocs(l, &l->debug_info[i], output);
+        }
+
         // tb__apply_external_relocs(l, output, opt_header.image_base);
     }
 
@@ -185,6 +185,14 @@ typedef struct {
     uint64_t *iat, *ilt;
 } ImportTable;
 
+// debug sections generated from a TB module, they're linked as opaque
+// pieces and relocated once the final layout is known.
+typedef struct {
+    TB_Module* module;
+    TB_SectionGroup group;
+    TB_LinkerSectionPiece** pieces;
+} TB_LinkerDebugInfo;
+
 typedef struct TB_LinkerRelocRel TB_LinkerRelocRel;
 struct TB_LinkerRelocRel {
     // within the same piece
@@ -294,6 +302,8 @@ typedef struct TB_Linker {
 
     NL_Strmap(TB_UnresolvedSymbol*) unresolved_symbols;
 
+    DynArray(TB_LinkerDebugInfo) debug_info;
+
     // Message pump:
     //   this is how the user and linker communicate
     //
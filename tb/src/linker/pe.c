@@ -421,7 +421,7 @@ static void pe_append_module(TB_Linker* l, TB_LinkerThreadInfo* info, TB_Module*
     // Also resolves internal call patches which is cool
     ExportList exports;
     CUIK_TIMED_BLOCK("layout section") {
-        m->exports = tb_module_layout_sections(m);
+        m->exports = tb_module_layout_sections(m, false);
     }
 
     TB_LinkerInputHandle mod_index = tb__track_module(l, 0, m);
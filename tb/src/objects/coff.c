@@ -123,7 +123,7 @@ TB_ExportBuffer tb_coff_write_output(TB_Module* m, const IDebugFormat* dbg) {
 
     ExportList exports;
     CUIK_TIMED_BLOCK("layout section") {
-        exports = tb_module_layout_sections(m);
+        exports = tb_module_layout_sections(m, false);
     }
 
     // accumulate all sections
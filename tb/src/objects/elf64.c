@@ -35,7 +35,18 @@ static void put_section_symbols(DynArray(TB_ModuleSection) sections, TB_Emitter*
             TB_FunctionOutput* out_f = funcs[i];
             const char* name_str = out_f->parent->super.name;
 
-            uint32_t name = name_str ? tb_outstr_nul_UNSAFE(strtbl, name_str) : 0;
+            // the cold part of a split function is a local "name.cold", nothing
+            // refers to it by symbol so it's just there for debuggers & profilers.
+            if (out_f->hot_part != NULL) {
+                if (t == TB_ELF64_STB_LOCAL) {
+                    uint32_t name = tb_outs(strtbl, strlen(name_str), name_str);
+                    tb_outstr_nul(strtbl, ".cold");
+                    put_symbol(stab, name, TB_ELF64_ST_INFO(t, TB_ELF64_STT_FUNC), sec_num, out_f->code_pos, out_f->code_size);
+                }
+                continue;
+            }
+
+            uint32_t name = name_str ? tb_outstr_nul(strtbl, name_str) : 0;
             out_f->parent->super.symbol_id = put_symbol(stab, name, TB_ELF64_ST_INFO(t, TB_ELF64_STT_FUNC), sec_num, out_f->code_pos, out_f->code_size);
         }
 
@@ -48,11 +59,11 @@ static void put_section_symbols(DynArray(TB_ModuleSection) sections, TB_Emitter*
 
             uint32_t name = 0;
             if (g->super.name) {
-                name = tb_outstr_nul_UNSAFE(strtbl, g->super.name);
+                name = tb_outstr_nul(strtbl, g->super.name);
             } else {
                 char buf[8];
                 snprintf(buf, 8, "$%d_%td", sec_num, i);
-                name = tb_outstr_nul_UNSAFE(strtbl, buf);
+                name = tb_outstr_nul(strtbl, buf);
             }
 
             g->super.symbol_id = put_symbol(stab, name, TB_ELF64_ST_INFO(t, TB_ELF64_STT_OBJECT), sec_num, g->pos, 0);
@@ -62,9 +73,15 @@ static void put_section_symbols(DynArray(TB_ModuleSection) sections, TB_Emitter*
 
 #define WRITE(data, size) (memcpy(&output[write_pos], data, size), write_pos += (size))
 TB_ExportBuffer tb_elf64obj_write_output(TB_Module* m, const IDebugFormat* dbg) {
+    if (dbg && !dbg->supported_target(m)) {
+        dbg = NULL;
+    }
+
+    // cold code goes into .text.cold unless we're making debug info, the line
+    // tables and unwind info assume a function is in one piece.
     ExportList exports;
     CUIK_TIMED_BLOCK("layout section") {
-        exports = tb_module_layout_sections(m);
+        exports = tb_module_layout_sections(m, dbg == NULL);
     }
 
     const ICodeGen* restrict code_gen = tb__find_code_generator(m);
@@ -111,8 +128,12 @@ TB_ExportBuffer tb_elf64obj_write_output(TB_Module* m, const IDebugFormat* dbg)
     // accumulate all sections
     DynArray(TB_ModuleSection) sections = m->sections;
 
-    int dbg_section_count = (dbg ? dbg->number_of_debug_sections(m) : 0);
-    int section_count = 2 + dyn_array_length(sections) + dbg_section_count;
+    TB_SectionGroup debug_sections = { 0 };
+    if (dbg) CUIK_TIMED_BLOCK("generate debug") {
+        debug_sections = dbg->generate_debug_info(m, tb_tls_allocate());
+    }
+
+    int section_count = 2 + dyn_array_length(sections) + debug_sections.length;
 
     size_t output_size = sizeof(TB_Elf64_Ehdr);
     dyn_array_for(i, sections) {
@@ -121,6 +142,18 @@ TB_ExportBuffer tb_elf64obj_write_output(TB_Module* m, const IDebugFormat* dbg)
         output_size += sections[i].total_size;
     }
 
+    // debug sections go right after the module sections, we stash the file offset in
+    // the virtual address since there's no other use for it in objects.
+    size_t dbg_section_num = 3 + dyn_array_length(sections);
+    FOREACH_N(i, 0, debug_sections.length) {
+        if (debug_sections.data[i].flags & TB_SHF_ALLOC) {
+            output_size = align_up(output_size, 8);
+        }
+
+        debug_sections.data[i].virtual_address = output_size;
+        output_size += debug_sections.data[i].raw_data.length;
+    }
+
     // calculate relocation layout
     // each section with relocations needs a matching .rel section
     output_size = tb__layout_relocations(m, sections, code_gen, output_size, sizeof(TB_Elf64_Rela));
@@ -130,14 +163,30 @@ TB_ExportBuffer tb_elf64obj_write_output(TB_Module* m, const IDebugFormat* dbg)
             tb_outs(&strtbl, 5, ".rela");
         }
 
-        sections[i].name_pos = tb_outstr_nul_UNSAFE(&strtbl, sections[i].name);
+        sections[i].name_pos = tb_outstr_nul(&strtbl, sections[i].name);
+    }
+
+    // the debug relocation arrays are stored in the same way as the module ones
+    uint32_t* dbg_name_pos = tb_platform_heap_alloc((debug_sections.length + 1) * sizeof(uint32_t));
+    FOREACH_N(i, 0, debug_sections.length) {
+        TB_ObjectSection* s = &debug_sections.data[i];
+        if (s->relocation_count > 0) {
+            section_count += 1;
+            tb_outs(&strtbl, 5, ".rela");
+
+            s->user_data = (void*) (uintptr_t) output_size;
+            output_size += s->relocation_count * sizeof(TB_Elf64_Rela);
+        }
+
+        dbg_name_pos[i] = tb_outs(&strtbl, s->name.length, s->name.data);
+        tb_out1b(&strtbl, 0);
     }
 
     // calculate symbol IDs
     TB_Emitter local_symtab = { 0 }, global_symtab = { 0 };
     tb_out_zero(&local_symtab, sizeof(TB_Elf64_Sym));
     dyn_array_for(i, sections) {
-        put_symbol(&local_symtab, sections[i].name_pos, TB_ELF64_ST_INFO(TB_ELF64_STB_LOCAL, TB_ELF64_STT_SECTION), 1 + i, 0, 0);
+        put_symbol(&local_symtab, sections[i].name_pos, TB_ELF64_ST_INFO(TB_ELF64_STB_LOCAL, TB_ELF64_STT_SECTION), sections[i].section_num, 0, 0);
     }
 
     // .rela sections
@@ -145,22 +194,26 @@ TB_ExportBuffer tb_elf64obj_write_output(TB_Module* m, const IDebugFormat* dbg)
         put_symbol(&local_symtab, sections[i].name_pos - 5, TB_ELF64_ST_INFO(TB_ELF64_STB_LOCAL, TB_ELF64_STT_SECTION), 1 + i, 0, 0);
     }
 
-    assert(dbg_section_count == 0);
+    // debug relocations are all section-relative so they need section symbols too
+    size_t dbg_sym_base = local_symtab.count / sizeof(TB_Elf64_Sym);
+    FOREACH_N(i, 0, debug_sections.length) {
+        put_symbol(&local_symtab, dbg_name_pos[i], TB_ELF64_ST_INFO(TB_ELF64_STB_LOCAL, TB_ELF64_STT_SECTION), dbg_section_num + i, 0, 0);
+    }
 
     put_section_symbols(sections, &strtbl, &local_symtab, TB_ELF64_STB_LOCAL);
     put_section_symbols(sections, &strtbl, &global_symtab, TB_ELF64_STB_GLOBAL);
 
     FOREACH_N(i, 0, exports.count) {
         TB_External* ext = exports.data[i];
-        uint32_t name = tb_outstr_nul_UNSAFE(&strtbl, ext->super.name);
+        uint32_t name = tb_outstr_nul(&strtbl, ext->super.name);
         ext->super.symbol_id = global_symtab.count / sizeof(TB_Elf64_Sym);
 
         put_symbol(&global_symtab, name, TB_ELF64_ST_INFO(TB_ELF64_STB_GLOBAL, 0), 0, 0, 0);
     }
 
-    uint32_t symtab_name = tb_outstr_nul_UNSAFE(&strtbl, ".symtab");
+    uint32_t symtab_name = tb_outstr_nul(&strtbl, ".symtab");
     TB_Elf64_Shdr strtab = {
-        .name = tb_outstr_nul_UNSAFE(&strtbl, ".strtab"),
+        .name = tb_outstr_nul(&strtbl, ".strtab"),
         .type = TB_SHT_STRTAB,
         .flags = 0,
         .addralign = 1,
@@ -200,6 +253,16 @@ TB_ExportBuffer tb_elf64obj_write_output(TB_Module* m, const IDebugFormat* dbg)
         write_pos = tb_helper_write_section(m, write_pos, &sections[i], output, sections[i].raw_data_pos);
     }
 
+    FOREACH_N(i, 0, debug_sections.length) {
+        TB_Slice raw = debug_sections.data[i].raw_data;
+
+        // padding for .eh_frame
+        size_t pos = debug_sections.data[i].virtual_address;
+        memset(&output[write_pos], 0, pos - write_pos), write_pos = pos;
+
+        WRITE(raw.data, raw.length);
+    }
+
     // write relocation arrays
     size_t local_sym_count = local_symtab.count / sizeof(TB_Elf64_Sym);
     dyn_array_for(i, sections) if (sections[i].reloc_count > 0) {
@@ -222,12 +285,54 @@ TB_ExportBuffer tb_elf64obj_write_output(TB_Module* m, const IDebugFormat* dbg)
                 }
                 assert(symbol_id != 0);
 
+                // the emitter leaves the displacement in place (it's negative when an
+                // immediate follows it), RELA ignores that so it goes into the addend.
+                int32_t disp;
+                memcpy(&disp, &func_out->code[p->pos], sizeof(disp));
+
                 TB_ELF_RelocType type = p->target->tag == TB_SYMBOL_GLOBAL ? TB_ELF_X86_64_PC32 : TB_ELF_X86_64_PLT32;
                 *rels++ = (TB_Elf64_Rela){
                     .offset = actual_pos,
                     // check when we should prefer R_X86_64_GOTPCREL
                     .info   = TB_ELF64_R_INFO(symbol_id, type),
-                    .addend = -4
+                    .addend = disp - 4
+                };
+            }
+
+            // jumps into the other part of a split function, they're relative
+            // to its section and hold the target's offset within the part.
+            TB_FunctionOutput* other = func_out->cold_part ? func_out->cold_part : func_out->hot_part;
+            if (other != NULL) {
+                dyn_array_for(k, func_out->cold_jumps) {
+                    uint32_t pos = func_out->cold_jumps[k];
+
+                    uint32_t target;
+                    memcpy(&target, &func_out->code[pos], sizeof(target));
+
+                    *rels++ = (TB_Elf64_Rela){
+                        .offset = source_offset + pos,
+                        .info   = TB_ELF64_R_INFO(1 + other->section, TB_ELF_X86_64_PC32),
+                        .addend = (int64_t) (other->code_pos + target) - 4
+                    };
+                }
+            }
+        }
+
+        dyn_array_for(j, globals) {
+            TB_Global* g = globals[j];
+            FOREACH_N(k, 0, g->obj_count) {
+                if (g->objects[k].type != TB_INIT_OBJ_RELOC) continue;
+
+                const TB_Symbol* target = g->objects[k].reloc;
+                size_t symbol_id = target->symbol_id;
+                if (is_nonlocal(target)) {
+                    symbol_id += local_sym_count;
+                }
+                assert(symbol_id != 0);
+
+                *rels++ = (TB_Elf64_Rela){
+                    .offset = g->pos + g->objects[k].offset,
+                    .info   = TB_ELF64_R_INFO(symbol_id, TB_ELF_X86_64_64),
                 };
             }
         }
@@ -235,6 +340,35 @@ TB_ExportBuffer tb_elf64obj_write_output(TB_Module* m, const IDebugFormat* dbg)
         write_pos += sections[i].reloc_count * sizeof(TB_Elf64_Rela);
     }
 
+    // see debug/dwarf.c for how these relocations are meant to be interpreted
+    FOREACH_N(i, 0, debug_sections.length) {
+        TB_ObjectSection* s = &debug_sections.data[i];
+        if (s->relocation_count == 0) continue;
+
+        assert((uintptr_t) s->user_data == write_pos);
+        TB_Elf64_Rela* rels = (TB_Elf64_Rela*) &output[write_pos];
+        FOREACH_N(j, 0, s->relocation_count) {
+            TB_ObjectReloc* r = &s->relocations[j];
+
+            size_t symbol_id;
+            TB_ELF_RelocType type;
+            switch (r->type) {
+                case TB_OBJECT_RELOC_ADDR64: type = TB_ELF_X86_64_64;   symbol_id = 1 + r->symbol_index; break;
+                case TB_OBJECT_RELOC_REL32:  type = TB_ELF_X86_64_PC32; symbol_id = 1 + r->symbol_index; break;
+                case TB_OBJECT_RELOC_SECREL: type = TB_ELF_X86_64_32;   symbol_id = dbg_sym_base + r->symbol_index; break;
+                default: tb_todo();
+            }
+
+            *rels++ = (TB_Elf64_Rela){
+                .offset = r->virtual_address,
+                .info   = TB_ELF64_R_INFO(symbol_id, type),
+                .addend = r->addend
+            };
+        }
+
+        write_pos += s->relocation_count * sizeof(TB_Elf64_Rela);
+    }
+
     assert(write_pos == strtab.offset);
     WRITE(strtbl.data, strtbl.count);
 
@@ -267,6 +401,19 @@ TB_ExportBuffer tb_elf64obj_write_output(TB_Module* m, const IDebugFormat* dbg)
         WRITE(&sec, sizeof(sec));
     }
 
+    FOREACH_N(i, 0, debug_sections.length) {
+        TB_ObjectSection* s = &debug_sections.data[i];
+        TB_Elf64_Shdr sec = {
+            .name = dbg_name_pos[i],
+            .type = TB_SHT_PROGBITS,
+            .flags = s->flags,
+            .addralign = s->flags & TB_SHF_ALLOC ? 8 : 1,
+            .size = s->raw_data.length,
+            .offset = s->virtual_address,
+        };
+        WRITE(&sec, sizeof(sec));
+    }
+
     dyn_array_for(i, sections) if (sections[i].reloc_count) {
         TB_Elf64_Shdr sec = {
             .name = sections[i].name_pos - 5,
@@ -282,6 +429,25 @@ TB_ExportBuffer tb_elf64obj_write_output(TB_Module* m, const IDebugFormat* dbg)
         WRITE(&sec, sizeof(sec));
     }
 
+    FOREACH_N(i, 0, debug_sections.length) {
+        TB_ObjectSection* s = &debug_sections.data[i];
+        if (s->relocation_count == 0) continue;
+
+        TB_Elf64_Shdr sec = {
+            .name = dbg_name_pos[i] - 5,
+            .type = TB_SHT_RELA,
+            .flags = TB_SHF_INFO_LINK,
+            .addralign = 16,
+            .info = dbg_section_num + i,
+            .link = 2,
+            .size = s->relocation_count * sizeof(TB_Elf64_Rela),
+            .offset = (uintptr_t) s->user_data,
+            .entsize = sizeof(TB_Elf64_Rela)
+        };
+        WRITE(&sec, sizeof(sec));
+    }
+
     assert(write_pos == output_size);
+    tb_platform_heap_free(dbg_name_pos);
     return (TB_ExportBuffer){ .total = output_size, .head = chunk, .tail = chunk };
 }
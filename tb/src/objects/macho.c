@@ -8,7 +8,7 @@ TB_ExportBuffer tb_macho_write_output(TB_Module* m, const IDebugFormat* dbg) {
     TB_Emitter string_table = { 0 };
 
     CUIK_TIMED_BLOCK("layout section") {
-        tb_module_layout_sections(m);
+        tb_module_layout_sections(m, false);
     }
 
     // segments
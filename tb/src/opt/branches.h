@@ -1,5 +1,20 @@
 enum { MAX_DOM_WALK = 10 };
 
+// if-conversion limits: how much we're willing to compute on the path we
+// didn't take (in cycles) and how biased a branch can be before we keep it.
+enum { IF_CONVERT_MAX_COST = 8, IF_CONVERT_MAX_DEPTH = 4 };
+#define IF_CONVERT_MIN_BIAS 0.1f
+
+// profiled (or hinted) regions hanging off a branch are the only place we know how
+// likely that path is, we keep them around so the CFG still sees it.
+static bool region_holds_profile(TB_Function* f, TB_Node* n) {
+    if (n->input_count != 1 || n->inputs[0]->type != TB_PROJ || n->inputs[0]->inputs[0]->type != TB_BRANCH) {
+        return false;
+    }
+
+    return f->profiled || TB_NODE_GET_EXTRA_T(n, TB_NodeRegion)->freq != 1.0f;
+}
+
 static TB_Node* ideal_region(TB_Passes* restrict p, TB_Function* f, TB_Node* n) {
     TB_NodeRegion* r = TB_NODE_GET_EXTRA(n);
 
@@ -20,6 +35,10 @@ static TB_Node* ideal_region(TB_Passes* restrict p, TB_Function* f, TB_Node* n)
             use = next;
         }
 
+        if (region_holds_profile(f, n)) {
+            return NULL;
+        }
+
         // we might want this as an identity
         return n->inputs[0];
     } else {
@@ -42,7 +61,7 @@ static TB_Node* ideal_region(TB_Passes* restrict p, TB_Function* f, TB_Node* n)
             } else if (n->inputs[i]->type == TB_REGION) {
                 #if 1
                 // pure regions can be collapsed into direct edges
-                if (n->inputs[i]->users->next == NULL && n->inputs[i]->input_count > 0) {
+                if (n->inputs[i]->users->next == NULL && n->inputs[i]->input_count > 0 && !region_holds_profile(f, n->inputs[i])) {
                     assert(n->inputs[i]->users->n == n);
                     changes = true;
 
@@ -107,148 +126,364 @@ static TB_Node* ideal_region(TB_Passes* restrict p, TB_Function* f, TB_Node* n)
     return NULL;
 }
 
-static TB_Node* ideal_phi(TB_Passes* restrict opt, TB_Function* f, TB_Node* n) {
-    // degenerate PHI, poison it
-    if (n->input_count == 1) {
-        log_warn("%s: ir: generated poison due to PHI with no edges", f->super.name);
-        return make_poison(f, opt, n->dt);
+typedef struct {
+    uint64_t key;
+    int slot; // which region edge this key enters on
+} LookupCase;
+
+static int compare_lookup_cases(const void* a, const void* b) {
+    uint64_t ak = ((const LookupCase*) a)->key;
+    uint64_t bk = ((const LookupCase*) b)->key;
+    return (ak > bk) - (ak < bk);
+}
+
+// phi with the same value on every edge (memory phis through empty paths)
+static TB_Node* phi_same_input(TB_Node* phi) {
+    FOREACH_N(i, 2, phi->input_count) {
+        if (phi->inputs[i] != phi->inputs[1]) return NULL;
     }
+    return phi->inputs[1];
+}
 
-    // if branch, both paths are empty => select(cond, t, f)
-    //
-    // TODO(NeGate): we can make this diamond trick work for bigger
-    // branches, we should support a lookup instruction similar to
-    // "switch" logic for data.
-    TB_DataType dt = n->dt;
+// try to make a multi-way lookup:
+//
+//      Branch
+//       / | \
+//    ... ... ...         each of these is a CProj
+//       \ | /
+//       Region
+//            \
+//             \ ... ...  each of these is a trivial value (int consts only for now)
+//              \ | /
+//               Phi
+//
+// every phi on the region gets its own lookup, dense keys are lowered into a flat
+// table and sparse keys (up to LOOKUP_MAX_SPARSE) into compare + cmov chains.
+static TB_Node* try_as_lookup(TB_Passes* restrict opt, TB_Function* f, TB_Node* n) {
     TB_Node* region = n->inputs[0];
-    if (n->dt.type != TB_MEMORY) {
-        if (region->input_count == 2) {
-            // for now we'll leave multi-phi scenarios alone, we need
-            // to come up with a cost-model around this stuff.
-            for (User* use = find_users(opt, region); use; use = use->next) {
-                if (use->n->type == TB_PHI) {
-                    if (use->n != n) return NULL;
-                }
-            }
+    if (region->inputs[0]->type != TB_PROJ || region->inputs[0]->inputs[0]->type != TB_BRANCH) {
+        return NULL;
+    }
 
-            // guarentee paths are effectless (there's only one data phi and no control nodes)
-            //
-            //        If
-            //       /  \
-            // CProjT    CProjF          Region[0][0] == Region[1][0]
-            //       \  /
-            //      Region
-            //
-            TB_Node* left = region->inputs[0];
-            TB_Node* right = region->inputs[1];
-            if (left->type == TB_PROJ && right->type == TB_PROJ &&
-                left->inputs[0]->type == TB_BRANCH && left->inputs[0] == right->inputs[0]) {
-                TB_Node* branch = left->inputs[0];
-                TB_NodeBranch* header_br = TB_NODE_GET_EXTRA(branch);
-
-                if (header_br->succ_count == 2) {
-                    assert(branch->input_count == 2);
-
-                    TB_Node *values[2];
-                    for (User* u = branch->users; u; u = u->next) {
-                        TB_Node* proj = u->n;
-                        if (proj->type == TB_PROJ) {
-                            int index = TB_NODE_GET_EXTRA_T(proj, TB_NodeProj)->index;
-                            // the projection needs to exclusively refer to the region,
-                            // if not we can't elide those effects here.
-                            if (proj->users->next != NULL || proj->users->n != region) {
-                                return NULL;
-                            }
+    TB_Node* parent = region->inputs[0]->inputs[0];
+    TB_NodeBranch* br = TB_NODE_GET_EXTRA(parent);
+    if (parent->input_count != 2 || parent->inputs[1]->dt.type != TB_INT || br->succ_count != region->input_count) {
+        return NULL;
+    }
 
-                            int phi_i = proj->users->slot;
-                            assert(phi_i + 1 < n->input_count);
-                            values[index] = n->inputs[1 + phi_i];
-                        }
-                    }
+    // verify we have a really clean looking diamond shape, every successor must enter
+    // the region directly (no effects on the paths) and the region must be the only
+    // place those paths go.
+    FOREACH_N(i, 0, region->input_count) {
+        TB_Node* proj = region->inputs[i];
+        if (proj->type != TB_PROJ || proj->inputs[0] != parent || proj->users->next != NULL) {
+            return NULL;
+        }
+    }
 
-                    uint64_t falsey = TB_NODE_GET_EXTRA_T(branch, TB_NodeBranch)->keys[0];
-                    TB_Node* cond = branch->inputs[1];
-
-                    // TODO(NeGate): handle non-zero falseys
-                    if (falsey == 0) {
-                        // header -> merge
-                        {
-                            TB_Node* parent = branch->inputs[0];
-                            tb_pass_kill_node(opt, branch);
-                            tb_pass_kill_node(opt, left);
-                            tb_pass_kill_node(opt, right);
-
-                            // attach the header and merge to each other
-                            tb_pass_mark(opt, parent);
-                            tb_pass_mark_users(opt, region);
-                            subsume_node(opt, f, region, parent);
-                        }
+    // every phi has to be either all constants or the same value on each edge
+    size_t phi_count = 0;
+    for (User* u = region->users; u; u = u->next) {
+        TB_Node* phi = u->n;
+        if (phi->type != TB_PHI || u->slot != 0) continue;
 
-                        TB_Node* selector = tb_alloc_node(f, TB_SELECT, dt, 4, 0);
-                        set_input(opt, selector, cond, 1);
-                        set_input(opt, selector, values[0], 2);
-                        set_input(opt, selector, values[1], 3);
-                        return selector;
-                    }
-                }
-            }
+        phi_count += 1;
+        if (phi_same_input(phi) != NULL) continue;
+        if (phi->dt.type != TB_INT) return NULL;
+
+        FOREACH_N(i, 1, phi->input_count) {
+            if (phi->inputs[i]->type != TB_INTEGER_CONST) return NULL;
         }
+    }
 
-        if (region->input_count > 2 && n->dt.type == TB_INT) {
-            if (region->inputs[0]->type != TB_PROJ || region->inputs[0]->inputs[0]->type != TB_BRANCH) {
-                return NULL;
+    // sort cases by key, keys are compared unsigned within the width of the key
+    size_t key_count = br->succ_count - 1;
+    uint64_t key_mask = tb__mask(parent->inputs[1]->dt.data);
+
+    int default_slot = -1;
+    LookupCase* cases = tb_arena_alloc(tmp_arena, key_count * sizeof(LookupCase));
+    FOREACH_N(i, 0, region->input_count) {
+        int index = TB_NODE_GET_EXTRA_T(region->inputs[i], TB_NodeProj)->index;
+        assert(index < br->succ_count);
+
+        if (index == 0) {
+            default_slot = i;
+        } else {
+            cases[index - 1] = (LookupCase){ br->keys[index - 1] & key_mask, i };
+        }
+    }
+    assert(default_slot >= 0);
+    qsort(cases, key_count, sizeof(LookupCase), compare_lookup_cases);
+
+    // cost model: tables are cheap when they're dense, cmov chains are cheap when short.
+    if (!lookup_is_dense(cases[0].key, cases[key_count - 1].key, key_count) && key_count > LOOKUP_MAX_SPARSE) {
+        return NULL;
+    }
+
+    // we'll be subsuming the phis so we can't walk the user list while doing it
+    size_t j = 0;
+    TB_Node** phis = tb_arena_alloc(tmp_arena, phi_count * sizeof(TB_Node*));
+    for (User* u = region->users; u; u = u->next) {
+        if (u->n->type == TB_PHI && u->slot == 0) phis[j++] = u->n;
+    }
+
+    TB_Node* key = parent->inputs[1];
+    TB_Node* result = NULL;
+    FOREACH_N(i, 0, phi_count) {
+        TB_Node* phi = phis[i];
+
+        TB_Node* k = phi_same_input(phi);
+        if (k == NULL) {
+            uint64_t val_mask = tb__mask(phi->dt.data);
+
+            k = tb_alloc_node(f, TB_LOOKUP, phi->dt, 2, sizeof(TB_NodeLookup) + (br->succ_count * sizeof(TB_LookupEntry)));
+            set_input(opt, k, key, 1);
+
+            TB_NodeLookup* l = TB_NODE_GET_EXTRA(k);
+            l->entry_count = br->succ_count;
+            l->entries[0].key = 0; // default value, key doesn't matter
+            l->entries[0].val = TB_NODE_GET_EXTRA_T(phi->inputs[1 + default_slot], TB_NodeInt)->value & val_mask;
+            FOREACH_N(c, 0, key_count) {
+                l->entries[1 + c].key = cases[c].key;
+                l->entries[1 + c].val = TB_NODE_GET_EXTRA_T(phi->inputs[1 + cases[c].slot], TB_NodeInt)->value & val_mask;
             }
+            tb_pass_mark(opt, k);
+        }
 
-            // try to make a multi-way lookup:
-            //
-            //      Branch
-            //       / | \
-            //    ... ... ...         each of these is a CProj
-            //       \ | /
-            //       Region
-            //            \
-            //             \ ... ...  each of these is a trivial value (int consts only for now)
-            //              \ | /
-            //               Phi
-            TB_Node* parent = region->inputs[0]->inputs[0];
-            TB_NodeBranch* br = TB_NODE_GET_EXTRA(parent);
-            if (parent->type != TB_BRANCH || br->succ_count != n->input_count - 1) {
+        // the peephole will subsume n with the result
+        if (phi == n) {
+            result = k;
+        } else {
+            tb_pass_mark_users(opt, phi);
+            subsume_node(opt, f, phi, k);
+        }
+    }
+
+    // kill branch, we don't really need it anymore
+    size_t proj_count = region->input_count;
+    TB_Node** projs = tb_arena_alloc(tmp_arena, proj_count * sizeof(TB_Node*));
+    memcpy(projs, region->inputs, proj_count * sizeof(TB_Node*));
+
+    TB_Node* before = parent->inputs[0];
+    tb_pass_mark(opt, before);
+    tb_pass_mark_users(opt, region);
+    subsume_node(opt, f, region, before);
+
+    FOREACH_N(i, 0, proj_count) {
+        tb_pass_kill_node(opt, projs[i]);
+    }
+    tb_pass_kill_node(opt, parent);
+    return result;
+}
+
+// cost of computing n on both sides of the branch, -1 if it's not safe to speculate.
+static int speculation_cost(ICodeGen* cg, TB_Node* n, int depth) {
+    // shared values get computed regardless of which way we go
+    if (n->users == NULL || n->users->next != NULL) return 0;
+    // anything pinned already has its place (we verified the arms are empty)
+    if (n->input_count > 0 && n->inputs[0] != NULL) return 0;
+
+    switch (n->type) {
+        case TB_INTEGER_CONST: case TB_FLOAT32_CONST: case TB_FLOAT64_CONST:
+        case TB_SYMBOL: case TB_LOCAL: case TB_PROJ: case TB_PHI: case TB_POISON:
+        return 0;
+
+        // division can trap, only speculate it when the divisor can't
+        case TB_SDIV: case TB_UDIV: case TB_SMOD: case TB_UMOD: {
+            uint64_t d;
+            if (!get_int_const(n->inputs[2], &d) || d == 0) return -1;
+            if ((n->type == TB_SDIV || n->type == TB_SMOD) && (d & tb__mask(n->dt.data)) == tb__mask(n->dt.data)) return -1;
+            break;
+        }
+
+        default: break;
+    }
+
+    if (depth >= IF_CONVERT_MAX_DEPTH) return -1;
+
+    int cost = cg && cg->node_cost ? cg->node_cost(n).latency : 1;
+    FOREACH_N(i, 1, n->input_count) {
+        if (n->inputs[i] == NULL) continue;
+
+        int c = speculation_cost(cg, n->inputs[i], depth + 1);
+        if (c < 0) return -1;
+        cost += c;
+    }
+    return cost;
+}
+
+// arms of an if-diamond are either the branch's projection or a single entry region
+// left around to hold its frequency, returns the projection.
+static TB_Node* if_convert_arm(TB_Node* region, TB_Node* arm) {
+    if (arm->users->next != NULL || arm->users->n != region) {
+        return NULL;
+    }
+
+    if (arm->type == TB_REGION) {
+        if (arm->input_count != 1) return NULL;
+        arm = arm->inputs[0];
+        if (arm->users->next != NULL) return NULL;
+    }
+
+    return arm->type == TB_PROJ && arm->inputs[0]->type == TB_BRANCH ? arm : NULL;
+}
+
+// empty diamond => select(cond, t, f) for every phi on the merge:
+//
+//        If
+//       /  \
+// CProjT    CProjF          both arms may have a (profile holding) region in between
+//       \  /
+//      Region
+//
+// cmov is only a win when the branch is hard to predict and the arms are cheap, so we
+// leave well biased branches alone (when we know it) and cap the work we'd speculate.
+static TB_Node* try_if_convert(TB_Passes* restrict opt, TB_Function* f, TB_Node* n) {
+    TB_Node* region = n->inputs[0];
+    TB_Node* arms[2] = { region->inputs[0], region->inputs[1] };
+    TB_Node* left = if_convert_arm(region, arms[0]);
+    TB_Node* right = if_convert_arm(region, arms[1]);
+    if (left == NULL || right == NULL || left->inputs[0] != right->inputs[0]) {
+        return NULL;
+    }
+
+    TB_Node* branch = left->inputs[0];
+    TB_NodeBranch* br = TB_NODE_GET_EXTRA(branch);
+    if (br->succ_count != 2 || branch->input_count != 2) {
+        return NULL;
+    }
+
+    // which region edge does the true side come in through
+    int true_slot = TB_NODE_GET_EXTRA_T(left, TB_NodeProj)->index == 0 ? 0 : 1;
+
+    // predictable branches are cheaper than the dependency on the condition, arms
+    // without a region weren't hinted so they're just the usual frequency.
+    if (arms[0]->type == TB_REGION || arms[1]->type == TB_REGION) {
+        float a = arms[0]->type == TB_REGION ? TB_NODE_GET_EXTRA_T(arms[0], TB_NodeRegion)->freq : 1.0f;
+        float b = arms[1]->type == TB_REGION ? TB_NODE_GET_EXTRA_T(arms[1], TB_NodeRegion)->freq : 1.0f;
+        float p = a + b > 0.0f ? a / (a + b) : 0.5f;
+        if (p < IF_CONVERT_MIN_BIAS || p > 1.0f - IF_CONVERT_MIN_BIAS) {
+            return NULL;
+        }
+    }
+
+    TB_Node* cond = branch->inputs[1];
+    ICodeGen* cg = tb__find_code_generator(f->super.module);
+
+    size_t phi_count = 0;
+    int cost = 0;
+    for (User* u = find_users(opt, region); u; u = u->next) {
+        TB_Node* phi = u->n;
+        if (phi->type != TB_PHI || u->slot != 0) continue;
+
+        phi_count += 1;
+        if (phi_same_input(phi) != NULL) continue;
+
+        // we can't select between effects
+        if (phi->dt.type == TB_MEMORY || phi->dt.type == TB_CONTROL || phi->dt.type == TB_TUPLE) {
+            return NULL;
+        }
+
+        // there's no float cmov, only the min/max patterns are worth it
+        if (phi->dt.type == TB_FLOAT) {
+            TB_Node* t = phi->inputs[1 + true_slot];
+            TB_Node* e = phi->inputs[2 - true_slot];
+            if (br->keys[0] != 0 || cond->type != TB_CMP_FLT ||
+                !((t == cond->inputs[1] && e == cond->inputs[2]) || (t == cond->inputs[2] && e == cond->inputs[1]))) {
                 return NULL;
             }
+        }
 
-            // verify we have a really clean looking diamond shape
-            FOREACH_N(i, 0, n->input_count - 1) {
-                if (region->inputs[i]->type != TB_PROJ || region->inputs[i]->inputs[0] != parent) return NULL;
-                if (n->inputs[1 + i]->type != TB_INTEGER_CONST) return NULL;
-            }
+        FOREACH_N(i, 1, 3) {
+            int c = speculation_cost(cg, phi->inputs[i], 0);
+            if (c < 0) return NULL;
+            cost += c;
+        }
+    }
 
-            // convert to lookup node
-            TB_Node* lookup = tb_alloc_node(f, TB_LOOKUP, n->dt, 2, sizeof(TB_NodeLookup) + (br->succ_count * sizeof(TB_LookupEntry)));
-            set_input(opt, lookup, parent->inputs[1], 1);
+    if (cost > IF_CONVERT_MAX_COST) {
+        return NULL;
+    }
 
-            TB_NodeLookup* l = TB_NODE_GET_EXTRA(lookup);
-            l->entry_count = br->succ_count;
-            FOREACH_N(i, 0, n->input_count - 1) {
-                TB_Node* k = region->inputs[i];
-                int index = TB_NODE_GET_EXTRA_T(k, TB_NodeProj)->index;
-                assert(index < br->succ_count);
-
-                if (index == 0) {
-                    l->entries[index].key = 0; // default value, doesn't matter
-                } else {
-                    l->entries[index].key = br->keys[index - 1];
-                }
+    // the branch is taken on anything but the falsey value
+    if (br->keys[0] != 0) {
+        TB_Node* imm = make_int_node(f, opt, cond->dt, br->keys[0]);
+        TB_Node* cmp = tb_alloc_node(f, TB_CMP_NE, TB_TYPE_BOOL, 3, sizeof(TB_NodeCompare));
+        set_input(opt, cmp, cond, 1);
+        set_input(opt, cmp, imm, 2);
+        TB_NODE_SET_EXTRA(cmp, TB_NodeCompare, .cmp_dt = cond->dt);
+        tb_pass_mark(opt, cmp);
+        cond = cmp;
+    }
 
-                TB_NodeInt* v = TB_NODE_GET_EXTRA(n->inputs[1 + i]);
-                l->entries[index].val = v->value;
+    // we'll be subsuming the phis so we can't walk the user list while doing it
+    size_t j = 0;
+    TB_Node** phis = tb_arena_alloc(tmp_arena, phi_count * sizeof(TB_Node*));
+    for (User* u = region->users; u; u = u->next) {
+        if (u->n->type == TB_PHI && u->slot == 0) phis[j++] = u->n;
+    }
+
+    TB_Node* result = NULL;
+    FOREACH_N(i, 0, phi_count) {
+        TB_Node* phi = phis[i];
+
+        TB_Node* k = phi_same_input(phi);
+        if (k == NULL) {
+            TB_Node* t = phi->inputs[1 + true_slot];
+            TB_Node* e = phi->inputs[2 - true_slot];
+            if (phi->dt.type == TB_FLOAT) {
+                // (lt A B) ? A : B => min(A, B), (lt A B) ? B : A => max(A, B)
+                k = tb_alloc_node(f, t == cond->inputs[1] ? TB_FMIN : TB_FMAX, phi->dt, 3, 0);
+                set_input(opt, k, cond->inputs[1], 1);
+                set_input(opt, k, cond->inputs[2], 2);
+            } else {
+                k = tb_alloc_node(f, TB_SELECT, phi->dt, 4, 0);
+                set_input(opt, k, cond, 1);
+                set_input(opt, k, t, 2);
+                set_input(opt, k, e, 3);
             }
+            tb_pass_mark(opt, k);
+        }
+
+        // the peephole will subsume n with the result
+        if (phi == n) {
+            result = k;
+        } else {
+            tb_pass_mark_users(opt, phi);
+            subsume_node(opt, f, phi, k);
+        }
+    }
+
+    // header -> merge
+    TB_Node* parent = branch->inputs[0];
+    tb_pass_mark(opt, parent);
+    tb_pass_mark_users(opt, region);
+    subsume_node(opt, f, region, parent);
 
-            // kill branch, we don't really need it anymore
-            TB_Node* before = parent->inputs[0];
-            tb_pass_kill_node(opt, parent);
-            subsume_node(opt, f, region, before);
+    FOREACH_N(i, 0, 2) {
+        if (arms[i]->type == TB_REGION) tb_pass_kill_node(opt, arms[i]);
+    }
+    tb_pass_kill_node(opt, left);
+    tb_pass_kill_node(opt, right);
+    tb_pass_kill_node(opt, branch);
+    return result;
+}
+
+static TB_Node* ideal_phi(TB_Passes* restrict opt, TB_Function* f, TB_Node* n) {
+    // degenerate PHI, poison it
+    if (n->input_count == 1) {
+        log_warn("%s: ir: generated poison due to PHI with no edges", f->super.name);
+        return make_poison(f, opt, n->dt);
+    }
 
-            return lookup;
+    TB_Node* region = n->inputs[0];
+    if (n->dt.type != TB_MEMORY) {
+        if (region->input_count == 2) {
+            return try_if_convert(opt, f, n);
+        }
+
+        if (region->input_count > 2 && n->dt.type == TB_INT) {
+            return try_as_lookup(opt, f, n);
         }
     }
 
@@ -440,3 +675,98 @@ static TB_Node* ideal_branch(TB_Passes* restrict opt, TB_Function* f, TB_Node* n
 
     return NULL;
 }
+
+// every return goes through the one exit region, when it's small enough each
+// of the predecessors gets its own copy of the return instead:
+//
+//   A   B             A       B
+//    \ /              |       |
+//   Region    =>    End(a)  End(b)
+//     |
+//   End(phi(a, b))
+//
+// it gives shrink wrapping somewhere to put the epilogue for the early outs
+// which never set up a frame (see shrink_wrap_point).
+enum { RETURN_SPLIT_LIMIT = 8 };
+
+static TB_Node* split_return_input(TB_Node* region, TB_Node* n, int i) {
+    return n->type == TB_PHI && n->inputs[0] == region ? n->inputs[1 + i] : n;
+}
+
+void tb_pass_split_returns(TB_Passes* p) {
+    TB_Function* f = p->f;
+    TB_Node* end = f->stop_node;
+    if (end == NULL || end->type != TB_END) {
+        return;
+    }
+
+    TB_Node* sp = NULL;
+    TB_Node* region = end->inputs[0];
+    if (region->type == TB_SAFEPOINT_NOP) {
+        sp = region;
+        region = sp->inputs[0];
+    }
+
+    if (region->type != TB_REGION || region->input_count < 2 || region->input_count > RETURN_SPLIT_LIMIT) {
+        return;
+    }
+
+    // the exit can't hold anything but the phis for the return
+    for (User* u = region->users; u; u = u->next) {
+        TB_Node* use = u->n;
+        if (use == sp || use == end) {
+            continue;
+        } else if (use->type != TB_PHI) {
+            return;
+        }
+
+        for (User* phi_u = use->users; phi_u; phi_u = phi_u->next) {
+            if (phi_u->n != sp && phi_u->n != end) return;
+        }
+    }
+
+    if (sp != NULL && (sp->users == NULL || sp->users->n != end || sp->users->next != NULL)) {
+        return;
+    }
+
+    TB_Node* first = NULL;
+    FOREACH_N(i, 0, region->input_count) {
+        TB_Node* ctrl = region->inputs[i];
+        if (sp != NULL) {
+            TB_Node* new_sp = tb_alloc_node(f, TB_SAFEPOINT_NOP, TB_TYPE_CONTROL, sp->input_count, sizeof(TB_NodeSafepoint));
+            memcpy(new_sp->extra, sp->extra, sizeof(TB_NodeSafepoint));
+            set_input(p, new_sp, ctrl, 0);
+            FOREACH_N(j, 1, sp->input_count) {
+                set_input(p, new_sp, split_return_input(region, sp->inputs[j], i), j);
+            }
+            ctrl = new_sp;
+        }
+
+        TB_Node* new_end = tb_alloc_node(f, TB_END, TB_TYPE_CONTROL, end->input_count, 0);
+        set_input(p, new_end, ctrl, 0);
+        FOREACH_N(j, 1, end->input_count) {
+            set_input(p, new_end, split_return_input(region, end->inputs[j], i), j);
+        }
+
+        dyn_array_put(f->terminators, new_end);
+        if (first == NULL) first = new_end;
+    }
+
+    // kill the old exit, the phis are dead once the END and the safepoint are
+    dyn_array_for(i, f->terminators) if (f->terminators[i] == end) {
+        dyn_array_remove(f->terminators, i);
+        break;
+    }
+
+    tb_pass_kill_node(p, end);
+    if (sp != NULL) {
+        tb_pass_kill_node(p, sp);
+    }
+
+    while (region->users != NULL) {
+        tb_pass_kill_node(p, region->users->n);
+    }
+    tb_pass_kill_node(p, region);
+
+    f->stop_node = first;
+}
@@ -515,20 +515,6 @@ static TB_Node* ideal_int_binop(TB_Passes* restrict opt, TB_Function* f, TB_Node
                 return n;
             }
         }
-    } else if (type == TB_MUL) {
-        uint64_t rhs;
-        if (get_int_const(b, &rhs)) {
-            uint64_t log2 = tb_ffs(rhs) - 1;
-            if (rhs == (UINT64_C(1) << log2)) {
-                TB_Node* shl_node = tb_alloc_node(f, TB_SHL, n->dt, 3, sizeof(TB_NodeBinopInt));
-                set_input(opt, shl_node, a, 1);
-                set_input(opt, shl_node, make_int_node(f, opt, n->dt, log2), 2);
-
-                tb_pass_mark(opt, shl_node->inputs[1]);
-                tb_pass_mark(opt, shl_node->inputs[2]);
-                return shl_node;
-            }
-        }
     } else if (type == TB_CMP_EQ) {
         // (a == 0) is !a
         TB_Node* cmp = n->inputs[1];
@@ -604,24 +590,6 @@ static TB_Node* ideal_int_binop(TB_Passes* restrict opt, TB_Function* f, TB_Node
     return NULL;
 }
 
-static TB_Node* ideal_int_mod(TB_Passes* restrict opt, TB_Function* f, TB_Node* n) {
-    bool is_signed = n->type == TB_SMOD;
-
-    TB_DataType dt = n->dt;
-    TB_Node* x = n->inputs[1];
-
-    uint64_t y = TB_NODE_GET_EXTRA_T(n->inputs[2], TB_NodeInt)->value;
-    uint64_t log2 = tb_ffs(y) - 1;
-    if (!is_signed && y == (UINT64_C(1) << log2)) {
-        TB_Node* and_node = tb_alloc_node(f, TB_AND, dt, 3, sizeof(TB_NodeBinopInt));
-        set_input(opt, and_node, x, 1);
-        set_input(opt, and_node, make_int_node(f, opt, dt, y - 1), 2);
-        return and_node;
-    }
-
-    return NULL;
-}
-
 static TB_Node* ideal_int_div(TB_Passes* restrict opt, TB_Function* f, TB_Node* n) {
     bool is_signed = n->type == TB_SDIV;
 
@@ -639,17 +607,9 @@ static TB_Node* ideal_int_div(TB_Passes* restrict opt, TB_Function* f, TB_Node*
         return NULL;
     } else if (y == 0) {
         return tb_alloc_node(f, TB_POISON, dt, 1, 0);
-    } else if (y == 1) {
-        return x;
-    } else {
-        // (udiv a N) => a >> log2(N) where N is a power of two
-        uint64_t log2 = tb_ffs(y) - 1;
-        if (!is_signed && y == (UINT64_C(1) << log2)) {
-            TB_Node* shr_node = tb_alloc_node(f, TB_SHR, dt, 3, sizeof(TB_NodeBinopInt));
-            set_input(opt, shr_node, x, 1);
-            set_input(opt, shr_node, make_int_node(f, opt, dt, log2), 2);
-            return shr_node;
-        }
+    } else if (y == 1 || (y & (y - 1)) == 0) {
+        // peeps.rules handles the powers of two
+        return NULL;
     }
 
     // idk how to handle this yet
@@ -714,27 +674,15 @@ static TB_Node* ideal_int_div(TB_Passes* restrict opt, TB_Function* f, TB_Node*
 ////////////////////////////////
 // Integer identities
 ////////////////////////////////
-// a + 0 => a
-// a - 0 => a
-// a ^ 0 => a
-// a * 0 => 0
 // a / 0 => poison
+//
+// the simpler ones (a + 0 and friends) are in peeps.rules
 static TB_Node* identity_int_binop(TB_Passes* restrict opt, TB_Function* f, TB_Node* n) {
     if (!is_zero(n->inputs[2])) return n;
 
     switch (n->type) {
         default: return n;
 
-        case TB_SHL:
-        case TB_SHR:
-        case TB_ADD:
-        case TB_SUB:
-        case TB_XOR:
-        return n->inputs[1];
-
-        case TB_MUL:
-        return n->inputs[0];
-
         case TB_UDIV:
         case TB_SDIV:
         return make_poison(f, opt, n->dt);
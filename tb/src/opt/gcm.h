@@ -96,6 +96,32 @@ static TB_BasicBlock* find_lca(TB_Passes* p, TB_BasicBlock* a, TB_BasicBlock* b)
     return a;
 }
 
+static bool block_dominates(TB_BasicBlock* a, TB_BasicBlock* b) {
+    while (b->dom_depth > a->dom_depth) b = b->dom;
+    return a == b;
+}
+
+// the block where y actually reads n, phis read on the edge from their predecessor
+static TB_BasicBlock* use_block(TB_Passes* p, TB_Node* y, int slot) {
+    ptrdiff_t search = nl_map_get(p->scheduled, y);
+    if (search < 0) return NULL; // dead
+
+    TB_BasicBlock* bb = p->scheduled[search].v;
+    if (y->type == TB_PHI && slot > 0) {
+        TB_Node* region = y->inputs[0];
+        assert(region->type == TB_REGION);
+
+        if (y->input_count != region->input_count + 1) {
+            tb_panic("phi has parent with mismatched predecessors");
+        }
+
+        search = nl_map_get(p->scheduled, region->inputs[slot - 1]);
+        if (search >= 0) bb = p->scheduled[search].v;
+    }
+
+    return bb;
+}
+
 static void schedule_late(TB_Passes* p, TB_Node* n) {
     // pinned nodes can't be rescheduled
     if (!is_pinned(n)) {
@@ -104,33 +130,23 @@ static void schedule_late(TB_Passes* p, TB_Node* n) {
         // we're gonna find the least common ancestor
         TB_BasicBlock* lca = NULL;
         for (User* use = n->users; use; use = use->next) {
-            TB_Node* y = use->n;
-
-            ptrdiff_t search = nl_map_get(p->scheduled, y);
-            if (search < 0) continue; // dead
-
-            TB_BasicBlock* use_block = p->scheduled[search].v;
-            if (y->type == TB_PHI) {
-                TB_Node* use_node = y->inputs[0];
-                assert(use_node->type == TB_REGION);
-
-                if (y->input_count != use_node->input_count + 1) {
-                    tb_panic("phi has parent with mismatched predecessors");
-                }
+            TB_BasicBlock* bb = use_block(p, use->n, use->slot);
+            if (bb != NULL) lca = find_lca(p, lca, bb);
+        }
 
-                ptrdiff_t j = 1;
-                for (; j < y->input_count; j++) {
-                    if (y->inputs[j] == n) {
-                        break;
-                    }
+        // loads can't sink past the other effects on the same memory, those might
+        // overwrite what we're reading (anti-dependences). only the ones under our
+        // early block matter, the rest are on paths the load isn't.
+        if (n->type == TB_LOAD && lca != NULL) {
+            TB_BasicBlock* early = nl_map_get_checked(p->scheduled, n);
+            for (User* use = n->inputs[1]->users; use; use = use->next) {
+                if (use->n == n || !is_mem_out_op(use->n)) continue;
+
+                TB_BasicBlock* bb = use_block(p, use->n, use->slot);
+                if (bb != NULL && block_dominates(early, bb)) {
+                    lca = find_lca(p, lca, bb);
                 }
-                assert(j >= 0);
-
-                ptrdiff_t search = nl_map_get(p->scheduled, use_node->inputs[j - 1]);
-                if (search >= 0) use_block = p->scheduled[search].v;
             }
-
-            lca = find_lca(p, lca, use_block);
         }
 
         // tb_assert(lca, "missing least common ancestor");
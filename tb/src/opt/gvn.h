@@ -65,7 +65,6 @@ static size_t extra_bytes(TB_Node* n) {
         case TB_NEG:
         case TB_NOT:
         case TB_END:
-        case TB_PROJ:
         case TB_PHI:
         case TB_CLZ:
         case TB_CTZ:
@@ -79,8 +78,19 @@ static size_t extra_bytes(TB_Node* n) {
         case TB_DEBUGBREAK:
         case TB_ADDPAIR:
         case TB_MULPAIR:
+        case TB_TRAP:
+        case TB_BSWAP:
+        case TB_POPCNT:
+        case TB_CYCLE_COUNTER:
+        case TB_X86INTRIN_LDMXCSR:
+        case TB_X86INTRIN_STMXCSR:
+        case TB_X86INTRIN_SQRT:
+        case TB_X86INTRIN_RSQRT:
         return 0;
 
+        case TB_PROJ:
+        return sizeof(TB_NodeProj);
+
         case TB_START:
         case TB_REGION:
         return sizeof(TB_NodeRegion);
@@ -0,0 +1,696 @@
+// Whole program optimizations, unlike the rest of the passes these work across
+// the entire module so they need to run once all the IR is built but before any
+// function goes through tb_pass_enter (it throws away the terminator lists which
+// we use to walk the bodies).
+//
+//   internalize: public symbols which aren't roots become private, this is what
+//     lets the rest of these passes see every use of a function.
+//
+//   IPCP: private functions which never have their address taken get the ranges
+//     of their integer parameters from meeting all the call site arguments, the
+//     peepholes pick these up through dataflow_param.
+//
+//   specialization: hot call sites (in a cycle or a high freq region) which pass
+//     constants will call a cloned callee instead, IPCP then folds them in.
+//
+//   dead symbols: anything not reachable from a public symbol is removed.
+#define IPO_CLONE_BUDGET    64  // per module
+#define IPO_CLONES_PER_FUNC 4
+#define IPO_CLONE_MAX_NODES 256
+#define IPO_HOT_CHECKS      64  // per caller, each one walks the CFG backwards
+#define IPO_RANGE_ROUNDS    4
+
+typedef struct {
+    TB_Function* caller;
+    TB_Node* n; // TB_CALL or TB_TAILCALL, target is inputs[2]
+} IPOCallSite;
+
+typedef struct {
+    int clone;
+    uint64_t mask; // which of the first 64 params are constant
+    uint64_t* values;
+} IPOSpec;
+
+typedef struct {
+    TB_Symbol* sym;
+
+    // anything the body (or the relocations of a global) points to
+    DynArray(TB_Symbol*) refs;
+    DynArray(IPOCallSite) callers;
+
+    // address was taken or it's called with a different prototype,
+    // either way we can't know all the argument values.
+    bool escapes;
+    // lives in a custom section, we don't touch these
+    bool pinned;
+    bool live;
+    bool has_machine_ops;
+
+    int node_count;
+    int hot_checks;
+
+    int spec_count;
+    IPOSpec specs[IPO_CLONES_PER_FUNC];
+} IPOSym;
+
+typedef struct {
+    TB_Module* m;
+    Worklist ws;
+
+    DynArray(IPOSym) syms;
+    NL_Map(TB_Symbol*, int) index;
+
+    // public definitions by name, used to resolve externals which got
+    // defined by some other translation unit in the same module.
+    NL_Strmap(TB_Symbol*) defs;
+
+    int clone_count;
+} IPO;
+
+static Lattice* dataflow_param(TB_Passes* restrict p, LatticeUniverse* uni, TB_Node* n) {
+    TB_Function* f = p->f;
+    if (f->param_ranges == NULL || n->inputs[0] != f->start_node || n->dt.type != TB_INT) {
+        return NULL;
+    }
+
+    int index = TB_NODE_GET_EXTRA_T(n, TB_NodeProj)->index;
+    if (index < 3 || !f->param_ranges[index - 3].known) {
+        return NULL;
+    }
+
+    TB_ParamRange* r = &f->param_ranges[index - 3];
+    uint64_t mask = tb__mask(n->dt.data);
+    if (r->min == r->max) {
+        uint64_t x = r->min & mask;
+        return lattice_intern(uni, (Lattice){ LATTICE_INT, ._int = { x, x, ~x & mask, x } });
+    }
+
+    return lattice_intern(uni, (Lattice){ LATTICE_INT, ._int = { r->min & mask, r->max & mask } });
+}
+
+static IPOSym* ipo_get(IPO* ipo, const TB_Symbol* s) {
+    ptrdiff_t search = nl_map_get(ipo->index, s);
+    return search >= 0 ? &ipo->syms[ipo->index[search].v] : NULL;
+}
+
+static int ipo_add(IPO* ipo, TB_Symbol* s) {
+    int i = dyn_array_length(ipo->syms);
+    dyn_array_put(ipo->syms, (IPOSym){ .sym = s });
+    nl_map_put(ipo->index, s, i);
+    return i;
+}
+
+static TB_Linkage* ipo_linkage(TB_Symbol* s) {
+    switch (s->tag) {
+        case TB_SYMBOL_FUNCTION: return &((TB_Function*) s)->linkage;
+        case TB_SYMBOL_GLOBAL:   return &((TB_Global*) s)->linkage;
+        default: return NULL;
+    }
+}
+
+static bool ipo_is_definition(TB_Symbol* s) {
+    return s->tag == TB_SYMBOL_GLOBAL || (s->tag == TB_SYMBOL_FUNCTION && ((TB_Function*) s)->start_node != NULL);
+}
+
+static int ipo_compare_syms(const void* a, const void* b) {
+    const TB_Symbol* sym_a = ((const IPOSym*) a)->sym;
+    const TB_Symbol* sym_b = ((const IPOSym*) b)->sym;
+
+    if (sym_a->ordinal != sym_b->ordinal) {
+        return (sym_a->ordinal > sym_b->ordinal) - (sym_a->ordinal < sym_b->ordinal);
+    }
+
+    return strcmp(sym_a->name, sym_b->name);
+}
+
+static TB_Symbol* ipo_resolve(IPO* ipo, TB_Symbol* s) {
+    if (s->tag == TB_SYMBOL_EXTERNAL) {
+        ptrdiff_t search = nl_map_get_cstr(ipo->defs, s->name);
+        if (search >= 0) {
+            return ipo->defs[search].v;
+        }
+    }
+
+    return s;
+}
+
+// every node reachable from the terminators ends up in ws->items, projections
+// which only hang off of the extra data are included.
+static void ipo_walk(IPO* ipo, TB_Function* f) {
+    Worklist* ws = &ipo->ws;
+    worklist_clear(ws);
+
+    dyn_array_for(i, f->terminators) {
+        worklist_push(ws, f->terminators[i]);
+    }
+
+    for (size_t i = 0; i < dyn_array_length(ws->items); i++) {
+        TB_Node* n = ws->items[i];
+        FOREACH_N(j, 0, n->input_count) if (n->inputs[j]) {
+            worklist_push(ws, n->inputs[j]);
+        }
+
+        if (n->type == TB_CALL || n->type == TB_SYSCALL) {
+            TB_NodeCall* c = TB_NODE_GET_EXTRA(n);
+            FOREACH_N(j, 0, c->proj_count) if (c->projs[j]) {
+                worklist_push(ws, c->projs[j]);
+            }
+        } else if (n->type >= TB_ATOMIC_LOAD && n->type <= TB_ATOMIC_CAS) {
+            TB_NodeAtomic* a = TB_NODE_GET_EXTRA(n);
+            if (a->proj0) worklist_push(ws, a->proj0);
+            if (a->proj1) worklist_push(ws, a->proj1);
+        }
+    }
+}
+
+// can we map the arguments of this call directly onto the callee's parameters
+static bool ipo_call_matches(TB_Node* n, TB_Function* callee) {
+    TB_FunctionPrototype* proto = n->type == TB_CALL
+        ? TB_NODE_GET_EXTRA_T(n, TB_NodeCall)->proto
+        : TB_NODE_GET_EXTRA_T(n, TB_NodeTailcall)->proto;
+
+    TB_FunctionPrototype* p = callee->prototype;
+    if (p == NULL || p->has_varargs || proto->has_varargs || proto->param_count != p->param_count || n->input_count != 3 + p->param_count) {
+        return false;
+    }
+
+    FOREACH_N(i, 0, p->param_count) {
+        TB_Node* arg = n->inputs[3 + i];
+        if (arg == NULL || !TB_DATA_TYPE_EQUALS(arg->dt, p->params[i].dt)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void ipo_scan_function(IPO* ipo, int index) {
+    TB_Function* f = (TB_Function*) ipo->syms[index].sym;
+    ipo_walk(ipo, f);
+
+    DynArray(TB_Node*) items = ipo->ws.items;
+    ipo->syms[index].node_count = dyn_array_length(items);
+
+    // externals which got defined elsewhere in the module get resolved first
+    // so the edges below see the real callee.
+    dyn_array_for(i, items) {
+        TB_Node* n = items[i];
+        if (n->type == TB_SYMBOL) {
+            TB_NodeSymbol* s = TB_NODE_GET_EXTRA(n);
+            s->sym = ipo_resolve(ipo, s->sym);
+            dyn_array_put(ipo->syms[index].refs, s->sym);
+        } else if (n->type == TB_MACHINE_OP) {
+            ipo->syms[index].has_machine_ops = true;
+        }
+    }
+
+    dyn_array_for(i, items) {
+        TB_Node* n = items[i];
+        FOREACH_N(j, 0, n->input_count) {
+            TB_Node* in = n->inputs[j];
+            if (in == NULL || in->type != TB_SYMBOL) continue;
+
+            TB_Symbol* target = TB_NODE_GET_EXTRA_T(in, TB_NodeSymbol)->sym;
+            IPOSym* callee = ipo_get(ipo, target);
+            if (callee == NULL || target->tag != TB_SYMBOL_FUNCTION) continue;
+
+            bool is_call = (n->type == TB_CALL || n->type == TB_TAILCALL) && j == 2;
+            if (is_call && ipo_call_matches(n, (TB_Function*) target)) {
+                dyn_array_put(callee->callers, (IPOCallSite){ f, n });
+            } else {
+                callee->escapes = true;
+            }
+        }
+    }
+}
+
+static void ipo_scan(IPO* ipo) {
+    CUIK_TIMED_BLOCK("ipo scan") {
+        dyn_array_for(i, ipo->syms) {
+            IPOSym* s = &ipo->syms[i];
+            dyn_array_clear(s->refs);
+            dyn_array_clear(s->callers);
+            s->escapes = false;
+        }
+
+        dyn_array_for(i, ipo->syms) {
+            TB_Symbol* s = ipo->syms[i].sym;
+            if (s->tag == TB_SYMBOL_FUNCTION) {
+                if (((TB_Function*) s)->start_node != NULL) {
+                    ipo_scan_function(ipo, i);
+                }
+            } else if (s->tag == TB_SYMBOL_GLOBAL) {
+                TB_Global* g = (TB_Global*) s;
+                FOREACH_N(j, 0, g->obj_count) if (g->objects[j].type == TB_INIT_OBJ_RELOC) {
+                    TB_Symbol* target = ipo_resolve(ipo, (TB_Symbol*) g->objects[j].reloc);
+                    g->objects[j].reloc = target;
+                    dyn_array_put(ipo->syms[i].refs, target);
+
+                    IPOSym* t = ipo_get(ipo, target);
+                    if (t != NULL) t->escapes = true;
+                }
+            }
+        }
+    }
+}
+
+static bool ipo_is_root(size_t root_count, const char** roots, const char* name) {
+    FOREACH_N(i, 0, root_count) {
+        if (strcmp(roots[i], name) == 0) return true;
+    }
+    return false;
+}
+
+static void ipo_internalize(IPO* ipo, size_t root_count, const char** roots) {
+    // if none of the roots are defined here, the entry is coming from somewhere
+    // we can't see so all the public symbols might be needed.
+    bool found = false;
+    dyn_array_for(i, ipo->syms) {
+        TB_Symbol* s = ipo->syms[i].sym;
+        if (ipo_is_definition(s) && ipo_is_root(root_count, roots, s->name)) {
+            found = true;
+            break;
+        }
+    }
+
+    if (!found) {
+        log_debug("ipo: no roots defined, skipping internalization");
+        return;
+    }
+
+    dyn_array_for(i, ipo->syms) {
+        IPOSym* s = &ipo->syms[i];
+        TB_Linkage* linkage = ipo_linkage(s->sym);
+        if (linkage && *linkage == TB_LINKAGE_PUBLIC && !s->pinned && !ipo_is_root(root_count, roots, s->sym->name)) {
+            *linkage = TB_LINKAGE_PRIVATE;
+        }
+    }
+}
+
+// we haven't run any loop analysis so all the regions have a freq of 1, unless
+// someone told us otherwise. a call site which can reach itself going backwards
+// along the control edges is in a loop so we'll call that hot. with a profile
+// we just believe it, a loop which never spun isn't hot.
+static bool ipo_is_hot(IPO* ipo, TB_Function* caller, TB_Node* call) {
+    for (TB_Node* ctrl = call->inputs[0]; ctrl != NULL;) {
+        if (ctrl->type == TB_START) {
+            // the entry runs once per call
+            if (caller->profiled) return false;
+            break;
+        } else if (ctrl->type == TB_REGION) {
+            float freq = TB_NODE_GET_EXTRA_T(ctrl, TB_NodeRegion)->freq;
+            if (caller->profiled || freq > 1.0f) {
+                return freq > 1.0f;
+            }
+            break;
+        }
+
+        ctrl = ctrl->input_count > 0 ? ctrl->inputs[0] : NULL;
+    }
+
+    Worklist* ws = &ipo->ws;
+    worklist_clear(ws);
+    worklist_push(ws, call->inputs[0]);
+
+    for (size_t i = 0; i < dyn_array_length(ws->items); i++) {
+        TB_Node* n = ws->items[i];
+        if (n == call) {
+            return true;
+        }
+
+        if (n->type == TB_REGION) {
+            FOREACH_N(j, 0, n->input_count) if (n->inputs[j]) {
+                worklist_push(ws, n->inputs[j]);
+            }
+        } else if (n->input_count > 0 && n->inputs[0]) {
+            worklist_push(ws, n->inputs[0]);
+        }
+    }
+
+    return false;
+}
+
+static bool ipo_can_clone(IPOSym* s) {
+    TB_Function* f = (TB_Function*) s->sym;
+    return f->start_node != NULL && !f->prototype->has_varargs && !s->has_machine_ops && s->node_count <= IPO_CLONE_MAX_NODES;
+}
+
+static TB_Function* ipo_clone(IPO* ipo, TB_Function* g) {
+    TB_Module* m = ipo->m;
+
+    size_t len = strlen(g->super.name) + 16;
+    char* name = tb_platform_heap_alloc(len);
+    snprintf(name, len, "%s.spec%d", g->super.name, ipo->clone_count);
+
+    TB_Function* f = tb_function_create(m, -1, name, TB_LINKAGE_PRIVATE);
+    tb_platform_heap_free(name);
+
+    // sorted after everything the frontend made, still deterministic
+    f->super.ordinal = (1ull << 63ull) | ipo->clone_count++;
+    f->dbg_type = g->dbg_type;
+    f->exit_attrib = g->exit_attrib;
+    tb_function_set_prototype(f, g->section, g->prototype, g->arena);
+    f->active_control_node = NULL;
+
+    ipo_walk(ipo, g);
+    DynArray(TB_Node*) items = ipo->ws.items;
+
+    TB_Node** map = tb_platform_heap_alloc(g->node_count * sizeof(TB_Node*));
+    memset(map, 0, g->node_count * sizeof(TB_Node*));
+
+    map[g->start_node->gvn] = f->start_node;
+    FOREACH_N(i, 0, 3 + g->param_count) if (g->params[i]) {
+        map[g->params[i]->gvn] = f->params[i];
+    }
+
+    dyn_array_for(i, items) {
+        TB_Node* n = items[i];
+        if (map[n->gvn] != NULL) continue;
+
+        size_t extra = extra_bytes(n);
+        TB_Node* k = tb_alloc_node(f, n->type, n->dt, n->input_count, extra);
+        memcpy(k->extra, n->extra, extra);
+        map[n->gvn] = k;
+    }
+
+    #define REMAP(x) ((x) ? map[(x)->gvn] : NULL)
+    dyn_array_for(i, items) {
+        TB_Node* n = items[i];
+        TB_Node* k = map[n->gvn];
+        if (n->type == TB_START) continue;
+
+        FOREACH_N(j, 0, n->input_count) {
+            k->inputs[j] = REMAP(n->inputs[j]);
+        }
+
+        if (n->type == TB_CALL || n->type == TB_SYSCALL) {
+            TB_NodeCall* c = TB_NODE_GET_EXTRA(k);
+            FOREACH_N(j, 0, c->proj_count) {
+                c->projs[j] = REMAP(c->projs[j]);
+            }
+        } else if (n->type >= TB_ATOMIC_LOAD && n->type <= TB_ATOMIC_CAS) {
+            TB_NodeAtomic* a = TB_NODE_GET_EXTRA(k);
+            a->proj0 = REMAP(a->proj0);
+            a->proj1 = REMAP(a->proj1);
+        } else if (n->type == TB_REGION) {
+            TB_NodeRegion* r = TB_NODE_GET_EXTRA(k);
+            r->mem_in = REMAP(r->mem_in);
+            r->mem_out = REMAP(r->mem_out);
+        }
+    }
+
+    dyn_array_for(i, g->terminators) {
+        dyn_array_put(f->terminators, map[g->terminators[i]->gvn]);
+    }
+    f->stop_node = REMAP(g->stop_node);
+    #undef REMAP
+
+    tb_platform_heap_free(map);
+    return f;
+}
+
+static void ipo_specialize(IPO* ipo) {
+    CUIK_TIMED_BLOCK("ipo specialize") {
+        int budget = IPO_CLONE_BUDGET;
+
+        // clones get appended, we don't wanna clone those again
+        size_t count = dyn_array_length(ipo->syms);
+        for (size_t i = 0; i < count && budget > 0; i++) {
+            IPOSym* s = &ipo->syms[i];
+            if (s->sym->tag != TB_SYMBOL_FUNCTION || dyn_array_length(s->callers) == 0 || !ipo_can_clone(s)) {
+                continue;
+            }
+
+            // if we can see the only call site, IPCP will do the job
+            TB_Function* g = (TB_Function*) s->sym;
+            if (g->linkage == TB_LINKAGE_PRIVATE && !s->escapes && !s->pinned && dyn_array_length(s->callers) == 1) {
+                continue;
+            }
+
+            size_t param_count = g->param_count < 64 ? g->param_count : 64;
+            dyn_array_for(j, ipo->syms[i].callers) {
+                IPOCallSite cs = ipo->syms[i].callers[j];
+                if (cs.caller == g) continue;
+
+                uint64_t mask = 0;
+                FOREACH_N(k, 0, param_count) {
+                    TB_Node* arg = cs.n->inputs[3 + k];
+                    if (arg->type == TB_INTEGER_CONST && arg->dt.type == TB_INT) {
+                        mask |= 1ull << k;
+                    }
+                }
+
+                if (mask == 0) continue;
+
+                IPOSym* caller = ipo_get(ipo, &cs.caller->super);
+                if (caller->hot_checks >= IPO_HOT_CHECKS) continue;
+                caller->hot_checks++;
+
+                if (!ipo_is_hot(ipo, cs.caller, cs.n)) continue;
+
+                // reuse a clone with the same constants
+                s = &ipo->syms[i];
+                IPOSpec* spec = NULL;
+                FOREACH_N(k, 0, s->spec_count) {
+                    IPOSpec* other = &s->specs[k];
+                    if (other->mask != mask) continue;
+
+                    bool match = true;
+                    FOREACH_N(l, 0, param_count) if (mask & (1ull << l)) {
+                        if (other->values[l] != TB_NODE_GET_EXTRA_T(cs.n->inputs[3 + l], TB_NodeInt)->value) {
+                            match = false;
+                            break;
+                        }
+                    }
+
+                    if (match) {
+                        spec = other;
+                        break;
+                    }
+                }
+
+                if (spec == NULL) {
+                    if (s->spec_count >= IPO_CLONES_PER_FUNC || budget == 0) continue;
+
+                    TB_Function* clone = ipo_clone(ipo, g);
+                    int clone_index = ipo_add(ipo, &clone->super);
+                    budget--;
+
+                    s = &ipo->syms[i];
+                    spec = &s->specs[s->spec_count++];
+                    spec->clone = clone_index;
+                    spec->mask = mask;
+                    spec->values = tb_platform_heap_alloc(param_count * sizeof(uint64_t));
+                    FOREACH_N(l, 0, param_count) if (mask & (1ull << l)) {
+                        spec->values[l] = TB_NODE_GET_EXTRA_T(cs.n->inputs[3 + l], TB_NodeInt)->value;
+                    }
+
+                    log_debug("ipo: specialized %s as %s", g->super.name, clone->super.name);
+                }
+
+                TB_Node* target = tb_inst_get_symbol_address(cs.caller, ipo->syms[spec->clone].sym);
+                cs.n->inputs[2] = target;
+
+                if (budget == 0) break;
+            }
+        }
+
+        dyn_array_for(i, ipo->syms) {
+            IPOSym* s = &ipo->syms[i];
+            FOREACH_N(j, 0, s->spec_count) {
+                tb_platform_heap_free(s->specs[j].values);
+            }
+            s->spec_count = 0;
+        }
+    }
+}
+
+static bool ipo_arg_range(TB_Function* caller, TB_Node* arg, TB_ParamRange* out) {
+    if (arg->type == TB_INTEGER_CONST) {
+        int64_t x = tb__sxt(TB_NODE_GET_EXTRA_T(arg, TB_NodeInt)->value, arg->dt.data, 64);
+        *out = (TB_ParamRange){ true, x, x };
+        return true;
+    }
+
+    // passing along one of our own params
+    if (arg->type == TB_PROJ && arg->inputs[0] == caller->start_node && caller->param_ranges != NULL) {
+        int index = TB_NODE_GET_EXTRA_T(arg, TB_NodeProj)->index;
+        if (index >= 3 && caller->param_ranges[index - 3].known) {
+            *out = caller->param_ranges[index - 3];
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void ipo_propagate_ranges(IPO* ipo) {
+    CUIK_TIMED_BLOCK("ipo ranges") {
+        // ranges only go from unknown to known (and stay put after) so it's
+        // fine to stop early, we'll just know less.
+        for (int round = 0; round < IPO_RANGE_ROUNDS; round++) {
+            bool progress = false;
+
+            dyn_array_for(i, ipo->syms) {
+                IPOSym* s = &ipo->syms[i];
+                if (s->sym->tag != TB_SYMBOL_FUNCTION || s->escapes || s->pinned || dyn_array_length(s->callers) == 0) {
+                    continue;
+                }
+
+                TB_Function* f = (TB_Function*) s->sym;
+                if (f->linkage != TB_LINKAGE_PRIVATE || f->start_node == NULL || f->param_count == 0) {
+                    continue;
+                }
+
+                FOREACH_N(j, 0, f->param_count) {
+                    TB_DataType dt = f->prototype->params[j].dt;
+                    if (dt.type != TB_INT || dt.data > 64 || (f->param_ranges && f->param_ranges[j].known)) {
+                        continue;
+                    }
+
+                    TB_ParamRange r = { 0 };
+                    dyn_array_for(k, s->callers) {
+                        IPOCallSite cs = s->callers[k];
+
+                        TB_ParamRange arg;
+                        if (!ipo_arg_range(cs.caller, cs.n->inputs[3 + j], &arg)) {
+                            r.known = false;
+                            break;
+                        }
+
+                        if (!r.known) {
+                            r = arg;
+                        } else {
+                            if (arg.min < r.min) r.min = arg.min;
+                            if (arg.max > r.max) r.max = arg.max;
+                        }
+                    }
+
+                    if (r.known) {
+                        if (f->param_ranges == NULL) {
+                            f->param_ranges = tb_arena_alloc(f->arena, f->param_count * sizeof(TB_ParamRange));
+                            memset(f->param_ranges, 0, f->param_count * sizeof(TB_ParamRange));
+                        }
+
+                        log_debug("ipo: %s param %zu in [%"PRId64", %"PRId64"]", f->super.name, j, r.min, r.max);
+                        f->param_ranges[j] = r;
+                        progress = true;
+                    }
+                }
+            }
+
+            if (!progress) break;
+        }
+    }
+}
+
+static void ipo_kill_dead(IPO* ipo) {
+    CUIK_TIMED_BLOCK("ipo dead symbols") {
+        TB_Module* m = ipo->m;
+
+        DynArray(int) stack = dyn_array_create(int, 64);
+        dyn_array_for(i, ipo->syms) {
+            IPOSym* s = &ipo->syms[i];
+            TB_Linkage* linkage = ipo_linkage(s->sym);
+
+            // the backend might need these later
+            bool is_builtin = s->sym == m->chkstk_extern || s->sym == m->tls_index_extern;
+            if (s->pinned || is_builtin || (linkage && *linkage == TB_LINKAGE_PUBLIC)) {
+                s->live = true;
+                dyn_array_put(stack, i);
+            }
+        }
+
+        while (dyn_array_length(stack)) {
+            IPOSym* s = &ipo->syms[dyn_array_pop(stack)];
+            dyn_array_for(i, s->refs) {
+                ptrdiff_t search = nl_map_get(ipo->index, s->refs[i]);
+                if (search < 0) continue;
+
+                int j = ipo->index[search].v;
+                if (!ipo->syms[j].live) {
+                    ipo->syms[j].live = true;
+                    dyn_array_put(stack, j);
+                }
+            }
+        }
+        dyn_array_destroy(stack);
+
+        int killed = 0;
+        dyn_array_for(i, ipo->syms) {
+            IPOSym* s = &ipo->syms[i];
+            if (s->live) continue;
+
+            if (s->sym->tag == TB_SYMBOL_FUNCTION) {
+                dyn_array_destroy(((TB_Function*) s->sym)->terminators);
+            }
+
+            tb_module_kill_symbol(m, s->sym);
+            killed++;
+        }
+
+        log_debug("ipo: removed %d dead symbols", killed);
+    }
+}
+
+void tb_module_ipo(TB_Module* m, size_t root_count, const char** roots) {
+    IPO ipo = { .m = m };
+
+    CUIK_TIMED_BLOCK("ipo collect") {
+        TB_Symbol* s;
+        for (TB_SymbolIter it = tb_symbol_iter(m); s = tb_symbol_iter_next(&it), s;) {
+            if (s->tag != TB_SYMBOL_NONE) {
+                dyn_array_put(ipo.syms, (IPOSym){ .sym = s });
+            }
+        }
+
+        // we want the clone names and the order of everything to
+        // be the same from run to run.
+        qsort(ipo.syms, dyn_array_length(ipo.syms), sizeof(IPOSym), ipo_compare_syms);
+
+        size_t max_nodes = 64;
+        dyn_array_for(i, ipo.syms) {
+            TB_Symbol* s = ipo.syms[i].sym;
+            nl_map_put(ipo.index, s, i);
+
+            TB_Linkage* linkage = ipo_linkage(s);
+            if (linkage && *linkage == TB_LINKAGE_PUBLIC && ipo_is_definition(s)) {
+                nl_map_put_cstr(ipo.defs, s->name, s);
+            }
+
+            // the builtin sections come first, anything past those
+            // was asked for explicitly (comdats, custom sections)
+            if (s->tag == TB_SYMBOL_FUNCTION) {
+                TB_Function* f = (TB_Function*) s;
+                ipo.syms[i].pinned = f->section > tb_module_get_tls(m);
+                if (max_nodes < f->node_count) max_nodes = f->node_count;
+            } else if (s->tag == TB_SYMBOL_GLOBAL) {
+                ipo.syms[i].pinned = ((TB_Global*) s)->parent > tb_module_get_tls(m);
+            }
+        }
+
+        worklist_alloc(&ipo.ws, max_nodes);
+    }
+
+    ipo_scan(&ipo);
+    if (roots != NULL) {
+        ipo_internalize(&ipo, root_count, roots);
+    }
+
+    ipo_specialize(&ipo);
+    if (ipo.clone_count > 0) {
+        ipo_scan(&ipo);
+    }
+
+    ipo_propagate_ranges(&ipo);
+    ipo_kill_dead(&ipo);
+
+    dyn_array_for(i, ipo.syms) {
+        dyn_array_destroy(ipo.syms[i].refs);
+        dyn_array_destroy(ipo.syms[i].callers);
+    }
+    dyn_array_destroy(ipo.syms);
+    nl_map_free(ipo.index);
+    nl_map_free(ipo.defs);
+    worklist_free(&ipo.ws);
+}
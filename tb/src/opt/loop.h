@@ -70,7 +70,11 @@ bool tb_pass_loop(TB_Passes* p) {
         // found a loop :)
         if (dyn_array_length(backedges) > 0) {
             TB_OPTDEBUG(LOOP)(printf("found loop on .bb%zu with %zu backedges\n", i, dyn_array_length(backedges)));
-            TB_NODE_GET_EXTRA_T(header, TB_NodeRegion)->freq = 10.0f;
+
+            // measured frequencies beat our guess
+            if (!f->profiled) {
+                TB_NODE_GET_EXTRA_T(header, TB_NodeRegion)->freq = 10.0f;
+            }
         }
 
         if (0) {
@@ -248,6 +252,7 @@ bool tb_pass_loop(TB_Passes* p) {
     }
 
     dyn_array_destroy(backedges);
+    tb_free_cfg(&p->cfg);
     cuikperf_region_end();
     return progress;
 }
@@ -25,11 +25,19 @@ typedef struct Mem2Reg_Ctx {
 
     // [to_promote_count]
     Mem2Reg_Def* defs;
+
+    // phis we made, a variable can also be assigned a phi which was already
+    // in the block and we shouldn't be filling those in.
+    NL_HashSet new_phis;
 } Mem2Reg_Ctx;
 
 static int bits_in_data_type(int pointer_size, TB_DataType dt);
 static Coherency tb_get_stack_slot_coherency(TB_Passes* p, TB_Function* f, TB_Node* address, TB_DataType* dt);
 
+static bool is_new_phi(Mem2Reg_Ctx* restrict c, TB_Node* n) {
+    return n->type == TB_PHI && nl_hashset_lookup(&c->new_phis, n) & ~(SIZE_MAX >> 1);
+}
+
 static int get_variable_id(Mem2Reg_Ctx* restrict c, TB_Node* r) {
     // TODO(NeGate): Maybe we speed this up... maybe it doesn't matter :P
     FOREACH_N(i, 0, c->to_promote_count) {
@@ -46,6 +54,7 @@ static TB_Node* new_phi(Mem2Reg_Ctx* restrict c, TB_Function* f, int var, TB_Nod
     FOREACH_N(i, 0, 1 + block->input_count) n->inputs[i] = NULL;
 
     set_input(c->p, n, block, 0);
+    nl_hashset_put(&c->new_phis, n);
 
     // append variable attrib
     /*for (TB_Attrib* a = c->to_promote[var]->first_attrib; a; a = a->next) if (a->type == TB_ATTRIB_VARIABLE) {
@@ -99,7 +108,7 @@ static void ssa_replace_phi_arg(Mem2Reg_Ctx* c, TB_Function* f, TB_Node* bb, TB_
         if (search < 0) continue;
 
         TB_Node* phi_reg = c->defs[var][search].v;
-        if (phi_reg->type != TB_PHI) continue;
+        if (!is_new_phi(c, phi_reg)) continue;
 
         TB_Node* top;
         if (dyn_array_length(stack[var]) == 0) {
@@ -139,7 +148,7 @@ static void ssa_rename(Mem2Reg_Ctx* c, TB_Function* f, TB_Node* bb, DynArray(TB_
         old_len[var] = dyn_array_length(stack[var]);
 
         ptrdiff_t search = nl_map_get(c->defs[var], bb);
-        if (search >= 0 && c->defs[var][search].v->type == TB_PHI) {
+        if (search >= 0 && is_new_phi(c, c->defs[var][search].v)) {
             dyn_array_put(stack[var], c->defs[var][search].v);
         }
     }
@@ -357,6 +366,7 @@ bool tb_pass_mem2reg(TB_Passes* p) {
 
     c.defs = tb_tls_push(c.tls, to_promote_count * sizeof(Mem2Reg_Def));
     memset(c.defs, 0, to_promote_count * sizeof(Mem2Reg_Def));
+    c.new_phis = nl_hashset_alloc(32);
 
     tb_pass_update_cfg(p, &p->worklist, true);
     c.blocks = &p->worklist.items[0];
@@ -461,7 +471,7 @@ bool tb_pass_mem2reg(TB_Passes* p) {
                     } else {
                         phi_reg = c.defs[var][search].v;
 
-                        if (phi_reg->type != TB_PHI) {
+                        if (!is_new_phi(&c, phi_reg)) {
                             TB_Node* old_reg = phi_reg;
                             phi_reg = new_phi(&c, f, var, l, dt);
                             add_phi_operand(&c, f, phi_reg, l, old_reg);
@@ -479,6 +489,8 @@ bool tb_pass_mem2reg(TB_Passes* p) {
             }
         }
     }
+    nl_hashset_free(ever_worked);
+    nl_hashset_free(has_already);
     tb_platform_heap_free(df);
     tb_tls_restore(tls, phi_p);
 
@@ -496,7 +508,11 @@ bool tb_pass_mem2reg(TB_Passes* p) {
     FOREACH_N(var, 0, c.to_promote_count) {
         assert(c.to_promote[var]->users == NULL);
         tb_pass_kill_node(c.p, c.to_promote[var]);
+
+        dyn_array_destroy(stack[var]);
+        nl_map_free(c.defs[var]);
     }
+    nl_hashset_free(c.new_phis);
 
     tb_tls_restore(tls, to_promote);
 
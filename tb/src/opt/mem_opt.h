@@ -1,11 +1,6 @@
 // Certain aliasing optimizations technically count as peepholes lmao, these can get fancy
 // so the sliding window notion starts to break down but there's no global analysis and
 // i can make them incremental technically so we'll go wit it.
-typedef struct {
-    TB_Node* base;
-    int64_t offset;
-} KnownPointer;
-
 static bool is_local_ptr(TB_Node* n) {
     // skip past ptr arith
     while (n->type == TB_MEMBER_ACCESS || n->type == TB_ARRAY_ACCESS) {
@@ -15,12 +10,261 @@ static bool is_local_ptr(TB_Node* n) {
     return n->type == TB_LOCAL;
 }
 
-static KnownPointer known_pointer(TB_Node* n) {
-    if (n->type == TB_MEMBER_ACCESS) {
-        return (KnownPointer){ n->inputs[1], TB_NODE_GET_EXTRA_T(n, TB_NodeMember)->offset };
+////////////////////////////////
+// Alias analysis
+////////////////////////////////
+// Pointers get broken into a root (whatever we couldn't see past) and a constant
+// offset, two accesses off the same root only overlap if their byte ranges do.
+// Different LOCALs and SYMBOLs are different objects, and a LOCAL which never
+// escapes can't be reached through any other pointer (or by any call).
+typedef enum {
+    ALIAS_NO,
+    ALIAS_MAY,
+    ALIAS_MUST,
+} AliasResult;
+
+typedef struct {
+    TB_Node* addr;
+    TB_Node* root;
+    int64_t offset;
+
+    // false if we crossed a non-constant array index, offset means nothing then
+    bool exact;
+
+    // -1 if we don't know how many bytes are touched
+    int64_t size;
+    int alias_class;
+} MemLoc;
+
+static MemLoc mem_loc_of(TB_Node* addr, int64_t size, int alias_class) {
+    MemLoc l = { .addr = addr, .exact = true, .size = size, .alias_class = alias_class };
+    for (;;) {
+        if (addr->type == TB_MEMBER_ACCESS) {
+            l.offset += TB_NODE_GET_EXTRA_T(addr, TB_NodeMember)->offset;
+        } else if (addr->type == TB_ARRAY_ACCESS) {
+            uint64_t index;
+            if (get_int_const(addr->inputs[2], &index)) {
+                l.offset += (int64_t) index * TB_NODE_GET_EXTRA_T(addr, TB_NodeArray)->stride;
+            } else {
+                l.exact = false;
+            }
+        } else {
+            break;
+        }
+
+        addr = addr->inputs[1];
+    }
+
+    l.root = addr;
+    return l;
+}
+
+static int64_t mem_size_of(TB_Function* f, TB_DataType dt) {
+    int bits = bits_in_data_type(tb__find_code_generator(f->super.module)->pointer_size, dt);
+    return bits > 0 ? (bits + 7) / 8 : -1;
+}
+
+// the bytes written by a STORE, MEMSET or MEMCPY (or read by a LOAD)
+static MemLoc mem_loc(TB_Function* f, TB_Node* n) {
+    int alias_class = TB_NODE_GET_EXTRA_T(n, TB_NodeMemAccess)->alias_class;
+    if (n->type == TB_LOAD) {
+        return mem_loc_of(n->inputs[2], mem_size_of(f, n->dt), alias_class);
+    } else if (n->type == TB_STORE) {
+        return mem_loc_of(n->inputs[2], mem_size_of(f, n->inputs[3]->dt), alias_class);
+    } else {
+        assert(n->type == TB_MEMSET || n->type == TB_MEMCPY);
+
+        uint64_t size;
+        return mem_loc_of(n->inputs[2], get_int_const(n->inputs[4], &size) ? (int64_t) size : -1, alias_class);
+    }
+}
+
+// a local escapes once its address goes anywhere we can't follow, the only
+// uses we understand are addressing into it and being the address of an access.
+static bool local_escapes(TB_Node* n) {
+    for (User* u = n->users; u; u = u->next) {
+        switch (u->n->type) {
+            case TB_LOAD:
+            case TB_STORE:
+            case TB_MEMSET:
+            if (u->slot != 2) return true;
+            break;
+
+            case TB_MEMCPY:
+            if (u->slot != 2 && u->slot != 3) return true;
+            break;
+
+            case TB_MEMBER_ACCESS:
+            case TB_ARRAY_ACCESS:
+            if (u->slot != 1 || local_escapes(u->n)) return true;
+            break;
+
+            default:
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool is_private_root(TB_Node* root) {
+    return root->type == TB_LOCAL && !local_escapes(root);
+}
+
+static bool same_root(TB_Node* a, TB_Node* b) {
+    if (a->type == TB_SYMBOL && b->type == TB_SYMBOL) {
+        return TB_NODE_GET_EXTRA_T(a, TB_NodeSymbol)->sym == TB_NODE_GET_EXTRA_T(b, TB_NodeSymbol)->sym;
+    }
+
+    return a == b;
+}
+
+static AliasResult mem_alias(MemLoc a, MemLoc b) {
+    if (a.addr == b.addr && a.size == b.size && a.size > 0) {
+        return ALIAS_MUST;
+    }
+
+    if (same_root(a.root, b.root)) {
+        if (a.exact && b.exact) {
+            if (a.size >= 0 && a.offset + a.size <= b.offset) return ALIAS_NO;
+            if (b.size >= 0 && b.offset + b.size <= a.offset) return ALIAS_NO;
+            if (a.offset == b.offset && a.size == b.size && a.size > 0) return ALIAS_MUST;
+        }
     } else {
-        return (KnownPointer){ n, 0 };
+        bool a_obj = a.root->type == TB_LOCAL || a.root->type == TB_SYMBOL;
+        bool b_obj = b.root->type == TB_LOCAL || b.root->type == TB_SYMBOL;
+        if (a_obj && b_obj) {
+            return ALIAS_NO;
+        }
+
+        // only the local needs checking, the other pointer can't be derived from it
+        if (a.root->type == TB_LOCAL && is_private_root(a.root)) return ALIAS_NO;
+        if (b.root->type == TB_LOCAL && is_private_root(b.root)) return ALIAS_NO;
+    }
+
+    // the frontend told us the types can't overlap
+    if (a.alias_class != 0 && b.alias_class != 0 && a.alias_class != b.alias_class) {
+        return ALIAS_NO;
     }
+
+    return ALIAS_MAY;
+}
+
+// does a write every byte b touches
+static bool mem_covers(MemLoc a, MemLoc b) {
+    if (a.addr == b.addr && a.size >= b.size && b.size > 0) {
+        return true;
+    }
+
+    return same_root(a.root, b.root) && a.exact && b.exact && a.size > 0 && b.size > 0
+        && a.offset <= b.offset && b.offset + b.size <= a.offset + a.size;
+}
+
+static TB_Node* call_mem_proj(TB_Node* call) {
+    for (User* u = call->users; u; u = u->next) {
+        if (u->n->type == TB_PROJ && TB_NODE_GET_EXTRA_T(u->n, TB_NodeProj)->index == 1) {
+            return u->n;
+        }
+    }
+
+    return NULL;
+}
+
+// walks up the memory chain from mem skipping the effects which can't write
+// to loc, this gives back the first one which might (or where we gave up).
+static TB_Node* mem_clobber(TB_Function* f, MemLoc loc, TB_Node* mem) {
+    int is_private = -1;
+    FOREACH_N(i, 0, 64) {
+        switch (mem->type) {
+            case TB_STORE:
+            case TB_MEMSET:
+            case TB_MEMCPY:
+            if (mem_alias(loc, mem_loc(f, mem)) != ALIAS_NO) return mem;
+            break;
+
+            // calls can only touch locals which escaped
+            case TB_PROJ: {
+                TB_Node* call = mem->inputs[0];
+                if (call->type != TB_CALL && call->type != TB_SYSCALL) return mem;
+
+                if (is_private < 0) is_private = is_private_root(loc.root);
+                if (!is_private) return mem;
+
+                mem = call;
+                break;
+            }
+
+            // phis, volatile & atomic accesses and the entry
+            default:
+            return mem;
+        }
+
+        mem = mem->inputs[1];
+    }
+
+    return mem;
+}
+
+// a store (or memset/memcpy) is dead if every path after it overwrites the bytes
+// before anyone reads them (or the function returns and it was into a local).
+static bool is_dead_store(TB_Function* f, TB_Node* n) {
+    MemLoc loc = mem_loc(f, n);
+    if (loc.size <= 0) {
+        return false;
+    }
+
+    int is_private = -1;
+    TB_Node* mem = n;
+    FOREACH_N(i, 0, 64) {
+        TB_Node* next = NULL;
+        for (User* u = mem->users; u; u = u->next) {
+            if (u->n->type == TB_LOAD && u->slot == 1) {
+                if (mem_alias(loc, mem_loc(f, u->n)) != ALIAS_NO) return false;
+            } else if (next == NULL && u->slot == 1) {
+                next = u->n;
+            } else {
+                // the chain splits, we'd need to check every path
+                return false;
+            }
+        }
+
+        if (next == NULL) {
+            return false;
+        }
+
+        switch (next->type) {
+            case TB_MEMCPY: {
+                uint64_t size;
+                int64_t src_size = get_int_const(next->inputs[4], &size) ? (int64_t) size : -1;
+                if (mem_alias(loc, mem_loc_of(next->inputs[3], src_size, 0)) != ALIAS_NO) return false;
+            }
+            // fallthrough
+            case TB_STORE:
+            case TB_MEMSET:
+            if (mem_covers(mem_loc(f, next), loc)) return true;
+            break;
+
+            case TB_CALL:
+            case TB_SYSCALL:
+            if (is_private < 0) is_private = is_private_root(loc.root);
+            if (!is_private) return false;
+
+            next = call_mem_proj(next);
+            if (next == NULL) return false;
+            break;
+
+            // the frame's gone once we return
+            case TB_END:
+            return loc.root->type == TB_LOCAL;
+
+            default:
+            return false;
+        }
+
+        mem = next;
+    }
+
+    return false;
 }
 
 static TB_Node* data_phi_from_memory_phi(TB_Passes* restrict p, TB_Function* f, TB_DataType dt, TB_Node* n, TB_Node* addr, TB_CharUnits* out_align) {
@@ -76,6 +320,19 @@ static TB_Node* data_phi_from_memory_phi(TB_Passes* restrict p, TB_Function* f,
     return phi;
 }
 
+// another load off mem which reads the same thing as n
+static bool has_twin_load(TB_Node* mem, TB_Node* n) {
+    for (User* u = mem->users; u; u = u->next) {
+        TB_Node* use = u->n;
+        if (use != n && use->type == TB_LOAD && u->slot == 1 && use->inputs[0] == n->inputs[0] &&
+            use->inputs[2] == n->inputs[2] && use->dt.raw == n->dt.raw && is_same_align(use, n)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
 static TB_Node* ideal_load(TB_Passes* restrict p, TB_Function* f, TB_Node* n) {
     TB_Node* mem = n->inputs[1];
     TB_Node* addr = n->inputs[2];
@@ -93,8 +350,39 @@ static TB_Node* ideal_load(TB_Passes* restrict p, TB_Function* f, TB_Node* n) {
             // loads based on LOCALs don't need control-dependence, it's actually kinda annoying
             if (base->type == TB_LOCAL) {
                 set_input(p, n, NULL, 0);
+
+                // the other loads of this address might be able to merge with us now
+                tb_pass_mark_users(p, addr);
+                return n;
+            }
+        }
+    }
+
+    // skip past the effects which can't touch our bytes, loads which read the same
+    // thing end up on the same memory and GVN merges them. skipping calls would
+    // stretch us across them so we only do that if there's someone to merge with.
+    TB_Node* clobber = mem_clobber(f, mem_loc(f, n), mem);
+    if (clobber != mem) {
+        bool crosses_call = false;
+        for (TB_Node* m = mem;;) {
+            if (m != mem && has_twin_load(m, n)) {
+                set_input(p, n, m, 1);
+                tb_pass_mark_users(p, addr);
                 return n;
             }
+
+            if (m == clobber) break;
+            if (m->type == TB_PROJ) {
+                crosses_call = true;
+                m = m->inputs[0];
+            }
+            m = m->inputs[1];
+        }
+
+        if (!crosses_call) {
+            set_input(p, n, clobber, 1);
+            tb_pass_mark_users(p, addr);
+            return n;
         }
     }
 
@@ -129,9 +417,15 @@ static TB_Node* ideal_load(TB_Passes* restrict p, TB_Function* f, TB_Node* n) {
 static TB_Node* identity_load(TB_Passes* restrict p, TB_Function* f, TB_Node* n) {
     // god i need a pattern matcher
     //   (load (store X A Y) A) => Y
-    TB_Node *mem = n->inputs[1], *addr = n->inputs[2];
-    if (mem->type == TB_STORE && mem->inputs[2] == addr &&
+    //
+    // the store doesn't need to be right above us, just the first thing which
+    // might write to the same bytes.
+    MemLoc loc = mem_loc(f, n);
+    TB_Node* mem = mem_clobber(f, loc, n->inputs[1]);
+    if (mem->type == TB_STORE && mem_alias(loc, mem_loc(f, mem)) == ALIAS_MUST &&
         n->dt.raw == mem->inputs[3]->dt.raw && is_same_align(n, mem)) {
+        // the stores above might've only been kept alive by us
+        tb_pass_mark(p, n->inputs[1]);
         return mem->inputs[3];
     }
 
@@ -162,6 +456,16 @@ static TB_Node* ideal_store(TB_Passes* restrict p, TB_Function* f, TB_Node* n) {
     return NULL;
 }
 
+static TB_Node* identity_store(TB_Passes* restrict p, TB_Function* f, TB_Node* n) {
+    if (is_dead_store(f, n)) {
+        // the effect before us might be dead now too
+        tb_pass_mark(p, n->inputs[1]);
+        return n->inputs[1];
+    }
+
+    return n;
+}
+
 static TB_Node* ideal_end(TB_Passes* restrict p, TB_Function* f, TB_Node* n) {
     // remove dead local store
     if (n->inputs[1]->type == TB_STORE && is_local_ptr(n->inputs[1]->inputs[2])) {
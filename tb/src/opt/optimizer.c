@@ -234,15 +234,18 @@ static bool is_if_branch(TB_Node* n, uint64_t* falsey) {
 #include "cfg.h"
 #include "gvn.h"
 #include "fold.h"
+#include "peeps.h"
 #include "mem_opt.h"
 #include "sroa.h"
 #include "loop.h"
+#include "tailrec.h"
 #include "branches.h"
 #include "print.h"
 #include "mem2reg.h"
 #include "gcm.h"
 #include "libcalls.h"
 #include "scheduler.h"
+#include "ipo.h"
 
 static bool lattice_dommy(LatticeUniverse* uni, TB_Node* expected_dom, TB_Node* bb) {
     while (bb != NULL && expected_dom != bb) {
@@ -521,6 +524,12 @@ void print_node_sexpr(TB_Node* n, int depth) {
 
 // Returns NULL or a modified node (could be the same node, we can stitch it back into place)
 static TB_Node* idealize(TB_Passes* restrict p, TB_Function* f, TB_Node* n, TB_PeepholeFlags flags) {
+    // generated from peeps.rules
+    TB_Node* k = peep_rules(p, f, n);
+    if (k != NULL) {
+        return k;
+    }
+
     switch (n->type) {
         // integer ops
         case TB_AND:
@@ -565,11 +574,6 @@ static TB_Node* idealize(TB_Passes* restrict p, TB_Function* f, TB_Node* n, TB_P
         case TB_UDIV:
         return ideal_int_div(p, f, n);
 
-        // modulo
-        case TB_SMOD:
-        case TB_UMOD:
-        return ideal_int_mod(p, f, n);
-
         // casting
         case TB_SIGN_EXT:
         case TB_ZERO_EXT:
@@ -630,6 +634,11 @@ static TB_Node* identity(TB_Passes* restrict p, TB_Function* f, TB_Node* n, TB_P
         case TB_LOAD:
         return (flags & TB_PEEPHOLE_MEMORY) ? identity_load(p, f, n) : n;
 
+        case TB_STORE:
+        case TB_MEMSET:
+        case TB_MEMCPY:
+        return (flags & TB_PEEPHOLE_MEMORY) ? identity_store(p, f, n) : n;
+
         case TB_SAFEPOINT_NOP:
         case TB_SAFEPOINT_POLL:
         if (n->inputs[0]->type == TB_DEAD) {
@@ -709,15 +718,19 @@ static Lattice* dataflow(TB_Passes* restrict p, LatticeUniverse* uni, TB_Node* n
         case TB_SHR:
         return dataflow_shift(p, uni, n);
 
+        case TB_PROJ:
+        return dataflow_param(p, uni, n);
+
         // meet all inputs
         case TB_LOOKUP: {
             TB_NodeLookup* l = TB_NODE_GET_EXTRA(n);
             TB_DataType dt = n->dt;
             assert(dt.type == TB_INT);
 
-            LatticeInt a = { l->entries[0].val, l->entries[0].val, l->entries[0].val, ~l->entries[0].val };
-            FOREACH_N(i, 1, n->input_count) {
-                LatticeInt b = { l->entries[i].val, l->entries[i].val, l->entries[i].val, ~l->entries[i].val };
+            uint64_t mask = tb__mask(dt.data);
+            LatticeInt a = { l->entries[0].val, l->entries[0].val, ~l->entries[0].val & mask, l->entries[0].val };
+            FOREACH_N(i, 1, l->entry_count) {
+                LatticeInt b = { l->entries[i].val, l->entries[i].val, ~l->entries[i].val & mask, l->entries[i].val };
                 lattice_meet_int(&a, &b, dt);
             }
 
@@ -923,8 +936,11 @@ static void generate_use_lists(TB_Passes* restrict p, TB_Function* f) {
 
 TB_Passes* tb_pass_enter(TB_Function* f, TB_Arena* arena) {
     // assert(f->stop_node && "missing return");
+    Cuik_Heap* heap = cuik_heap_create();
+    Cuik_Heap* old_heap = cuik_heap_enter(heap);
+
     TB_Passes* p = tb_platform_heap_alloc(sizeof(TB_Passes));
-    *p = (TB_Passes){ .f = f };
+    *p = (TB_Passes){ .f = f, .heap = heap };
 
     TB_Arena* old_arena = f->arena;
     f->line_attrib.file = NULL;
@@ -948,6 +964,7 @@ TB_Passes* tb_pass_enter(TB_Function* f, TB_Arena* arena) {
         generate_use_lists(p, f);
     }
 
+    cuik_heap_enter(old_heap);
     return p;
 }
 
@@ -968,6 +985,9 @@ void tb_pass_sroa(TB_Passes* p) {
 }
 
 void tb_pass_optimize(TB_Passes* p) {
+    Cuik_Heap* old_heap = cuik_heap_enter(p->heap);
+
+    tb_pass_tail_recursion(p);
     tb_pass_peephole(p, TB_PEEPHOLE_ALL);
     tb_pass_sroa(p);
     tb_pass_peephole(p, TB_PEEPHOLE_ALL);
@@ -975,6 +995,9 @@ void tb_pass_optimize(TB_Passes* p) {
     tb_pass_peephole(p, TB_PEEPHOLE_ALL);
     tb_pass_loop(p);
     tb_pass_peephole(p, TB_PEEPHOLE_ALL);
+    p->optimized = true;
+
+    cuik_heap_enter(old_heap);
 }
 
 static size_t tb_pass_update_cfg(TB_Passes* p, Worklist* ws, bool preserve) {
@@ -1075,6 +1098,10 @@ void tb_pass_exit(TB_Passes* p) {
     // printf("  %4d   -> %4d nodes (%.2f%%)\n", p->stats.initial, final_count, factor);
     printf("  %4d GVN hit    %4d GVN miss\n", p->stats.gvn_hit, p->stats.gvn_miss);
     printf("  %4d peepholes  %4d rewrites    %4d identities\n", p->stats.peeps, p->stats.rewrites, p->stats.identities);
+    FOREACH_N(i, 0, PEEP_RULE_COUNT) if (peep_rule_hits[i]) {
+        printf("  %4d %s\n", peep_rule_hits[i], peep_rule_names[i]);
+        peep_rule_hits[i] = 0;
+    }
     #endif
 
     nl_map_free(p->scheduled);
@@ -1090,5 +1117,10 @@ void tb_pass_exit(TB_Passes* p) {
     }
 
     tb_arena_clear(tmp_arena);
+
+    Cuik_Heap* heap = p->heap;
     tb_platform_heap_free(p);
+
+    // anything the passes didn't clean up goes with the heap
+    cuik_heap_destroy(heap);
 }
@@ -16,8 +16,6 @@
 #define DO_IF_0(...)
 #define DO_IF_1(...) __VA_ARGS__
 
-#define BB_LOW_FREQ 1e-4
-
 ////////////////////////////////
 // SCCP
 ////////////////////////////////
@@ -152,6 +150,10 @@ struct TB_Passes {
     // for the entire duration of the TB_Passes.
     TB_ThreadInfo* pinned_thread;
 
+    // scratch allocated by the optimizer, it's thrown out wholesale in
+    // tb_pass_exit (codegen runs outside of it since its output sticks around).
+    Cuik_Heap* heap;
+
     Worklist worklist;
 
     // sometimes we be using arrays of nodes, let's just keep one around for a bit
@@ -169,6 +171,9 @@ struct TB_Passes {
     // might be out of date if you haven't called tb_pass_update_cfg
     TB_CFG cfg;
 
+    // tb_pass_optimize ran, codegen can spend more time on things
+    bool optimized;
+
     // debug shit:
     TB_Node* error_n;
 
@@ -190,6 +195,18 @@ static uint64_t tb__mask(uint64_t bits) {
     return ~UINT64_C(0) >> (64 - bits);
 }
 
+// TB_LOOKUP keys are masked to the key's width and sorted (unsigned), dense
+// lookups get lowered to a flat table while sparse ones become a compare chain.
+enum {
+    LOOKUP_MAX_TABLE  = 1024,
+    LOOKUP_MAX_SPARSE = 8,
+};
+
+static bool lookup_is_dense(uint64_t lo, uint64_t hi, size_t key_count) {
+    uint64_t span = hi - lo;
+    return span < LOOKUP_MAX_TABLE && span < key_count * 4;
+}
+
 static bool ctrl_out_as_cproj_but_not_branch(TB_Node* n) {
     return n->type == TB_CALL || n->type == TB_TAILCALL || n->type == TB_SYSCALL || n->type == TB_READ || n->type == TB_WRITE;
 }
@@ -465,6 +482,10 @@ TB_Node* worklist_pop(Worklist* ws);
 
 // Local scheduler
 void greedy_scheduler(TB_Passes* passes, TB_CFG* cfg, Worklist* ws, DynArray(PhiVal)* phi_vals, TB_BasicBlock* bb, TB_Node* end);
+void list_scheduler(TB_Passes* passes, TB_CFG* cfg, Worklist* ws, DynArray(PhiVal)* phi_vals, TB_BasicBlock* bb, TB_Node* end);
 void tb_pass_schedule(TB_Passes* opt, TB_CFG cfg);
 
+// Codegen prep
+void tb_pass_split_returns(TB_Passes* p);
+
 Lattice* lattice_universe_get(LatticeUniverse* uni, TB_Node* n);
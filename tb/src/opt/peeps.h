@@ -0,0 +1,613 @@
+// generated by tb/meta/peepgen.c from tb/src/opt/peeps.rules, don't edit.
+enum { PEEP_RULE_COUNT = 27 };
+
+#if TB_OPTDEBUG_STATS
+static int peep_rule_hits[PEEP_RULE_COUNT];
+static const char* peep_rule_names[PEEP_RULE_COUNT] = {
+    "(add x 0) => x",
+    "(sub x 0) => x",
+    "(or  x 0) => x",
+    "(xor x 0) => x",
+    "(shl x 0) => x",
+    "(shr x 0) => x",
+    "(sar x 0) => x",
+    "(mul x 0) => 0",
+    "(mul x 1) => x",
+    "(and x 0) => 0",
+    "(and x C) => x  if [(C & tb__mask(n->dt.data)) == tb__mask(n->dt.data)]",
+    "(udiv x 1) => x",
+    "(sdiv x 1) => x",
+    "(sub x x) => 0",
+    "(xor x x) => 0",
+    "(and x x) => x",
+    "(or  x x) => x",
+    "(add (add x C1) C2) => (add x [C1 + C2])",
+    "(mul (mul x C1) C2) => (mul x [C1 * C2])",
+    "(and (and x C1) C2) => (and x [C1 & C2])",
+    "(or  (or  x C1) C2) => (or  x [C1 | C2])",
+    "(xor (xor x C1) C2) => (xor x [C1 ^ C2])",
+    "(shl (shl x C1) C2) => (shl x [C1 + C2])  if [C1 < 64 && C2 < 64 && C1 + C2 < n->dt.data]",
+    "(shr (shr x C1) C2) => (shr x [C1 + C2])  if [C1 < 64 && C2 < 64 && C1 + C2 < n->dt.data]",
+    "(mul  x C) => (shl x [tb_ffs(C) - 1])  if [C != 0 && (C & (C - 1)) == 0]",
+    "(udiv x C) => (shr x [tb_ffs(C) - 1])  if [C != 0 && (C & (C - 1)) == 0]",
+    "(umod x C) => (and x [C - 1])          if [C != 0 && (C & (C - 1)) == 0]",
+};
+#endif
+
+static TB_Node* peep_rules(TB_Passes* restrict p, TB_Function* f, TB_Node* n) {
+    if (n->dt.type != TB_INT) return NULL;
+
+    switch (n->type) {
+        case TB_ADD: {
+            switch (n->inputs[2]->type) {
+                case TB_INTEGER_CONST: {
+                    // (add x 0) => x
+                    {
+                        TB_Node* x = n->inputs[1];
+                        (void) x;
+                        if (TB_NODE_GET_EXTRA_T(n->inputs[2], TB_NodeInt)->value == (uint64_t) 0) {
+                            TB_Node* t0 = x;
+                            DO_IF(TB_OPTDEBUG_STATS)(peep_rule_hits[0]++);
+                            return t0;
+                        }
+                    }
+                    switch (n->inputs[1]->type) {
+                        case TB_ADD: {
+                            switch (n->inputs[1]->inputs[2]->type) {
+                                case TB_INTEGER_CONST: {
+                                    // (add (add x C1) C2) => (add x [C1 + C2])
+                                    {
+                                        TB_Node* x = n->inputs[1]->inputs[1];
+                                        uint64_t C1 = TB_NODE_GET_EXTRA_T(n->inputs[1]->inputs[2], TB_NodeInt)->value;
+                                        uint64_t C2 = TB_NODE_GET_EXTRA_T(n->inputs[2], TB_NodeInt)->value;
+                                        (void) x;
+                                        (void) C1;
+                                        (void) C2;
+                                        if (true) {
+                                            TB_Node* t0 = tb_alloc_node(f, TB_ADD, n->dt, 3, sizeof(TB_NodeBinopInt));
+                                            TB_Node* t1 = x;
+                                            set_input(p, t0, t1, 1);
+                                            TB_Node* t2 = make_int_node(f, p, n->dt, C1 + C2);
+                                            set_input(p, t0, t2, 2);
+                                            DO_IF(TB_OPTDEBUG_STATS)(peep_rule_hits[17]++);
+                                            return t0;
+                                        }
+                                    }
+                                    break;
+                                }
+                                default: break;
+                            }
+                            break;
+                        }
+                        default: break;
+                    }
+                    break;
+                }
+                default: break;
+            }
+            break;
+        }
+
+        case TB_SUB: {
+            switch (n->inputs[2]->type) {
+                case TB_INTEGER_CONST: {
+                    // (sub x 0) => x
+                    {
+                        TB_Node* x = n->inputs[1];
+                        (void) x;
+                        if (TB_NODE_GET_EXTRA_T(n->inputs[2], TB_NodeInt)->value == (uint64_t) 0) {
+                            TB_Node* t0 = x;
+                            DO_IF(TB_OPTDEBUG_STATS)(peep_rule_hits[1]++);
+                            return t0;
+                        }
+                    }
+                    break;
+                }
+                default: break;
+            }
+            // (sub x x) => 0
+            {
+                TB_Node* x = n->inputs[1];
+                (void) x;
+                if (n->inputs[2] == x) {
+                    TB_Node* t0 = make_int_node(f, p, n->dt, 0);
+                    DO_IF(TB_OPTDEBUG_STATS)(peep_rule_hits[13]++);
+                    return t0;
+                }
+            }
+            break;
+        }
+
+        case TB_OR: {
+            switch (n->inputs[2]->type) {
+                case TB_INTEGER_CONST: {
+                    // (or  x 0) => x
+                    {
+                        TB_Node* x = n->inputs[1];
+                        (void) x;
+                        if (TB_NODE_GET_EXTRA_T(n->inputs[2], TB_NodeInt)->value == (uint64_t) 0) {
+                            TB_Node* t0 = x;
+                            DO_IF(TB_OPTDEBUG_STATS)(peep_rule_hits[2]++);
+                            return t0;
+                        }
+                    }
+                    break;
+                }
+                default: break;
+            }
+            // (or  x x) => x
+            {
+                TB_Node* x = n->inputs[1];
+                (void) x;
+                if (n->inputs[2] == x) {
+                    TB_Node* t0 = x;
+                    DO_IF(TB_OPTDEBUG_STATS)(peep_rule_hits[16]++);
+                    return t0;
+                }
+            }
+            switch (n->inputs[1]->type) {
+                case TB_OR: {
+                    switch (n->inputs[1]->inputs[2]->type) {
+                        case TB_INTEGER_CONST: {
+                            switch (n->inputs[2]->type) {
+                                case TB_INTEGER_CONST: {
+                                    // (or  (or  x C1) C2) => (or  x [C1 | C2])
+                                    {
+                                        TB_Node* x = n->inputs[1]->inputs[1];
+                                        uint64_t C1 = TB_NODE_GET_EXTRA_T(n->inputs[1]->inputs[2], TB_NodeInt)->value;
+                                        uint64_t C2 = TB_NODE_GET_EXTRA_T(n->inputs[2], TB_NodeInt)->value;
+                                        (void) x;
+                                        (void) C1;
+                                        (void) C2;
+                                        if (true) {
+                                            TB_Node* t0 = tb_alloc_node(f, TB_OR, n->dt, 3, sizeof(TB_NodeBinopInt));
+                                            TB_Node* t1 = x;
+                                            set_input(p, t0, t1, 1);
+                                            TB_Node* t2 = make_int_node(f, p, n->dt, C1 | C2);
+                                            set_input(p, t0, t2, 2);
+                                            DO_IF(TB_OPTDEBUG_STATS)(peep_rule_hits[20]++);
+                                            return t0;
+                                        }
+                                    }
+                                    break;
+                                }
+                                default: break;
+                            }
+                            break;
+                        }
+                        default: break;
+                    }
+                    break;
+                }
+                default: break;
+            }
+            break;
+        }
+
+        case TB_XOR: {
+            switch (n->inputs[2]->type) {
+                case TB_INTEGER_CONST: {
+                    // (xor x 0) => x
+                    {
+                        TB_Node* x = n->inputs[1];
+                        (void) x;
+                        if (TB_NODE_GET_EXTRA_T(n->inputs[2], TB_NodeInt)->value == (uint64_t) 0) {
+                            TB_Node* t0 = x;
+                            DO_IF(TB_OPTDEBUG_STATS)(peep_rule_hits[3]++);
+                            return t0;
+                        }
+                    }
+                    break;
+                }
+                default: break;
+            }
+            // (xor x x) => 0
+            {
+                TB_Node* x = n->inputs[1];
+                (void) x;
+                if (n->inputs[2] == x) {
+                    TB_Node* t0 = make_int_node(f, p, n->dt, 0);
+                    DO_IF(TB_OPTDEBUG_STATS)(peep_rule_hits[14]++);
+                    return t0;
+                }
+            }
+            switch (n->inputs[1]->type) {
+                case TB_XOR: {
+                    switch (n->inputs[1]->inputs[2]->type) {
+                        case TB_INTEGER_CONST: {
+                            switch (n->inputs[2]->type) {
+                                case TB_INTEGER_CONST: {
+                                    // (xor (xor x C1) C2) => (xor x [C1 ^ C2])
+                                    {
+                                        TB_Node* x = n->inputs[1]->inputs[1];
+                                        uint64_t C1 = TB_NODE_GET_EXTRA_T(n->inputs[1]->inputs[2], TB_NodeInt)->value;
+                                        uint64_t C2 = TB_NODE_GET_EXTRA_T(n->inputs[2], TB_NodeInt)->value;
+                                        (void) x;
+                                        (void) C1;
+                                        (void) C2;
+                                        if (true) {
+                                            TB_Node* t0 = tb_alloc_node(f, TB_XOR, n->dt, 3, sizeof(TB_NodeBinopInt));
+                                            TB_Node* t1 = x;
+                                            set_input(p, t0, t1, 1);
+                                            TB_Node* t2 = make_int_node(f, p, n->dt, C1 ^ C2);
+                                            set_input(p, t0, t2, 2);
+                                            DO_IF(TB_OPTDEBUG_STATS)(peep_rule_hits[21]++);
+                                            return t0;
+                                        }
+                                    }
+                                    break;
+                                }
+                                default: break;
+                            }
+                            break;
+                        }
+                        default: break;
+                    }
+                    break;
+                }
+                default: break;
+            }
+            break;
+        }
+
+        case TB_SHL: {
+            switch (n->inputs[2]->type) {
+                case TB_INTEGER_CONST: {
+                    // (shl x 0) => x
+                    {
+                        TB_Node* x = n->inputs[1];
+                        (void) x;
+                        if (TB_NODE_GET_EXTRA_T(n->inputs[2], TB_NodeInt)->value == (uint64_t) 0) {
+                            TB_Node* t0 = x;
+                            DO_IF(TB_OPTDEBUG_STATS)(peep_rule_hits[4]++);
+                            return t0;
+                        }
+                    }
+                    switch (n->inputs[1]->type) {
+                        case TB_SHL: {
+                            switch (n->inputs[1]->inputs[2]->type) {
+                                case TB_INTEGER_CONST: {
+                                    // (shl (shl x C1) C2) => (shl x [C1 + C2])  if [C1 < 64 && C2 < 64 && C1 + C2 < n->dt.data]
+                                    {
+                                        TB_Node* x = n->inputs[1]->inputs[1];
+                                        uint64_t C1 = TB_NODE_GET_EXTRA_T(n->inputs[1]->inputs[2], TB_NodeInt)->value;
+                                        uint64_t C2 = TB_NODE_GET_EXTRA_T(n->inputs[2], TB_NodeInt)->value;
+                                        (void) x;
+                                        (void) C1;
+                                        (void) C2;
+                                        if ((C1 < 64 && C2 < 64 && C1 + C2 < n->dt.data)) {
+                                            TB_Node* t0 = tb_alloc_node(f, TB_SHL, n->dt, 3, sizeof(TB_NodeBinopInt));
+                                            TB_Node* t1 = x;
+                                            set_input(p, t0, t1, 1);
+                                            TB_Node* t2 = make_int_node(f, p, n->dt, C1 + C2);
+                                            set_input(p, t0, t2, 2);
+                                            DO_IF(TB_OPTDEBUG_STATS)(peep_rule_hits[22]++);
+                                            return t0;
+                                        }
+                                    }
+                                    break;
+                                }
+                                default: break;
+                            }
+                            break;
+                        }
+                        default: break;
+                    }
+                    break;
+                }
+                default: break;
+            }
+            break;
+        }
+
+        case TB_SHR: {
+            switch (n->inputs[2]->type) {
+                case TB_INTEGER_CONST: {
+                    // (shr x 0) => x
+                    {
+                        TB_Node* x = n->inputs[1];
+                        (void) x;
+                        if (TB_NODE_GET_EXTRA_T(n->inputs[2], TB_NodeInt)->value == (uint64_t) 0) {
+                            TB_Node* t0 = x;
+                            DO_IF(TB_OPTDEBUG_STATS)(peep_rule_hits[5]++);
+                            return t0;
+                        }
+                    }
+                    switch (n->inputs[1]->type) {
+                        case TB_SHR: {
+                            switch (n->inputs[1]->inputs[2]->type) {
+                                case TB_INTEGER_CONST: {
+                                    // (shr (shr x C1) C2) => (shr x [C1 + C2])  if [C1 < 64 && C2 < 64 && C1 + C2 < n->dt.data]
+                                    {
+                                        TB_Node* x = n->inputs[1]->inputs[1];
+                                        uint64_t C1 = TB_NODE_GET_EXTRA_T(n->inputs[1]->inputs[2], TB_NodeInt)->value;
+                                        uint64_t C2 = TB_NODE_GET_EXTRA_T(n->inputs[2], TB_NodeInt)->value;
+                                        (void) x;
+                                        (void) C1;
+                                        (void) C2;
+                                        if ((C1 < 64 && C2 < 64 && C1 + C2 < n->dt.data)) {
+                                            TB_Node* t0 = tb_alloc_node(f, TB_SHR, n->dt, 3, sizeof(TB_NodeBinopInt));
+                                            TB_Node* t1 = x;
+                                            set_input(p, t0, t1, 1);
+                                            TB_Node* t2 = make_int_node(f, p, n->dt, C1 + C2);
+                                            set_input(p, t0, t2, 2);
+                                            DO_IF(TB_OPTDEBUG_STATS)(peep_rule_hits[23]++);
+                                            return t0;
+                                        }
+                                    }
+                                    break;
+                                }
+                                default: break;
+                            }
+                            break;
+                        }
+                        default: break;
+                    }
+                    break;
+                }
+                default: break;
+            }
+            break;
+        }
+
+        case TB_SAR: {
+            switch (n->inputs[2]->type) {
+                case TB_INTEGER_CONST: {
+                    // (sar x 0) => x
+                    {
+                        TB_Node* x = n->inputs[1];
+                        (void) x;
+                        if (TB_NODE_GET_EXTRA_T(n->inputs[2], TB_NodeInt)->value == (uint64_t) 0) {
+                            TB_Node* t0 = x;
+                            DO_IF(TB_OPTDEBUG_STATS)(peep_rule_hits[6]++);
+                            return t0;
+                        }
+                    }
+                    break;
+                }
+                default: break;
+            }
+            break;
+        }
+
+        case TB_MUL: {
+            switch (n->inputs[2]->type) {
+                case TB_INTEGER_CONST: {
+                    // (mul x 0) => 0
+                    {
+                        TB_Node* x = n->inputs[1];
+                        (void) x;
+                        if (TB_NODE_GET_EXTRA_T(n->inputs[2], TB_NodeInt)->value == (uint64_t) 0) {
+                            TB_Node* t0 = make_int_node(f, p, n->dt, 0);
+                            DO_IF(TB_OPTDEBUG_STATS)(peep_rule_hits[7]++);
+                            return t0;
+                        }
+                    }
+                    // (mul x 1) => x
+                    {
+                        TB_Node* x = n->inputs[1];
+                        (void) x;
+                        if (TB_NODE_GET_EXTRA_T(n->inputs[2], TB_NodeInt)->value == (uint64_t) 1) {
+                            TB_Node* t0 = x;
+                            DO_IF(TB_OPTDEBUG_STATS)(peep_rule_hits[8]++);
+                            return t0;
+                        }
+                    }
+                    switch (n->inputs[1]->type) {
+                        case TB_MUL: {
+                            switch (n->inputs[1]->inputs[2]->type) {
+                                case TB_INTEGER_CONST: {
+                                    // (mul (mul x C1) C2) => (mul x [C1 * C2])
+                                    {
+                                        TB_Node* x = n->inputs[1]->inputs[1];
+                                        uint64_t C1 = TB_NODE_GET_EXTRA_T(n->inputs[1]->inputs[2], TB_NodeInt)->value;
+                                        uint64_t C2 = TB_NODE_GET_EXTRA_T(n->inputs[2], TB_NodeInt)->value;
+                                        (void) x;
+                                        (void) C1;
+                                        (void) C2;
+                                        if (true) {
+                                            TB_Node* t0 = tb_alloc_node(f, TB_MUL, n->dt, 3, sizeof(TB_NodeBinopInt));
+                                            TB_Node* t1 = x;
+                                            set_input(p, t0, t1, 1);
+                                            TB_Node* t2 = make_int_node(f, p, n->dt, C1 * C2);
+                                            set_input(p, t0, t2, 2);
+                                            DO_IF(TB_OPTDEBUG_STATS)(peep_rule_hits[18]++);
+                                            return t0;
+                                        }
+                                    }
+                                    break;
+                                }
+                                default: break;
+                            }
+                            break;
+                        }
+                        default: break;
+                    }
+                    // (mul  x C) => (shl x [tb_ffs(C) - 1])  if [C != 0 && (C & (C - 1)) == 0]
+                    {
+                        TB_Node* x = n->inputs[1];
+                        uint64_t C = TB_NODE_GET_EXTRA_T(n->inputs[2], TB_NodeInt)->value;
+                        (void) x;
+                        (void) C;
+                        if ((C != 0 && (C & (C - 1)) == 0)) {
+                            TB_Node* t0 = tb_alloc_node(f, TB_SHL, n->dt, 3, sizeof(TB_NodeBinopInt));
+                            TB_Node* t1 = x;
+                            set_input(p, t0, t1, 1);
+                            TB_Node* t2 = make_int_node(f, p, n->dt, tb_ffs(C) - 1);
+                            set_input(p, t0, t2, 2);
+                            DO_IF(TB_OPTDEBUG_STATS)(peep_rule_hits[24]++);
+                            return t0;
+                        }
+                    }
+                    break;
+                }
+                default: break;
+            }
+            break;
+        }
+
+        case TB_AND: {
+            switch (n->inputs[2]->type) {
+                case TB_INTEGER_CONST: {
+                    // (and x 0) => 0
+                    {
+                        TB_Node* x = n->inputs[1];
+                        (void) x;
+                        if (TB_NODE_GET_EXTRA_T(n->inputs[2], TB_NodeInt)->value == (uint64_t) 0) {
+                            TB_Node* t0 = make_int_node(f, p, n->dt, 0);
+                            DO_IF(TB_OPTDEBUG_STATS)(peep_rule_hits[9]++);
+                            return t0;
+                        }
+                    }
+                    // (and x C) => x  if [(C & tb__mask(n->dt.data)) == tb__mask(n->dt.data)]
+                    {
+                        TB_Node* x = n->inputs[1];
+                        uint64_t C = TB_NODE_GET_EXTRA_T(n->inputs[2], TB_NodeInt)->value;
+                        (void) x;
+                        (void) C;
+                        if (((C & tb__mask(n->dt.data)) == tb__mask(n->dt.data))) {
+                            TB_Node* t0 = x;
+                            DO_IF(TB_OPTDEBUG_STATS)(peep_rule_hits[10]++);
+                            return t0;
+                        }
+                    }
+                    break;
+                }
+                default: break;
+            }
+            // (and x x) => x
+            {
+                TB_Node* x = n->inputs[1];
+                (void) x;
+                if (n->inputs[2] == x) {
+                    TB_Node* t0 = x;
+                    DO_IF(TB_OPTDEBUG_STATS)(peep_rule_hits[15]++);
+                    return t0;
+                }
+            }
+            switch (n->inputs[1]->type) {
+                case TB_AND: {
+                    switch (n->inputs[1]->inputs[2]->type) {
+                        case TB_INTEGER_CONST: {
+                            switch (n->inputs[2]->type) {
+                                case TB_INTEGER_CONST: {
+                                    // (and (and x C1) C2) => (and x [C1 & C2])
+                                    {
+                                        TB_Node* x = n->inputs[1]->inputs[1];
+                                        uint64_t C1 = TB_NODE_GET_EXTRA_T(n->inputs[1]->inputs[2], TB_NodeInt)->value;
+                                        uint64_t C2 = TB_NODE_GET_EXTRA_T(n->inputs[2], TB_NodeInt)->value;
+                                        (void) x;
+                                        (void) C1;
+                                        (void) C2;
+                                        if (true) {
+                                            TB_Node* t0 = tb_alloc_node(f, TB_AND, n->dt, 3, sizeof(TB_NodeBinopInt));
+                                            TB_Node* t1 = x;
+                                            set_input(p, t0, t1, 1);
+                                            TB_Node* t2 = make_int_node(f, p, n->dt, C1 & C2);
+                                            set_input(p, t0, t2, 2);
+                                            DO_IF(TB_OPTDEBUG_STATS)(peep_rule_hits[19]++);
+                                            return t0;
+                                        }
+                                    }
+                                    break;
+                                }
+                                default: break;
+                            }
+                            break;
+                        }
+                        default: break;
+                    }
+                    break;
+                }
+                default: break;
+            }
+            break;
+        }
+
+        case TB_UDIV: {
+            switch (n->inputs[2]->type) {
+                case TB_INTEGER_CONST: {
+                    // (udiv x 1) => x
+                    {
+                        TB_Node* x = n->inputs[1];
+                        (void) x;
+                        if (TB_NODE_GET_EXTRA_T(n->inputs[2], TB_NodeInt)->value == (uint64_t) 1) {
+                            TB_Node* t0 = x;
+                            DO_IF(TB_OPTDEBUG_STATS)(peep_rule_hits[11]++);
+                            return t0;
+                        }
+                    }
+                    // (udiv x C) => (shr x [tb_ffs(C) - 1])  if [C != 0 && (C & (C - 1)) == 0]
+                    {
+                        TB_Node* x = n->inputs[1];
+                        uint64_t C = TB_NODE_GET_EXTRA_T(n->inputs[2], TB_NodeInt)->value;
+                        (void) x;
+                        (void) C;
+                        if ((C != 0 && (C & (C - 1)) == 0)) {
+                            TB_Node* t0 = tb_alloc_node(f, TB_SHR, n->dt, 3, sizeof(TB_NodeBinopInt));
+                            TB_Node* t1 = x;
+                            set_input(p, t0, t1, 1);
+                            TB_Node* t2 = make_int_node(f, p, n->dt, tb_ffs(C) - 1);
+                            set_input(p, t0, t2, 2);
+                            DO_IF(TB_OPTDEBUG_STATS)(peep_rule_hits[25]++);
+                            return t0;
+                        }
+                    }
+                    break;
+                }
+                default: break;
+            }
+            break;
+        }
+
+        case TB_SDIV: {
+            switch (n->inputs[2]->type) {
+                case TB_INTEGER_CONST: {
+                    // (sdiv x 1) => x
+                    {
+                        TB_Node* x = n->inputs[1];
+                        (void) x;
+                        if (TB_NODE_GET_EXTRA_T(n->inputs[2], TB_NodeInt)->value == (uint64_t) 1) {
+                            TB_Node* t0 = x;
+                            DO_IF(TB_OPTDEBUG_STATS)(peep_rule_hits[12]++);
+                            return t0;
+                        }
+                    }
+                    break;
+                }
+                default: break;
+            }
+            break;
+        }
+
+        case TB_UMOD: {
+            switch (n->inputs[2]->type) {
+                case TB_INTEGER_CONST: {
+                    // (umod x C) => (and x [C - 1])          if [C != 0 && (C & (C - 1)) == 0]
+                    {
+                        TB_Node* x = n->inputs[1];
+                        uint64_t C = TB_NODE_GET_EXTRA_T(n->inputs[2], TB_NodeInt)->value;
+                        (void) x;
+                        (void) C;
+                        if ((C != 0 && (C & (C - 1)) == 0)) {
+                            TB_Node* t0 = tb_alloc_node(f, TB_AND, n->dt, 3, sizeof(TB_NodeBinopInt));
+                            TB_Node* t1 = x;
+                            set_input(p, t0, t1, 1);
+                            TB_Node* t2 = make_int_node(f, p, n->dt, C - 1);
+                            set_input(p, t0, t2, 2);
+                            DO_IF(TB_OPTDEBUG_STATS)(peep_rule_hits[26]++);
+                            return t0;
+                        }
+                    }
+                    break;
+                }
+                default: break;
+            }
+            break;
+        }
+
+        default: break;
+    }
+
+    return NULL;
+}
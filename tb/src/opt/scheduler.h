@@ -164,3 +164,349 @@ void greedy_scheduler(TB_Passes* passes, TB_CFG* cfg, Worklist* ws, DynArray(Phi
 
     tb_arena_restore(arena, sp);
 }
+
+////////////////////////////////
+// List scheduler
+////////////////////////////////
+// greedy_scheduler hands us a valid order, from there we rebuild the dependencies
+// within the block and place one node per cycle, picking whatever's ready with the
+// longest path to the end of the block so long latency ops (loads, multiplies,
+// divides) get started early and independent work fills in behind them. Once too
+// many values are live we start favoring whatever kills values so we don't hand
+// linear scan a mess.
+enum { SCHED_PRESSURE_LIMIT = 12 };
+
+typedef struct {
+    TB_Node* n;
+    int preds, height, ready;
+    // in-block users which haven't been placed yet, once it hits zero the value
+    // is dead (unless something outside the block wants it)
+    int uses;
+    bool is_value, live_out;
+    // projections stick to their tuple
+    bool glued, queued, placed;
+    int succ_start, succ_count;
+} ListNode;
+
+typedef struct {
+    int from, to;
+} ListEdge;
+
+typedef struct {
+    int count, end;
+    ListNode* nodes;
+    int* succs;
+
+    // gvn -> index (sparse set, stale entries are caught by checking the node)
+    int* local;
+
+    TB_NodeCost (*cost)(TB_Node* n);
+    int cycle, unit_free, pressure;
+
+    TB_Node** out;
+    int out_count;
+} ListSched;
+
+static int list_sched_index(ListSched* s, TB_Node* n) {
+    int i = s->local[n->gvn];
+    return i >= 0 && i < s->count && s->nodes[i].n == n ? i : -1;
+}
+
+static TB_NodeCost list_sched_cost(ListSched* s, TB_Node* n) {
+    return s->cost ? s->cost(n) : (TB_NodeCost){ 1, 1 };
+}
+
+// anything which has to stay in order with the other effects, memory ops
+// already have edges between them so this is mostly for the weirdos.
+static bool list_sched_is_effect(TB_Node* n) {
+    TB_DataTypeEnum t = n->dt.type;
+    return t == TB_CONTROL || t == TB_MEMORY || t == TB_TUPLE ||
+        n->type == TB_CYCLE_COUNTER || n->type == TB_MACHINE_OP ||
+        n->type == TB_X86INTRIN_LDMXCSR || n->type == TB_X86INTRIN_STMXCSR;
+}
+
+static bool list_sched_is_value(TB_Node* n) {
+    TB_DataTypeEnum t = n->dt.type;
+    if (t == TB_CONTROL || t == TB_MEMORY || t == TB_TUPLE) {
+        return false;
+    }
+
+    // these are either live-in or get rematerialized
+    switch (n->type) {
+        case TB_PHI:
+        case TB_INTEGER_CONST:
+        case TB_FLOAT32_CONST:
+        case TB_FLOAT64_CONST:
+        case TB_SYMBOL:
+        case TB_LOCAL:
+        return false;
+
+        default:
+        return true;
+    }
+}
+
+// how much the register pressure changes if we place i now
+static int list_sched_delta(ListSched* s, int i) {
+    ListNode* ln = &s->nodes[i];
+    int delta = ln->is_value && (ln->uses > 0 || ln->live_out) ? 1 : 0;
+
+    if (ln->n->type != TB_PHI) {
+        FOREACH_N(j, 0, ln->n->input_count) {
+            TB_Node* in = ln->n->inputs[j];
+            int k = in ? list_sched_index(s, in) : -1;
+            if (k >= 0 && s->nodes[k].is_value && !s->nodes[k].live_out && s->nodes[k].uses == 1) {
+                delta -= 1;
+            }
+        }
+    }
+
+    return delta;
+}
+
+static void list_sched_place(ListSched* s, int i, DynArray(int)* ready) {
+    ListNode* ln = &s->nodes[i];
+    TB_NodeCost cost = ln->glued ? (TB_NodeCost){ 0, 1 } : list_sched_cost(s, ln->n);
+
+    if (!ln->glued) {
+        if (s->cycle < ln->ready) s->cycle = ln->ready;
+        if (cost.occupancy > 1) {
+            if (s->cycle < s->unit_free) s->cycle = s->unit_free;
+            s->unit_free = s->cycle + cost.occupancy;
+        }
+    }
+
+    ln->placed = true;
+    s->out[s->out_count++] = ln->n;
+
+    // values die as their last in-block user is placed
+    if (ln->is_value && (ln->uses > 0 || ln->live_out)) {
+        s->pressure += 1;
+    }
+
+    if (ln->n->type != TB_PHI) {
+        FOREACH_N(j, 0, ln->n->input_count) {
+            TB_Node* in = ln->n->inputs[j];
+            int k = in ? list_sched_index(s, in) : -1;
+            if (k >= 0 && s->nodes[k].is_value && s->nodes[k].uses > 0) {
+                s->nodes[k].uses -= 1;
+                if (s->nodes[k].uses == 0 && !s->nodes[k].live_out) {
+                    s->pressure -= 1;
+                }
+            }
+        }
+    }
+
+    int finish = s->cycle + cost.latency;
+    FOREACH_N(j, 0, ln->succ_count) {
+        ListNode* succ = &s->nodes[s->succs[ln->succ_start + j]];
+        if (succ->ready < finish) succ->ready = finish;
+        succ->preds -= 1;
+    }
+
+    // projections go right after their tuple, everything else waits its turn
+    FOREACH_N(j, 0, ln->succ_count) {
+        int k = s->succs[ln->succ_start + j];
+        ListNode* succ = &s->nodes[k];
+        if (succ->preds == 0 && !succ->queued) {
+            succ->queued = true;
+            if (succ->glued) {
+                list_sched_place(s, k, ready);
+            } else if (k != s->end) {
+                dyn_array_put(*ready, k);
+            }
+        }
+    }
+
+    if (!ln->glued) {
+        s->cycle += 1;
+    }
+}
+
+void list_scheduler(TB_Passes* passes, TB_CFG* cfg, Worklist* ws, DynArray(PhiVal)* phi_vals, TB_BasicBlock* bb, TB_Node* end) {
+    size_t base = dyn_array_length(ws->items);
+    greedy_scheduler(passes, cfg, ws, phi_vals, bb, end);
+
+    size_t count = dyn_array_length(ws->items) - base;
+    if (count <= 2) {
+        return;
+    }
+
+    TB_Arena* arena = tmp_arena;
+    TB_ArenaSavepoint sp = tb_arena_save(arena);
+
+    TB_Function* f = passes->f;
+    ICodeGen* cg = tb__find_code_generator(f->super.module);
+
+    ListSched s = {
+        .count = count,
+        .nodes = tb_arena_alloc(arena, count * sizeof(ListNode)),
+        .local = tb_arena_alloc(arena, f->node_count * sizeof(int)),
+        .cost  = cg ? cg->node_cost : NULL,
+        .out   = &ws->items[base],
+    };
+
+    TB_Node** order = tb_arena_alloc(arena, count * sizeof(TB_Node*));
+    memcpy(order, &ws->items[base], count * sizeof(TB_Node*));
+
+    FOREACH_N(i, 0, count) {
+        s.nodes[i] = (ListNode){ .n = order[i] };
+        s.local[order[i]->gvn] = i;
+    }
+
+    // the end of the block is always last, anything after it in the greedy
+    // order is one of its projections.
+    int end_i = s.end = list_sched_index(&s, end);
+    assert(end_i >= 0);
+
+    // build the edges, only ever forward in the greedy order which keeps
+    // them acyclic and means we can't undo anything it got right.
+    DynArray(ListEdge) edges = dyn_array_create(ListEdge, count * 2);
+    int last_effect = -1;
+    FOREACH_N(i, 0, count) {
+        TB_Node* n = order[i];
+        ListNode* ln = &s.nodes[i];
+
+        ln->is_value = list_sched_is_value(n);
+        if (n->type == TB_PROJ && n->inputs[0]->type != TB_BRANCH) {
+            int t = list_sched_index(&s, n->inputs[0]);
+            ln->glued = t >= 0 && t < i;
+        }
+
+        if (n->type != TB_PHI) {
+            FOREACH_N(j, 0, n->input_count) {
+                int k = n->inputs[j] ? list_sched_index(&s, n->inputs[j]) : -1;
+                if (k >= 0 && k < i) {
+                    dyn_array_put(edges, (ListEdge){ k, i });
+                }
+            }
+        }
+
+        // anti-dependencies: loads of the old memory go before we overwrite it,
+        // the user of a load also stays in front since isel likes to fold loads
+        // into their only user.
+        if (is_mem_out_op(n) && n->type != TB_PHI && n->type != TB_PROJ && n->input_count > 1 && n->inputs[1]) {
+            for (User* u = n->inputs[1]->users; u; u = u->next) {
+                int k = list_sched_index(&s, u->n);
+                if (u->slot != 1 || u->n == n || k < 0 || k >= i) continue;
+
+                dyn_array_put(edges, (ListEdge){ k, i });
+                if (u->n->type == TB_LOAD && u->n->users && u->n->users->next == NULL) {
+                    int user_i = list_sched_index(&s, u->n->users->n);
+                    if (user_i >= 0 && user_i < i) {
+                        dyn_array_put(edges, (ListEdge){ user_i, i });
+                    }
+                }
+            }
+        }
+
+        if (list_sched_is_effect(n) && !ln->glued) {
+            if (last_effect >= 0) {
+                dyn_array_put(edges, (ListEdge){ last_effect, i });
+            }
+            last_effect = i;
+        }
+
+        // anything which isn't used in the block (or used by a phi) is live
+        // until the end of it
+        if (ln->is_value) {
+            for (User* u = n->users; u; u = u->next) {
+                int k = list_sched_index(&s, u->n);
+                if (k >= 0 && u->n->type != TB_PHI) {
+                    ln->uses += 1;
+                } else {
+                    ln->live_out = true;
+                }
+            }
+        }
+    }
+
+    // successor lists
+    size_t edge_count = dyn_array_length(edges);
+    s.succs = tb_arena_alloc(arena, edge_count * sizeof(int));
+    FOREACH_N(i, 0, edge_count) {
+        s.nodes[edges[i].from].succ_count += 1;
+        s.nodes[edges[i].to].preds += 1;
+    }
+
+    int total = 0;
+    FOREACH_N(i, 0, count) {
+        s.nodes[i].succ_start = total;
+        total += s.nodes[i].succ_count;
+        s.nodes[i].succ_count = 0;
+    }
+
+    FOREACH_N(i, 0, edge_count) {
+        ListNode* from = &s.nodes[edges[i].from];
+        s.succs[from->succ_start + from->succ_count++] = edges[i].to;
+    }
+    dyn_array_destroy(edges);
+
+    // critical path to the end of the block
+    FOREACH_REVERSE_N(i, 0, count) {
+        ListNode* ln = &s.nodes[i];
+        int h = 0;
+        FOREACH_N(j, 0, ln->succ_count) {
+            int succ_h = s.nodes[s.succs[ln->succ_start + j]].height;
+            if (h < succ_h) h = succ_h;
+        }
+
+        ln->height = h + (ln->glued ? 0 : list_sched_cost(&s, ln->n).latency);
+    }
+
+    DynArray(int) ready = dyn_array_create(int, 32);
+    FOREACH_N(i, 0, count) {
+        if (s.nodes[i].preds == 0 && !s.nodes[i].glued && i != end_i) {
+            s.nodes[i].queued = true;
+            dyn_array_put(ready, i);
+        }
+    }
+
+    while (dyn_array_length(ready) > 0) {
+        bool spilly = s.pressure >= SCHED_PRESSURE_LIMIT;
+
+        // pick the best candidate
+        size_t best = 0;
+        int best_delta = 0;
+        bool best_avail = false;
+        FOREACH_N(j, 0, dyn_array_length(ready)) {
+            ListNode* ln = &s.nodes[ready[j]];
+            int delta = spilly ? list_sched_delta(&s, ready[j]) : 0;
+            bool avail = ln->ready <= s.cycle;
+
+            if (j > 0) {
+                ListNode* b = &s.nodes[ready[best]];
+                if (delta != best_delta) {
+                    if (delta > best_delta) continue;
+                } else if (avail != best_avail) {
+                    if (!avail) continue;
+                } else if (ln->height != b->height) {
+                    if (ln->height < b->height) continue;
+                } else if (ln->ready != b->ready) {
+                    if (ln->ready > b->ready) continue;
+                } else if (ready[j] > ready[best]) {
+                    continue;
+                }
+            }
+
+            best = j, best_delta = delta, best_avail = avail;
+        }
+
+        int i = ready[best];
+        ready[best] = ready[dyn_array_length(ready) - 1];
+        dyn_array_pop(ready);
+
+        list_sched_place(&s, i, &ready);
+    }
+
+    // the end only goes once everything else is placed (unless it's a projection
+    // in which case it went with its tuple)
+    if (!s.nodes[end_i].placed) {
+        assert(s.nodes[end_i].preds == 0 && "the end of the block should depend on nothing after it");
+        list_sched_place(&s, end_i, &ready);
+    }
+    assert(s.out_count == count);
+    dyn_array_destroy(ready);
+
+    tb_arena_restore(arena, sp);
+}
@@ -0,0 +1,121 @@
+// Self tail recursion => loops
+//
+//   Start                         Start
+//     |                             |
+//    ...                  =>      Header <----+     every param (and the memory)
+//     |                             |         |     gets a phi on the header, the
+//   tailcall(f, a, b)              ...        |     tailcall's arguments are the
+//                                   +---------+     backedge values.
+//
+// the frontend only makes tail calls when nothing can point into the frame, so
+// reusing it for the next iteration is fine.
+static bool is_self_tailcall(TB_Function* f, TB_Node* n) {
+    if (n->type != TB_TAILCALL) {
+        return false;
+    }
+
+    TB_Node* target = n->inputs[2];
+    if (target->type != TB_SYMBOL || TB_NODE_GET_EXTRA_T(target, TB_NodeSymbol)->sym != &f->super) {
+        return false;
+    }
+
+    // the arguments have to line up with our params
+    TB_FunctionPrototype* proto = f->prototype;
+    if (n->input_count - 3 != proto->param_count) {
+        return false;
+    }
+
+    TB_PrototypeParam* params = proto->params;
+    FOREACH_N(i, 0, proto->param_count) {
+        if (!TB_DATA_TYPE_EQUALS(n->inputs[3 + i]->dt, params[i].dt)) return false;
+    }
+
+    return true;
+}
+
+// replaces every use of old (other than the ones made here) with new
+static void tailrec_replace_uses(TB_Passes* restrict p, TB_Node* old, TB_Node* new) {
+    size_t count = 0;
+    for (User* u = old->users; u; u = u->next) count++;
+
+    User* uses = tb_arena_alloc(tmp_arena, count * sizeof(User));
+    size_t i = 0;
+    for (User* u = old->users; u; u = u->next) uses[i++] = *u;
+
+    FOREACH_N(i, 0, count) {
+        tb_pass_mark(p, uses[i].n);
+        set_input(p, uses[i].n, new, uses[i].slot);
+    }
+}
+
+bool tb_pass_tail_recursion(TB_Passes* p) {
+    verify_tmp_arena(p);
+
+    TB_Function* f = p->f;
+
+    size_t call_count = 0;
+    TB_Node** calls = tb_arena_alloc(tmp_arena, dyn_array_length(f->terminators) * sizeof(TB_Node*));
+    dyn_array_for(i, f->terminators) {
+        if (is_self_tailcall(f, f->terminators[i])) {
+            calls[call_count++] = f->terminators[i];
+        }
+    }
+
+    if (call_count == 0) {
+        return false;
+    }
+
+    // entry control, memory and params, the RPC stays the same between iterations
+    size_t param_count = f->prototype->param_count;
+    TB_Node** projs = tb_arena_alloc(tmp_arena, (3 + param_count) * sizeof(TB_Node*));
+    memset(projs, 0, (3 + param_count) * sizeof(TB_Node*));
+    for (User* u = f->start_node->users; u; u = u->next) {
+        if (u->n->type == TB_PROJ) {
+            int index = TB_NODE_GET_EXTRA_T(u->n, TB_NodeProj)->index;
+            if (index != 2) projs[index] = u->n;
+        }
+    }
+
+    TB_Node* header = tb_alloc_node(f, TB_REGION, TB_TYPE_CONTROL, 1 + call_count, sizeof(TB_NodeRegion));
+    TB_NODE_SET_EXTRA(header, TB_NodeRegion, .freq = 1.0f, .tag = "tailrec");
+
+    TB_Node** merged = tb_arena_alloc(tmp_arena, (3 + param_count) * sizeof(TB_Node*));
+    merged[0] = header;
+    FOREACH_N(i, 1, 3 + param_count) {
+        merged[i] = NULL;
+        if (i == 2 || projs[i] == NULL || projs[i]->users == NULL) continue;
+
+        merged[i] = tb_alloc_node(f, TB_PHI, projs[i]->dt, 2 + call_count, 0);
+        set_input(p, merged[i], header, 0);
+    }
+
+    // everything which used the entry now sits on the header, the tailcalls
+    // included so their arguments see the phis.
+    FOREACH_N(i, 0, 3 + param_count) if (merged[i] != NULL) {
+        tailrec_replace_uses(p, projs[i], merged[i]);
+    }
+
+    FOREACH_N(i, 0, 3 + param_count) if (merged[i] != NULL) {
+        TB_Node* n = merged[i];
+        int base = n->type == TB_REGION ? 0 : 1;
+
+        // the tailcall's inputs line up with the projections, control, memory
+        // and the arguments after the target (where the RPC would be)
+        set_input(p, n, projs[i], base);
+        FOREACH_N(j, 0, call_count) {
+            set_input(p, n, calls[j]->inputs[i], base + 1 + j);
+        }
+        tb_pass_mark(p, n);
+    }
+
+    // we might be running before the peepholes made the GVN table
+    if (p->gvn_nodes.data == NULL) {
+        p->gvn_nodes = nl_hashset_alloc(f->node_count);
+    }
+
+    FOREACH_N(j, 0, call_count) {
+        tb_pass_kill_node(p, calls[j]);
+    }
+
+    return true;
+}
@@ -27,6 +27,9 @@ typedef struct {
         USE_REG,
         USE_MEM_OR_REG,
     } kind;
+
+    // how often the block with the use runs
+    float freq;
 } UsePos;
 
 typedef struct {
@@ -84,6 +87,10 @@ typedef struct {
     DynArray(int) epilogues;
     uint64_t callee_saved[CG_REGISTER_CLASSES];
 
+    // callee saved registers we've taken and where they're saved
+    uint64_t saved[CG_REGISTER_CLASSES];
+    RegIndex save_slots[CG_REGISTER_CLASSES][16];
+
     Set active_set[CG_REGISTER_CLASSES];
     RegIndex active[CG_REGISTER_CLASSES][16];
 
@@ -97,8 +104,8 @@ static LiveRange* last_range(LiveInterval* i) {
 ////////////////////////////////
 // Generate intervals
 ////////////////////////////////
-static void add_use_pos(LiveInterval* interval, int t, int kind) {
-    UsePos u = { t, kind };
+static void add_use_pos(LiveInterval* interval, int t, int kind, float freq) {
+    UsePos u = { t, kind, freq };
     dyn_array_put(interval->uses, u);
 }
 
@@ -146,7 +153,7 @@ static void reverse_bb_walk(LSRA* restrict ra, MachineBB* bb, Inst* inst) {
             interval->ranges[interval->range_count - 1].start = inst->time;
         }
 
-        add_use_pos(interval, inst->time, dst_use_reg ? USE_REG : USE_OUT);
+        add_use_pos(interval, inst->time, dst_use_reg ? USE_REG : USE_OUT, bb->freq);
     }
 
     int t = inst->type == MOV || inst->type == FP_MOV ? inst->time - 1 : inst->time;
@@ -162,7 +169,7 @@ static void reverse_bb_walk(LSRA* restrict ra, MachineBB* bb, Inst* inst) {
         LiveInterval* interval = &ra->intervals[*ops++];
 
         add_range(interval, bb->start, t);
-        add_use_pos(interval, t, use);
+        add_use_pos(interval, t, use, bb->freq);
     }
 
     // calls use the temporaries for clobbers
@@ -173,7 +180,7 @@ static void reverse_bb_walk(LSRA* restrict ra, MachineBB* bb, Inst* inst) {
 
         add_range(interval, inst->time, inst->time + 1);
         if (!is_call) {
-            add_use_pos(interval, inst->time, USE_REG);
+            add_use_pos(interval, inst->time, USE_REG, bb->freq);
         }
     }
 
@@ -183,7 +190,7 @@ static void reverse_bb_walk(LSRA* restrict ra, MachineBB* bb, Inst* inst) {
         LiveInterval* interval = &ra->intervals[*ops++];
 
         add_range(interval, bb->start, t);
-        add_use_pos(interval, t, USE_MEM_OR_REG);
+        add_use_pos(interval, t, USE_MEM_OR_REG, bb->freq);
     }
 }
 
@@ -211,10 +218,11 @@ static int interval_intersect(LiveInterval* a, LiveInterval* b) {
 #define FOREACH_SET(it, set) \
 FOREACH_N(_i, 0, ((set).capacity + 63) / 64) FOREACH_BIT(it, _i*64, (set).data[_i])
 
-static int next_use(LSRA* restrict ra, LiveInterval* interval, int time) {
+static int next_use(LSRA* restrict ra, LiveInterval* interval, int time, float* freq) {
     for (;;) {
         FOREACH_N(i, 0, dyn_array_length(interval->uses)) {
             if (interval->uses[i].pos > time) {
+                *freq = interval->uses[i].freq;
                 return interval->uses[i].pos;
             }
         }
@@ -224,6 +232,7 @@ static int next_use(LSRA* restrict ra, LiveInterval* interval, int time) {
             continue;
         }
 
+        *freq = 1.0f;
         return INT_MAX;
     }
 }
@@ -519,11 +528,10 @@ static ptrdiff_t allocate_free_reg(LSRA* restrict ra, LiveInterval* interval) {
             int spill_slot = dyn_array_length(ra->intervals);
             dyn_array_put(ra->intervals, it);
 
-            // insert spill and reload
-            insert_split_move(ra, 0, vreg, spill_slot);
-            dyn_array_for(i, ra->epilogues) {
-                insert_split_move(ra, ra->epilogues[i] - 1, spill_slot, vreg);
-            }
+            // the spill and reloads get placed once we know every place
+            // the register is used (see shrink_wrap_callee_saves)
+            ra->saved[rc] |= 1ull << highest;
+            ra->save_slots[rc][highest] = spill_slot;
 
             // adding to intervals might resized this
             interval = &ra->intervals[old_reg];
@@ -552,26 +560,38 @@ static ptrdiff_t allocate_free_reg(LSRA* restrict ra, LiveInterval* interval) {
     }
 }
 
+static double spill_weight(int use_pos, float freq, int start) {
+    if (use_pos == INT_MAX) {
+        return DBL_MAX;
+    } else if (use_pos <= start) {
+        // blocked, the frequency doesn't change that
+        return use_pos - start;
+    } else {
+        return (use_pos - start) / (double) freq;
+    }
+}
+
 static ptrdiff_t allocate_blocked_reg(LSRA* restrict ra, LiveInterval* interval) {
     int rc = interval->reg_class;
     int* use_pos = ra->free_pos;
 
+    float use_freq[16];
     FOREACH_N(i, 0, 16) ra->block_pos[i] = INT_MAX;
-    FOREACH_N(i, 0, 16) use_pos[i] = INT_MAX;
+    FOREACH_N(i, 0, 16) use_pos[i] = INT_MAX, use_freq[i] = 1.0f;
 
     // mark non-fixed intervals
     int start = interval_start(interval);
     FOREACH_SET(i, ra->active_set[rc]) {
         LiveInterval* it = &ra->intervals[ra->active[rc][i]];
         if (it->reg_class == rc && it->reg < 0) {
-            use_pos[i] = next_use(ra, it, start);
+            use_pos[i] = next_use(ra, it, start, &use_freq[i]);
         }
     }
 
     dyn_array_for(i, ra->inactive) {
         LiveInterval* it = &ra->intervals[ra->inactive[i]];
         if (it->reg_class == rc && it->reg < 0) {
-            use_pos[i] = next_use(ra, it, start);
+            use_pos[i] = next_use(ra, it, start, &use_freq[i]);
         }
     }
 
@@ -603,10 +623,15 @@ static ptrdiff_t allocate_blocked_reg(LSRA* restrict ra, LiveInterval* interval)
         use_pos[RSP] = 0;
     }
 
-    // pick highest use pos
+    // pick the furthest next use, scaled by how often that use runs so
+    // we'd rather reload in a cold block than a hot one a bit further out.
     int highest = 0;
-    FOREACH_N(i, 1, 16) if (use_pos[i] > use_pos[highest]) {
-        highest = i;
+    double best = spill_weight(use_pos[0], use_freq[0], start);
+    FOREACH_N(i, 1, 16) {
+        double w = spill_weight(use_pos[i], use_freq[i], start);
+        if (w > best) {
+            highest = i, best = w;
+        }
     }
 
     int pos = use_pos[highest];
@@ -719,6 +744,78 @@ static bool update_interval(LSRA* restrict ra, LiveInterval* restrict interval,
     return false;
 }
 
+// finds the block (in layout order) which has this time
+static int find_machine_bb(MachineBB** mbbs, int count, int t) {
+    int lo = 0, hi = count - 1;
+    while (lo < hi) {
+        int mid = lo + (hi - lo + 1) / 2;
+        if (mbbs[mid]->start <= t) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return lo;
+}
+
+// callee saved registers are saved at the shrink wrap point of every block
+// the register is live in, the epilogues it covers restore it.
+static void shrink_wrap_callee_saves(Ctx* restrict ctx, LSRA* restrict ra) {
+    TB_Node** bbs = ctx->worklist.items;
+    int bb_count = ctx->bb_count;
+
+    // no savepoint, the moves we insert live in the tmp arena too
+    MachineBB** mbbs = tb_arena_alloc(tmp_arena, bb_count * sizeof(MachineBB*));
+    bool* uses = tb_arena_alloc(tmp_arena, ctx->cfg.block_count * sizeof(bool));
+    bool* covered = tb_arena_alloc(tmp_arena, ctx->cfg.block_count * sizeof(bool));
+    FOREACH_N(i, 0, bb_count) {
+        mbbs[i] = &nl_map_get_checked(ctx->machine_bbs, bbs[ctx->bb_order[i]]);
+    }
+
+    FOREACH_N(rc, 0, CG_REGISTER_CLASSES) {
+        FOREACH_N(reg, 0, 16) if (ra->saved[rc] & (1ull << reg)) {
+            memset(uses, 0, ctx->cfg.block_count * sizeof(bool));
+
+            // every block which the register's live in
+            dyn_array_for(i, ra->intervals) {
+                LiveInterval* it = &ra->intervals[i];
+                if (it->reg_class != rc || it->is_spill || it->assigned != reg) {
+                    continue;
+                }
+
+                FOREACH_N(j, 1, it->range_count) {
+                    LiveRange* r = &it->ranges[j];
+                    for (int k = find_machine_bb(mbbs, bb_count, r->start); k < bb_count && mbbs[k]->start <= r->end; k++) {
+                        if (mbbs[k]->end >= r->start) {
+                            uses[ctx->bb_order[k]] = true;
+                        }
+                    }
+                }
+            }
+
+            int point = shrink_wrap_point(ctx, uses, covered);
+            if (point < 0) {
+                continue;
+            }
+
+            int vreg = (rc ? FIRST_XMM : FIRST_GPR) + reg;
+            int slot = ra->save_slots[rc][reg];
+
+            // insert spill and reloads
+            MachineBB* mbb = &nl_map_get_checked(ctx->machine_bbs, bbs[point]);
+            insert_split_move(ra, mbb->start, vreg, slot);
+            dyn_array_for(i, ra->epilogues) {
+                int t = ra->epilogues[i];
+                int k = find_machine_bb(mbbs, bb_count, t);
+
+                if (covered[ctx->bb_order[k]]) {
+                    insert_split_move(ra, t - 1, slot, vreg);
+                }
+            }
+        }
+    }
+}
+
 static void cuiksort_defs(LiveInterval* intervals, ptrdiff_t lo, ptrdiff_t hi, RegIndex* arr);
 static int linear_scan(Ctx* restrict ctx, TB_Function* f, int stack_usage, DynArray(int) epilogues) {
     LSRA ra = { .first = ctx->first, .cache = ctx->first, .intervals = ctx->intervals, .epilogues = epilogues, .stack_usage = stack_usage };
@@ -875,6 +972,10 @@ static int linear_scan(Ctx* restrict ctx, TB_Function* f, int stack_usage, DynAr
         }
     }
 
+    CUIK_TIMED_BLOCK("shrink wrap") {
+        shrink_wrap_callee_saves(ctx, &ra);
+    }
+
     // move resolver
     CUIK_TIMED_BLOCK("move resolver") {
         TB_Node** bbs = ctx->worklist.items;
@@ -898,7 +999,11 @@ static int linear_scan(Ctx* restrict ctx, TB_Function* f, int stack_usage, DynAr
                         LiveInterval* end = split_interval_at(&ra, interval, target->start);
 
                         if (start != end) {
-                            if (start->spill > 0) {
+                            // reloads go at the top of the successor unless it's got other
+                            // ways in, block layout doesn't promise RPO order so the other
+                            // predecessors might not have the value in the spill slot.
+                            bool single_pred = succ->type != TB_REGION || succ->input_count == 1;
+                            if (start->spill > 0 && single_pred) {
                                 assert(end->spill == start->spill && "TODO: both can't be spills yet");
                                 insert_split_move(&ra, target->start + 1, start - ra.intervals, end - ra.intervals);
                             } else {
@@ -930,6 +1035,9 @@ static int linear_scan(Ctx* restrict ctx, TB_Function* f, int stack_usage, DynAr
             tb_platform_heap_free(ra.intervals[i].ranges);
             dyn_array_destroy(ra.intervals[i].uses);
         }
+
+        dyn_array_destroy(ra.unhandled);
+        dyn_array_destroy(ra.inactive);
     }
 
     ctx->intervals = ra.intervals;
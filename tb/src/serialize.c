@@ -0,0 +1,1068 @@
+// Binary module images (.tbm), a flat dump of a TB_Module's IR which gets memory-mapped
+// and turned back into a module without going through a frontend again.
+//
+//   header:  ImageHeader
+//   tables:  symbols (with their node graphs), prototypes, source files, sections, debug types
+//   data:    strings and raw blobs, everything else refers to these by offset
+//
+// Anything that's just bytes (symbol names, global contents, region tags, machine op
+// buffers) is used straight out of the mapping, the loader only rebuilds the pointer
+// graph: symbols, prototypes, debug types and nodes. Nodes keep their GVN numbers and
+// the extras are stored with the same layout they have in memory except the pointers
+// are swapped for (index + 1), 0 being NULL, so most of them are a memcpy.
+//
+// It's not an interchange format, the image only loads into the same build of TB.
+#include <file_map.h>
+
+#define IMAGE_VERSION 1
+
+enum {
+    // the windows modules make their own __chkstk, we reuse it on load
+    IMAGE_SYMBOL_CHKSTK = 1,
+};
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+
+    // node extras are stored in the host's layout, enum values can move between builds
+    char stamp[24];
+    uint32_t pointer_size;
+
+    uint32_t arch, system;
+    TB_FeatureSet features;
+
+    uint32_t symbol_count, proto_count, file_count, section_count, type_count;
+    uint32_t tls_index; // symbol + 1
+
+    // file offsets
+    uint64_t symbols, protos, files, sections, types, data;
+} ImageHeader;
+
+typedef struct {
+    uint32_t size; // whole record, multiple of 8
+    uint32_t tag;
+    uint32_t name;
+    uint32_t flags;
+    uint64_t ordinal;
+} ImageSymbol;
+
+typedef struct {
+    uint32_t type, reserved;
+} ImageExternal;
+
+typedef struct {
+    uint32_t linkage, parent;
+    uint32_t size, align;
+    uint32_t dbg_type;
+    uint32_t obj_count;
+} ImageGlobal;
+
+typedef struct {
+    uint32_t type, offset;
+    // region: size & data offset, reloc: symbol + 1
+    uint32_t size, ref;
+} ImageInitObj;
+
+typedef struct {
+    uint32_t section, linkage;
+    uint32_t dbg_type, proto;
+    uint32_t has_body;
+    uint32_t param_count;
+    uint32_t node_count; // stored nodes
+    uint32_t gvn_count;  // TB_Function.node_count
+    uint32_t terminator_count;
+    uint32_t start, stop;
+    uint32_t has_param_ranges;
+    // followed by the params & terminators (node + 1), the param ranges then the nodes
+} ImageFunction;
+
+typedef struct {
+    uint16_t type, input_count;
+    uint16_t dt, attrib_count;
+    uint32_t gvn;
+    uint32_t extra_size;
+    // followed by the inputs (node + 1), the extras then the attributes, each padded to 8 bytes
+} ImageNode;
+
+typedef struct {
+    uint32_t tag, parent;
+    uint32_t name, storage;
+} ImageAttrib;
+
+typedef struct {
+    uint32_t call_conv;
+    uint16_t return_count, param_count;
+    uint32_t has_varargs, reserved;
+} ImageProto;
+
+typedef struct {
+    uint32_t dt, debug_type;
+    uint32_t name, reserved;
+} ImageParam;
+
+typedef struct {
+    uint32_t path, len;
+} ImageFile;
+
+typedef struct {
+    uint32_t name, flags;
+    uint32_t comdat, reserved;
+} ImageSection;
+
+typedef struct {
+    uint32_t tag;
+    uint32_t name;  // alias & field names, record tags
+    uint32_t base;  // pointee, array element, alias & field type
+    uint32_t value; // int bits, float format, field offset, record size, calling convention
+    uint32_t align; // record alignment, function varargs
+    uint32_t count; // record members, function params
+    uint32_t extra; // function returns
+    uint32_t reserved;
+    uint64_t array_count;
+    // followed by the count + extra type refs, padded to 8 bytes
+} ImageDebugType;
+
+static const ImageHeader image_header = { "TBMF", IMAGE_VERSION, __DATE__ " " __TIME__, sizeof(void*) };
+
+// keeps the mapping alive for as long as the module points into it
+typedef struct TB_ModuleImage {
+    FileMap file;
+    TB_Arena arena;
+} TB_ModuleImage;
+
+#define IMAGE_REF(x)     ((void*) (uintptr_t) (x))
+#define IMAGE_REF_ID(p)  ((uint32_t) (uintptr_t) (p))
+
+////////////////////////////////
+// Writer
+////////////////////////////////
+typedef struct {
+    TB_Module* m;
+    TB_Emitter out;
+    TB_Emitter data;
+
+    // symbols, prototypes, source files & debug types -> index + 1
+    NL_Map(const void*, uint32_t) ids;
+
+    DynArray(TB_FunctionPrototype*) protos;
+    DynArray(TB_SourceFile*) files;
+    DynArray(TB_DebugType*) types;
+} ImageWriter;
+
+static void image_align(TB_Emitter* e, size_t align) {
+    size_t pad = (align - (e->count & (align - 1))) & (align - 1);
+    if (pad) tb_out_zero(e, pad);
+}
+
+// 0 is NULL, the data section starts with a zero byte so nothing else lands there
+static uint32_t image_str(ImageWriter* w, const char* str) {
+    if (str == NULL) return 0;
+
+    size_t pos = tb_outs(&w->data, strlen(str) + 1, str);
+    assert(pos == (uint32_t) pos && "image data is too big");
+    return pos;
+}
+
+static uint32_t image_blob(ImageWriter* w, size_t len, const void* data) {
+    image_align(&w->data, 16);
+    size_t pos = len ? tb_outs(&w->data, len, data) : w->data.count;
+    assert(pos == (uint32_t) pos && "image data is too big");
+    return pos;
+}
+
+static uint32_t image_id(ImageWriter* w, const void* ptr) {
+    ptrdiff_t search = nl_map_get(w->ids, ptr);
+    return search >= 0 ? w->ids[search].v : 0;
+}
+
+#define IMAGE_INTERN(name, T, list)             \
+static uint32_t name(ImageWriter* w, T* ptr) {  \
+    if (ptr == NULL) return 0;                  \
+    uint32_t id = image_id(w, ptr);             \
+    if (id == 0) {                              \
+        dyn_array_put(w->list, ptr);            \
+        id = dyn_array_length(w->list);         \
+        nl_map_put(w->ids, ptr, id);            \
+    }                                           \
+    return id;                                  \
+}
+
+IMAGE_INTERN(image_proto, TB_FunctionPrototype, protos)
+IMAGE_INTERN(image_file,  TB_SourceFile,        files)
+IMAGE_INTERN(image_type,  TB_DebugType,         types)
+#undef IMAGE_INTERN
+
+static void image_push_node(Worklist* ws, TB_Node* n) {
+    if (n != NULL) worklist_push(ws, n);
+}
+
+// everything reachable from the terminators & the params
+static void image_walk(TB_Function* f, Worklist* ws) {
+    dyn_array_for(i, f->terminators) {
+        worklist_push(ws, f->terminators[i]);
+    }
+
+    image_push_node(ws, f->start_node);
+    image_push_node(ws, f->stop_node);
+    FOREACH_N(i, 0, 3 + f->param_count) {
+        image_push_node(ws, f->params[i]);
+    }
+
+    for (size_t i = 0; i < dyn_array_length(ws->items); i++) {
+        TB_Node* n = ws->items[i];
+        FOREACH_N(j, 0, n->input_count) {
+            image_push_node(ws, n->inputs[j]);
+        }
+
+        if (n->type == TB_CALL || n->type == TB_SYSCALL) {
+            TB_NodeCall* c = TB_NODE_GET_EXTRA(n);
+            FOREACH_N(j, 0, c->proj_count) {
+                image_push_node(ws, c->projs[j]);
+            }
+        } else if (n->type >= TB_ATOMIC_LOAD && n->type <= TB_ATOMIC_CAS) {
+            TB_NodeAtomic* a = TB_NODE_GET_EXTRA(n);
+            image_push_node(ws, a->proj0);
+            image_push_node(ws, a->proj1);
+        }
+    }
+}
+
+static size_t image_extra_size(TB_Node* n) {
+    if (n->type == TB_MACHINE_OP) {
+        TB_NodeMachineOp* mach = TB_NODE_GET_EXTRA(n);
+        return sizeof(TB_NodeMachineOp) + (mach->outs + mach->ins + mach->tmps) * sizeof(TB_PhysicalReg);
+    }
+
+    return extra_bytes(n);
+}
+
+static void image_write_function(ImageWriter* w, TB_Function* f) {
+    assert(f->output == NULL && "modules can only be serialized before codegen");
+
+    size_t header_pos = tb_out_grab_i(&w->out, sizeof(ImageFunction));
+    ImageFunction func = {
+        .section  = f->section,
+        .linkage  = f->linkage,
+        .dbg_type = image_type(w, f->dbg_type),
+        .proto    = image_proto(w, f->prototype),
+        .has_body = f->prototype != NULL && f->terminators != NULL,
+    };
+
+    if (!func.has_body) {
+        memcpy(tb_out_get(&w->out, header_pos), &func, sizeof(func));
+        return;
+    }
+
+    Worklist ws = { 0 };
+    worklist_alloc(&ws, f->node_count);
+    image_walk(f, &ws);
+
+    // node index + 1, 0 if it's not part of the graph we're storing
+    size_t node_count = dyn_array_length(ws.items);
+    uint32_t* ids = tb_platform_heap_alloc(f->node_count * sizeof(uint32_t));
+    memset(ids, 0, f->node_count * sizeof(uint32_t));
+    FOREACH_N(i, 0, node_count) {
+        ids[ws.items[i]->gvn] = i + 1;
+    }
+
+    #define NODE_ID(n) ((n) != NULL && ids[(n)->gvn] && ws.items[ids[(n)->gvn] - 1] == (n) ? ids[(n)->gvn] : 0)
+
+    func.param_count = f->param_count;
+    func.node_count = node_count;
+    func.gvn_count = f->node_count;
+    func.terminator_count = dyn_array_length(f->terminators);
+    func.start = NODE_ID(f->start_node);
+    func.stop = NODE_ID(f->stop_node);
+    func.has_param_ranges = f->param_ranges != NULL;
+    memcpy(tb_out_get(&w->out, header_pos), &func, sizeof(func));
+
+    FOREACH_N(i, 0, 3 + f->param_count) {
+        tb_out4b(&w->out, NODE_ID(f->params[i]));
+    }
+
+    dyn_array_for(i, f->terminators) {
+        tb_out4b(&w->out, NODE_ID(f->terminators[i]));
+    }
+    image_align(&w->out, 8);
+
+    if (f->param_ranges) {
+        tb_outs(&w->out, f->param_count * sizeof(TB_ParamRange), f->param_ranges);
+        image_align(&w->out, 8);
+    }
+
+    FOREACH_N(i, 0, node_count) {
+        TB_Node* n = ws.items[i];
+
+        ptrdiff_t search = nl_map_get(f->attribs, n);
+        DynArray(TB_Attrib) attribs = search >= 0 ? f->attribs[search].v : NULL;
+
+        size_t extra_size = image_extra_size(n);
+        ImageNode node = {
+            .type = n->type,
+            .input_count = n->input_count,
+            .dt = n->dt.raw,
+            .attrib_count = dyn_array_length(attribs),
+            .gvn = n->gvn,
+            .extra_size = extra_size,
+        };
+        tb_outs(&w->out, sizeof(node), &node);
+
+        FOREACH_N(j, 0, n->input_count) {
+            tb_out4b(&w->out, NODE_ID(n->inputs[j]));
+        }
+        image_align(&w->out, 8);
+
+        // swap the pointers in the extras for IDs
+        uint8_t* extra = tb_out_reserve(&w->out, extra_size);
+        memcpy(extra, n->extra, extra_size);
+        switch (n->type) {
+            case TB_SYMBOL: {
+                TB_NodeSymbol* s = (TB_NodeSymbol*) extra;
+                s->sym = IMAGE_REF(image_id(w, s->sym));
+                break;
+            }
+
+            case TB_CALL:
+            case TB_SYSCALL: {
+                TB_NodeCall* c = (TB_NodeCall*) extra;
+                c->proto = IMAGE_REF(image_proto(w, c->proto));
+                FOREACH_N(j, 0, c->proj_count) {
+                    c->projs[j] = IMAGE_REF(NODE_ID(c->projs[j]));
+                }
+                break;
+            }
+
+            case TB_TAILCALL: {
+                TB_NodeTailcall* c = (TB_NodeTailcall*) extra;
+                c->proto = IMAGE_REF(image_proto(w, c->proto));
+                break;
+            }
+
+            case TB_START:
+            case TB_REGION: {
+                TB_NodeRegion* r = (TB_NodeRegion*) extra;
+                r->tag = IMAGE_REF(image_str(w, r->tag));
+                r->mem_in = IMAGE_REF(NODE_ID(r->mem_in));
+                r->mem_out = IMAGE_REF(NODE_ID(r->mem_out));
+                break;
+            }
+
+            case TB_ATOMIC_LOAD:
+            case TB_ATOMIC_XCHG:
+            case TB_ATOMIC_ADD:
+            case TB_ATOMIC_SUB:
+            case TB_ATOMIC_AND:
+            case TB_ATOMIC_XOR:
+            case TB_ATOMIC_OR:
+            case TB_ATOMIC_CAS: {
+                TB_NodeAtomic* a = (TB_NodeAtomic*) extra;
+                a->proj0 = IMAGE_REF(NODE_ID(a->proj0));
+                a->proj1 = IMAGE_REF(NODE_ID(a->proj1));
+                break;
+            }
+
+            case TB_SAFEPOINT_NOP:
+            case TB_SAFEPOINT_POLL: {
+                TB_NodeSafepoint* sp = (TB_NodeSafepoint*) extra;
+                sp->file = IMAGE_REF(image_file(w, sp->file));
+                break;
+            }
+
+            case TB_MACHINE_OP: {
+                TB_NodeMachineOp* mach = (TB_NodeMachineOp*) extra;
+                mach->data = IMAGE_REF(image_blob(w, mach->length, mach->data));
+                break;
+            }
+
+            default: break;
+        }
+        tb_out_commit(&w->out, extra_size);
+        image_align(&w->out, 8);
+
+        dyn_array_for(j, attribs) {
+            TB_Attrib* a = &attribs[j];
+            ImageAttrib attrib = { .tag = a->tag };
+            if (a->tag == TB_ATTRIB_VARIABLE) {
+                attrib.parent = NODE_ID(a->var.parent);
+                attrib.name = image_str(w, a->var.name);
+                attrib.storage = image_type(w, a->var.storage);
+            } else {
+                attrib.parent = NODE_ID(a->scope.parent);
+            }
+            tb_outs(&w->out, sizeof(attrib), &attrib);
+        }
+    }
+    #undef NODE_ID
+
+    tb_platform_heap_free(ids);
+    worklist_free(&ws);
+}
+
+static void image_write_symbol(ImageWriter* w, TB_Symbol* s) {
+    size_t start = tb_out_grab_i(&w->out, sizeof(ImageSymbol));
+
+    switch (s->tag) {
+        case TB_SYMBOL_EXTERNAL: {
+            TB_External* e = (TB_External*) s;
+            ImageExternal ext = { .type = e->type };
+            tb_outs(&w->out, sizeof(ext), &ext);
+            break;
+        }
+
+        case TB_SYMBOL_GLOBAL: {
+            TB_Global* g = (TB_Global*) s;
+            ImageGlobal global = {
+                .linkage = g->linkage, .parent = g->parent,
+                .size = g->size, .align = g->align,
+                .dbg_type = image_type(w, g->dbg_type),
+                .obj_count = g->obj_count,
+            };
+            tb_outs(&w->out, sizeof(global), &global);
+
+            FOREACH_N(i, 0, g->obj_count) {
+                TB_InitObj* o = &g->objects[i];
+                ImageInitObj obj = { .type = o->type, .offset = o->offset };
+                if (o->type == TB_INIT_OBJ_REGION) {
+                    obj.size = o->region.size;
+                    obj.ref = image_blob(w, o->region.size, o->region.ptr);
+                } else {
+                    obj.ref = image_id(w, o->reloc);
+                }
+                tb_outs(&w->out, sizeof(obj), &obj);
+            }
+            break;
+        }
+
+        case TB_SYMBOL_FUNCTION:
+        image_write_function(w, (TB_Function*) s);
+        break;
+
+        default: tb_todo();
+    }
+    image_align(&w->out, 8);
+
+    ImageSymbol sym = {
+        .size = w->out.count - start,
+        .tag = s->tag,
+        .name = image_str(w, s->name),
+        .flags = s == w->m->chkstk_extern ? IMAGE_SYMBOL_CHKSTK : 0,
+        .ordinal = s->ordinal,
+    };
+    memcpy(tb_out_get(&w->out, start), &sym, sizeof(sym));
+}
+
+static void image_write_type(ImageWriter* w, TB_DebugType* t) {
+    ImageDebugType type = { .tag = t->tag };
+    DynArray(TB_DebugType*) refs = NULL;
+
+    switch (t->tag) {
+        case TB_DEBUG_TYPE_VOID:
+        case TB_DEBUG_TYPE_BOOL:
+        break;
+
+        case TB_DEBUG_TYPE_UINT:
+        case TB_DEBUG_TYPE_INT:
+        type.value = t->int_bits;
+        break;
+
+        case TB_DEBUG_TYPE_FLOAT:
+        type.value = t->float_fmt;
+        break;
+
+        case TB_DEBUG_TYPE_ARRAY:
+        type.base = image_type(w, t->array.base);
+        type.array_count = t->array.count;
+        break;
+
+        case TB_DEBUG_TYPE_POINTER:
+        type.base = image_type(w, t->ptr_to);
+        break;
+
+        case TB_DEBUG_TYPE_ALIAS:
+        type.name = image_str(w, t->alias.name);
+        type.base = image_type(w, t->alias.type);
+        break;
+
+        case TB_DEBUG_TYPE_FIELD:
+        type.name = image_str(w, t->field.name);
+        type.value = t->field.offset;
+        type.base = image_type(w, t->field.type);
+        break;
+
+        case TB_DEBUG_TYPE_STRUCT:
+        case TB_DEBUG_TYPE_UNION:
+        type.name = image_str(w, t->record.tag);
+        type.value = t->record.size;
+        type.align = t->record.align;
+        type.count = t->record.count;
+        FOREACH_N(i, 0, t->record.count) {
+            dyn_array_put(refs, t->record.members[i]);
+        }
+        break;
+
+        case TB_DEBUG_TYPE_FUNCTION:
+        type.value = t->func.cc;
+        type.align = t->func.has_varargs;
+        type.count = t->func.param_count;
+        type.extra = t->func.return_count;
+        FOREACH_N(i, 0, t->func.param_count) {
+            dyn_array_put(refs, t->func.params[i]);
+        }
+        FOREACH_N(i, 0, t->func.return_count) {
+            dyn_array_put(refs, t->func.returns[i]);
+        }
+        break;
+
+        default: tb_todo();
+    }
+
+    tb_outs(&w->out, sizeof(type), &type);
+    dyn_array_for(i, refs) {
+        tb_out4b(&w->out, image_type(w, refs[i]));
+    }
+    image_align(&w->out, 8);
+    dyn_array_destroy(refs);
+}
+
+TB_ExportBuffer tb_module_serialize(TB_Module* m) {
+    ImageWriter w = { .m = m };
+    ImageHeader header = image_header;
+    header.arch = m->target_arch;
+    header.system = m->target_system;
+    header.features = m->features;
+
+    CUIK_TIMED_BLOCK("serialize module") {
+        tb_out1b(&w.data, 0);
+        tb_out_grab_i(&w.out, sizeof(ImageHeader));
+
+        // symbols are numbered up front since the graphs refer to each other
+        DynArray(TB_Symbol*) syms = NULL;
+        TB_Symbol* s;
+        for (TB_SymbolIter it = tb_symbol_iter(m); s = tb_symbol_iter_next(&it), s;) {
+            dyn_array_put(syms, s);
+            nl_map_put(w.ids, s, dyn_array_length(syms));
+        }
+
+        header.symbol_count = dyn_array_length(syms);
+        header.symbols = w.out.count;
+        dyn_array_for(i, syms) {
+            image_write_symbol(&w, syms[i]);
+        }
+        header.tls_index = image_id(&w, m->tls_index_extern);
+        dyn_array_destroy(syms);
+
+        header.protos = w.out.count;
+        dyn_array_for(i, w.protos) {
+            TB_FunctionPrototype* p = w.protos[i];
+            ImageProto proto = {
+                .call_conv = p->call_conv,
+                .return_count = p->return_count,
+                .param_count = p->param_count,
+                .has_varargs = p->has_varargs,
+            };
+            tb_outs(&w.out, sizeof(proto), &proto);
+
+            FOREACH_N(j, 0, p->param_count + p->return_count) {
+                ImageParam param = {
+                    .dt = p->params[j].dt.raw,
+                    .debug_type = image_type(&w, p->params[j].debug_type),
+                    .name = image_str(&w, p->params[j].name),
+                };
+                tb_outs(&w.out, sizeof(param), &param);
+            }
+        }
+        header.proto_count = dyn_array_length(w.protos);
+
+        header.files = w.out.count;
+        dyn_array_for(i, w.files) {
+            ImageFile file = { .path = image_blob(&w, w.files[i]->len, w.files[i]->path), .len = w.files[i]->len };
+            tb_outs(&w.out, sizeof(file), &file);
+        }
+        header.file_count = dyn_array_length(w.files);
+
+        header.sections = w.out.count;
+        dyn_array_for(i, m->sections) {
+            TB_ModuleSection* sec = &m->sections[i];
+            ImageSection section = {
+                .name = image_str(&w, sec->name),
+                .flags = sec->flags,
+                .comdat = sec->comdat.type,
+            };
+            tb_outs(&w.out, sizeof(section), &section);
+        }
+        header.section_count = dyn_array_length(m->sections);
+
+        // this one grows as we go, types refer to more types
+        header.types = w.out.count;
+        for (size_t i = 0; i < dyn_array_length(w.types); i++) {
+            image_write_type(&w, w.types[i]);
+        }
+        header.type_count = dyn_array_length(w.types);
+
+        image_align(&w.out, 16);
+        header.data = w.out.count;
+        memcpy(w.out.data, &header, sizeof(header));
+    }
+
+    TB_ExportChunk* chunk = tb_export_make_chunk(w.out.count + w.data.count);
+    memcpy(chunk->data, w.out.data, w.out.count);
+    memcpy(chunk->data + w.out.count, w.data.data, w.data.count);
+
+    TB_ExportBuffer buffer = { 0 };
+    tb_export_append_chunk(&buffer, chunk);
+
+    tb_platform_heap_free(w.out.data);
+    tb_platform_heap_free(w.data.data);
+    dyn_array_destroy(w.protos);
+    dyn_array_destroy(w.files);
+    dyn_array_destroy(w.types);
+    nl_map_free(w.ids);
+    return buffer;
+}
+
+////////////////////////////////
+// Loader
+////////////////////////////////
+typedef struct {
+    TB_Module* m;
+    TB_ModuleImage* image;
+    const uint8_t* base;
+    const char* data;
+
+    TB_Symbol** syms;
+    TB_FunctionPrototype** protos;
+    TB_SourceFile** files;
+    TB_DebugType** types;
+} ImageReader;
+
+static const char* image_get_str(ImageReader* r, uint32_t pos) {
+    return pos ? r->data + pos : NULL;
+}
+
+static size_t image_align_up(size_t x) {
+    return (x + 7) & ~(size_t) 7;
+}
+
+#define IMAGE_GET(list, id) ((id) ? (list)[(id) - 1] : NULL)
+
+static const uint8_t* image_read_function(ImageReader* r, TB_Function* f, const uint8_t* p) {
+    const ImageFunction* func = (const ImageFunction*) p;
+    p += sizeof(ImageFunction);
+
+    f->section = func->section;
+    f->linkage = func->linkage;
+    f->dbg_type = IMAGE_GET(r->types, func->dbg_type);
+    f->prototype = IMAGE_GET(r->protos, func->proto);
+    if (!func->has_body) {
+        return p;
+    }
+
+    f->arena = &r->image->arena;
+
+    const uint32_t* params = (const uint32_t*) p;
+    const uint32_t* terms = params + 3 + func->param_count;
+    p += image_align_up((3 + func->param_count + func->terminator_count) * sizeof(uint32_t));
+
+    if (func->has_param_ranges) {
+        f->param_ranges = tb_arena_alloc(f->arena, func->param_count * sizeof(TB_ParamRange));
+        memcpy(f->param_ranges, p, func->param_count * sizeof(TB_ParamRange));
+        p += image_align_up(func->param_count * sizeof(TB_ParamRange));
+    }
+
+    // make all the nodes first, the edges can point forwards
+    TB_Node** nodes = tb_platform_heap_alloc(func->node_count * sizeof(TB_Node*));
+    const ImageNode** records = tb_platform_heap_alloc(func->node_count * sizeof(ImageNode*));
+    FOREACH_N(i, 0, func->node_count) {
+        const ImageNode* node = (const ImageNode*) p;
+        TB_Node* n = tb_alloc_node(f, node->type, (TB_DataType){ .raw = node->dt }, node->input_count, node->extra_size);
+        n->gvn = node->gvn;
+
+        p += sizeof(ImageNode) + image_align_up(node->input_count * sizeof(uint32_t));
+        memcpy(n->extra, p, node->extra_size);
+        p += image_align_up(node->extra_size);
+        p += node->attrib_count * sizeof(ImageAttrib);
+
+        nodes[i] = n;
+        records[i] = node;
+    }
+
+    #define NODE_GET(id) IMAGE_GET(nodes, id)
+    FOREACH_N(i, 0, func->node_count) {
+        TB_Node* n = nodes[i];
+        const ImageNode* node = records[i];
+
+        const uint32_t* inputs = (const uint32_t*) (node + 1);
+        FOREACH_N(j, 0, n->input_count) {
+            n->inputs[j] = NODE_GET(inputs[j]);
+        }
+
+        switch (n->type) {
+            case TB_SYMBOL: {
+                TB_NodeSymbol* s = TB_NODE_GET_EXTRA(n);
+                s->sym = IMAGE_GET(r->syms, IMAGE_REF_ID(s->sym));
+                break;
+            }
+
+            case TB_CALL:
+            case TB_SYSCALL: {
+                TB_NodeCall* c = TB_NODE_GET_EXTRA(n);
+                c->proto = IMAGE_GET(r->protos, IMAGE_REF_ID(c->proto));
+                FOREACH_N(j, 0, c->proj_count) {
+                    c->projs[j] = NODE_GET(IMAGE_REF_ID(c->projs[j]));
+                }
+                break;
+            }
+
+            case TB_TAILCALL: {
+                TB_NodeTailcall* c = TB_NODE_GET_EXTRA(n);
+                c->proto = IMAGE_GET(r->protos, IMAGE_REF_ID(c->proto));
+                break;
+            }
+
+            case TB_START:
+            case TB_REGION: {
+                TB_NodeRegion* region = TB_NODE_GET_EXTRA(n);
+                region->tag = image_get_str(r, IMAGE_REF_ID(region->tag));
+                region->mem_in = NODE_GET(IMAGE_REF_ID(region->mem_in));
+                region->mem_out = NODE_GET(IMAGE_REF_ID(region->mem_out));
+                break;
+            }
+
+            case TB_ATOMIC_LOAD:
+            case TB_ATOMIC_XCHG:
+            case TB_ATOMIC_ADD:
+            case TB_ATOMIC_SUB:
+            case TB_ATOMIC_AND:
+            case TB_ATOMIC_XOR:
+            case TB_ATOMIC_OR:
+            case TB_ATOMIC_CAS: {
+                TB_NodeAtomic* a = TB_NODE_GET_EXTRA(n);
+                a->proj0 = NODE_GET(IMAGE_REF_ID(a->proj0));
+                a->proj1 = NODE_GET(IMAGE_REF_ID(a->proj1));
+                break;
+            }
+
+            case TB_SAFEPOINT_NOP:
+            case TB_SAFEPOINT_POLL: {
+                TB_NodeSafepoint* sp = TB_NODE_GET_EXTRA(n);
+                sp->file = IMAGE_GET(r->files, IMAGE_REF_ID(sp->file));
+                break;
+            }
+
+            case TB_MACHINE_OP: {
+                TB_NodeMachineOp* mach = TB_NODE_GET_EXTRA(n);
+                mach->data = (const uint8_t*) r->data + IMAGE_REF_ID(mach->data);
+                break;
+            }
+
+            default: break;
+        }
+
+        const ImageAttrib* attribs = (const ImageAttrib*) ((const uint8_t*) inputs + image_align_up(n->input_count * sizeof(uint32_t)) + image_align_up(node->extra_size));
+        FOREACH_N(j, 0, node->attrib_count) {
+            TB_Attrib a = { .tag = attribs[j].tag };
+            if (a.tag == TB_ATTRIB_VARIABLE) {
+                a.var.parent = NODE_GET(attribs[j].parent);
+                a.var.name = (char*) image_get_str(r, attribs[j].name);
+                a.var.storage = IMAGE_GET(r->types, attribs[j].storage);
+            } else {
+                a.scope.parent = NODE_GET(attribs[j].parent);
+            }
+            append_attrib(f, n, a);
+        }
+    }
+
+    f->start_node = NODE_GET(func->start);
+    f->stop_node = NODE_GET(func->stop);
+    f->node_count = func->gvn_count;
+
+    f->param_count = func->param_count;
+    f->params = tb_arena_alloc(f->arena, (3 + func->param_count) * sizeof(TB_Node*));
+    FOREACH_N(i, 0, 3 + func->param_count) {
+        f->params[i] = NODE_GET(params[i]);
+    }
+
+    f->terminators = dyn_array_create(TB_Node*, func->terminator_count);
+    FOREACH_N(i, 0, func->terminator_count) {
+        dyn_array_put(f->terminators, NODE_GET(terms[i]));
+    }
+    #undef NODE_GET
+
+    tb_platform_heap_free(records);
+    tb_platform_heap_free(nodes);
+    return p;
+}
+
+static void image_read_types(ImageReader* r, const ImageHeader* header) {
+    TB_Module* m = r->m;
+
+    // allocate them first, they can be cyclic
+    const ImageDebugType** records = tb_platform_heap_alloc(header->type_count * sizeof(ImageDebugType*));
+    const uint8_t* p = r->base + header->types;
+    FOREACH_N(i, 0, header->type_count) {
+        const ImageDebugType* type = (const ImageDebugType*) p;
+        p += sizeof(ImageDebugType) + image_align_up((type->count + type->extra) * sizeof(uint32_t));
+        records[i] = type;
+
+        // the builtin types are shared
+        switch (type->tag) {
+            case TB_DEBUG_TYPE_VOID:  r->types[i] = tb_debug_get_void(m); break;
+            case TB_DEBUG_TYPE_BOOL:  r->types[i] = tb_debug_get_bool(m); break;
+            case TB_DEBUG_TYPE_UINT:  r->types[i] = tb_debug_get_integer(m, false, type->value); break;
+            case TB_DEBUG_TYPE_INT:   r->types[i] = tb_debug_get_integer(m, true, type->value); break;
+            case TB_DEBUG_TYPE_FLOAT: r->types[i] = tb_debug_get_float(m, type->value); break;
+
+            default:
+            r->types[i] = tb_arena_alloc(get_permanent_arena(m), sizeof(TB_DebugType));
+            *r->types[i] = (TB_DebugType){ .tag = type->tag };
+            break;
+        }
+    }
+
+    FOREACH_N(i, 0, header->type_count) {
+        const ImageDebugType* type = records[i];
+        const uint32_t* refs = (const uint32_t*) (type + 1);
+        TB_DebugType* t = r->types[i];
+
+        switch (type->tag) {
+            case TB_DEBUG_TYPE_ARRAY:
+            t->array.base = IMAGE_GET(r->types, type->base);
+            t->array.count = type->array_count;
+            break;
+
+            case TB_DEBUG_TYPE_POINTER:
+            t->ptr_to = IMAGE_GET(r->types, type->base);
+            break;
+
+            case TB_DEBUG_TYPE_ALIAS:
+            t->alias.name = (char*) image_get_str(r, type->name);
+            t->alias.type = IMAGE_GET(r->types, type->base);
+            break;
+
+            case TB_DEBUG_TYPE_FIELD:
+            t->field.name = (char*) image_get_str(r, type->name);
+            t->field.offset = type->value;
+            t->field.type = IMAGE_GET(r->types, type->base);
+            break;
+
+            case TB_DEBUG_TYPE_STRUCT:
+            case TB_DEBUG_TYPE_UNION:
+            t->record.tag = (char*) image_get_str(r, type->name);
+            t->record.size = type->value;
+            t->record.align = type->align;
+            t->record.count = type->count;
+            t->record.members = TB_ARENA_ARR_ALLOC(get_permanent_arena(m), type->count, TB_DebugType*);
+            FOREACH_N(j, 0, type->count) {
+                t->record.members[j] = IMAGE_GET(r->types, refs[j]);
+            }
+            break;
+
+            case TB_DEBUG_TYPE_FUNCTION:
+            t->func.cc = type->value;
+            t->func.has_varargs = type->align;
+            t->func.param_count = type->count;
+            t->func.return_count = type->extra;
+            t->func.params = TB_ARENA_ARR_ALLOC(get_permanent_arena(m), type->count + type->extra, TB_DebugType*);
+            t->func.returns = t->func.params + type->count;
+            FOREACH_N(j, 0, type->count + type->extra) {
+                t->func.params[j] = IMAGE_GET(r->types, refs[j]);
+            }
+            break;
+
+            default: break;
+        }
+    }
+
+    tb_platform_heap_free(records);
+}
+
+static bool image_read(ImageReader* r, const ImageHeader* header) {
+    TB_Module* m = r->m;
+
+    // sections past the default ones
+    const ImageSection* sections = (const ImageSection*) (r->base + header->sections);
+    if (!m->is_jit) {
+        FOREACH_N(i, dyn_array_length(m->sections), header->section_count) {
+            tb_module_create_section(m, -1, image_get_str(r, sections[i].name), sections[i].flags, sections[i].comdat);
+        }
+    }
+
+    const ImageFile* files = (const ImageFile*) (r->base + header->files);
+    FOREACH_N(i, 0, header->file_count) {
+        // tb_get_source_file wants a C string
+        char* path = tb_platform_heap_alloc(files[i].len + 1);
+        memcpy(path, r->data + files[i].path, files[i].len);
+        path[files[i].len] = 0;
+
+        r->files[i] = tb_get_source_file(m, path);
+        tb_platform_heap_free(path);
+    }
+
+    image_read_types(r, header);
+
+    const uint8_t* p = r->base + header->protos;
+    FOREACH_N(i, 0, header->proto_count) {
+        const ImageProto* proto = (const ImageProto*) p;
+        const ImageParam* params = (const ImageParam*) (proto + 1);
+        size_t count = proto->param_count + proto->return_count;
+        p += sizeof(ImageProto) + count*sizeof(ImageParam);
+
+        TB_FunctionPrototype* fp = tb_arena_alloc(get_permanent_arena(m), sizeof(TB_FunctionPrototype) + count*sizeof(TB_PrototypeParam));
+        fp->call_conv = proto->call_conv;
+        fp->return_count = proto->return_count;
+        fp->param_count = proto->param_count;
+        fp->has_varargs = proto->has_varargs;
+        FOREACH_N(j, 0, count) {
+            fp->params[j] = (TB_PrototypeParam){
+                .dt = { .raw = params[j].dt },
+                .debug_type = IMAGE_GET(r->types, params[j].debug_type),
+                .name = image_get_str(r, params[j].name),
+            };
+        }
+        r->protos[i] = fp;
+    }
+
+    // make all the symbols, the bodies refer to each other
+    p = r->base + header->symbols;
+    FOREACH_N(i, 0, header->symbol_count) {
+        const ImageSymbol* sym = (const ImageSymbol*) p;
+        p += sym->size;
+
+        TB_Symbol* s = NULL;
+        switch (sym->tag) {
+            case TB_SYMBOL_EXTERNAL: {
+                if ((sym->flags & IMAGE_SYMBOL_CHKSTK) && m->chkstk_extern) {
+                    s = m->chkstk_extern;
+                    break;
+                }
+
+                const ImageExternal* ext = (const ImageExternal*) (sym + 1);
+                s = (TB_Symbol*) tb_extern_create(m, 0, "", ext->type);
+                break;
+            }
+
+            case TB_SYMBOL_GLOBAL:
+            s = (TB_Symbol*) tb_global_create(m, 0, NULL, NULL, TB_LINKAGE_PRIVATE);
+            break;
+
+            case TB_SYMBOL_FUNCTION:
+            s = (TB_Symbol*) tb_function_create(m, 0, NULL, TB_LINKAGE_PRIVATE);
+            break;
+
+            default:
+            fprintf(stderr, "\x1b[31merror\x1b[0m: bad symbol in module image\n");
+            return false;
+        }
+
+        // names live in the mapping
+        s->name = (char*) image_get_str(r, sym->name);
+        s->ordinal = sym->ordinal;
+        r->syms[i] = s;
+    }
+
+    p = r->base + header->symbols;
+    FOREACH_N(i, 0, header->symbol_count) {
+        const ImageSymbol* sym = (const ImageSymbol*) p;
+        TB_Symbol* s = r->syms[i];
+        p += sym->size;
+
+        if (s->tag == TB_SYMBOL_GLOBAL) {
+            const ImageGlobal* global = (const ImageGlobal*) (sym + 1);
+            const ImageInitObj* objs = (const ImageInitObj*) (global + 1);
+
+            TB_Global* g = (TB_Global*) s;
+            g->linkage = global->linkage;
+            g->parent = global->parent;
+            g->size = global->size;
+            g->align = global->align;
+            g->dbg_type = IMAGE_GET(r->types, global->dbg_type);
+            g->obj_count = g->obj_capacity = global->obj_count;
+            g->objects = TB_ARENA_ARR_ALLOC(get_permanent_arena(m), global->obj_count, TB_InitObj);
+            FOREACH_N(j, 0, global->obj_count) {
+                TB_InitObj* o = &g->objects[j];
+                o->type = objs[j].type;
+                o->offset = objs[j].offset;
+                if (o->type == TB_INIT_OBJ_REGION) {
+                    o->region.size = objs[j].size;
+                    o->region.ptr = r->data + objs[j].ref;
+                } else {
+                    o->reloc = IMAGE_GET(r->syms, objs[j].ref);
+                }
+            }
+        } else if (s->tag == TB_SYMBOL_FUNCTION) {
+            image_read_function(r, (TB_Function*) s, (const uint8_t*) (sym + 1));
+        }
+    }
+
+    if (header->tls_index) {
+        atomic_flag_test_and_set(&m->is_tls_defined);
+        m->tls_index_extern = r->syms[header->tls_index - 1];
+    }
+
+    return true;
+}
+
+TB_Module* tb_module_deserialize(const char* path, TB_Arch arch, TB_System sys, bool is_jit) {
+    FileMap file = open_file_map(path);
+    if (file.data == NULL) {
+        fprintf(stderr, "\x1b[31merror\x1b[0m: could not open module image! %s\n", path);
+        return NULL;
+    }
+
+    const ImageHeader* header = file.data;
+    if (file.size < sizeof(ImageHeader) || memcmp(header, &image_header, offsetof(ImageHeader, arch)) != 0) {
+        fprintf(stderr, "\x1b[31merror\x1b[0m: %s was not made by this build of TB\n", path);
+        close_file_map(&file);
+        return NULL;
+    }
+
+    if (header->arch != arch || header->system != sys || header->data > file.size) {
+        fprintf(stderr, "\x1b[31merror\x1b[0m: %s was made for a different target\n", path);
+        close_file_map(&file);
+        return NULL;
+    }
+
+    TB_Module* m = tb_module_create(arch, sys, &header->features, is_jit);
+    TB_ModuleImage* image = tb_platform_heap_alloc(sizeof(TB_ModuleImage));
+    image->file = file;
+    tb_arena_create(&image->arena, TB_ARENA_LARGE_CHUNK_SIZE);
+    m->image = image;
+
+    ImageReader r = {
+        .m = m,
+        .image = image,
+        .base = file.data,
+        .data = (const char*) file.data + header->data,
+        .syms = tb_platform_heap_alloc(header->symbol_count * sizeof(TB_Symbol*)),
+        .protos = tb_platform_heap_alloc(header->proto_count * sizeof(TB_FunctionPrototype*)),
+        .files = tb_platform_heap_alloc(header->file_count * sizeof(TB_SourceFile*)),
+        .types = tb_platform_heap_alloc(header->type_count * sizeof(TB_DebugType*)),
+    };
+
+    bool ok;
+    CUIK_TIMED_BLOCK_ARGS("deserialize module", path) {
+        ok = image_read(&r, header);
+    }
+
+    tb_platform_heap_free(r.syms);
+    tb_platform_heap_free(r.protos);
+    tb_platform_heap_free(r.files);
+    tb_platform_heap_free(r.types);
+
+    if (!ok) {
+        tb_module_destroy(m);
+        return NULL;
+    }
+
+    return m;
+}
+
+void tb__module_image_free(TB_Module* m) {
+    if (m->image != NULL) {
+        tb_arena_destroy(&m->image->arena);
+        close_file_map(&m->image->file);
+        tb_platform_heap_free(m->image);
+        m->image = NULL;
+    }
+}
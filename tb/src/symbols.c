@@ -7,7 +7,7 @@ TB_SymbolIter tb_symbol_iter(TB_Module* mod) {
 
 TB_Symbol* tb_symbol_iter_next(TB_SymbolIter* iter) {
     for (TB_ThreadInfo* info = iter->info; info != NULL; info = info->next_in_module) {
-        size_t cap = 1ull << info->symbols.exp;
+        size_t cap = info->symbols.data ? 1ull << info->symbols.exp : 0;
         for (size_t i = iter->i; i < cap; i++) {
             void* ptr = info->symbols.data[i];
             if (ptr == NULL) continue;
@@ -17,12 +17,25 @@ TB_Symbol* tb_symbol_iter_next(TB_SymbolIter* iter) {
             iter->info = info;
             return (TB_Symbol*) ptr;
         }
+
+        iter->i = 0;
     }
 
+    iter->info = NULL;
+
     return NULL;
 }
 
 void tb_module_kill_symbol(TB_Module* m, TB_Symbol* sym) {
+    TB_ThreadInfo* info = sym->info;
+
+    mtx_lock(&info->symbol_lock);
+    bool removed = nl_hashset_remove(&info->symbols, sym);
+    mtx_unlock(&info->symbol_lock);
+
+    if (removed) {
+        atomic_fetch_sub(&m->symbol_count[sym->tag], 1);
+    }
 }
 
 void tb_symbol_append(TB_Module* m, TB_Symbol* s) {
@@ -26,7 +26,11 @@ TB_ThreadInfo* tb_thread_info(TB_Module* m) {
         info = info->next;
     }
 
+    // lives as long as the module, not whatever heap the caller is in
+    Cuik_Heap* old_heap = cuik_heap_enter(NULL);
     info = tb_platform_heap_alloc(sizeof(TB_ThreadInfo));
+    cuik_heap_enter(old_heap);
+
     *info = (TB_ThreadInfo){ .owner = m, .chain = &chain, .lock = &lock };
 
     // allocate memory for it
@@ -217,6 +221,37 @@ TB_FunctionOutput* tb_pass_codegen(TB_Passes* p, bool emit_asm) {
     return func_out;
 }
 
+// for machine code which didn't come out of the code generator (code cache), the
+// bytes are placed right after the TB_FunctionOutput.
+TB_FunctionOutput* tb__alloc_function_output(TB_Function* f, size_t code_size) {
+    TB_ThreadInfo* info = tb_thread_info(f->super.module);
+    TB_CodeRegion* region = get_or_allocate_code_region(info);
+
+    size_t align_mask = _Alignof(TB_FunctionOutput) - 1;
+    size_t next_size = (region->size + align_mask) & ~align_mask;
+    size_t total = sizeof(TB_FunctionOutput) + code_size;
+    if (next_size + total >= region->capacity) {
+        TB_CodeRegion* new_region = tb_platform_valloc(CODE_REGION_BUFFER_SIZE);
+        if (new_region == NULL) tb_panic("could not allocate code region!");
+
+        new_region->capacity = CODE_REGION_BUFFER_SIZE - sizeof(TB_CodeRegion);
+        new_region->prev = region;
+        info->code = region = new_region;
+        assert(total < region->capacity && "function is too big for a code region");
+    } else {
+        region->size = next_size;
+    }
+
+    TB_FunctionOutput* func_out = (TB_FunctionOutput*) &region->data[region->size];
+    region->size += total;
+
+    *func_out = (TB_FunctionOutput){
+        .parent = f, .section = f->section, .linkage = f->linkage, .code_region = region,
+        .code = (uint8_t*) &func_out[1], .code_size = code_size,
+    };
+    return func_out;
+}
+
 void tb_output_print_asm(TB_FunctionOutput* out, FILE* fp) {
     if (fp == NULL) {
         fp = stdout;
@@ -275,12 +310,17 @@ void tb_module_destroy(TB_Module* m) {
         } else {
             info->prev->next = info->next;
         }
+
+        if (info->next != NULL) {
+            info->next->prev = info->prev;
+        }
         mtx_unlock(info->lock);
 
         tb_platform_heap_free(info);
         info = next;
     }
 
+    tb__module_image_free(m);
     dyn_array_destroy(m->files);
     tb_platform_heap_free(m);
 }
@@ -360,6 +400,7 @@ void tb_function_set_prototype(TB_Function* f, TB_ModuleSectionHandle section, T
 
     f->section = section;
     f->node_count = 0;
+    f->alias_class = 0;
     f->start_node = tb_alloc_node(f, TB_START, TB_TYPE_TUPLE, 0, extra_size);
 
     f->terminators = dyn_array_create(TB_Node*, 4);
@@ -466,18 +507,22 @@ TB_Global* tb__small_data_intern(TB_Module* m, size_t len, const void* data) {
 }
 
 TB_Safepoint* tb_safepoint_get(TB_Function* f, uint32_t relative_ip) {
-    /*size_t left = 0;
-    size_t right = f->safepoint_count;
+    if (f->output == NULL) {
+        return NULL;
+    }
+
+    size_t left = 0;
+    size_t right = dyn_array_length(f->output->safepoints);
 
     uint32_t ip = relative_ip;
     const TB_SafepointKey* keys = f->output->safepoints;
     while (left < right) {
         size_t middle = (left + right) / 2;
 
-        if (keys[middle].ip == ip) return keys[left].sp;
+        if (keys[middle].ip == ip) return keys[middle].sp;
         if (keys[middle].ip < ip) left = middle + 1;
         else right = middle;
-    }*/
+    }
 
     return NULL;
 }
@@ -618,7 +663,7 @@ void tb_emit_symbol_patch(TB_FunctionOutput* func_out, const TB_Symbol* target,
 void* tb_out_reserve(TB_Emitter* o, size_t count) {
     if (o->count + count >= o->capacity) {
         if (o->capacity == 0) {
-            o->capacity = 64;
+            o->capacity = count < 64 ? 64 : count * 2;
         } else {
             o->capacity += count;
             o->capacity *= 2;
@@ -648,7 +693,7 @@ void* tb_out_grab(TB_Emitter* o, size_t count) {
 }
 
 void* tb_out_get(TB_Emitter* o, size_t pos) {
-    return &o->data[o->count];
+    return &o->data[pos];
 }
 
 size_t tb_out_grab_i(TB_Emitter* o, size_t count) {
@@ -753,6 +798,7 @@ size_t tb_outstr_nul(TB_Emitter* o, const char* str) {
     tb_out_reserve(o, len);
 
     memcpy(&o->data[o->count], str, len);
+    o->count += len;
     return start;
 }
 
@@ -209,8 +209,49 @@ void tb_get_data_type_size(TB_Module* mod, TB_DataType dt, size_t* size, size_t*
     code_gen->get_data_type_size(dt, size, align);
 }
 
+static void prof_bump(TB_Function* f, uint32_t id) {
+    TB_Node* addr = tb_inst_member_access(f, tb_inst_get_symbol_address(f, f->prof_counters), id * sizeof(uint64_t));
+    TB_Node* count = tb_inst_load(f, TB_TYPE_I64, addr, 8, false);
+    tb_inst_store(f, TB_TYPE_I64, addr, tb_inst_add(f, count, tb_inst_uint(f, TB_TYPE_I64, 1), 0), 8, false);
+}
+
+void tb_function_instrument(TB_Function* f, TB_Symbol* counters) {
+    assert(f->prototype != NULL && f->prof_slots == 0 && "call tb_function_instrument right after the prototype");
+    f->prof_counters = counters;
+    f->prof_slots = 1;
+
+    prof_bump(f, 0);
+}
+
+size_t tb_function_get_counter_count(TB_Function* f) {
+    return f->prof_slots;
+}
+
+void tb_function_set_profile(TB_Function* f, size_t count, const uint64_t* counts) {
+    assert(f->prototype != NULL && f->prof_slots == 0 && "call tb_function_set_profile right after the prototype");
+
+    // a function which never ran tells us nothing about the shape of it
+    if (count > 0 && counts[0] > 0) {
+        f->prof_counts = counts;
+        f->prof_count = count;
+        f->prof_slots = 1;
+        f->profiled = true;
+    }
+}
+
 void tb_inst_set_control(TB_Function* f, TB_Node* control) {
     f->active_control_node = control;
+
+    // the first time we start filling a region we count it, regions without any
+    // predecessors at this point are the dead code after a return or goto and we
+    // don't want their counters floating into live code.
+    if (control != NULL && control->type == TB_REGION && f->prof_counters != NULL) {
+        TB_NodeRegion* r = TB_NODE_GET_EXTRA(control);
+        if (r->prof_id != 0 && control->input_count > 0) {
+            prof_bump(f, r->prof_id);
+            r->prof_id = 0;
+        }
+    }
 }
 
 TB_Node* tb_inst_get_control(TB_Function* f) {
@@ -267,7 +308,7 @@ TB_Node* tb_inst_load(TB_Function* f, TB_DataType dt, TB_Node* addr, TB_CharUnit
     n->inputs[0] = f->active_control_node;
     n->inputs[1] = peek_mem(f, f->active_control_node);
     n->inputs[2] = addr;
-    TB_NODE_SET_EXTRA(n, TB_NodeMemAccess, .align = alignment);
+    TB_NODE_SET_EXTRA(n, TB_NodeMemAccess, .align = alignment, .alias_class = f->alias_class);
 
     if (is_volatile) {
         append_mem(f, tb__make_proj(f, TB_TYPE_MEMORY, n, 0));
@@ -285,7 +326,11 @@ void tb_inst_store(TB_Function* f, TB_DataType dt, TB_Node* addr, TB_Node* val,
     n->inputs[1] = append_mem(f, n);
     n->inputs[2] = addr;
     n->inputs[3] = val;
-    TB_NODE_SET_EXTRA(n, TB_NodeMemAccess, .align = alignment);
+    TB_NODE_SET_EXTRA(n, TB_NodeMemAccess, .align = alignment, .alias_class = f->alias_class);
+}
+
+void tb_inst_set_alias_class(TB_Function* f, int alias_class) {
+    f->alias_class = alias_class;
 }
 
 void tb_inst_memset(TB_Function* f, TB_Node* dst, TB_Node* val, TB_Node* size, TB_CharUnits align) {
@@ -836,6 +881,17 @@ TB_Node* tb_inst_region(TB_Function* f) {
     TB_NodeRegion* r = TB_NODE_GET_EXTRA(n);
     r->freq = 1.0f;
 
+    if (f->prof_slots > 0) {
+        uint32_t id = f->prof_slots++;
+        if (f->prof_counters) {
+            r->prof_id = id;
+        } else if (id < f->prof_count) {
+            // frequencies are relative to the function entry
+            float freq = (double) f->prof_counts[id] / (double) f->prof_counts[0];
+            r->freq = TB_MAX(freq, BB_LOW_FREQ);
+        }
+    }
+
     TB_Node* phi = tb_alloc_node(f, TB_PHI, TB_TYPE_MEMORY, 1, 0);
     phi->inputs[0] = n;
     r->mem_in = r->mem_out = phi;
@@ -852,6 +908,14 @@ void tb_inst_set_region_name(TB_Function* f, TB_Node* n, ptrdiff_t len, const ch
     r->tag = newstr;
 }
 
+void tb_inst_set_region_freq(TB_Function* f, TB_Node* n, float freq) {
+    // real counts beat guesses
+    if (f->profiled) return;
+
+    TB_NodeRegion* r = TB_NODE_GET_EXTRA(n);
+    r->freq = TB_MAX(freq, BB_LOW_FREQ);
+}
+
 // this has to move things which is not nice...
 static void add_input_late(TB_Function* f, TB_Node* n, TB_Node* in) {
     // detach old predecessor list, make bigger one
@@ -9,6 +9,7 @@
 #include "tb.h"
 #include "tb_formats.h"
 
+#include <float.h>
 #include <limits.h>
 #include <time.h>
 #include <stdalign.h>
@@ -52,6 +53,10 @@ for (uint64_t _bits_ = (bits), it = (start); _bits_; _bits_ >>= 1, ++it) if (_bi
 #define TB_MIN(x, y) ((x) < (y) ? (x) : (y))
 #define TB_MAX(x, y) ((x) > (y) ? (x) : (y))
 
+// the coldest a block can be, profiles which never saw a region run will
+// bottom out here.
+#define BB_LOW_FREQ 1e-4f
+
 #define PP_ARG0(a, ...) a
 #define PP_AFTER0(a, ...) __VA_ARGS__
 
@@ -237,6 +242,13 @@ struct TB_CodeRegion {
 
 typedef struct COFF_UnwindInfo COFF_UnwindInfo;
 
+// from pos onwards the code runs with (or without) the frame set up, see
+// TB_FunctionOutput.frame_changes
+typedef struct {
+    uint32_t pos;
+    bool has_frame;
+} TB_FrameChange;
+
 typedef struct TB_FunctionOutput {
     TB_Function* parent;
     TB_ModuleSectionHandle section;
@@ -246,6 +258,13 @@ typedef struct TB_FunctionOutput {
     uint64_t ordinal;
     uint8_t prologue_length;
 
+    // shrink wrapping might set up the frame somewhere after the entry, the
+    // frame changes are sorted by pos and tell the unwinders which code runs
+    // with it (the one at prologue_pos is the prologue itself). It's empty if
+    // there's no frame.
+    uint32_t prologue_pos;
+    DynArray(TB_FrameChange) frame_changes;
+
     TB_Assembly* asm_out;
     uint64_t stack_usage;
 
@@ -264,14 +283,35 @@ typedef struct TB_FunctionOutput {
     // Part of the debug info
     DynArray(TB_Location) locations;
 
+    // Stack maps, sorted by IP
+    DynArray(TB_SafepointKey) safepoints;
+
     // Relocations
     uint32_t patch_pos;
     uint32_t patch_count;
 
     TB_SymbolPatch* first_patch;
     TB_SymbolPatch* last_patch;
+
+    // the code from cold_start onwards is only for rare paths (0 if there's
+    // none) and cold_jumps are the rel32 jumps which cross between the two.
+    uint32_t cold_start;
+    DynArray(uint32_t) cold_jumps;
+
+    // export-specific, once the cold code is split off (tb_module_layout_sections)
+    // the two parts point at each other and the displacement of each cold jump
+    // is replaced with the target's offset within the other part.
+    struct TB_FunctionOutput* cold_part;
+    struct TB_FunctionOutput* hot_part;
 } TB_FunctionOutput;
 
+// known ranges of the integer params across every call site, these
+// are filled in by tb_module_ipo and picked up by the peepholes.
+typedef struct {
+    bool known;
+    int64_t min, max;
+} TB_ParamRange;
+
 struct TB_Function {
     TB_Symbol super;
     TB_ModuleSectionHandle section;
@@ -284,6 +324,9 @@ struct TB_Function {
     size_t param_count;
     TB_Node** params;
 
+    // NULL if we don't know anything
+    TB_ParamRange* param_ranges;
+
     TB_Node* start_node;
     TB_Node* stop_node;
 
@@ -300,10 +343,21 @@ struct TB_Function {
     TB_Node* active_control_node;
     TB_NodeSafepoint exit_attrib;
     TB_NodeSafepoint line_attrib;
+    int alias_class;
 
     // Attributes
     NL_Map(uint64_t, DynArray(TB_Attrib)) attribs;
 
+    // Profile-guided optimization, prof_slots is how many regions have been
+    // numbered so far (+1 for the entry). prof_counts is only valid while building.
+    TB_Symbol* prof_counters;
+    const uint64_t* prof_counts;
+    uint32_t prof_slots, prof_count;
+    bool profiled;
+
+    // filled in when tb_code_cache_lookup misses, tb_code_cache_insert uses it
+    struct TB_CodeCacheMiss* cache_miss;
+
     // Compilation output
     union {
         void* compiled_pos;
@@ -413,8 +467,16 @@ struct TB_Module {
     // unused by the JIT
     DynArray(TB_ModuleSection) sections;
 
+    // .text.cold, it's made the first time an exporter splits off cold code
+    // (0 until then since that's .text)
+    TB_ModuleSectionHandle text_cold;
+
     // windows specific lol
     TB_LinkerSectionPiece* xdata;
+
+    // NULL unless it was loaded by tb_module_deserialize, symbol names
+    // and global contents point into it.
+    struct TB_ModuleImage* image;
 };
 
 typedef struct {
@@ -427,6 +489,14 @@ typedef struct {
     uint8_t data[];
 } TB_TemporaryStorage;
 
+// what the list scheduler knows about an operation on some target
+typedef struct {
+    // cycles until the result can be used
+    int latency;
+    // cycles before the unit can start another one, 1 if it's pipelined
+    int occupancy;
+} TB_NodeCost;
+
 typedef struct {
     // what does CHAR_BIT mean on said platform
     int minimum_addressable_size, pointer_size;
@@ -440,6 +510,9 @@ typedef struct {
     void (*emit_win64eh_unwind_info)(TB_Emitter* e, TB_FunctionOutput* out_f, uint64_t stack_usage);
 
     void (*compile_function)(TB_Passes* p, TB_FunctionOutput* restrict func_out, const TB_FeatureSet* features, uint8_t* out, size_t out_capacity, bool emit_asm);
+
+    // NULLable, latency & throughput table for the list scheduler
+    TB_NodeCost (*node_cost)(TB_Node* n);
 } ICodeGen;
 
 // All debug formats i know of boil down to adding some extra sections to the object file
@@ -575,7 +648,9 @@ inline static bool tb_is_power_of_two(uint64_t x) {
 TB_Node* tb_alloc_node(TB_Function* f, int type, TB_DataType dt, int input_count, size_t extra);
 TB_Node* tb__make_proj(TB_Function* f, TB_DataType dt, TB_Node* src, int index);
 
-ExportList tb_module_layout_sections(TB_Module* m);
+// split_cold moves the cold code of functions into .text.cold, the exporter is then
+// on the hook for relocating the cold jumps (see TB_FunctionOutput.cold_jumps).
+ExportList tb_module_layout_sections(TB_Module* m, bool split_cold);
 
 ////////////////////////////////
 // EXPORTER HELPER
@@ -596,6 +671,8 @@ void tb_symbol_append(TB_Module* m, TB_Symbol* s);
 
 void tb_emit_symbol_patch(TB_FunctionOutput* func_out, const TB_Symbol* target, size_t pos);
 TB_Global* tb__small_data_intern(TB_Module* m, size_t len, const void* data);
+void tb__module_image_free(TB_Module* m);
+TB_FunctionOutput* tb__alloc_function_output(TB_Function* f, size_t code_size);
 
 // out_bytes needs at least 16 bytes
 void tb__md5sum(uint8_t* out_bytes, uint8_t* initial_msg, size_t initial_len);
@@ -626,5 +703,5 @@ extern ICodeGen tb__aarch64_codegen;
 extern ICodeGen tb__wasm32_codegen;
 
 // And all debug formats here
-//extern IDebugFormat dwarf_debug_format;
+extern IDebugFormat tb__dwarf_debug_format;
 extern IDebugFormat tb__codeview_debug_format;
@@ -4,10 +4,10 @@
 #include <setjmp.h>
 
 #if defined(TB_USE_MIMALLOC)
-#include <mimalloc.h>
-#define tb_platform_heap_alloc(size)        mi_malloc(size)
-#define tb_platform_heap_realloc(ptr, size) mi_realloc(ptr, size)
-#define tb_platform_heap_free(ptr)          mi_free(ptr)
+#include <common.h>
+#define tb_platform_heap_alloc(size)        cuik_malloc(size)
+#define tb_platform_heap_realloc(ptr, size) cuik_realloc(ptr, size)
+#define tb_platform_heap_free(ptr)          cuik_free(ptr)
 #else
 #define tb_platform_heap_alloc(size)        malloc(size)
 #define tb_platform_heap_free(ptr)          free(ptr)
@@ -517,6 +517,12 @@ static void isel(Ctx* restrict ctx, TB_Node* n, const int dst) {
             // walk the entry to find any parameter stack slots
             bool has_param_slots = false;
             FOREACH_N(i, 0, ctx->f->param_count) {
+                // SysV has no home space for the register parameters, anything
+                // above the return address belongs to the caller.
+                if (is_sysv && i < 6) {
+                    continue;
+                }
+
                 TB_Node* proj = params[3 + i];
                 User* use = find_users(ctx->p, proj);
                 if (use == NULL || use->next != NULL || use->slot == 0) {
@@ -602,9 +608,15 @@ static void isel(Ctx* restrict ctx, TB_Node* n, const int dst) {
             int lhs = input_reg(ctx, n->inputs[2]);
             int rhs = input_reg(ctx, n->inputs[3]);
 
+            // there's no 8bit cmov, the upper bits don't matter anyways
+            TB_DataType dt = n->dt;
+            if (dt.type == TB_INT && dt.data < 16) {
+                dt = TB_TYPE_I32;
+            }
+
             Cond cc = isel_cmp(ctx, n->inputs[1]);
-            SUBMIT(inst_move(n->dt, dst, rhs));
-            SUBMIT(inst_op_rr(CMOVO + cc, n->dt, dst, lhs));
+            SUBMIT(inst_move(dt, dst, rhs));
+            SUBMIT(inst_op_rr(CMOVO + cc, dt, dst, lhs));
             break;
         }
 
@@ -1246,22 +1258,59 @@ static void isel(Ctx* restrict ctx, TB_Node* n, const int dst) {
         // table lookup constant -> constant
         case TB_LOOKUP: {
             TB_NodeLookup* l = TB_NODE_GET_EXTRA(n);
+            size_t key_count = l->entry_count - 1;
+
+            // keys are sorted and masked to the width of the key type
+            uint64_t lo = l->entries[1].key;
+            uint64_t hi = l->entries[key_count].key;
 
-            TB_LookupEntry* min = &l->entries[1];
-            TB_LookupEntry* max = &l->entries[l->entry_count - 1];
+            // zero extend the key, small keys get widened to 32bits (also makes CMOVs legal)
+            TB_DataType key_dt = n->inputs[1]->dt;
+            TB_DataType dt = key_dt.data > 32 ? TB_TYPE_I64 : TB_TYPE_I32;
+            TB_DataType val_dt = n->dt.data > 32 ? TB_TYPE_I64 : TB_TYPE_I32;
 
-            // "+ 2" because of the inclusive range + the default case
-            int64_t range = (max->key - min->key) + 2;
+            int key = input_reg(ctx, n->inputs[1]);
+            int index = DEF(NULL, dt);
+            hint_reg(ctx, index, key);
+            if (key_dt.data >= 32) {
+                SUBMIT(inst_move(dt, index, key));
+            } else if (key_dt.data == 16) {
+                SUBMIT(inst_op_rr(MOVZXW, dt, index, key));
+            } else if (key_dt.data == 8) {
+                SUBMIT(inst_op_rr(MOVZXB, dt, index, key));
+            } else {
+                SUBMIT(inst_move(dt, index, key));
+                SUBMIT(inst_op_rri(AND, dt, index, index, tb__mask(key_dt.data)));
+            }
 
-            double dist_avg = 0;
-            double inv_key_count = 1.0 / (l->entry_count - 1);
+            if (!lookup_is_dense(lo, hi, key_count) || (dt.data == 64 && !fits_into_int32(lo - 1))) {
+                // sparse keys, compare + cmov chain:
+                //   mov dst, default
+                //   cmp index, key
+                //   cmove dst, val    for each key
+                FOREACH_N(i, 0, l->entry_count) {
+                    uint64_t val = l->entries[i].val;
 
-            int64_t last = l->entries[1].key;
-            FOREACH_N(i, 2, l->entry_count) {
-                int64_t key = l->entries[i].key;
+                    int tmp = i == 0 ? dst : DEF(NULL, val_dt);
+                    if (val_dt.data == 32 || fits_into_int32(val)) {
+                        SUBMIT(inst_op_imm(MOV, val_dt, tmp, val));
+                    } else {
+                        SUBMIT(inst_op_abs(MOVABS, val_dt, tmp, val));
+                    }
 
-                dist_avg += (key - last) * inv_key_count;
-                last = key;
+                    if (i > 0) {
+                        uint64_t curr_key = l->entries[i].key;
+                        if (dt.data == 32 || fits_into_int32(curr_key)) {
+                            SUBMIT(inst_op_ri(CMP, dt, index, curr_key));
+                        } else {
+                            int key_tmp = DEF(NULL, dt);
+                            SUBMIT(inst_op_abs(MOVABS, dt, key_tmp, curr_key));
+                            SUBMIT(inst_op_rr_no_dst(CMP, dt, index, key_tmp));
+                        }
+                        SUBMIT(inst_op_rr(CMOVO + E, val_dt, dst, tmp));
+                    }
+                }
+                break;
             }
 
             // we wanna figure out how many bits per table entry
@@ -1277,77 +1326,65 @@ static void isel(Ctx* restrict ctx, TB_Node* n, const int dst) {
                 }
             }
 
-            // in QWORDs
-            size_t table_size = ((range * bits) + 63) / 64;
+            // flat table from start to finish (first element is the default, the rest
+            // of the keys start at 1)
+            size_t table_len = (hi - lo) + 2;
+            size_t table_size = bits == 1 ? ((table_len + 63) / 64) * 8 : (table_len * bits) / 8;
 
-            // flat table from start to finish (first element is the default)
             TB_Function* f = ctx->f;
             TB_Global* table_sym = tb_global_create(f->super.module, 0, NULL, NULL, TB_LINKAGE_PRIVATE);
-            tb_global_set_storage(f->super.module, tb_module_get_rdata(f->super.module), table_sym, table_size * sizeof(uint64_t), 8, 1);
-            uint64_t* table_data = tb_global_add_region(f->super.module, table_sym, 0, table_size * sizeof(uint64_t));
-
-            memset(table_data, 0, table_size * sizeof(uint64_t));
-
-            // encode every entry
-            int amt = tb_ffs(64 / bits) - 1;
-            FOREACH_N(i, 0, l->entry_count) {
-                uint64_t index = 0;
-                if (i > 0) {
-                    index = (l->entries[i].key - min->key) + 1;
+            tb_global_set_storage(f->super.module, tb_module_get_rdata(f->super.module), table_sym, table_size, 8, 1);
+            uint8_t* table_data = tb_global_add_region(f->super.module, table_sym, 0, table_size);
+            memset(table_data, 0, table_size);
+
+            // encode every entry (holes are the default case)
+            size_t next = 1;
+            FOREACH_N(i, 0, table_len) {
+                uint64_t val = l->entries[0].val;
+                if (i > 0 && next <= key_count && l->entries[next].key - lo + 1 == i) {
+                    val = l->entries[next++].val;
                 }
 
-                uint64_t mask = (1ull << bits) - 1;
-                uint64_t shift = index & ((1ull << amt) - 1);
-                table_data[index >> amt] |= (l->entries[i].val & mask) << shift;
+                if (bits == 1) {
+                    table_data[i / 8] |= (val & 1) << (i % 8);
+                } else {
+                    memcpy(&table_data[i * (bits / 8)], &val, bits / 8);
+                }
             }
 
-            TB_DataType dt = n->dt;
-            int key = input_reg(ctx, n->inputs[1]);
-
-            int index = DEF(NULL, dt);
-            hint_reg(ctx, index, key);
-            SUBMIT(inst_move(dt, index, key));
             // Simple range check:
-            //   if ((key - min) >= (max - min)) goto default
-            if (1) {
-                int zero = DEF(NULL, dt);
-                SUBMIT(inst_op_zero(dt, zero));
-
-                if (min != 0) {
-                    SUBMIT(inst_op_rri(SUB, dt, index, index, min->key - 1));
-                }
-                SUBMIT(inst_op_ri(CMP, dt, index, range));
-                SUBMIT(inst_op_rr(CMOVA, n->dt, index, zero));
+            //   if ((key - lo + 1) > (hi - lo + 1)) key = 0
+            int zero = DEF(NULL, dt);
+            SUBMIT(inst_op_zero(dt, zero));
+            if (lo != 1) {
+                SUBMIT(inst_op_rri(SUB, dt, index, index, lo - 1));
             }
+            SUBMIT(inst_op_ri(CMP, dt, index, table_len - 1));
+            SUBMIT(inst_op_rr(CMOVA, dt, index, zero));
+
             //   lea table, [rip + TABLE]
             int table = DEF(NULL, TB_TYPE_I64);
             SUBMIT(inst_op_global(LEA, TB_TYPE_I64, table, (TB_Symbol*) table_sym));
 
-            // word_index = key
-            int word_index = DEF(NULL, dt);
-            hint_reg(ctx, word_index, index);
-            SUBMIT(inst_move(dt, word_index, index));
-            if (bits != 64) {
-                // word_index /= (64 / bits)
-                SUBMIT(inst_op_rri(SHR, TB_TYPE_I64, word_index, word_index, amt));
-            }
-            //   mov table, [table + index*8]
-            SUBMIT(inst_op_rm(MOV, TB_TYPE_I64, dst, table, word_index, SCALE_X8, 0));
-            // we need to extract bits
-            if (bits != 64) {
-                //   mov RCX, index
-                hint_reg(ctx, index, RCX);
+            if (bits == 1) {
+                //   mov word_index, index
+                //   shr word_index, 6
+                int word_index = DEF(NULL, dt);
+                SUBMIT(inst_move(dt, word_index, index));
+                SUBMIT(inst_op_rri(SHR, dt, word_index, word_index, 6));
+                //   mov dst, [table + word_index*8]
+                SUBMIT(inst_op_rm(MOV, TB_TYPE_I64, dst, table, word_index, SCALE_X8, 0));
+                //   shr dst, index (shift amount is implicitly masked to 6 bits)
                 SUBMIT(inst_move(dt, RCX, index));
-                //   and dst, amt_mask
-                uint64_t amt_mask = (1ull << amt) - 1;
-                if (amt_mask != 0x3F) {
-                    SUBMIT(inst_op_rri(AND, TB_TYPE_I64, RCX, RCX, amt_mask));
-                }
-                //   shr dst, RCX
-                SUBMIT(inst_op_rrr(SHR, TB_TYPE_I64, dst, dst, RCX));
-                //   and dst, mask
-                uint64_t mask = (1ull << bits) - 1;
-                SUBMIT(inst_op_rri(AND, TB_TYPE_I64, dst, dst, mask));
+                SUBMIT(inst_op_rrr_tmp(SHR, TB_TYPE_I64, dst, dst, RCX, RCX));
+                //   and dst, 1
+                SUBMIT(inst_op_rri(AND, val_dt, dst, dst, 1));
+            } else if (bits == 8) {
+                SUBMIT(inst_op_rm(MOVZXB, val_dt, dst, table, index, SCALE_X1, 0));
+            } else if (bits == 16) {
+                SUBMIT(inst_op_rm(MOVZXW, val_dt, dst, table, index, SCALE_X2, 0));
+            } else {
+                SUBMIT(inst_op_rm(MOV, val_dt, dst, table, index, bits == 32 ? SCALE_X4 : SCALE_X8, 0));
             }
             break;
         }
@@ -1361,6 +1398,7 @@ static void isel(Ctx* restrict ctx, TB_Node* n, const int dst) {
             TB_Arena* arena = ctx->f->arena;
             TB_ArenaSavepoint sp = tb_arena_save(arena);
             int* succ = tb_arena_alloc(arena, br->succ_count * sizeof(int));
+            float* succ_freq = tb_arena_alloc(arena, br->succ_count * sizeof(float));
 
             // fill successors
             bool has_default = false;
@@ -1373,7 +1411,9 @@ static void isel(Ctx* restrict ctx, TB_Node* n, const int dst) {
                         has_default = !cfg_is_unreachable(succ_n);
                     }
 
-                    succ[index] = nl_map_get_checked(ctx->cfg.node_to_block, succ_n).id;
+                    TB_BasicBlock* succ_bb = &nl_map_get_checked(ctx->cfg.node_to_block, succ_n);
+                    succ[index] = succ_bb->id;
+                    succ_freq[index] = succ_bb->freq;
                 }
             }
 
@@ -1398,6 +1438,11 @@ static void isel(Ctx* restrict ctx, TB_Node* n, const int dst) {
                 // if flipping avoids a jmp, do that
                 if (ctx->fallthrough == t) {
                     SUBMIT(inst_jcc(f, cc ^ 1));
+                } else if (ctx->fallthrough != f && succ_freq[0] > succ_freq[1]) {
+                    // neither side falls through, the conditional jump goes to
+                    // the colder side so the hot path is the not-taken one.
+                    SUBMIT(inst_jcc(f, cc ^ 1));
+                    SUBMIT(inst_jmp(t));
                 } else {
                     SUBMIT(inst_jcc(t, cc));
                     if (ctx->fallthrough != f) {
@@ -1435,8 +1480,18 @@ static void isel(Ctx* restrict ctx, TB_Node* n, const int dst) {
 
                 switch (r) {
                     case IF_ELSE_CHAIN: {
-                        // Basic if-else chain
+                        // Basic if-else chain, the hotter cases get tested first
+                        int* order = tb_arena_alloc(arena, br->succ_count * sizeof(int));
                         FOREACH_N(i, 1, br->succ_count) {
+                            int j = i - 1;
+                            for (; j > 0 && succ_freq[order[j - 1]] < succ_freq[i]; j--) {
+                                order[j] = order[j - 1];
+                            }
+                            order[j] = i;
+                        }
+
+                        FOREACH_N(k, 0, br->succ_count - 1) {
+                            int i = order[k];
                             uint64_t curr_key = br->keys[i-1];
 
                             if (fits_into_int32(curr_key)) {
@@ -1565,19 +1620,27 @@ static void isel(Ctx* restrict ctx, TB_Node* n, const int dst) {
         case TB_SAFEPOINT_POLL: {
             TB_Node* addr = n->inputs[2];
 
-            tb_todo();
-
-            // force uses of the inputs
-            /*FOREACH_N(i, 3, n->input_count) {
-                input_reg(ctx, n->inputs[i]);
-            }*/
+            // the data inputs are what the stack map describes
+            int save_count = n->input_count - 3;
+            RegIndex* saves = tb_arena_alloc(tmp_arena, save_count * sizeof(RegIndex));
+            FOREACH_N(i, 0, save_count) {
+                saves[i] = input_reg(ctx, n->inputs[3 + i]);
+            }
 
             // test tmp, dword [poll_site]
             int tmp = DEF(n, TB_TYPE_I32);
-            Inst* ld_inst = isel_addr2(ctx, addr, tmp, -1, -1);
-            ld_inst->type = TEST;
-            ld_inst->dt = TB_X86_TYPE_DWORD;
-            SUBMIT(ld_inst);
+            Inst* ld_inst;
+            if (addr != NULL) {
+                ld_inst = isel_addr2(ctx, addr, tmp, -1, -1);
+                ld_inst->type = TEST;
+                ld_inst->dt = TB_X86_TYPE_DWORD;
+            } else {
+                // no poll site, it's just a stack map at this IP
+                ld_inst = alloc_inst(NOP, TB_TYPE_I32, 1, 0, 0);
+                ld_inst->operands[0] = tmp;
+            }
+
+            SUBMIT(inst_add_saves(ld_inst, save_count, saves));
             break;
         }
 
@@ -1856,6 +1919,251 @@ static int resolve_interval(Ctx* restrict ctx, Inst* inst, int i, Val* val) {
     return 1;
 }
 
+// writes out where each of the safepoint's values live at this IP
+static void emit_safepoint(Ctx* restrict ctx, Inst* inst, uint32_t pos) {
+    RegIndex* saves = &inst->operands[inst->out_count + inst->in_count + inst->tmp_count];
+
+    TB_Safepoint* sp = tb_platform_heap_alloc(sizeof(TB_Safepoint) + (inst->save_count * sizeof(int32_t)));
+    sp->node = ctx->intervals[inst->operands[0]].n;
+    sp->userdata = NULL;
+    sp->ip = pos;
+    sp->count = inst->save_count;
+
+    FOREACH_N(i, 0, inst->save_count) {
+        LiveInterval* interval = &ctx->intervals[saves[i]];
+        if (interval->is_spill) {
+            sp->values[i] = (-interval->spill->pos * 2) | 1;
+        } else {
+            int reg = interval->assigned + (interval->reg_class == REG_CLASS_XMM ? 16 : 0);
+            sp->values[i] = reg * 2;
+        }
+    }
+
+    // we emit in order so the keys are already sorted
+    TB_SafepointKey key = { pos, sp };
+    dyn_array_put(ctx->safepoints, key);
+}
+
+////////////////////////////////
+// Branch relaxation
+////////////////////////////////
+// every jump to a label is emitted as rel32 since we don't know where the label
+// lands yet, once the whole function is out we thread jumps which land on other
+// jumps, flip "jcc A; jmp B; A:" into "jncc B", shrink whatever reaches into rel8
+// and drop jumps to the very next instruction. Shrinking only ever pulls code
+// closer together so we just keep going until nothing else fits.
+typedef struct {
+    uint32_t pos;  // where it started in the unrelaxed code
+    int target;    // label
+    int cc;        // -1 for jmp
+    int size;      // 5 or 6 for rel32, 2 for rel8, 0 if it's gone
+} Branch;
+
+static int branch_long_size(Branch* b) {
+    return b->cc < 0 ? 5 : 6;
+}
+
+// the jump which starts exactly at pos, if any
+static Branch* branch_at(Branch* branches, size_t count, uint32_t pos) {
+    size_t lo = 0, hi = count;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (branches[mid].pos < pos) lo = mid + 1;
+        else hi = mid;
+    }
+
+    return lo < count && branches[lo].pos == pos ? &branches[lo] : NULL;
+}
+
+static uint32_t label_pos(Ctx* restrict ctx, int label) {
+    assert(ctx->emit.labels[label] & 0x80000000);
+    return ctx->emit.labels[label] & 0x7FFFFFFF;
+}
+
+// removed[i] is how many bytes the jumps before branches[i] lost
+static uint32_t relaxed_pos(Branch* branches, uint32_t* removed, size_t count, uint32_t pos) {
+    size_t lo = 0, hi = count;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (branches[mid].pos < pos) lo = mid + 1;
+        else hi = mid;
+    }
+
+    return pos - removed[lo];
+}
+
+static void relax_branches(Ctx* restrict ctx, DynArray(Branch) branches) {
+    TB_CGEmitter* e = &ctx->emit;
+    size_t count = dyn_array_length(branches);
+    if (count == 0) {
+        return;
+    }
+
+    // jump threading, jumps which land on a jmp can go straight to where
+    // that one's going (the hop limit is for infinite loops of jumps).
+    FOREACH_N(i, 0, count) {
+        Branch* b = &branches[i];
+        for (size_t hops = 0; hops < count; hops++) {
+            Branch* next = branch_at(branches, count, label_pos(ctx, b->target));
+            if (next == NULL || next->cc >= 0 || next->target == b->target) break;
+
+            b->target = next->target;
+        }
+    }
+
+    // "jcc A; jmp B; A:" => "jncc B; A:" as long as nothing jumps to the jmp
+    FOREACH_N(i, 0, count - 1) {
+        Branch* b = &branches[i];
+        Branch* next = &branches[i + 1];
+        if (b->cc < 0 || next->cc >= 0 || next->pos != b->pos + b->size) continue;
+        if (label_pos(ctx, b->target) != next->pos + next->size) continue;
+
+        bool is_target = false;
+        FOREACH_N(j, 0, e->label_count) {
+            if (e->labels[j] == (0x80000000 | next->pos)) {
+                is_target = true;
+                break;
+            }
+        }
+
+        if (!is_target) {
+            b->cc ^= 1;
+            b->target = next->target;
+            next->size = 0;
+        }
+    }
+
+    // jumps between hot and cold code get split into different sections
+    // by the exporter so those stay rel32 and get reported.
+    bool has_cold = ctx->cold_bb < ctx->bb_count;
+    uint32_t cold_start = has_cold ? label_pos(ctx, ctx->bb_order[ctx->cold_bb]) : UINT32_MAX;
+
+    uint32_t* removed = tb_platform_heap_alloc((count + 1) * sizeof(uint32_t));
+    for (bool changed = true; changed;) {
+        changed = false;
+
+        removed[0] = 0;
+        FOREACH_N(i, 0, count) {
+            removed[i + 1] = removed[i] + (branch_long_size(&branches[i]) - branches[i].size);
+        }
+
+        FOREACH_N(i, 0, count) {
+            Branch* b = &branches[i];
+            uint32_t target = label_pos(ctx, b->target);
+            if (b->size == 0 || (b->pos < cold_start) != (target < cold_start)) continue;
+
+            int64_t disp = (int64_t) relaxed_pos(branches, removed, count, target) - (b->pos - removed[i] + 2);
+            if (disp == 0 || (b->size > 2 && disp == (int8_t) disp)) {
+                b->size = disp == 0 ? 0 : 2;
+                changed = true;
+            }
+        }
+    }
+
+    // compact the code, it only ever moves backwards so we can do it in place
+    uint32_t src = 0, dst = 0;
+    FOREACH_N(i, 0, count) {
+        Branch* b = &branches[i];
+        memmove(&e->data[dst], &e->data[src], b->pos - src);
+        dst += b->pos - src;
+        src = b->pos + branch_long_size(b);
+
+        if (b->size == 0) continue;
+
+        int32_t disp = relaxed_pos(branches, removed, count, label_pos(ctx, b->target)) - (dst + b->size);
+        uint8_t* out = &e->data[dst];
+        if (b->size == 2) {
+            out[0] = b->cc < 0 ? 0xEB : 0x70 + b->cc;
+            out[1] = (int8_t) disp;
+        } else {
+            if (b->cc < 0) {
+                *out++ = 0xE9;
+            } else {
+                *out++ = 0x0F;
+                *out++ = 0x80 + b->cc;
+            }
+            memcpy(out, &disp, sizeof(disp));
+
+            if (has_cold) {
+                dyn_array_put(ctx->label_refs, dst + b->size - 4);
+            }
+        }
+        dst += b->size;
+    }
+    memmove(&e->data[dst], &e->data[src], e->count - src);
+    e->count = dst + (e->count - src);
+
+    // everything which pointed into the code needs to move along with it
+    FOREACH_N(i, 0, e->label_count) {
+        if (e->labels[i] & 0x80000000) {
+            e->labels[i] = 0x80000000 | relaxed_pos(branches, removed, count, e->labels[i] & 0x7FFFFFFF);
+        }
+    }
+
+    dyn_array_for(i, ctx->locations) {
+        ctx->locations[i].pos = relaxed_pos(branches, removed, count, ctx->locations[i].pos);
+    }
+
+    dyn_array_for(i, ctx->safepoints) {
+        ctx->safepoints[i].ip = relaxed_pos(branches, removed, count, ctx->safepoints[i].ip);
+        ctx->safepoints[i].sp->ip = ctx->safepoints[i].ip;
+    }
+
+    for (TB_SymbolPatch* p = e->output->first_patch; p; p = p->next) {
+        p->pos = relaxed_pos(branches, removed, count, p->pos);
+    }
+
+    tb_platform_heap_free(removed);
+}
+
+// anything which touches the stack needs the frame, calls need it for the
+// alignment too.
+static bool needs_frame(Ctx* restrict ctx, Inst* inst) {
+    if (inst->type == CALL || inst->type == INST_INLINE) {
+        return true;
+    }
+
+    FOREACH_N(i, 0, inst->out_count + inst->in_count + inst->tmp_count + inst->save_count) {
+        // globals put a placeholder in the memory operand
+        if ((inst->flags & INST_GLOBAL) && i == inst->mem_slot) {
+            continue;
+        }
+
+        int r = inst->operands[i];
+        if (r >= 0 && (r == FIRST_GPR + RBP || r == FIRST_GPR + RSP || ctx->intervals[r].is_spill)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// the frame goes wherever shrink wrapping puts it, win64's unwind info needs
+// the prologue at the entry so it stays there.
+static int frame_point(Ctx* restrict ctx, bool* covered) {
+    if (ctx->stack_usage <= 16) {
+        memset(covered, 0, ctx->cfg.block_count * sizeof(bool));
+        return -1;
+    } else if (ctx->target_abi == TB_ABI_WIN64) {
+        memset(covered, 1, ctx->cfg.block_count * sizeof(bool));
+        return 0;
+    }
+
+    bool* uses = tb_arena_alloc(tmp_arena, ctx->cfg.block_count * sizeof(bool));
+    memset(uses, 0, ctx->cfg.block_count * sizeof(bool));
+
+    int bb = 0;
+    for (Inst* restrict inst = ctx->first; inst; inst = inst->next) {
+        if (inst->type == INST_LABEL) {
+            bb = nl_map_get_checked(ctx->cfg.node_to_block, inst->n).id;
+        } else if (!uses[bb] && needs_frame(ctx, inst)) {
+            uses[bb] = true;
+        }
+    }
+
+    return shrink_wrap_point(ctx, uses, covered);
+}
+
 static void emit_code(Ctx* restrict ctx, TB_FunctionOutput* restrict func_out) {
     TB_CGEmitter* e = &ctx->emit;
 
@@ -1873,7 +2181,14 @@ static void emit_code(Ctx* restrict ctx, TB_FunctionOutput* restrict func_out) {
     }
 
     // emit prologue
-    func_out->prologue_length = emit_prologue(ctx);
+    bool* frame_covered = tb_arena_alloc(tmp_arena, ctx->cfg.block_count * sizeof(bool));
+    int frame_bb = frame_point(ctx, frame_covered);
+    if (frame_bb == 0) {
+        func_out->prologue_length = emit_prologue(ctx);
+    }
+
+    bool has_frame = false;
+    DynArray(Branch) branches = dyn_array_create(Branch, 64);
 
     Inst* prev_line = NULL;
     for (Inst* restrict inst = ctx->first; inst; inst = inst->next) {
@@ -1893,6 +2208,10 @@ static void emit_code(Ctx* restrict ctx, TB_FunctionOutput* restrict func_out) {
             printf("}\x1b[0m\n");
         }
 
+        if (inst->save_count > 0) {
+            emit_safepoint(ctx, inst, GET_CODE_POS(&ctx->emit));
+        }
+
         if (inst->type == INST_ENTRY || inst->type == INST_TERMINATOR) {
             // does nothing
         } else if (inst->type == INST_LABEL) {
@@ -1901,6 +2220,11 @@ static void emit_code(Ctx* restrict ctx, TB_FunctionOutput* restrict func_out) {
 
             int id = nl_map_get_checked(ctx->cfg.node_to_block, bb).id;
             tb_resolve_rel32(&ctx->emit, &ctx->emit.labels[id], pos);
+
+            if (id == frame_bb && id != 0) {
+                func_out->prologue_length = emit_prologue(ctx);
+            }
+            has_frame = frame_covered[id];
         } else if (inst->type == INST_INLINE) {
             if (inst->n) {
                 TB_NodeMachineOp* mach = TB_NODE_GET_EXTRA(inst->n);
@@ -1911,7 +2235,9 @@ static void emit_code(Ctx* restrict ctx, TB_FunctionOutput* restrict func_out) {
             }
         } else if (inst->type == INST_EPILOGUE) {
             // just a marker for regalloc
-            emit_epilogue(ctx);
+            if (has_frame) {
+                emit_epilogue(ctx);
+            }
 
             if (inst->flags & INST_RET) {
                 // ret
@@ -1957,7 +2283,12 @@ static void emit_code(Ctx* restrict ctx, TB_FunctionOutput* restrict func_out) {
                 resolve_interval(ctx, inst, in_base, &target);
             }
 
+            uint32_t start = GET_CODE_POS(e);
             inst1(e, inst->type, &target, inst->dt);
+            if (inst->flags & INST_NODE) {
+                Branch b = { start, inst->l, inst->type == JMP ? -1 : inst->type - JO, GET_CODE_POS(e) - start };
+                dyn_array_put(branches, b);
+            }
         } else if (inst->type == CALL) {
             Val target;
             size_t i = resolve_interval(ctx, inst, in_base, &target);
@@ -2050,6 +2381,32 @@ static void emit_code(Ctx* restrict ctx, TB_FunctionOutput* restrict func_out) {
         }
     }
 
+    CUIK_TIMED_BLOCK("relax branches") {
+        relax_branches(ctx, branches);
+    }
+    dyn_array_destroy(branches);
+
+    // where the frame's up, blocks covered by the shrink wrap point have it
+    // and the rest don't (we never go between the two outside of the prologue
+    // and epilogues).
+    if (frame_bb >= 0) {
+        bool prev = false;
+
+        FOREACH_N(i, 0, ctx->bb_count) {
+            int id = ctx->bb_order[i];
+            uint32_t pos = ctx->emit.labels[id] & ~0x80000000;
+
+            if (id == frame_bb) {
+                func_out->prologue_pos = id == 0 ? 0 : pos;
+                dyn_array_put(func_out->frame_changes, (TB_FrameChange){ func_out->prologue_pos, true });
+                prev = true;
+            } else if (frame_covered[id] != prev) {
+                prev = !prev;
+                dyn_array_put(func_out->frame_changes, (TB_FrameChange){ pos, prev });
+            }
+        }
+    }
+
     // pad to 16bytes
     static const uint8_t nops[8][8] = {
         { 0x90 },
@@ -2114,6 +2471,7 @@ static size_t emit_prologue(Ctx* restrict ctx) {
     }
 
     TB_CGEmitter* e = &ctx->emit;
+    size_t start = e->count;
 
     // push rbp
     if (stack_usage > 0) {
@@ -2152,7 +2510,7 @@ static size_t emit_prologue(Ctx* restrict ctx) {
         }
     }
 
-    return e->count;
+    return e->count - start;
 }
 
 static void emit_epilogue(Ctx* restrict ctx) {
@@ -2260,7 +2618,7 @@ static void disassemble(TB_CGEmitter* e, Disasm* restrict d, int bb, size_t pos,
                     mem = false;
 
                     if (inst.flags & TB_X86_INSTR_USE_RIPMEM) {
-                        bool is_label = inst.opcode == 0xE8 || inst.opcode == 0xE9
+                        bool is_label = inst.opcode == 0xE8 || inst.opcode == 0xE9 || inst.opcode == 0xEB
                             || (inst.opcode >= 0x70   && inst.opcode <= 0x7F)
                             || (inst.opcode >= 0x0F80 && inst.opcode <= 0x0F8F);
 
@@ -2339,6 +2697,47 @@ static void disassemble(TB_CGEmitter* e, Disasm* restrict d, int bb, size_t pos,
 }
 #undef E
 
+// rough numbers for a recent x64 core, they don't need to be exact just
+// good enough to tell the scheduler what's worth hiding.
+static TB_NodeCost node_cost(TB_Node* n) {
+    switch (n->type) {
+        case TB_LOAD:
+        case TB_ATOMIC_LOAD:
+        return (TB_NodeCost){ 5, 1 };
+
+        case TB_MUL:
+        case TB_MULPAIR:
+        return (TB_NodeCost){ 3, 1 };
+
+        // the divider isn't pipelined
+        case TB_UDIV: case TB_SDIV:
+        case TB_UMOD: case TB_SMOD:
+        return (TB_NodeCost){ 26, 6 };
+
+        case TB_FADD: case TB_FSUB:
+        case TB_FMUL: case TB_FMAX: case TB_FMIN:
+        case TB_INT2FLOAT: case TB_UINT2FLOAT:
+        case TB_FLOAT2INT: case TB_FLOAT2UINT:
+        case TB_FLOAT_EXT:
+        return (TB_NodeCost){ 4, 1 };
+
+        case TB_FDIV:
+        return (TB_NodeCost){ 13, 4 };
+
+        case TB_X86INTRIN_SQRT:
+        return (TB_NodeCost){ 15, 6 };
+
+        case TB_X86INTRIN_RSQRT:
+        return (TB_NodeCost){ 4, 1 };
+
+        case TB_CLZ: case TB_CTZ: case TB_POPCNT:
+        return (TB_NodeCost){ 3, 1 };
+
+        default:
+        return (TB_NodeCost){ 1, 1 };
+    }
+}
+
 ICodeGen tb__x64_codegen = {
     .minimum_addressable_size = 8,
     .pointer_size = 64,
@@ -2346,4 +2745,5 @@ ICodeGen tb__x64_codegen = {
     .emit_call_patches  = emit_call_patches,
     .get_data_type_size = get_data_type_size,
     .compile_function   = compile_function,
+    .node_cost          = node_cost,
 };
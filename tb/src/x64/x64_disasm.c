@@ -239,6 +239,8 @@ bool tb_x86_disasm(TB_X86_Inst* restrict inst, size_t length, const uint8_t* dat
         [0x18] = OP_FAKERX,
         // SSE: movu
         [0x10] = OP_RM | OP_SSE, [0x11] = OP_MR | OP_SSE,
+        // SSE: mova
+        [0x28] = OP_RM | OP_SSE,
         // SSE: add, mul, sub, min, div, max
         [0x51 ... 0x5F] = OP_RM | OP_SSE,
         // cmovcc
@@ -326,6 +328,16 @@ bool tb_x86_disasm(TB_X86_Inst* restrict inst, size_t length, const uint8_t* dat
         inst->disp = imm;
         inst->length = current;
         return true;
+    } else if (enc == OP_REL8) {
+        inst->flags |= TB_X86_INSTR_USE_RIPMEM;
+        inst->flags |= TB_X86_INSTR_USE_MEMOP;
+        inst->base = -1;
+        inst->index = -1;
+
+        ABC(1);
+        inst->disp = (int8_t) data[current++];
+        inst->length = current;
+        return true;
     } else if (enc == OP_0ARY) {
         inst->length = current;
         return true;
@@ -473,6 +485,7 @@ const char* tb_x86_mnemonic(TB_X86_Inst* inst) {
         case 0x84: case 0x85: return "test";
 
         case 0x0F10: case 0x0F11: return "mov";
+        case 0x0F28: return "mova";
         case 0x0F58: return "add";
         case 0x0F59: return "mul";
         case 0x0F5C: return "sub";
@@ -157,9 +157,11 @@ static void inst2(TB_CGEmitter* restrict e, InstType type, const Val* a, const V
     // a sign extended 8 bit number
     bool short_imm = (sz && b->type == VAL_IMM && b->imm == (int8_t)b->imm && inst->op_i == 0x80);
 
-    // the destination can only be a GPR, no direction flag
+    // the destination can only be a GPR, no direction flag (TEST doesn't have one
+    // either but it's commutative so the memory operand goes in r/m either way, the
+    // bottom bits of a CMOVcc are the condition so those don't get one either)
     bool is_gpr_only_dst = (inst->op & 1);
-    bool dir_flag = (dir != is_gpr_only_dst) && inst->op != 0x69;
+    bool dir_flag = (dir != is_gpr_only_dst) && inst->op != 0x69 && type != TEST && !(type >= CMOVO && type <= CMOVG);
 
     if (inst->cat != INST_BINOP_EXT3) {
         // Address size prefix
@@ -274,6 +276,18 @@ static void inst2sse(TB_CGEmitter* restrict e, InstType type, const Val* a, cons
         SWAP(const Val*, a, b);
     }
 
+    // register copies are movaps, movss/movsd only write the bottom of the
+    // register so they'd wait on whatever was in there before.
+    if (type == FP_MOV && a->type == VAL_XMM && b->type == VAL_XMM) {
+        if (a->reg >= 8 || b->reg >= 8) {
+            EMIT1(e, rex(false, a->reg, b->reg, 0));
+        }
+        EMIT1(e, 0x0F);
+        EMIT1(e, 0x28);
+        EMIT1(e, mod_rx_rm(MOD_DIRECT, a->reg, b->reg));
+        return;
+    }
+
     uint8_t rx = a->reg;
     uint8_t base, index;
     if (b->type == VAL_MEM) {
@@ -0,0 +1,129 @@
+// Microbenchmarks for the hash maps & sets in common/, each test gets the best
+// of a few runs in nanoseconds per operation.
+#include <common.h>
+#include <arena.h>
+#include <perf.h>
+#include <hash_map.h>
+#include <hash_set.h>
+
+#define RUNS 5
+
+typedef struct {
+    int x, y;
+} Pair;
+
+static uint32_t pair_hash(void* a) {
+    Pair* p = a;
+    return p->x * 31 + p->y;
+}
+
+static bool pair_cmp(void* a, void* b) {
+    Pair *pa = a, *pb = b;
+    return pa->x == pb->x && pa->y == pb->y;
+}
+
+static void** keys;
+static char** strs;
+static Pair* pairs;
+
+static void report(const char* name, size_t n, uint64_t best) {
+    printf("  %-24s %8.2f ns/op\n", name, (double) best / (double) n);
+}
+
+#define BENCH(name, n, setup, body) do { \
+    uint64_t best = UINT64_MAX;          \
+    for (int run = 0; run < RUNS; run++) { \
+        setup;                           \
+        uint64_t t0 = cuik_time_in_nanos(); \
+        body;                            \
+        uint64_t t = cuik_time_in_nanos() - t0; \
+        if (t < best) best = t;          \
+    }                                    \
+    report(name, n, best);               \
+} while (0)
+
+static void bench(size_t n) {
+    printf("%zu keys:\n", n);
+
+    volatile size_t sink = 0;
+
+    // pointer keys, like the scheduler's maps
+    NL_Map(void*, size_t) map = NULL;
+    BENCH("map insert", n, nl_map_free(map), {
+        nl_map_create(map, 16);
+        for (size_t i = 0; i < n; i++) nl_map_put(map, keys[i], i);
+    });
+    BENCH("map get (hit)", n, (void) 0, {
+        for (size_t i = 0; i < n; i++) sink += map[nl_map_get(map, keys[i])].v;
+    });
+    BENCH("map get (miss)", n, (void) 0, {
+        for (size_t i = 0; i < n; i++) {
+            void* k = (char*) keys[i] + 1;
+            sink += nl_map_get(map, k);
+        }
+    });
+    nl_map_free(map);
+
+    // string keys, like the linker's symbol tables
+    NL_Strmap(size_t) strmap = NULL;
+    BENCH("strmap insert", n, nl_map_free(strmap), {
+        nl_map_create(strmap, 16);
+        for (size_t i = 0; i < n; i++) nl_map_put_cstr(strmap, strs[i], i);
+    });
+    BENCH("strmap get (hit)", n, (void) 0, {
+        for (size_t i = 0; i < n; i++) sink += nl_map_get_cstr(strmap, strs[i]);
+    });
+    nl_map_free(strmap);
+
+    // pointer sets
+    NL_HashSet set = nl_hashset_alloc(16);
+    BENCH("set put", n, (nl_hashset_free(set), set = nl_hashset_alloc(16)), {
+        for (size_t i = 0; i < n; i++) nl_hashset_put(&set, keys[i]);
+    });
+    BENCH("set lookup (hit)", n, (void) 0, {
+        for (size_t i = 0; i < n; i++) sink += nl_hashset_lookup(&set, keys[i]);
+    });
+    BENCH("set remove + put", n, (void) 0, {
+        for (size_t i = 0; i < n; i++) {
+            nl_hashset_remove(&set, keys[i]);
+            nl_hashset_put(&set, keys[i]);
+        }
+    });
+    nl_hashset_free(set);
+
+    // custom hashes, like GVN
+    NL_HashSet gvn = nl_hashset_alloc(16);
+    BENCH("set put2", n, (nl_hashset_free(gvn), gvn = nl_hashset_alloc(16)), {
+        for (size_t i = 0; i < n; i++) nl_hashset_put2(&gvn, &pairs[i], pair_hash, pair_cmp);
+    });
+    BENCH("set get2 (hit)", n, (void) 0, {
+        for (size_t i = 0; i < n; i++) sink += (size_t) nl_hashset_get2(&gvn, &pairs[i], pair_hash, pair_cmp);
+    });
+    nl_hashset_free(gvn);
+}
+
+int main(int argc, char** argv) {
+    cuik_init_timer_system();
+
+    size_t max = 1 << 20;
+    keys  = cuik_malloc(max * sizeof(void*));
+    strs  = cuik_malloc(max * sizeof(char*));
+    pairs = cuik_malloc(max * sizeof(Pair));
+
+    // spaced out like real allocations
+    char* base = cuik_malloc(max * 32);
+    for (size_t i = 0; i < max; i++) {
+        keys[i] = &base[i * 32];
+
+        char tmp[64];
+        snprintf(tmp, sizeof(tmp), "_ZN4some9namespace%zuE", i * 2654435761u);
+        strs[i] = cuik_strdup(tmp);
+
+        pairs[i] = (Pair){ i, i >> 3 };
+    }
+
+    for (size_t n = 1 << 10; n <= max; n <<= 5) {
+        bench(n);
+    }
+    return 0;
+}
@@ -0,0 +1,24 @@
+#include <stdio.h>
+
+// none of these fit in a default stack without tail calls
+static long long sum(long long n, long long acc) {
+    if (n == 0) return acc;
+    return sum(n - 1, acc + n);
+}
+
+static int is_odd(unsigned n);
+static int is_even(unsigned n) {
+    if (n == 0) return 1;
+    return is_odd(n - 1);
+}
+
+static int is_odd(unsigned n) {
+    if (n == 0) return 0;
+    return is_even(n - 1);
+}
+
+int main() {
+    printf("%lld\n", sum(100000000, 0));
+    printf("%d %d\n", is_even(50000000), is_odd(50000000));
+    return 0;
+}